@@ -0,0 +1,101 @@
+/**
+ * @file    FreeRTOSConfig.h
+ * @author  Deadline--
+ * @brief   FreeRTOS内核配置
+ * @version 0.2
+ * @date    2023-12-13
+ * @note    仅在`SYS_SUPPORT_OS`为1时使用, 内核源码放在Middlewares/FreeRTOS,
+ *          移植层使用portable/RVDS/ARM_CM4F. 内核不在仓库中, 此配置没有编译过.
+ *          任务和内核对象全部静态分配, 不使用heap_x.c.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+#define configCPU_CLOCK_HZ (SystemCoreClock)
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
+
+#define configUSE_PREEMPTION 1
+#define configUSE_TICKLESS_IDLE 0
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configMAX_PRIORITIES 5
+#define configMINIMAL_STACK_SIZE ((uint16_t)128)
+#define configMAX_TASK_NAME_LEN 12
+#define configUSE_16_BIT_TICKS 0
+#define configIDLE_SHOULD_YIELD 1
+#define configUSE_TASK_NOTIFICATIONS 1
+#define configUSE_MUTEXES 0
+#define configUSE_RECURSIVE_MUTEXES 0
+#define configUSE_COUNTING_SEMAPHORES 0
+#define configQUEUE_REGISTRY_SIZE 0
+#define configUSE_QUEUE_SETS 0
+#define configUSE_TIME_SLICING 1
+#define configUSE_NEWLIB_REENTRANT 0
+
+/* 内存分配: 只用静态分配 */
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 0
+
+/* 钩子函数 */
+/* 空闲任务睡眠到下一个中断, SysTick每个节拍唤醒一次 */
+#define configUSE_IDLE_HOOK 1
+#define configUSE_TICK_HOOK 0
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define configUSE_MALLOC_FAILED_HOOK 0
+
+/* 运行统计, 用DWT周期计数器作为运行时间, 供profiler计算CPU负载.
+ * 睡眠时DWT停止计数, 睡眠时间由delay_get_sleep_cycles单独统计 */
+extern void DWT_Init(void);
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() DWT_Init()
+/* DWT->CYCCNT, 这里不能包含CMSIS头文件, 直接使用寄存器地址 */
+#define portGET_RUN_TIME_COUNTER_VALUE() (*(volatile uint32_t*)0xE0001004UL)
+#define configUSE_TRACE_FACILITY 0
+#define configUSE_STATS_FORMATTING_FUNCTIONS 0
+
+/* 软件定时器, 控制任务用xTaskDelayUntil定时, 不需要定时器任务 */
+#define configUSE_TIMERS 0
+
+/* 可选API */
+#define INCLUDE_vTaskPrioritySet 0
+#define INCLUDE_uxTaskPriorityGet 0
+#define INCLUDE_vTaskDelete 0
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_xTaskDelayUntil 1
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_xTaskGetIdleTaskHandle 1
+
+/* 中断优先级, STM32F4使用4位优先级, HAL_Init已设置为NVIC_PRIORITYGROUP_4 */
+#ifdef __NVIC_PRIO_BITS
+#define configPRIO_BITS __NVIC_PRIO_BITS
+#else
+#define configPRIO_BITS 4
+#endif
+
+/* 最低中断优先级 */
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY 15
+/* 可以调用FromISR函数的最高中断优先级, CAN(1)和串口(2)中断会通知任务 */
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 1
+
+#define configKERNEL_INTERRUPT_PRIORITY \
+    (configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY \
+    (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+
+/* 移植层中断函数映射到启动文件中的向量名, SysTick_Handler在delay.c中实现 */
+#define vPortSVCHandler SVC_Handler
+#define xPortPendSVHandler PendSV_Handler
+
+#define configASSERT(x)           \
+    if ((x) == 0) {               \
+        taskDISABLE_INTERRUPTS(); \
+        for (;;)                  \
+            ;                     \
+    }
+
+#endif /* FREERTOS_CONFIG_H */
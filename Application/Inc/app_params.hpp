@@ -0,0 +1,62 @@
+/**
+ * @file    app_params.hpp
+ * @author  Deadline--
+ * @brief   demo的运行时参数表
+ * @version 0.1
+ * @date    2023-12-24
+ * @note    给定值、增益、控制周期、速度估计滤波系数和看门狗期限都登记在
+ *          参数表中, 上位机用二进制GET/SET指令读写(见param.h), 不需要重新编译.
+ *          设置的参数在控制循环下一个周期开始时一起生效.
+ *          文本指令修改的也是这里的给定值, 两种方式可以混用.
+ */
+
+#ifndef __APP_PARAMS_H
+#define __APP_PARAMS_H
+
+#include "ak_config.hpp"
+#include "param.h"
+
+/**
+ * @brief 参数ID, 也是参数表的下标, 已经发布的ID不要改变
+ *
+ */
+typedef enum {
+    APP_PARAM_MIT_POS = 0,    /*!< 运控模式目标位置 */
+    APP_PARAM_MIT_SPD,        /*!< 运控模式目标速度 */
+    APP_PARAM_MIT_KP,         /*!< 运控模式位置增益 */
+    APP_PARAM_MIT_KD,         /*!< 运控模式速度增益 */
+    APP_PARAM_MIT_TORQUE,     /*!< 运控模式前馈扭矩 */
+    APP_PARAM_MIT_PERIOD,     /*!< 运控模式控制周期(ms) */
+    APP_PARAM_SERVO_POS,      /*!< 伺服模式位置 */
+    APP_PARAM_SERVO_RPM,      /*!< 伺服模式转速 */
+    APP_PARAM_SERVO_CURRENT,  /*!< 伺服模式电流 */
+    APP_PARAM_SERVO_PERIOD,   /*!< 伺服模式控制周期(ms) */
+    APP_PARAM_EST_ALPHA,      /*!< 速度估计位置修正系数 */
+    APP_PARAM_EST_BETA,       /*!< 速度估计速度修正系数 */
+    APP_PARAM_WDG_TIMEOUT,    /*!< 回包看门狗期限(us) */
+    APP_PARAM_LOOP_COUNT,     /*!< 控制周期计数, 只读 */
+    APP_PARAM_NUM,
+} App_Param_Id_t;
+
+/**
+ * @brief 参数表中的变量, 只在控制循环中读取, 由`param_apply()`修改
+ *
+ */
+typedef struct {
+    float mit[5];             /*!< 位置, 速度, kp, kd, 扭矩 */
+    uint32_t mit_period_ms;   /*!< 运控模式控制周期(ms) */
+    float servo[3];           /*!< 位置, 转速, 电流, 非0的第一个生效 */
+    uint32_t servo_period_ms; /*!< 伺服模式控制周期(ms) */
+    float est_alpha;          /*!< 速度估计位置修正系数 */
+    float est_beta;           /*!< 速度估计速度修正系数 */
+    uint32_t wdg_timeout_us;  /*!< 回包看门狗期限(us) */
+    uint32_t loop_count;      /*!< 控制周期计数 */
+} App_Params_t;
+
+extern App_Params_t app_params;
+
+void app_params_init(void);
+void app_params_bind(AK_Motor_Class* motor, const AK_Config_Motor_t* cfg);
+bool app_params_poll(void);
+
+#endif /* __APP_PARAMS_H */
@@ -0,0 +1,52 @@
+/**
+ * @file    app_scope.hpp
+ * @author  Deadline--
+ * @brief   demo的示波器信号表
+ * @version 0.1
+ * @date    2023-12-25
+ * @note    信号包括电机回包状态、回包看门狗、控制周期计时和运行时参数中的
+ *          给定值. 控制循环在收到回包或超时之后调用`app_scope_sample()`,
+ *          先复制一次电机状态快照, 再记录选中的通道.
+ *          上位机用scope_capture.py选择信号、设置触发并导出CSV.
+ */
+
+#ifndef __APP_SCOPE_H
+#define __APP_SCOPE_H
+
+#include "ak_motor.hpp"
+#include "scope.h"
+
+/**
+ * @brief 信号ID, 也是信号表的下标
+ *
+ */
+typedef enum {
+    APP_SCOPE_T_US = 0,      /*!< 采样时刻time_us() */
+    APP_SCOPE_DT_US,         /*!< 与上一次调用的间隔(us) */
+    APP_SCOPE_REPLY_AGE_US,  /*!< 最近一帧回包距采样时刻(us) */
+    APP_SCOPE_POS,           /*!< 电机位置 */
+    APP_SCOPE_SPD,           /*!< 电机速度 */
+    APP_SCOPE_TORQUE,        /*!< 扭矩, 伺服模式为电流 */
+    APP_SCOPE_POS_MULTI,     /*!< 多圈位置 */
+    APP_SCOPE_SPD_EST,       /*!< 估计速度 */
+    APP_SCOPE_TEMP,          /*!< 温度 */
+    APP_SCOPE_ERROR,         /*!< 错误码 */
+    APP_SCOPE_STALE,         /*!< 回包过期 */
+    APP_SCOPE_WDG_MISS,      /*!< 回包超时累计次数 */
+    APP_SCOPE_MIT_POS,       /*!< 运控模式给定值 */
+    APP_SCOPE_MIT_SPD,
+    APP_SCOPE_MIT_KP,
+    APP_SCOPE_MIT_KD,
+    APP_SCOPE_MIT_TORQUE,
+    APP_SCOPE_SERVO_POS,     /*!< 伺服模式给定值 */
+    APP_SCOPE_SERVO_RPM,
+    APP_SCOPE_SERVO_CURRENT,
+    APP_SCOPE_LOOP_COUNT,    /*!< 控制周期计数 */
+    APP_SCOPE_NUM,
+} App_Scope_Id_t;
+
+void app_scope_init(void);
+void app_scope_bind(AK_Motor_Class* motor);
+void app_scope_sample(void);
+
+#endif /* __APP_SCOPE_H */
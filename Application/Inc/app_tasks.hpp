@@ -0,0 +1,92 @@
+/**
+ * @file    app_tasks.hpp
+ * @author  Deadline--
+ * @brief   FreeRTOS任务划分: 控制任务, CAN发送任务, 遥测/指令任务
+ * @version 0.1
+ * @date    2023-12-10
+ * @note    仅在`SYS_SUPPORT_OS`为1时编译, 此时main在app_tasks.cpp中,
+ *          否则main.cpp中的main使用前后台循环.
+ *          FreeRTOS内核不在仓库中, 这部分代码没有在本仓库中编译和测试过,
+ *          也没有主机(POSIX移植层)构建.
+ */
+
+#ifndef __APP_TASKS_H
+#define __APP_TASKS_H
+
+#include "sys.h"
+
+#if SYS_SUPPORT_OS
+#if defined(__has_include)
+#if !__has_include("FreeRTOS.h")
+#error "SYS_SUPPORT_OS needs the FreeRTOS kernel in Middlewares/FreeRTOS"
+#endif
+#endif /* __has_include */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @defgroup 任务配置
+ * @{
+ */
+/* 控制周期(ms), 周期内等待回包, 超时记入统计 */
+#define APP_CTRL_PERIOD_MS 5U
+/* 遥测/指令任务轮询周期(ms) */
+#define APP_TELEM_PERIOD_MS 10U
+
+/* 优先级, 数字越大越高, 不能超过configMAX_PRIORITIES - 1 */
+#define APP_CTRL_TASK_PRIO 4
+#define APP_CAN_TX_TASK_PRIO 3
+#define APP_TELEM_TASK_PRIO 1
+
+/* 栈大小(字) */
+#define APP_CTRL_STACK_SIZE 256U
+#define APP_CAN_TX_STACK_SIZE 128U
+#define APP_TELEM_STACK_SIZE 512U
+
+/* 任务间队列长度, 必须是2的幂 */
+#define APP_SETPOINT_QUEUE_LEN 8U
+#define APP_STATE_QUEUE_LEN 16U
+/**
+ * @}
+ */
+
+/**
+ * @brief 遥测任务发给控制任务的指令
+ *
+ */
+typedef enum {
+    APP_CMD_NONE = 0, /*!< 只更新给定值 */
+    APP_CMD_ENTER,    /*!< 进入电机控制 */
+    APP_CMD_EXIT,     /*!< 退出电机控制 */
+    APP_CMD_ORIGIN,   /*!< 设置原点 */
+} App_Cmd_t;
+
+/**
+ * @brief 控制给定值
+ *
+ */
+typedef struct {
+    App_Cmd_t cmd;  /*!< 指令 */
+    float value[5]; /*!< 位置, 速度, kp, kd, 扭矩 */
+} App_Setpoint_t;
+
+/**
+ * @brief 调度统计, 用于测量调度延迟和吞吐量
+ *
+ */
+typedef struct {
+    uint32_t ctrl_cycles;     /*!< 控制周期数 */
+    uint32_t ctrl_overruns;   /*!< 控制任务错过唤醒时刻的次数 */
+    uint32_t reply_timeouts;  /*!< 周期内没有收齐回包的次数 */
+    uint32_t reply_ticks_max; /*!< 发出指令到收齐回包的最大节拍数 */
+    uint32_t state_dropped;   /*!< 状态队列满被丢弃的快照数 */
+    volatile bool ctrl_running; /*!< 控制任务是否在控制电机, 仅控制任务修改 */
+} App_Stats_t;
+
+extern App_Stats_t app_stats;
+
+void app_tasks_start(void);
+
+#endif /* SYS_SUPPORT_OS */
+
+#endif /* __APP_TASKS_H */
@@ -15,11 +15,20 @@ __asm(".global __ARM_use_no_argv \n\t");
 extern "C" {
 #endif /* __cplusplus */
 
+#include "ak_bus_budget.hpp"
+#include "ak_config.hpp"
 #include "ak_motor.hpp"
+#include "ak_scan.hpp"
+#include "app_params.hpp"
+#include "app_scope.hpp"
+#include "app_tasks.hpp"
 #include "can.h"
 #include "delay.h"
+#include "fault_rec.h"
 #include "key.h"
 #include "led.h"
+#include "num_parse.h"
+#include "profiler.h"
 #include "stdlib.h"
 #include "string.h"
 #include "sys.h"
@@ -29,8 +38,44 @@ extern "C" {
 }
 #endif /* __cplusplus */
 
+/* 运控模式demo控制周期(ms), 回包触发控制时为回包超时时间 */
+#define MIT_CTRL_PERIOD_MS 25
+/* 回包触发控制时运控模式demo的最高控制频率(Hz), 回包早到时补齐周期,
+   带宽按此频率规划 */
+#define MIT_TRIGGER_MAX_HZ 200U
+/* 伺服模式demo控制周期(ms) */
+#define SERVO_CTRL_PERIOD_MS 25
+/* demo电机的默认CAN ID, 配置中有同模式的电机时使用配置 */
+#define MIT_MOTOR_ID   01U
+#define SERVO_MOTOR_ID 104U
+/* 启动时扫描的CAN ID范围 */
+#define SCAN_FIRST_ID 1U
+#define SCAN_LAST_ID  127U
+/* CAN波特率(bps), 与bsp_init中CAN1_Init/CAN2_Init的配置一致 */
+#define CAN1_BITRATE 1000000U
+
+/* 编译期检查: 1Mbps总线能承载demo的电机数量和控制频率 */
+static_assert(ak_bus_max_loop_hz(CAN1_BITRATE, 1, 0, AK_BUS_LOAD_LIMIT) >=
+                  1000U / MIT_CTRL_PERIOD_MS,
+              "CAN bus cannot carry mit_demo loop rate");
+static_assert(ak_bus_max_loop_hz(CAN1_BITRATE, 0, 1, AK_BUS_LOAD_LIMIT) >=
+                  1000U / SERVO_CTRL_PERIOD_MS,
+              "CAN bus cannot carry servo_demo loop rate");
+#if AK_REPLY_TRIGGER_ENABLE
+static_assert(ak_bus_max_loop_hz(CAN1_BITRATE, 1, 0, AK_BUS_LOAD_LIMIT) >=
+                  MIT_TRIGGER_MAX_HZ,
+              "CAN bus cannot carry mit_demo reply-triggered loop rate");
+#endif /* AK_REPLY_TRIGGER_ENABLE */
+
 int main(void);
+void app_init(void);
 void bsp_init(void);
-char* my_strtok_r(char* str, const char* delim, char** save);
-void servo_demo(void);
-void mit_demo(void);
+bool parse_command(float* values, uint32_t count);
+bool bus_budget_check(uint32_t loop_hz);
+void motor_config(void);
+void motor_scan(void);
+void motor_record(AK_Motor_Class& motor, float cmd_pos, float cmd_torque);
+const AK_Config_Motor_t* demo_motor_config(AK_Ctrlmode_t mode,
+                                           uint32_t default_id);
+bool servo_demo(void);
+bool mit_demo(void);
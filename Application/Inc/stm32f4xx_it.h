@@ -40,6 +40,7 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void sys_tick_hook(void);
 
 #ifdef __cplusplus
 }
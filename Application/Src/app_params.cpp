@@ -0,0 +1,132 @@
+/**
+ * @file    app_params.cpp
+ * @author  Deadline--
+ * @brief   demo的运行时参数表
+ * @version 0.1
+ * @date    2023-12-24
+ */
+
+#include "main.hpp"
+
+App_Params_t app_params; /* 参数表中的变量 */
+
+static AK_Motor_Class* app_param_motor = NULL; /* 当前控制的电机 */
+
+/**
+ * @brief 速度估计滤波系数改变, 写入电机的估计器
+ *
+ * @param id 参数ID
+ */
+static void app_param_est_changed(uint16_t id) {
+    UNUSED(id);
+    if (app_param_motor != NULL) {
+        app_param_motor->set_vel_filter(app_params.est_alpha,
+                                        app_params.est_beta);
+    }
+}
+
+/**
+ * @brief 看门狗期限改变, 安全动作不变
+ *
+ * @param id 参数ID
+ */
+static void app_param_wdg_changed(uint16_t id) {
+    UNUSED(id);
+    if (app_param_motor != NULL) {
+        app_param_motor->set_watchdog(app_params.wdg_timeout_us,
+                                      app_param_motor->wdg.action);
+    }
+}
+
+/* 参数表, 下标与App_Param_Id_t一致. 运控模式的范围按最大的型号,
+ * 发送时再按型号限幅 */
+static const param_def_t app_param_table[APP_PARAM_NUM] = {
+    {"mit.pos", &app_params.mit[0], PARAM_F32, 0, -AK_MIT_LIM_POS,
+     AK_MIT_LIM_POS, NULL},
+    {"mit.spd", &app_params.mit[1], PARAM_F32, 0, -76.0f, 76.0f, NULL},
+    {"mit.kp", &app_params.mit[2], PARAM_F32, 0, 0.0f, AK_MIT_MAX_KP, NULL},
+    {"mit.kd", &app_params.mit[3], PARAM_F32, 0, 0.0f, AK_MIT_MAX_KD, NULL},
+    {"mit.torque", &app_params.mit[4], PARAM_F32, 0, -144.0f, 144.0f, NULL},
+    {"mit.period_ms", &app_params.mit_period_ms, PARAM_U32, 0, 1.0f, 1000.0f,
+     NULL},
+    {"servo.pos", &app_params.servo[0], PARAM_F32, 0, -MAX_POSITION,
+     MAX_POSITION, NULL},
+    {"servo.rpm", &app_params.servo[1], PARAM_F32, 0, -MAX_VELOCITY,
+     MAX_VELOCITY, NULL},
+    {"servo.current", &app_params.servo[2], PARAM_F32, 0, -MAX_CURRENT,
+     MAX_CURRENT, NULL},
+    {"servo.period_ms", &app_params.servo_period_ms, PARAM_U32, 0, 1.0f,
+     1000.0f, NULL},
+    {"est.alpha", &app_params.est_alpha, PARAM_F32, 0, 0.0f, 1.0f,
+     app_param_est_changed},
+    {"est.beta", &app_params.est_beta, PARAM_F32, 0, 0.0f, 1.0f,
+     app_param_est_changed},
+    {"wdg.timeout_us", &app_params.wdg_timeout_us, PARAM_U32, 0, 0.0f,
+     1000000.0f, app_param_wdg_changed},
+    {"loop.count", &app_params.loop_count, PARAM_U32, PARAM_FLAG_RO, 0.0f,
+     4294967295.0f, NULL},
+};
+
+/**
+ * @brief 参数设为默认值并登记参数表
+ *
+ */
+void app_params_init(void) {
+    memset(&app_params, 0, sizeof(app_params));
+#if SYS_SUPPORT_OS
+    app_params.mit_period_ms = APP_CTRL_PERIOD_MS;
+#else
+    app_params.mit_period_ms = MIT_CTRL_PERIOD_MS;
+#endif /* SYS_SUPPORT_OS */
+    app_params.servo_period_ms = SERVO_CTRL_PERIOD_MS;
+    app_params.est_alpha = AK_EST_ALPHA;
+    app_params.est_beta = AK_EST_BETA;
+    app_params.wdg_timeout_us = AK_WDG_TIMEOUT_US;
+    param_init(app_param_table, APP_PARAM_NUM);
+}
+
+/**
+ * @brief 开始控制一个电机, 给定值清零, 增益和看门狗期限取电机配置
+ *
+ * @param motor 电机对象, 控制结束前一直有效
+ * @param cfg 电机配置
+ * @note 在控制循环开始之前调用, 滤波系数保留上一次设置的值
+ */
+void app_params_bind(AK_Motor_Class* motor, const AK_Config_Motor_t* cfg) {
+    app_param_motor = motor;
+    memset(app_params.mit, 0, sizeof(app_params.mit));
+    memset(app_params.servo, 0, sizeof(app_params.servo));
+    app_params.mit[2] = cfg->kp;
+    app_params.mit[3] = cfg->kd;
+    app_params.wdg_timeout_us = cfg->wdg_timeout_us;
+    motor->set_vel_filter(app_params.est_alpha, app_params.est_beta);
+}
+
+/**
+ * @brief 处理串口收到的二进制帧(参数和示波器指令), 输出应答
+ *
+ * @return true-处理了一帧; false-没有收到帧
+ * @note CRC错误或不认识的帧直接丢弃, 上位机按超时重发
+ */
+bool app_params_poll(void) {
+#if EN_USART1_RX && USART1_BIN_ENABLE
+    static uint8_t reply[BIN_FRAME_MAX_LEN];
+    uint16_t sta = USART1_BIN_STA;
+    if ((sta & 0x8000U) == 0) {
+        return false;
+    }
+    if (bin_frame_check(USART1_BIN_BUF, sta & 0x3FFFU)) {
+        uint32_t len = param_handle(USART1_BIN_BUF, reply);
+        if (len == 0) {
+            len = scope_handle(USART1_BIN_BUF, reply);
+        }
+        if (len > 0) {
+            USART1_Write(reply, len);
+        }
+    }
+    USART1_BIN_STA = 0;
+    return true;
+#else
+    return false;
+#endif /* EN_USART1_RX && USART1_BIN_ENABLE */
+}
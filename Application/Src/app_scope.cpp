@@ -0,0 +1,103 @@
+/**
+ * @file    app_scope.cpp
+ * @author  Deadline--
+ * @brief   demo的示波器信号表
+ * @version 0.1
+ * @date    2023-12-25
+ */
+
+#include "main.hpp"
+
+/**
+ * @brief 每次采样前复制的电机状态, 信号表中的整数都扩展为32位
+ *
+ */
+typedef struct {
+    uint32_t t_us;          /*!< 采样时刻 */
+    uint32_t dt_us;         /*!< 与上一次调用的间隔 */
+    uint32_t reply_age_us;  /*!< 最近一帧回包距采样时刻 */
+    float pos;              /*!< 电机位置 */
+    float spd;              /*!< 电机速度 */
+    float torque;           /*!< 扭矩或电流 */
+    float pos_multi;        /*!< 多圈位置 */
+    float spd_est;          /*!< 估计速度 */
+    int32_t temp;           /*!< 温度 */
+    uint32_t error;         /*!< 错误码 */
+    uint32_t stale;         /*!< 回包过期 */
+    uint32_t wdg_miss;      /*!< 回包超时累计次数 */
+} App_Scope_Vars_t;
+
+static App_Scope_Vars_t app_scope_vars;
+static AK_Motor_Class* app_scope_motor = NULL; /* 当前控制的电机 */
+
+/* 信号表, 下标与App_Scope_Id_t一致 */
+static const scope_signal_t app_scope_table[APP_SCOPE_NUM] = {
+    {"t_us", &app_scope_vars.t_us, PARAM_U32},
+    {"dt_us", &app_scope_vars.dt_us, PARAM_U32},
+    {"reply_age_us", &app_scope_vars.reply_age_us, PARAM_U32},
+    {"pos", &app_scope_vars.pos, PARAM_F32},
+    {"spd", &app_scope_vars.spd, PARAM_F32},
+    {"torque", &app_scope_vars.torque, PARAM_F32},
+    {"pos_multi", &app_scope_vars.pos_multi, PARAM_F32},
+    {"spd_est", &app_scope_vars.spd_est, PARAM_F32},
+    {"temp", &app_scope_vars.temp, PARAM_I32},
+    {"error", &app_scope_vars.error, PARAM_U32},
+    {"stale", &app_scope_vars.stale, PARAM_U32},
+    {"wdg.miss", &app_scope_vars.wdg_miss, PARAM_U32},
+    {"mit.pos", &app_params.mit[0], PARAM_F32},
+    {"mit.spd", &app_params.mit[1], PARAM_F32},
+    {"mit.kp", &app_params.mit[2], PARAM_F32},
+    {"mit.kd", &app_params.mit[3], PARAM_F32},
+    {"mit.torque", &app_params.mit[4], PARAM_F32},
+    {"servo.pos", &app_params.servo[0], PARAM_F32},
+    {"servo.rpm", &app_params.servo[1], PARAM_F32},
+    {"servo.current", &app_params.servo[2], PARAM_F32},
+    {"loop.count", &app_params.loop_count, PARAM_U32},
+};
+
+/**
+ * @brief 登记信号表
+ *
+ */
+void app_scope_init(void) {
+    memset(&app_scope_vars, 0, sizeof(app_scope_vars));
+    scope_init(app_scope_table, APP_SCOPE_NUM);
+}
+
+/**
+ * @brief 开始控制一个电机
+ *
+ * @param motor 电机对象, 控制结束前一直有效
+ */
+void app_scope_bind(AK_Motor_Class* motor) {
+    app_scope_motor = motor;
+    app_scope_vars.t_us = time_us();
+}
+
+/**
+ * @brief 复制电机状态并记录一个采样点, 在控制循环中每个周期调用一次
+ *
+ * @note 没有开始采集时只更新计时
+ */
+void app_scope_sample(void) {
+    uint32_t now = time_us();
+    app_scope_vars.dt_us = now - app_scope_vars.t_us;
+    app_scope_vars.t_us = now;
+    if (app_scope_motor == NULL || scope_state() == SCOPE_IDLE ||
+        scope_state() == SCOPE_DONE) {
+        return;
+    }
+    AK_Motor_State_t state;
+    app_scope_motor->get_state(&state);
+    app_scope_vars.reply_age_us = now - state.rx_us;
+    app_scope_vars.pos = state.motor_pos;
+    app_scope_vars.spd = state.motor_spd;
+    app_scope_vars.torque = state.motor_cur_troq;
+    app_scope_vars.pos_multi = state.motor_pos_multi;
+    app_scope_vars.spd_est = state.motor_spd_est;
+    app_scope_vars.temp = state.motor_temperature;
+    app_scope_vars.error = state.error_code;
+    app_scope_vars.stale = state.stale;
+    app_scope_vars.wdg_miss = app_scope_motor->wdg.miss_total;
+    scope_sample();
+}
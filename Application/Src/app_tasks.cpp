@@ -0,0 +1,280 @@
+/**
+ * @file    app_tasks.cpp
+ * @author  Deadline--
+ * @brief   FreeRTOS任务划分: 控制任务, CAN发送任务, 遥测/指令任务
+ * @version 0.1
+ * @date    2023-12-10
+ * @note    任务之间不共享全局变量:
+ *          遥测任务 --Spsc_Ring--> 控制任务: 给定值和指令
+ *          遥测任务 --param暂存区--> 控制任务: 二进制指令设置的参数
+ *          控制任务 --Spsc_Ring--> 遥测任务: 电机状态快照
+ *          控制任务 --CAN发送队列--> CAN发送任务 --> 发送邮箱
+ *          中断只通过任务通知唤醒任务, 全部对象静态分配.
+ */
+
+#include "main.hpp"
+
+#if SYS_SUPPORT_OS
+
+App_Stats_t app_stats; /* 调度统计 */
+
+static Spsc_Ring<App_Setpoint_t, APP_SETPOINT_QUEUE_LEN> app_setpoint_queue;
+static Spsc_Ring<AK_Motor_State_t, APP_STATE_QUEUE_LEN> app_state_queue;
+
+static StaticTask_t app_ctrl_tcb;
+static StackType_t app_ctrl_stack[APP_CTRL_STACK_SIZE];
+static TaskHandle_t app_ctrl_task = NULL;
+
+static StaticTask_t app_can_tx_tcb;
+static StackType_t app_can_tx_stack[APP_CAN_TX_STACK_SIZE];
+static TaskHandle_t app_can_tx_task = NULL;
+
+static StaticTask_t app_telem_tcb;
+static StackType_t app_telem_stack[APP_TELEM_STACK_SIZE];
+static TaskHandle_t app_telem_task = NULL;
+
+static StaticTask_t app_idle_tcb;
+static StackType_t app_idle_stack[configMINIMAL_STACK_SIZE];
+
+/**
+ * @brief 在线程或中断中通知任务
+ *
+ * @param task 任务句柄
+ */
+static void app_notify(TaskHandle_t task) {
+    if (__get_IPSR() != 0) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(task);
+    }
+}
+
+/**
+ * @brief 控制组回包全部到达, 在CAN接收中断中调用
+ *
+ */
+void ak_group_ready_callback(void) {
+    if (app_ctrl_task != NULL) {
+        app_notify(app_ctrl_task);
+    }
+}
+
+/**
+ * @brief 发送队列有新帧或邮箱空闲, 唤醒CAN发送任务
+ *
+ * @param bus 总线编号
+ * @note 调度器启动前直接装填邮箱
+ */
+void CAN_TX_Request_Callback(CAN_Bus_t bus) {
+    if (app_can_tx_task == NULL) {
+        CAN_TX_Poll(bus);
+        return;
+    }
+    app_notify(app_can_tx_task);
+}
+
+/**
+ * @brief 控制任务, 按固定周期发送运控指令并等待回包
+ *
+ * @param arg 未使用
+ */
+static void app_ctrl_entry(void* arg) {
+    const AK_Config_Motor_t* cfg = demo_motor_config(AK_MIT_Mode, MIT_MOTOR_ID);
+    AK_Motor_Class motor(cfg->id, (AK_motor_model_t)cfg->model, AK_MIT_Mode,
+                         (CAN_Bus_t)cfg->bus);
+    float* setpoint = app_params.mit;
+    App_Setpoint_t input;
+    AK_Motor_State_t state;
+    bool running = false;
+
+    AK_Config_Class::apply(motor, *cfg);
+    app_params_bind(&motor, cfg);
+    app_scope_bind(&motor);
+    motor.set_reply_trigger(true);
+    fault_rec_wdg_start(); /* 只由控制任务喂狗 */
+    TickType_t wake = xTaskGetTickCount();
+    while (1) {
+        if (xTaskDelayUntil(&wake, pdMS_TO_TICKS(app_params.mit_period_ms)) ==
+            pdFALSE) {
+            app_stats.ctrl_overruns++;
+        }
+        app_stats.ctrl_cycles++;
+        fault_rec_kick();
+        /* 二进制指令设置的参数在周期开始时一起生效 */
+        param_apply();
+        scope_apply();
+        app_params.loop_count++;
+
+        /* 只保留最新的给定值, 指令逐条执行 */
+        while (app_setpoint_queue.pop(input)) {
+            if (input.cmd == APP_CMD_ENTER) {
+                ak_estop_clear(); /* 进入控制时解除急停 */
+                motor.mit_can_enter_motor();
+                running = true;
+                app_stats.ctrl_running = true;
+            } else if (input.cmd == APP_CMD_EXIT) {
+                motor.mit_can_exit_motor();
+                running = false;
+                app_stats.ctrl_running = false;
+            } else if (input.cmd == APP_CMD_ORIGIN) {
+                motor.mit_can_set_origin();
+            } else {
+                memcpy(setpoint, input.value, sizeof(input.value));
+            }
+        }
+        AK_Config_Class::clamp(*cfg, setpoint[0], setpoint[1], setpoint[4]);
+        if (ak_estop_active()) {
+            running = false; /* 停止帧已在按键中断中发出 */
+            app_stats.ctrl_running = false;
+        }
+        if (running == false) {
+            continue;
+        }
+
+        ulTaskNotifyTake(pdTRUE, 0); /* 清除上一周期迟到的通知 */
+        TickType_t sent = xTaskGetTickCount();
+        ak_group_arm();
+        motor.mit_can_send_data(setpoint[0], setpoint[1], setpoint[2],
+                                setpoint[3], setpoint[4]);
+        /* 最多等到下一个唤醒时刻. 超时后wake停在过去, 已经晚于下一个
+           唤醒时刻时不再等待, 无符号相减会回绕成接近永久的超时 */
+        TickType_t period = pdMS_TO_TICKS(app_params.mit_period_ms);
+        TickType_t next = wake + period;
+        TickType_t timeout =
+            (TickType_t)(sent - wake) >= period ? 0 : next - sent;
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            app_stats.reply_timeouts++;
+            app_scope_sample();
+            motor_record(motor, setpoint[0], setpoint[4]);
+            continue;
+        }
+        uint32_t ticks = (uint32_t)(xTaskGetTickCount() - sent);
+        if (ticks > app_stats.reply_ticks_max) {
+            app_stats.reply_ticks_max = ticks;
+        }
+        app_scope_sample();
+        motor_record(motor, setpoint[0], setpoint[4]);
+        motor.get_state(&state);
+        if (app_state_queue.push(state) == false) {
+            app_stats.state_dropped++;
+        }
+    }
+}
+
+/**
+ * @brief CAN发送任务, 把两条总线发送队列中的帧装入各自的邮箱
+ *
+ * @param arg 未使用
+ */
+static void app_can_tx_entry(void* arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+            CAN_TX_Poll((CAN_Bus_t)bus);
+        }
+    }
+}
+
+/**
+ * @brief 遥测/指令任务, 解析串口指令, 输出电机状态
+ *
+ * @param arg 未使用
+ */
+static void app_telem_entry(void* arg) {
+    App_Setpoint_t setpoint;
+    AK_Motor_State_t state;
+    char line[AK_STATE_LINE_LEN];
+    uint8_t key;
+
+    while (1) {
+        setpoint.cmd = APP_CMD_NONE;
+        key = KEY_Get_Press();
+        if (key == KEY0_PRES) {
+            /* 按下KEY0进入控制 */
+            LED0_TOGGLE();
+            setpoint.cmd = APP_CMD_ENTER;
+            app_setpoint_queue.push(setpoint);
+        } else if (key == KEY1_PRES) {
+            /* 按下KEY1退出控制 */
+            LED0_TOGGLE();
+            setpoint.cmd = APP_CMD_EXIT;
+            app_setpoint_queue.push(setpoint);
+        }
+        app_params_poll(); /* 设置的参数由控制任务在周期开始时应用 */
+        LED1_Blink_Poll();
+        if (USART1_RX_STA & 0x8000) {
+            LED1_Blink();
+            if (strcmp((const char*)USART1_RX_BUF, "origin") == 0) {
+                setpoint.cmd = APP_CMD_ORIGIN;
+                app_setpoint_queue.push(setpoint);
+            } else if (ak_config_command((const char*)USART1_RX_BUF,
+                                         app_stats.ctrl_running == false)) {
+                /* 控制时不读写flash, 擦除期间所有任务都会停顿 */
+            } else if (parse_command(setpoint.value, 5)) {
+                setpoint.cmd = APP_CMD_NONE;
+                app_setpoint_queue.push(setpoint);
+            }
+            USART1_RX_STA = 0;
+        }
+        while (app_state_queue.pop(state)) {
+            USART1_Write(line, ak_state_format(line, &state));
+        }
+        PROF_REPORT_POLL();
+        vTaskDelay(pdMS_TO_TICKS(APP_TELEM_PERIOD_MS));
+    }
+}
+
+/**
+ * @brief 空闲任务钩子, 没有任务就绪时睡眠到下一个中断
+ *
+ */
+void vApplicationIdleHook(void) {
+    delay_sleep();
+}
+
+/**
+ * @brief 空闲任务使用的静态内存
+ *
+ */
+void vApplicationGetIdleTaskMemory(StaticTask_t** tcb,
+                                   StackType_t** stack,
+                                   uint32_t* stack_size) {
+    *tcb = &app_idle_tcb;
+    *stack = app_idle_stack;
+    *stack_size = configMINIMAL_STACK_SIZE;
+}
+
+/**
+ * @brief 主函数, 初始化后启动任务
+ *
+ * @return int 不会返回
+ */
+int main(void) {
+    app_init();
+    app_tasks_start();
+    return 0;
+}
+
+/**
+ * @brief 创建任务并启动调度器
+ *
+ * @note 不会返回
+ */
+void app_tasks_start(void) {
+    app_can_tx_task = xTaskCreateStatic(
+        app_can_tx_entry, "can_tx", APP_CAN_TX_STACK_SIZE, NULL,
+        APP_CAN_TX_TASK_PRIO, app_can_tx_stack, &app_can_tx_tcb);
+    app_ctrl_task =
+        xTaskCreateStatic(app_ctrl_entry, "ctrl", APP_CTRL_STACK_SIZE, NULL,
+                          APP_CTRL_TASK_PRIO, app_ctrl_stack, &app_ctrl_tcb);
+    app_telem_task = xTaskCreateStatic(
+        app_telem_entry, "telem", APP_TELEM_STACK_SIZE, NULL,
+        APP_TELEM_TASK_PRIO, app_telem_stack, &app_telem_tcb);
+    vTaskStartScheduler();
+    while (1)
+        ;
+}
+
+#endif /* SYS_SUPPORT_OS */
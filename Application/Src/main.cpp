@@ -8,17 +8,35 @@
 
 #include "main.hpp"
 
+#if !SYS_SUPPORT_OS /* 使用FreeRTOS时main在app_tasks.cpp中 */
 /**
- * @brief 主函数
+ * @brief 主函数, 前后台循环
  *
  * @return int
  */
 int main(void) {
-    bsp_init();
+    app_init();
+    while (mit_demo()) {
+    }
+    /* 总线过载, 原因已经输出, 不再重试 */
+    printf("#mit_demo stopped\r\n");
     while (1) {
-        mit_demo();
+        delay_sleep();
     }
 }
+#endif /* !SYS_SUPPORT_OS */
+/**
+ * @brief 初始化板驱动, 参数和电机, 前后台循环和FreeRTOS任务共用
+ *
+ */
+void app_init(void) {
+    bsp_init();
+    fault_rec_report();
+    app_params_init();
+    app_scope_init();
+    motor_config();
+    motor_scan();
+}
 /**
  * @brief 板驱动初始化
  *
@@ -27,60 +45,195 @@ void bsp_init(void) {
     HAL_Init();
     sys_stm32_clock_init(360, 25, 2, 8);
     delay_init(180);
+    time_init();
+    PROF_INIT();
     USART1_Init(115200);
+    fault_rec_init();
     LED_Init();
     KEY_Init();
     CAN1_Init(CAN_SJW_1TQ, CAN_BS2_8TQ, CAN_BS1_6TQ, 3, CAN_MODE_NORMAL);
+    CAN2_Init(CAN_SJW_1TQ, CAN_BS2_8TQ, CAN_BS1_6TQ, 3, CAN_MODE_NORMAL);
 }
 /**
- * @brief 分割字符串
+ * @brief 从flash读取电机配置并输出
  *
- * @param[in] str 待分割的字符串
- * @param[in] delim 分割符
- * @param[out] save 保存剩下的字符串指针
- * @return char* 剩下的字符串指针
  */
-char* my_strtok_r(char* str, const char* delim, char** save) {
-    char *res, *last;
-
-    if (!save)
-        return strtok(str, delim);
-    if (!str && !(str = *save))
-        return NULL;
-    last = str + strlen(str);
-    if ((*save = res = strtok(str, delim))) {
-        *save += strlen(res);
-        if (*save < last)
-            (*save)++;
-        else
-            *save = NULL;
-    }
-    return res;
+void motor_config(void) {
+    AK_Config_Status_t status = ak_config.load();
+    if (status != AK_CFG_OK) {
+        printf("#cfg load %s, status %d\r\n",
+               flash_store_status_str(ak_config.store_status), (int)status);
+    }
+    ak_config_report();
+}
+/**
+ * @brief 扫描两条总线上的电机, 把发现的电机加入配置
+ *
+ * @note 配置中已有电机且关闭了启动扫描时跳过.
+ *       扫描无法区分型号, 加入的电机都是`AK_CONFIG_DEFAULT_MODEL`.
+ *       加入的电机只在内存中, `cfg save`之后下次启动不再扫描
+ */
+void motor_scan(void) {
+#if AK_SCAN_ENABLE
+    static AK_Scan_Result_t scan_result;
+    if (ak_config.data.motor_num > 0 && ak_config.data.scan_at_boot == 0) {
+        return;
+    }
+    ak_scan_run((1U << CAN_BUS_1) | (1U << CAN_BUS_2), SCAN_FIRST_ID,
+                SCAN_LAST_ID, &scan_result);
+    ak_scan_report(&scan_result);
+    uint32_t num = scan_result.found;
+    if (num > AK_SCAN_MAX_FOUND) {
+        num = AK_SCAN_MAX_FOUND;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        const AK_Scan_Entry_t* entry = &scan_result.entry[i];
+        ak_config.add_motor(entry->bus, entry->id, AK_CONFIG_DEFAULT_MODEL,
+                            entry->mode);
+    }
+#endif /* AK_SCAN_ENABLE */
+}
+/**
+ * @brief demo使用的电机配置
+ *
+ * @param mode 控制模式
+ * @param default_id 配置中没有同模式的电机时使用的ID
+ * @return const AK_Config_Motor_t* 配置中第一个同模式的电机,
+ *         没有时为CAN1上default_id的默认配置
+ */
+const AK_Config_Motor_t* demo_motor_config(AK_Ctrlmode_t mode,
+                                           uint32_t default_id) {
+    static AK_Config_Motor_t fallback[2];
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        const AK_Config_Motor_t* cfg = ak_config.find((CAN_Bus_t)bus, mode);
+        if (cfg != NULL) {
+            return cfg;
+        }
+    }
+    AK_Config_Class::motor_defaults(&fallback[mode]);
+    fallback[mode].id = (uint8_t)default_id;
+    fallback[mode].mode = (uint8_t)mode;
+    return &fallback[mode];
+}
+/**
+ * @brief 急停按键按下, 在按键EXTI中断中调用
+ *
+ * @param start_cycles 进入中断时的DWT周期计数
+ */
+void KEY_Estop_Callback(uint32_t start_cycles) {
+    ak_estop(start_cycles);
+}
+/**
+ * @brief 解析串口收到的一行数字指令, 出错时输出错误位置
+ *
+ * @param[out] values 结果, 出错时不修改
+ * @param count 字段数
+ * @return true-成功; false-格式错误
+ */
+bool parse_command(float* values, uint32_t count) {
+    uint32_t pos = 0;
+    num_parse_status_t status = num_parse_csv((const char*)USART1_RX_BUF,
+                                              values, count, 0.0f, &pos);
+    if (status != NUM_PARSE_OK) {
+        printf("#parse error: %s at %lu\r\n", num_parse_status_str(status),
+               (unsigned long)pos);
+        return false;
+    }
+    return true;
+}
+/**
+ * @brief 检查每条总线的带宽能否承载已注册的电机和控制频率
+ *
+ * @param loop_hz 控制频率(Hz)
+ * @return true-可以运行; false-有总线过载, 拒绝运行
+ */
+bool bus_budget_check(uint32_t loop_hz) {
+    AK_Bus_Budget_t budget;
+    bool ok = true;
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        AK_Bus_Status_t status = ak_bus_plan((CAN_Bus_t)bus, loop_hz, &budget);
+        if (status == AK_BUS_OK) {
+            continue;
+        }
+        printf("CAN%lu bus load %lu.%lu%% at %luHz, max %luHz\r\n",
+               (unsigned long)(bus + 1),
+               (unsigned long)(budget.load_permille / 10),
+               (unsigned long)(budget.load_permille % 10),
+               (unsigned long)loop_hz, (unsigned long)budget.max_loop_hz);
+        if (status == AK_BUS_OVERLOAD) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+/**
+ * @brief 把本周期的给定值和电机状态写入飞行记录
+ *
+ * @param motor 电机对象
+ * @param cmd_pos 给定位置
+ * @param cmd_torque 给定扭矩, 伺服模式为电流
+ */
+void motor_record(AK_Motor_Class& motor, float cmd_pos, float cmd_torque) {
+    AK_Motor_State_t state;
+    motor.get_state(&state);
+    uint8_t flags = 0;
+    if (state.stale) {
+        flags |= FAULT_REC_FLAG_STALE;
+    }
+    if (ak_estop_active()) {
+        flags |= FAULT_REC_FLAG_ESTOP;
+    }
+    fault_rec_log(cmd_pos, cmd_torque, state.motor_pos, state.motor_spd,
+                  state.motor_cur_troq, state.error_code, flags);
+}
+/**
+ * @brief 擦除flash扇区之前喂看门狗, 擦除期间CPU停顿
+ *
+ */
+void flash_store_erase_callback(void) {
+    fault_rec_kick();
 }
 /**
  * @brief 伺服模式demo程序
  *
+ * @return false-总线过载, 拒绝运行; 否则不返回
  */
-void servo_demo(void) {
-    float moto_value[3] = {0.0f};
+bool servo_demo(void) {
+    float* moto_value = app_params.servo;
+    const AK_Config_Motor_t* cfg =
+        demo_motor_config(AK_Servo_Mode, SERVO_MOTOR_ID);
     /* 实例化AK电机对象 */
-    AK_Motor_Class AK_Servo_Instance(104U, AK80_8);
+    AK_Motor_Class AK_Servo_Instance(cfg->id, (AK_motor_model_t)cfg->model,
+                                     AK_Servo_Mode, (CAN_Bus_t)cfg->bus);
+    AK_Config_Class::apply(AK_Servo_Instance, *cfg);
+    app_params_bind(&AK_Servo_Instance, cfg);
+    app_scope_bind(&AK_Servo_Instance);
+    if (bus_budget_check(1000U / app_params.servo_period_ms) == false) {
+        return false;
+    }
+    fault_rec_wdg_start();
     while (1) {
+        PROF_ENTER(PROF_MAIN_LOOP);
+        fault_rec_kick();
+        /* 二进制指令设置的参数在周期开始时一起生效 */
+        app_params_poll();
+        param_apply();
+        scope_apply();
+        app_params.loop_count++;
+        LED1_Blink_Poll();
         if (USART1_RX_STA & 0x8000) {
-            LED1_TOGGLE();
-            delay_ms(100);
-            LED1_TOGGLE();
-            char* save_ptr;
+            LED1_Blink(); /* 不阻塞, 指令速率不受闪烁限制 */
             if (strcmp((const char*)USART1_RX_BUF, "origin") == 0) {
                 AK_Servo_Instance.comm_can_set_origin(0);
-            }
-            moto_value[0] =
-                atof(my_strtok_r((char*)USART1_RX_BUF, ",", &save_ptr));
-            for (uint8_t i = 0; i < 2; i++) {
-                moto_value[i + 1] = atof(my_strtok_r(NULL, ",", &save_ptr));
+            } else if (ak_config_command((const char*)USART1_RX_BUF, false)) {
+                /* 控制时只修改内存中的配置 */
+            } else {
+                parse_command(moto_value, 3);
             }
             USART1_RX_STA = 0;
         }
+        AK_Config_Class::clamp(*cfg, moto_value[0], moto_value[1],
+                               moto_value[2]);
         if (moto_value[0] != 0) {
             AK_Servo_Instance.comm_can_set_pos(moto_value[0]);
         } else if (moto_value[1] != 0) {
@@ -88,52 +241,121 @@ void servo_demo(void) {
         } else if (moto_value[2] != 0) {
             AK_Servo_Instance.comm_can_set_current(moto_value[2]);
         }
-        delay_ms(25);
+        PROF_REPORT_POLL();
+        delay_ms(app_params.servo_period_ms);
+        app_scope_sample();
+        PROF_ENTER(PROF_FAULT_REC);
+        motor_record(AK_Servo_Instance, moto_value[0], moto_value[2]);
+        PROF_EXIT(PROF_FAULT_REC);
+        PROF_EXIT(PROF_MAIN_LOOP);
     }
 }
 
 /**
  * @brief 运控模式demo程序
  *
+ * @return true-按KEY1或急停退出控制; false-总线过载, 拒绝运行
+ * @note 回包触发控制时带宽按最高控制频率`MIT_TRIGGER_MAX_HZ`规划
  */
-void mit_demo(void) {
-    float moto_value[5] = {0.0f};
+bool mit_demo(void) {
+    const AK_Config_Motor_t* cfg = demo_motor_config(AK_MIT_Mode, MIT_MOTOR_ID);
+    float* moto_value = app_params.mit;
 
     /* 实例化AK电机对象 */
-    AK_Motor_Class AK_MIT_Instance(01U, AK80_8);
+    AK_Motor_Class AK_MIT_Instance(cfg->id, (AK_motor_model_t)cfg->model,
+                                   AK_MIT_Mode, (CAN_Bus_t)cfg->bus);
+    AK_Config_Class::apply(AK_MIT_Instance, *cfg);
+    app_params_bind(&AK_MIT_Instance, cfg);
+    app_scope_bind(&AK_MIT_Instance);
+#if AK_REPLY_TRIGGER_ENABLE
+    uint32_t loop_hz = MIT_TRIGGER_MAX_HZ;
+#else
+    uint32_t loop_hz = 1000U / app_params.mit_period_ms;
+#endif /* AK_REPLY_TRIGGER_ENABLE */
+    if (bus_budget_check(loop_hz) == false) {
+        return false;
+    }
 
-    /* 等待KEY0按下, 进入控制 */
-    while (KEY_Scan(0) != KEY0_PRES)
-        ;
+    /* 等待KEY0按下, 进入控制; 等待期间可以读写配置和参数 */
+    fault_rec_wdg_start();
+    while (KEY_Get_Press() != KEY0_PRES) {
+        fault_rec_kick();
+        app_params_poll();
+        param_apply();
+        if (USART1_RX_STA & 0x8000) {
+            ak_config_command((const char*)USART1_RX_BUF, true);
+            USART1_RX_STA = 0;
+        }
+        delay_sleep();
+    }
+    if (ak_estop_active()) {
+        /* KEY0解除急停, 输出上一次急停的延迟 */
+        printf("#estop %lu frames, queued %lu, sent %lu cycles\r\n",
+               (unsigned long)ak_estop_stats.frames,
+               (unsigned long)ak_estop_stats.cycles_queued,
+               (unsigned long)ak_estop_stats.cycles_sent);
+        ak_estop_clear();
+    }
     LED0_TOGGLE();
     AK_MIT_Instance.mit_can_enter_motor();
+#if AK_REPLY_TRIGGER_ENABLE
+    /* 回包到达即进入下一周期, 缩短测量到执行的延迟 */
+    AK_MIT_Instance.set_reply_trigger(true);
+#endif /* AK_REPLY_TRIGGER_ENABLE */
     uint8_t key;
     while (1) {
-        key = KEY_Scan(0);
-        if (key == KEY1_PRES) {
-            /* 按下KEY1退出控制 */
+        PROF_ENTER(PROF_MAIN_LOOP);
+        fault_rec_kick();
+        /* 二进制指令设置的参数在周期开始时一起生效 */
+        app_params_poll();
+        param_apply();
+        scope_apply();
+        app_params.loop_count++;
+        LED1_Blink_Poll();
+        key = KEY_Get_Press();
+        if (key == KEY1_PRES || ak_estop_active()) {
+            /* 按下KEY1退出控制; 急停时停止帧已经发出, 这里的指令不会发送 */
             LED0_TOGGLE();
             AK_MIT_Instance.mit_can_exit_motor();
-            return;
+            PROF_EXIT(PROF_MAIN_LOOP);
+            return true;
         }
         if (USART1_RX_STA & 0x8000) {
-            LED1_TOGGLE();
-            delay_ms(100);
-            LED1_TOGGLE();
-            char* save_ptr;
+            LED1_Blink(); /* 不阻塞, 指令速率不受闪烁限制 */
             if (strcmp((const char*)USART1_RX_BUF, "origin") == 0) {
                 AK_MIT_Instance.mit_can_set_origin();
-            }
-            moto_value[0] =
-                atof(my_strtok_r((char*)USART1_RX_BUF, ",", &save_ptr));
-            for (uint8_t i = 0; i < 4; i++) {
-                moto_value[i + 1] = atof(my_strtok_r(NULL, ",", &save_ptr));
+            } else if (ak_config_command((const char*)USART1_RX_BUF, false)) {
+                /* 控制时只修改内存中的配置 */
+            } else {
+                parse_command(moto_value, 5);
             }
             USART1_RX_STA = 0;
         }
+        AK_Config_Class::clamp(*cfg, moto_value[0], moto_value[1],
+                               moto_value[4]);
+#if AK_REPLY_TRIGGER_ENABLE
+        uint32_t cycle_end = time_deadline_us(1000000U / loop_hz);
+#endif /* AK_REPLY_TRIGGER_ENABLE */
+        ak_group_arm();
         AK_MIT_Instance.mit_can_send_data(moto_value[0], moto_value[1],
                                           moto_value[2], moto_value[3],
                                           moto_value[4]);
-        delay_ms(25);
+        PROF_REPORT_POLL();
+#if AK_REPLY_TRIGGER_ENABLE
+        ak_group_wait(app_params.mit_period_ms);
+        /* 回包早到时补齐最短周期, 控制频率不超过带宽规划的频率 */
+        PROF_ENTER(PROF_IDLE);
+        while (time_expired_us(cycle_end) == false) {
+            delay_sleep();
+        }
+        PROF_EXIT(PROF_IDLE);
+#else
+        delay_ms(app_params.mit_period_ms);
+#endif /* AK_REPLY_TRIGGER_ENABLE */
+        app_scope_sample();
+        PROF_ENTER(PROF_FAULT_REC);
+        motor_record(AK_MIT_Instance, moto_value[0], moto_value[4]);
+        PROF_EXIT(PROF_FAULT_REC);
+        PROF_EXIT(PROF_MAIN_LOOP);
     }
 }
@@ -22,6 +22,11 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_it.h"
 #include "stm32f4xx_hal.h"
+#include "sys.h"
+#include "profiler.h"
+#include "key.h"
+#include "ak_motor.hpp"
+#include "fault_rec.h"
 
 /** @addtogroup STM32F4xx_HAL_Examples
   * @{
@@ -57,12 +62,10 @@ void NMI_Handler(void)
   * @param  None
   * @retval None
   */
-void HardFault_Handler(void)
+FAULT_REC_NAKED void HardFault_Handler(void)
 {
-  /* Go to infinite loop when Hard Fault exception occurs */
-  while (1)
-  {
-  }
+  /* 保存现场到备份SRAM后复位, 启动时输出 */
+  FAULT_REC_HANDLER(FAULT_REC_HARD);
 }
 
 /**
@@ -70,12 +73,10 @@ void HardFault_Handler(void)
   * @param  None
   * @retval None
   */
-void MemManage_Handler(void)
+FAULT_REC_NAKED void MemManage_Handler(void)
 {
-  /* Go to infinite loop when Memory Manage exception occurs */
-  while (1)
-  {
-  }
+  /* 保存现场到备份SRAM后复位, 启动时输出 */
+  FAULT_REC_HANDLER(FAULT_REC_MEM);
 }
 
 /**
@@ -83,12 +84,10 @@ void MemManage_Handler(void)
   * @param  None
   * @retval None
   */
-void BusFault_Handler(void)
+FAULT_REC_NAKED void BusFault_Handler(void)
 {
-  /* Go to infinite loop when Bus Fault exception occurs */
-  while (1)
-  {
-  }
+  /* 保存现场到备份SRAM后复位, 启动时输出 */
+  FAULT_REC_HANDLER(FAULT_REC_BUS);
 }
 
 /**
@@ -96,12 +95,10 @@ void BusFault_Handler(void)
   * @param  None
   * @retval None
   */
-void UsageFault_Handler(void)
+FAULT_REC_NAKED void UsageFault_Handler(void)
 {
-  /* Go to infinite loop when Usage Fault exception occurs */
-  while (1)
-  {
-  }
+  /* 保存现场到备份SRAM后复位, 启动时输出 */
+  FAULT_REC_HANDLER(FAULT_REC_USAGE);
 }
 
 /**
@@ -109,9 +106,11 @@ void UsageFault_Handler(void)
   * @param  None
   * @retval None
   */
+#if !SYS_SUPPORT_OS /* 使用OS时由FreeRTOS移植层实现 */
 void SVC_Handler(void)
 {
 }
+#endif
 
 /**
   * @brief  This function handles Debug Monitor exception.
@@ -127,18 +126,43 @@ void DebugMon_Handler(void)
   * @param  None
   * @retval None
   */
+#if !SYS_SUPPORT_OS /* 使用OS时由FreeRTOS移植层实现 */
 void PendSV_Handler(void)
 {
 }
+#endif
 
 /**
   * @brief  This function handles SysTick Handler.
   * @param  None
   * @retval None
   */
+#if !SYS_SUPPORT_OS /* 使用OS时在delay.c中实现 */
 void SysTick_Handler(void)
 {
+  sys_tick_hook();
+}
+#endif
+
+/**
+  * @brief  SysTick中的周期处理, 使用OS时由delay.c中的SysTick_Handler调用
+  * @param  None
+  * @retval None
+  */
+void sys_tick_hook(void)
+{
+  PROF_ENTER(PROF_SYSTICK);
   HAL_IncTick();
+#if KEY_EXTI_ENABLE
+  KEY_Tick();     /* 按键消抖 */
+#endif
+#if AK_WDG_ENABLE
+  ak_wdg_tick();  /* 电机回包看门狗 */
+#endif
+#if CAN_ERR_ENABLE
+  CAN_Err_Tick(); /* CAN错误状态和离线恢复 */
+#endif
+  PROF_EXIT(PROF_SYSTICK);
 }
 
 /******************************************************************************/
@@ -0,0 +1,105 @@
+/**
+ * @file    ak_bus_budget.hpp
+ * @author  Deadline--
+ * @brief   CAN总线带宽规划
+ * @version 0.1
+ * @date    2023-12-08
+ * @note    每个控制周期每个电机占用一条指令帧和一条回包帧.
+ *          按最坏位填充计算一帧的位数, 判断当前注册的电机和控制频率
+ *          是否超出总线能力, 并给出最大可达控制频率.
+ *          帧位数和最大频率的计算都是`constexpr`, 可以在编译期用
+ *          `static_assert`检查配置.
+ */
+
+#ifndef __AK_BUS_BUDGET_H
+#define __AK_BUS_BUDGET_H
+
+#include "ak_motor.hpp"
+
+#define AK_BUS_LOAD_WARN  700U /*!< 总线负载告警阈值(千分比) */
+#define AK_BUS_LOAD_LIMIT 900U /*!< 总线负载上限(千分比), 超过则拒绝 */
+
+#define AK_MIT_CMD_DLC     8U /*!< 运控模式指令帧长度 */
+#define AK_MIT_REPLY_DLC   8U /*!< 运控模式回包帧长度 */
+#define AK_SERVO_CMD_DLC   8U /*!< 伺服模式指令帧最大长度(位置速度环) */
+#define AK_SERVO_REPLY_DLC 8U /*!< 伺服模式回包帧长度 */
+
+/**
+ * @brief 规划结果
+ *
+ */
+typedef enum {
+    AK_BUS_OK = 0,   /*!< 负载正常 */
+    AK_BUS_WARN,     /*!< 负载超过告警阈值 */
+    AK_BUS_OVERLOAD, /*!< 负载超过上限, 应拒绝该配置 */
+} AK_Bus_Status_t;
+
+/**
+ * @brief 规划详情
+ *
+ */
+typedef struct {
+    uint32_t bitrate;         /*!< 总线波特率(bps) */
+    uint32_t mit_motors;      /*!< 运控模式电机数量 */
+    uint32_t servo_motors;    /*!< 伺服模式电机数量 */
+    uint32_t bits_per_period; /*!< 每个控制周期占用的位数(最坏情况) */
+    uint32_t load_permille;   /*!< 总线负载(千分比) */
+    uint32_t max_loop_hz;     /*!< 负载上限内的最大控制频率 */
+} AK_Bus_Budget_t;
+
+/**
+ * @brief 一帧数据帧在总线上的最大位数
+ *
+ * @param ext `true`-扩展帧; `false`-标准帧
+ * @param dlc 数据长度
+ * @return 位数, 包含最坏情况的填充位和3位帧间隔
+ * @note 标准帧固定44位, 扩展帧固定64位; 从SOF到CRC的部分
+ *       (标准帧34位, 扩展帧54位, 加上数据)每4位最多填充1位.
+ *       8字节数据时, 不含填充分别为111位和131位, 最坏分别为135位和160位
+ */
+constexpr uint32_t ak_can_frame_bits(bool ext, uint32_t dlc) {
+    return ext ? (64U + 8U * dlc + 3U + (54U + 8U * dlc - 1U) / 4U)
+               : (44U + 8U * dlc + 3U + (34U + 8U * dlc - 1U) / 4U);
+}
+
+/**
+ * @brief 每个控制周期占用的位数
+ *
+ * @param mit_motors 运控模式电机数量
+ * @param servo_motors 伺服模式电机数量
+ * @return 位数(指令帧 + 回包帧)
+ */
+constexpr uint32_t ak_bus_bits_per_period(uint32_t mit_motors,
+                                          uint32_t servo_motors) {
+    return mit_motors * (ak_can_frame_bits(false, AK_MIT_CMD_DLC) +
+                         ak_can_frame_bits(false, AK_MIT_REPLY_DLC)) +
+           servo_motors * (ak_can_frame_bits(true, AK_SERVO_CMD_DLC) +
+                           ak_can_frame_bits(true, AK_SERVO_REPLY_DLC));
+}
+
+/**
+ * @brief 最大可达控制频率
+ *
+ * @param bitrate 总线波特率(bps)
+ * @param mit_motors 运控模式电机数量
+ * @param servo_motors 伺服模式电机数量
+ * @param load_permille 允许的总线负载(千分比)
+ * @return 控制频率(Hz), 没有电机时返回0
+ */
+constexpr uint32_t ak_bus_max_loop_hz(uint32_t bitrate,
+                                      uint32_t mit_motors,
+                                      uint32_t servo_motors,
+                                      uint32_t load_permille) {
+    return ak_bus_bits_per_period(mit_motors, servo_motors) == 0
+               ? 0
+               : (uint32_t)((uint64_t)bitrate * load_permille / 1000U /
+                            ak_bus_bits_per_period(mit_motors, servo_motors));
+}
+
+extern "C" {
+AK_Bus_Status_t ak_bus_plan(CAN_Bus_t bus,
+                            uint32_t loop_hz,
+                            AK_Bus_Budget_t* budget);
+}
+
+#endif /* __AK_BUS_BUDGET_H */
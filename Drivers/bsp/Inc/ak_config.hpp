@@ -0,0 +1,139 @@
+/**
+ * @file    ak_config.hpp
+ * @author  Deadline--
+ * @brief   电机配置, 保存在片内flash
+ * @version 0.1
+ * @date    2023-12-23
+ * @note    配置记录包括每个电机的CAN ID、总线、型号、控制模式、
+ *          运控模式默认增益、给定值限幅和回包看门狗, 以及启动时是否扫描.
+ *          记录带版本号和长度, 由`flash_store`双扇区轮换保存, 带CRC校验.
+ *          启动时读取一次, 有效时直接按配置创建电机, 不再重新扫描和设置.
+ *
+ *          上位机通过串口文本指令读写配置, `cfg`输出的第一行是版本和序号,
+ *          其余每行去掉开头的`#`就是对应的写入指令, 发回即可恢复配置:
+ *          - `cfg`: 输出全部配置
+ *          - `cfg motor i,id,bus,model,mode`: 设置第i个电机, i等于电机数时追加
+ *          - `cfg gain i,kp,kd`: 运控模式默认增益
+ *          - `cfg limit i,pos,spd,torque`: 给定值绝对值上限, 0不限制,
+ *            伺服模式为位置、转速、电流
+ *          - `cfg wdg i,timeout_us,action`: 回包看门狗, 见`AK_Safe_Action_t`
+ *          - `cfg scan 0|1`: 启动时是否扫描电机
+ *          - `cfg clear`: 删除所有电机
+ *          - `cfg save` / `cfg load` / `cfg erase`: 保存到flash / 从flash读取 /
+ *            擦除flash, 下次启动使用默认配置
+ *
+ *          升级版本时只能在记录末尾增加字段, 读取旧版本时末尾的新字段为默认值.
+ */
+
+#ifndef __AK_CONFIG_H
+#define __AK_CONFIG_H
+
+#include "ak_motor.hpp"
+#include "flash_store.h"
+
+/* 配置记录版本, 字段改变时加1 */
+#define AK_CONFIG_VERSION 1U
+/* 配置中最多的电机数量 */
+#define AK_CONFIG_MAX_MOTORS 8U
+/* 电机的默认型号, 扫描发现的电机也使用. 扫描无法区分型号,
+   型号不同时用`cfg motor`修改后保存 */
+#define AK_CONFIG_DEFAULT_MODEL AK80_8
+
+/**
+ * @brief 一个电机的配置
+ *
+ */
+typedef struct {
+    uint8_t id;              /*!< CAN ID */
+    uint8_t bus;             /*!< 所在总线, CAN_Bus_t */
+    uint8_t model;           /*!< 型号, AK_motor_model_t */
+    uint8_t mode;            /*!< 控制模式, AK_Ctrlmode_t */
+    uint8_t wdg_action;      /*!< 回包超时后的安全动作, AK_Safe_Action_t */
+    uint8_t reserved[3];     /*!< 保留, 写0 */
+    uint32_t wdg_timeout_us; /*!< 回包期限(us), 0不检查 */
+    float kp;                /*!< 运控模式默认位置增益 */
+    float kd;                /*!< 运控模式默认速度增益 */
+    float pos_limit;         /*!< 目标位置绝对值上限, 0不限制 */
+    float spd_limit;         /*!< 目标速度绝对值上限, 0不限制 */
+    float torque_limit;      /*!< 扭矩(伺服模式为电流)绝对值上限, 0不限制 */
+} AK_Config_Motor_t;
+
+/**
+ * @brief 配置记录
+ *
+ */
+typedef struct {
+    uint16_t version;     /*!< `AK_CONFIG_VERSION` */
+    uint16_t size;        /*!< 写入时的记录长度(字节) */
+    uint8_t motor_num;    /*!< 电机数量 */
+    uint8_t scan_at_boot; /*!< 启动时是否扫描电机 */
+    uint8_t reserved[2];  /*!< 保留, 写0 */
+    AK_Config_Motor_t motor[AK_CONFIG_MAX_MOTORS]; /*!< 电机配置 */
+} AK_Config_t;
+
+static_assert(sizeof(AK_Config_t) <= FLASH_STORE_MAX_LEN,
+              "AK_Config_t does not fit in one flash_store slot");
+
+/**
+ * @brief 读写结果
+ *
+ */
+typedef enum {
+    AK_CFG_OK = 0,       /*!< 成功 */
+    AK_CFG_DEFAULT,      /*!< flash中没有配置, 使用默认配置 */
+    AK_CFG_MIGRATED,     /*!< 读取的是旧版本, 新字段为默认值 */
+    AK_CFG_ERR_VERSION,  /*!< 版本比程序新或长度不对, 使用默认配置 */
+    AK_CFG_ERR_INVALID,  /*!< 字段超出范围, 没有修改配置 */
+    AK_CFG_ERR_STORE,    /*!< flash读写失败 */
+} AK_Config_Status_t;
+
+#ifdef __cplusplus
+/**
+ * @brief 电机配置, 程序中只有一个实例`ak_config`
+ *
+ */
+class AK_Config_Class {
+   public:
+    AK_Config_t data;                /*!< 当前配置 */
+    uint32_t seq;                    /*!< 读取或保存的flash记录序号, 0没有 */
+    flash_store_status_t store_status; /*!< 最近一次flash操作的结果 */
+
+    AK_Config_Class(void);
+
+    void set_defaults(void);
+    AK_Config_Status_t load(void);
+    AK_Config_Status_t save(void);
+    AK_Config_Status_t erase(void);
+
+    AK_Config_Status_t set_motor(uint32_t index, const AK_Config_Motor_t& motor);
+    int32_t add_motor(CAN_Bus_t bus,
+                      uint8_t id,
+                      AK_motor_model_t model,
+                      AK_Ctrlmode_t mode);
+    const AK_Config_Motor_t* find(CAN_Bus_t bus, AK_Ctrlmode_t mode) const;
+
+    static void motor_defaults(AK_Config_Motor_t* motor);
+    static bool motor_valid(const AK_Config_Motor_t& motor);
+    static void apply(AK_Motor_Class& motor, const AK_Config_Motor_t& cfg);
+    static void clamp(const AK_Config_Motor_t& cfg,
+                      float& pos,
+                      float& spd,
+                      float& torque);
+
+    /* 只有一个实例, 禁止拷贝 */
+    AK_Config_Class(const AK_Config_Class&) = delete;
+    AK_Config_Class& operator=(const AK_Config_Class&) = delete;
+
+   private:
+    bool valid(void) const;
+};
+
+extern AK_Config_Class ak_config;
+
+extern "C" {
+bool ak_config_command(const char* line, bool allow_write);
+void ak_config_report(void);
+}
+#endif /* __cplusplus */
+
+#endif /* __AK_CONFIG_H */
@@ -15,15 +15,21 @@ extern "C" {
 
 #include "buffer_append.h"
 #include "can.h"
-#include "mylist.h"
+#include "delay.h"
+#include "num_fmt.h"
+#include "profiler.h"
+#include "ring_buffer.h"
 #include "stdbool.h"
-#include "stdlib.h"
 #include "sys.h"
+#include "timebase.h"
+#include "usart.h"
 
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
 
+#include "intrusive_list.hpp"
+
 /**
  * @brief 控制模式定义
  *
@@ -104,23 +110,256 @@ static const float AK_MIT_param_limit[7][2] = {
     {50.0f, 65.0f}, {45.0f, 15.0f}, {50.0f, 25.0f}, {76.0f, 12.0f},
     {50.0f, 18.0f}, {8.0f, 144.0f}, {37.5f, 32.0f}};
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 电机注册表
+ * @{
+ */
+
+#define AK_MAX_MOTORS   16U  /*!< 两条总线共用, 最多注册的电机数量 */
+#define AK_MOTOR_ID_NUM 256U /*!< CAN ID范围, ID必须小于此值 */
+
+/**
+ * @brief 注册结果
+ *
+ */
+typedef enum {
+    AK_REG_OK = 0,      /*!< 注册成功 */
+    AK_REG_ID_CONFLICT, /*!< CAN ID冲突 */
+    AK_REG_ID_INVALID,  /*!< CAN ID或总线编号超出范围 */
+    AK_REG_POOL_FULL,   /*!< 超过AK_MAX_MOTORS, 节点已用完 */
+} AK_Reg_Status_t;
+
+/**
+ * @}
+ */
+
+/**
+ * @brief 电机状态快照
+ *
+ */
+typedef struct {
+    uint32_t controller_id;   /*!< CAN ID */
+    float motor_pos;          /*!< 电机位置 */
+    float motor_spd;          /*!< 电机速度 */
+    float motor_cur_troq;     /*!< 电机电流, 运控模式为扭矩 */
+    int8_t motor_temperature; /*!< 电机温度 */
+    uint8_t error_code;       /*!< 电机错误码 */
+    float motor_pos_multi;    /*!< 多圈展开后的位置 */
+    float motor_spd_est;      /*!< 由位置差分估计的速度 */
+    uint32_t rx_us;           /*!< 收到回包时的time_us() */
+    uint64_t rx_time;         /*!< 回包的硬件时间戳(位时间), 未启用时为0 */
+    bool stale;               /*!< 回包超时, 状态已过期 */
+} AK_Motor_State_t;
+
+/* 收到回包时在CAN中断里输出, 使用OS时由遥测任务输出 */
+#define AK_MEASURE_PRINT_ENABLE (!SYS_SUPPORT_OS)
+
+/* 状态输出的小数位数, 上位机按"位置,速度,电流,温度,错误码"解析 */
+#define AK_STATE_DECIMALS 2U
+/* 一行状态输出的最大长度 */
+#define AK_STATE_LINE_LEN (3U * NUM_FMT_MAX_LEN + 16U)
+
+/**
+ * @defgroup 回包触发控制
+ * @{
+ */
+
+/* 回包触发控制, 0禁用(按固定周期控制); 1启用(最后一个回包到达即触发下一周期).
+   启用后控制频率接近总线往返频率, 每个回包还会输出一行状态 */
+#define AK_REPLY_TRIGGER_ENABLE 0
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 多圈位置和速度估计
+ * @{
+ */
+
+/* α-β滤波器默认参数, β = α^2 / (2 - α)为临界阻尼 */
+#define AK_EST_ALPHA 0.2f
+#define AK_EST_BETA  0.0222f
+/* 两帧回包间隔超过此值(ms)时重新初始化速度估计 */
+#define AK_EST_TIMEOUT_MS 50U
+/* 位置原始值的周期, 两种模式都是16位 */
+#define AK_EST_RAW_SPAN 65536
+
+/**
+ * @brief 多圈位置和速度估计器, 以位置原始值(计数)为单位
+ *
+ */
+typedef struct {
+    bool valid;          /*!< 是否已用第一帧初始化 */
+    AK_Ctrlmode_t mode;  /*!< 初始化时的回包模式, 模式改变时重新初始化 */
+    uint16_t raw_last;   /*!< 上一帧位置原始值 */
+    int64_t counts;      /*!< 展开后的位置 */
+    uint32_t stamp;      /*!< 上一帧的time_us() */
+    float err;           /*!< 位置估计值与测量值之差 */
+    float vel;           /*!< 速度估计(计数/s) */
+    float alpha;         /*!< 位置修正系数 */
+    float beta;          /*!< 速度修正系数 */
+    uint32_t resets;     /*!< 超时重新初始化次数 */
+} AK_Pos_Est_t;
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 状态预测
+ * @{
+ */
+
+/* 预测的积分步长(us) */
+#define AK_PRED_STEP_US 250U
+/* 最长预测时间(ms), 超过时按此值预测 */
+#define AK_PRED_MAX_MS 10U
+
+/**
+ * @brief 最近一次发送的运控指令, 预测时用它计算电机输出的扭矩
+ *
+ */
+typedef struct {
+    float pos;    /*!< 目标位置 */
+    float spd;    /*!< 目标速度 */
+    float kp;     /*!< 位置增益 */
+    float kd;     /*!< 速度增益 */
+    float torque; /*!< 前馈扭矩 */
+} AK_MIT_Cmd_t;
+
+/**
+ * @brief 前推到指定时刻的电机状态
+ *
+ */
+typedef struct {
+    float pos;           /*!< 位置, 与motor_pos同一坐标 */
+    float pos_multi;     /*!< 多圈位置, 与motor_pos_multi同一坐标 */
+    float spd;           /*!< 速度 */
+    float torque;        /*!< 预测时刻的扭矩, 伺服模式为0 */
+    uint32_t horizon_us; /*!< 前推的时间(us) */
+} AK_Motor_Pred_t;
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 急停
+ * @{
+ */
+
+/**
+ * @brief 急停延迟统计, 单位是内核时钟周期, 从触发时刻开始计时
+ *
+ */
+typedef struct {
+    uint32_t count;           /*!< 急停次数 */
+    uint32_t frames;          /*!< 最近一次写入的停止帧数 */
+    uint32_t cycles_queued;   /*!< 最近一次停止帧全部写入紧急队列的延迟 */
+    uint32_t cycles_sent;     /*!< 最近一次停止帧全部发送完成的延迟 */
+    uint32_t cycles_sent_max; /*!< 发送完成的最大延迟 */
+} AK_Estop_Stats_t;
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 回包看门狗
+ * @{
+ */
+
+/* 回包看门狗, 0禁用; 1启用 */
+#define AK_WDG_ENABLE 1
+/* 默认回包期限(us), 从第一帧没有得到回包的指令开始计时.
+ * 伺服模式按上传周期回包, 期限必须大于上传周期 */
+#define AK_WDG_TIMEOUT_US 20000U
+/* 刹车动作的参数, 伺服模式为刹车电流(A), 运控模式为阻尼系数kd */
+#define AK_WDG_BRAKE_CURRENT 5.0f
+#define AK_WDG_BRAKE_KD      2.0f
+
+/**
+ * @brief 回包超时后的安全动作
+ *
+ */
+typedef enum {
+    AK_SAFE_NONE = 0,    /*!< 只标记失联, 不发送 */
+    AK_SAFE_ZERO_TORQUE, /*!< 运控模式参数全为0, 伺服模式电流为0 */
+    AK_SAFE_EXIT,        /*!< 运控模式退出控制, 伺服模式同零扭矩 */
+    AK_SAFE_BRAKE,       /*!< 伺服模式刹车电流, 运控模式只有阻尼 */
+} AK_Safe_Action_t;
+
+/**
+ * @brief 每个电机的回包看门狗
+ *
+ */
+typedef struct {
+    uint32_t timeout_us;     /*!< 回包期限(us), 0不检查 */
+    AK_Safe_Action_t action; /*!< 超时后的安全动作 */
+    volatile bool armed;     /*!< 是否在等待回包 */
+    volatile bool stale;     /*!< 是否失联, 收到回包时清除 */
+    uint32_t deadline;       /*!< 回包截止时刻, time_us() */
+    uint32_t miss_streak;    /*!< 连续超时次数, 收到回包时清零 */
+    uint32_t miss_total;     /*!< 累计超时次数 */
+    uint32_t actions;        /*!< 已发送的安全动作帧数 */
+} AK_Wdg_t;
+
 /**
  * @}
  */
 
 #ifdef __cplusplus
+struct AK_Motor_Linklist;
+
 class AK_Motor_Class {
    public:
     uint32_t controller_id;         /*!< CAN ID */
+    CAN_Bus_t can_bus;              /*!< 所在总线 */
     AK_motor_model_t motor_model;   /*!< 电机型号 */
-    bool id_conflict;               /*!< CAN ID是否冲突 */
+    AK_Ctrlmode_t ctrl_mode;        /*!< 控制模式, 随发送的指令更新 */
+    bool id_conflict;               /*!< 同一总线上CAN ID是否冲突 */
+    AK_Reg_Status_t reg_status;     /*!< 注册结果 */
     float motor_pos;                /*!< 电机位置 */
     float motor_spd;                /*!< 电机速度 */
     float motor_cur_troq;           /*!< 电机电流, 运控模式为扭矩 */
     int8_t motor_temperature;       /*!< 电机温度 */
     uint8_t error_code;             /*!< 电机错误码 */
+    float motor_pos_multi;          /*!< 多圈展开后的位置 */
+    float motor_spd_est;            /*!< 由位置差分估计的速度 */
+    volatile uint32_t state_seq;    /*!< 状态更新序号, 奇数表示正在更新 */
+
+    bool reply_trigger;             /*!< 是否参与回包触发控制 */
+    volatile bool reply_pending;    /*!< 本周期回包是否未到达 */
+
+    bool tx_dedup;                  /*!< 是否抑制重复指令帧 */
+    uint32_t tx_keepalive_us;       /*!< 保活间隔(us) */
+    uint32_t tx_suppressed;         /*!< 被抑制的帧数 */
+
+    uint32_t rx_us;                 /*!< 收到回包时的time_us() */
+    uint64_t rx_time;               /*!< 回包的硬件时间戳(位时间) */
+    AK_Pos_Est_t pos_est;           /*!< 估计器, 只在CAN接收中断中更新 */
+    AK_MIT_Cmd_t mit_cmd;           /*!< 最近一次发送的运控指令 */
+    float pred_inertia;             /*!< 输出端转动惯量(kg*m^2), 0不计扭矩 */
+    AK_Wdg_t wdg;                   /*!< 回包看门狗 */
+
+    AK_Motor_Class(uint32_t ID,
+                   AK_motor_model_t model,
+                   AK_Ctrlmode_t mode = AK_MIT_Mode,
+                   CAN_Bus_t bus = CAN_BUS_1);
 
-    AK_Motor_Class(uint32_t ID, AK_motor_model_t model);
+    void get_state(AK_Motor_State_t* state);
+    void set_reply_trigger(bool enable);
+    void set_tx_dedup(bool enable, uint32_t keepalive_ms);
+    void set_vel_filter(float alpha, float beta);
+    void reset_pos_est(void);
+    void set_pred_inertia(float inertia);
+    bool predict_state(AK_Motor_Pred_t* pred, uint32_t lead_us = 0);
+    void set_watchdog(uint32_t timeout_us, AK_Safe_Action_t action);
 
     /* 伺服模式方法 */
     void comm_can_set_duty(float duty);
@@ -142,18 +381,75 @@ class AK_Motor_Class {
     void mit_can_exit_motor(void);
 
     ~AK_Motor_Class();
+
+    /* 注册表节点与对象一一对应, 禁止拷贝 */
+    AK_Motor_Class(const AK_Motor_Class&) = delete;
+    AK_Motor_Class& operator=(const AK_Motor_Class&) = delete;
+
+   private:
+    AK_Motor_Linklist* reg_node; /* 注册表节点, 注册失败为NULL */
+
+    /* 上一帧发送的指令, 用于重复帧抑制 */
+    bool tx_cache_valid;
+    bool tx_cache_ext;
+    uint8_t tx_cache_len;
+    uint8_t tx_cache_data[8];
+    uint32_t tx_cache_id;
+    uint32_t tx_cache_deadline; /* 保活时刻, `time_us()`时基 */
+
+    uint8_t can_transmit(bool ext,
+                         uint32_t id,
+                         uint8_t* data,
+                         uint8_t len,
+                         bool dedup,
+                         CAN_Prio_t prio);
 };
 
 extern "C" {
-void ak_can_get_measure(uint8_t can_id,
+void ak_can_get_measure(CAN_Bus_t bus,
+                        uint8_t can_id,
                         uint8_t* can_msg,
-                        AK_Ctrlmode_t AK_mode);
+                        AK_Ctrlmode_t AK_mode,
+                        uint64_t rx_time);
+void ak_can_get_measure_words(CAN_Bus_t bus,
+                              uint8_t can_id,
+                              uint32_t data_lo,
+                              uint32_t data_hi,
+                              AK_Ctrlmode_t AK_mode,
+                              uint64_t rx_time);
+void ak_group_arm(void);
+bool ak_group_wait(uint32_t timeout_ms);
+void ak_group_ready_callback(void);
+uint32_t ak_motor_count(CAN_Bus_t bus, AK_Ctrlmode_t mode);
+
+extern AK_Estop_Stats_t ak_estop_stats;
+void ak_estop(uint32_t start_cycles);
+void ak_estop_clear(void);
+bool ak_estop_active(void);
+uint32_t ak_state_format(char* buf, const AK_Motor_State_t* state);
+void ak_wdg_tick(void);
 }
 #else /* __cplusplus */
 
-void ak_can_get_measure(uint8_t can_id,
+void ak_can_get_measure(CAN_Bus_t bus,
+                        uint8_t can_id,
                         uint8_t* can_msg,
-                        AK_Ctrlmode_t AK_mode);
+                        AK_Ctrlmode_t AK_mode,
+                        uint64_t rx_time);
+void ak_can_get_measure_words(CAN_Bus_t bus,
+                              uint8_t can_id,
+                              uint32_t data_lo,
+                              uint32_t data_hi,
+                              AK_Ctrlmode_t AK_mode,
+                              uint64_t rx_time);
+void ak_group_ready_callback(void);
+
+extern AK_Estop_Stats_t ak_estop_stats;
+void ak_estop(uint32_t start_cycles);
+void ak_estop_clear(void);
+bool ak_estop_active(void);
+uint32_t ak_state_format(char* buf, const AK_Motor_State_t* state);
+void ak_wdg_tick(void);
 
 #endif /* __cplusplus */
 
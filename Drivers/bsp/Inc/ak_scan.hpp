@@ -0,0 +1,72 @@
+/**
+ * @file    ak_scan.hpp
+ * @author  Deadline--
+ * @brief   AK电机自动发现
+ * @version 0.1
+ * @date    2023-12-22
+ * @note    按CAN ID范围给每个ID同时发送运控模式和伺服模式的探测帧,
+ *          按回包的帧格式判断电机的控制模式.
+ *          探测帧走批量发送队列, 每批`AK_SCAN_BATCH`个ID, 上一批还在发送时
+ *          就写入下一批, 两条总线并行; 回包在CAN接收中断中按ID记录,
+ *          不需要等每一批的回包. 1Mbps时扫描1 ~ 127不到50ms.
+ *          探测帧是运控模式退出控制和伺服模式电流0, 不改变电机参数,
+ *          但会让正在运行的电机停止输出, 只能在启动时、控制开始之前扫描.
+ */
+
+#ifndef __AK_SCAN_H
+#define __AK_SCAN_H
+
+#include "ak_motor.hpp"
+
+/* 启动时自动扫描电机, 0禁用; 1启用 */
+#define AK_SCAN_ENABLE 1
+
+/* 每批探测的ID数, 每个ID两帧, 两批的帧数不能超过批量发送队列长度 */
+#define AK_SCAN_BATCH 4U
+/* 最后一帧发出后等待回包的时间(us) */
+#define AK_SCAN_WINDOW_US 2000U
+/* 整个扫描的最长时间(ms), 总线故障时不会一直等待 */
+#define AK_SCAN_TIMEOUT_MS 500U
+/* 最多记录的电机数量 */
+#define AK_SCAN_MAX_FOUND 8U
+
+#if AK_SCAN_BATCH * 4U > CAN_BULK_QUEUE_LEN
+#error "AK_SCAN_BATCH too large for CAN_BULK_QUEUE_LEN"
+#endif
+
+/**
+ * @brief 发现的一个电机
+ *
+ */
+typedef struct {
+    CAN_Bus_t bus;      /*!< 所在总线 */
+    uint8_t id;         /*!< CAN ID */
+    AK_Ctrlmode_t mode; /*!< 回包的控制模式 */
+    bool both_modes;    /*!< 两种探测帧都有回包, 按运控模式记录 */
+} AK_Scan_Entry_t;
+
+/**
+ * @brief 扫描结果
+ *
+ */
+typedef struct {
+    uint32_t probes;     /*!< 发出的探测帧数 */
+    uint32_t tx_fail;    /*!< 写入发送队列失败的探测帧数 */
+    uint32_t elapsed_us; /*!< 扫描用时(us) */
+    bool timeout;        /*!< 是否超过`AK_SCAN_TIMEOUT_MS`而提前结束 */
+    uint32_t found;      /*!< 发现的电机数, 可能超过`AK_SCAN_MAX_FOUND` */
+    AK_Scan_Entry_t entry[AK_SCAN_MAX_FOUND]; /*!< 按总线和ID排序 */
+} AK_Scan_Result_t;
+
+extern "C" {
+extern volatile bool ak_scan_active;
+
+void ak_scan_on_reply(CAN_Bus_t bus, uint8_t id, AK_Ctrlmode_t mode);
+uint32_t ak_scan_run(uint32_t buses,
+                     uint8_t first_id,
+                     uint8_t last_id,
+                     AK_Scan_Result_t* result);
+void ak_scan_report(const AK_Scan_Result_t* result);
+}
+
+#endif /* __AK_SCAN_H */
@@ -2,25 +2,234 @@
  * @file    can.h
  * @author  Deadline--
  * @brief   CAN通信相关
- * @version 0.1
- * @date    2023-10-26
+ * @version 0.7
+ * @date    2023-12-21
  */
 #ifndef __CAN_H
 #define __CAN_H
 
-#include "ak_motor.hpp"
+#include "ring_buffer.h"
 #include "sys.h"
+#include "timebase.h"
 #include "usart.h"
 
 /* 启用CAN接收RX0中断, 0禁用; 1启用 */
 #define CAN_RX0_INT_ENABLE 1
 
+/* 收发路径, 0使用HAL库; 1直接读写邮箱寄存器, 数据按32位字传给解码函数 */
+#define CAN_FAST_PATH 1
+
+/* 统计收发中断的时钟周期数, 0禁用; 1启用 */
+#define CAN_ISR_CYCLE_STATS 1
+
+/**
+ * 发送队列按优先级分为紧急/控制/配置/批量四级, 每条总线各一组,
+ * 长度必须是2的幂. 邮箱空闲时总是装入优先级最高的帧,
+ * 邮箱全满时紧急帧中止低优先级的帧, 被中止的帧重新排队
+ */
+/* 紧急发送队列长度 */
+#define CAN_URGENT_QUEUE_LEN 16
+/* 控制发送队列长度 */
+#define CAN_TX_QUEUE_LEN 16
+/* 配置发送队列长度 */
+#define CAN_CONFIG_QUEUE_LEN 8
+/* 批量发送队列长度 */
+#define CAN_BULK_QUEUE_LEN 16
+
+/* CAN2使用的第一个过滤器组, CAN1使用0 ~ 13, CAN2使用14 ~ 27 */
+#define CAN_SLAVE_START_FILTER_BANK 14
+
+/**
+ * 硬件时间戳, 0禁用; 1启用
+ * 启用时打开时间触发通信模式(TTCM), 收发帧在帧起始位带16位计数值,
+ * 计数单位是1个位时间(1Mbps时为1us), 软件扩展成64位单调时间
+ */
+#define CAN_TIMESTAMP_ENABLE 1
+
+/**
+ * 错误状态中断和离线自动恢复, 0禁用; 1启用
+ * 离线(bus-off)后按退避时间由软件请求恢复, 连续离线时退避时间加倍
+ */
+#define CAN_ERR_ENABLE 1
+
+/* 离线后第一次请求恢复前的等待时间(us) */
+#define CAN_BUSOFF_BACKOFF_MIN_US 1000U
+/* 退避时间上限(us) */
+#define CAN_BUSOFF_BACKOFF_MAX_US 100000U
+/* 恢复后稳定超过此时间(ms)再离线时, 退避时间从最小值重新开始 */
+#define CAN_BUSOFF_STABLE_MS 1000U
+/* 离线时丢弃发送队列和邮箱中的普通帧, 恢复时再丢弃离线期间写入的帧,
+ * 0保留到恢复后发送. 紧急帧总是保留 */
+#define CAN_BUSOFF_FLUSH 1
+
+/**
+ * @brief CAN总线编号
+ *
+ */
+typedef enum {
+    CAN_BUS_1 = 0, /*!< CAN1, PA11/PA12 */
+    CAN_BUS_2,     /*!< CAN2, PB12/PB13 */
+    CAN_BUS_NUM    /*!< 总线数量 */
+} CAN_Bus_t;
+
+/**
+ * @brief 发送优先级, 数值越小优先级越高
+ *
+ * @note 同一级别按写入顺序发送, 不同级别之间不保证顺序
+ */
+typedef enum {
+    CAN_PRIO_EMERGENCY = 0, /*!< 紧急: 急停/退出控制/刹车, 可以中止其他帧 */
+    CAN_PRIO_CONTROL,       /*!< 控制: 周期性的给定值 */
+    CAN_PRIO_CONFIG,        /*!< 配置: 进入控制/设置原点等 */
+    CAN_PRIO_BULK,          /*!< 批量: 扫描/参数读写等没有实时要求的帧 */
+    CAN_PRIO_NUM            /*!< 优先级数量 */
+} CAN_Prio_t;
+
+/**
+ * @brief 发送队列中的一帧
+ *
+ */
+typedef struct {
+    uint32_t id;        /*!< 帧ID */
+    uint32_t ide;       /*!< CAN_ID_STD或CAN_ID_EXT */
+    uint8_t len;        /*!< 数据长度 */
+    uint8_t prio;       /*!< 优先级, CAN_Prio_t */
+    union {
+        uint8_t data[8];  /*!< 数据 */
+        uint32_t word[2]; /*!< 数据, 直接写入TDLR/TDHR */
+    };
+    uint32_t queued_us; /*!< 写入队列的时刻, 重新排队时不变 */
+} CAN_TxFrame_t;
+
+/**
+ * @brief 发送统计
+ *
+ */
+typedef struct {
+    uint32_t sent;     /*!< 装入邮箱的帧数 */
+    uint32_t urgent;   /*!< 其中紧急帧的数量 */
+    uint32_t overflow; /*!< 发送队列满被丢弃的帧数 */
+    uint32_t dropped;  /*!< 装入邮箱失败的帧数 */
+    uint32_t aborted;  /*!< 为紧急帧让出邮箱而中止的普通帧数 */
+    uint32_t flushed;  /*!< 被CAN_TX_Flush清除的普通帧数 */
+} CAN_TxStats_t;
+
+/**
+ * @brief 每个优先级的发送统计, 时间从写入队列开始计算
+ *
+ */
+typedef struct {
+    uint32_t queued;        /*!< 写入队列的帧数 */
+    uint32_t overflow;      /*!< 队列满被丢弃的帧数 */
+    uint32_t loaded;        /*!< 装入邮箱的次数, 包括重新装入 */
+    uint32_t sent;          /*!< 发送成功的帧数 */
+    uint32_t preempted;     /*!< 被紧急帧中止后重新排队的次数 */
+    uint32_t flushed;       /*!< 被清除的帧数 */
+    uint32_t wait_us_last;  /*!< 最近一次装入邮箱前的排队时间(us) */
+    uint32_t wait_us_max;   /*!< 最长排队时间(us) */
+    uint64_t wait_us_total; /*!< 累计排队时间, 除以loaded得到平均值 */
+    uint32_t sent_us_max;   /*!< 从写入队列到发送成功的最长时间(us) */
+    uint64_t sent_us_total; /*!< 累计发送时间, 除以sent得到平均值 */
+} CAN_PrioStats_t;
+
+/**
+ * @brief 中断耗时统计, 单位是内核时钟周期
+ *
+ */
+typedef struct {
+    uint32_t count;        /*!< 中断次数 */
+    uint32_t cycles_last;  /*!< 最近一次耗时 */
+    uint32_t cycles_max;   /*!< 最大耗时 */
+    uint64_t cycles_total; /*!< 累计耗时, 除以count得到平均值 */
+} CAN_IsrStats_t;
+
+/**
+ * @brief 错误状态, 由发送/接收错误计数决定
+ *
+ */
+typedef enum {
+    CAN_ERR_ACTIVE = 0, /*!< 主动错误, 正常 */
+    CAN_ERR_WARNING,    /*!< 错误计数达到96 */
+    CAN_ERR_PASSIVE,    /*!< 错误计数超过127, 被动错误 */
+    CAN_ERR_BUS_OFF,    /*!< 发送错误计数超过255, 离线 */
+    CAN_ERR_STATE_NUM   /*!< 状态数量 */
+} CAN_Err_State_t;
+
+/**
+ * @brief 错误统计
+ *
+ */
+typedef struct {
+    uint32_t enter[CAN_ERR_STATE_NUM]; /*!< 进入各状态的次数 */
+    uint32_t lec[8];          /*!< 各类错误次数, 下标是LEC: 1填充 2格式
+                                   3应答 4隐性位 5显性位 6CRC */
+    uint32_t recovered;       /*!< 离线后恢复的次数 */
+    uint32_t recover_us_last; /*!< 最近一次从离线到恢复的时间(us) */
+    uint32_t recover_us_max;  /*!< 从离线到恢复的最长时间(us) */
+    uint32_t stale_flushed;   /*!< 离线时丢弃的普通帧数 */
+    uint8_t tec_max;          /*!< 发送错误计数最大值 */
+    uint8_t rec_max;          /*!< 接收错误计数最大值 */
+} CAN_ErrStats_t;
+
+extern CAN_TxStats_t CAN_TxStats[CAN_BUS_NUM];
+extern CAN_PrioStats_t CAN_PrioStats[CAN_BUS_NUM][CAN_PRIO_NUM];
+#if CAN_ERR_ENABLE
+extern CAN_ErrStats_t CAN_ErrStats[CAN_BUS_NUM];
+#endif /* CAN_ERR_ENABLE */
+#if CAN_ISR_CYCLE_STATS
+extern CAN_IsrStats_t CAN_RxIsrStats[CAN_BUS_NUM];
+extern CAN_IsrStats_t CAN_TxIsrStats[CAN_BUS_NUM];
+#endif /* CAN_ISR_CYCLE_STATS */
+
+uint8_t CAN_Bus_Init(CAN_Bus_t bus,
+                     uint32_t tsjw,
+                     uint32_t tbs2,
+                     uint32_t tbs1,
+                     uint16_t brp,
+                     uint32_t mode);
 uint8_t CAN1_Init(uint32_t tsjw,
                   uint32_t tbs2,
                   uint32_t tbs1,
                   uint16_t brp,
                   uint32_t mode);
-uint8_t AKcmd_can_transmit_eid(uint32_t id, uint8_t* msg, uint8_t len);
-uint8_t AKcmd_can_transmit_mit(uint32_t id, uint8_t* msg, uint8_t len);
+uint8_t CAN2_Init(uint32_t tsjw,
+                  uint32_t tbs2,
+                  uint32_t tbs1,
+                  uint16_t brp,
+                  uint32_t mode);
+uint32_t CAN_Get_Bitrate(CAN_Bus_t bus);
+uint32_t CAN_Time_To_Local_Us(CAN_Bus_t bus, uint64_t time);
+uint64_t CAN_Time_To_Us(CAN_Bus_t bus, uint64_t time);
+void CAN_TX_Time_Callback(CAN_Bus_t bus, uint32_t mailbox, uint64_t time);
+void CAN_TX_Poll(CAN_Bus_t bus);
+void CAN_TX_Request_Callback(CAN_Bus_t bus);
+uint8_t CAN_TX_Send(CAN_Bus_t bus,
+                    CAN_Prio_t prio,
+                    uint32_t ide,
+                    uint32_t id,
+                    uint8_t* msg,
+                    uint8_t len);
+uint8_t CAN_TX_Urgent(CAN_Bus_t bus,
+                      uint32_t ide,
+                      uint32_t id,
+                      uint8_t* msg,
+                      uint8_t len);
+void CAN_TX_Urgent_Done_Callback(CAN_Bus_t bus);
+uint32_t CAN_TX_Flush(CAN_Bus_t bus);
+void CAN_TX_Block(CAN_Bus_t bus, bool block);
+uint32_t CAN_TX_Pending(CAN_Bus_t bus, CAN_Prio_t prio);
+CAN_Err_State_t CAN_Get_Err_State(CAN_Bus_t bus);
+void CAN_Err_Tick(void);
+void CAN_Err_State_Callback(CAN_Bus_t bus,
+                            CAN_Err_State_t old_state,
+                            CAN_Err_State_t new_state);
+uint8_t AKcmd_can_transmit_eid(CAN_Bus_t bus,
+                               uint32_t id,
+                               uint8_t* msg,
+                               uint8_t len);
+uint8_t AKcmd_can_transmit_mit(CAN_Bus_t bus,
+                               uint32_t id,
+                               uint8_t* msg,
+                               uint8_t len);
 
 #endif  // !__CAN_H
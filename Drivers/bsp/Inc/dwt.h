@@ -0,0 +1,27 @@
+/**
+ * @file    dwt.h
+ * @author  Deadline--
+ * @brief   DWT周期计数器, 用于测量代码执行的时钟周期数
+ * @version 0.1
+ * @date    2023-12-12
+ * @note    CYCCNT随内核时钟计数, 180MHz下约23.8s溢出一次,
+ *          两次读数相减得到的差值不受一次溢出影响
+ */
+
+#ifndef __DWT_H
+#define __DWT_H
+
+#include "sys.h"
+
+void DWT_Init(void);
+
+/**
+ * @brief 读取周期计数
+ *
+ * @return uint32_t 当前CYCCNT
+ */
+static inline uint32_t DWT_Get_Cycles(void) {
+    return DWT->CYCCNT;
+}
+
+#endif /* __DWT_H */
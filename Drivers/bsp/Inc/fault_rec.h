@@ -0,0 +1,163 @@
+/**
+ * @file    fault_rec.h
+ * @author  Deadline--
+ * @brief   飞行记录: 备份SRAM中的控制周期记录和异常现场, 复位后输出
+ * @version 0.1
+ * @date    2023-12-26
+ * @note    4KB备份SRAM(0x40024000)复位后内容不变, 接VBAT时掉电也保持.
+ *          其中保存:
+ *          - 最近`FAULT_REC_NUM`个控制周期的记录: 时刻、给定位置和扭矩、
+ *            测得的位置、速度和扭矩、错误码和标志. 数值存为半精度浮点,
+ *            每条16字节, 写一条不到1us
+ *          - 异常现场: HardFault/MemManage/BusFault/UsageFault时压栈的
+ *            r0 ~ r3, r12, lr, pc, xpsr, 栈指针和故障状态寄存器,
+ *            记录后立即软件复位, 不再停在死循环里. 记录时使用专用的栈,
+ *            栈溢出引起的异常也能记录
+ *          - 本次启动的复位原因和启动次数
+ *
+ *          控制循环卡住时由独立看门狗(IWDG)复位. 看门狗在进入控制时启动,
+ *          控制循环和等待按键的循环里喂狗. 擦除flash扇区最长约2s,
+ *          期间CPU停顿, 所以超时时间必须大于2s, 并在每次擦除前喂狗.
+ *
+ *          启动时`fault_rec_report()`输出复位原因; 上一次是异常或看门狗复位时
+ *          再输出异常现场和全部周期记录, 之后清除异常现场.
+ */
+
+#ifndef __FAULT_REC_H
+#define __FAULT_REC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__ARMCC_VERSION) || defined(__arm__)
+#include "sys.h"
+#define FAULT_REC_TARGET 1
+#else
+#define FAULT_REC_TARGET 0
+#endif /* __ARMCC_VERSION || __arm__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 周期记录条数, 与记录头一起不能超过4KB */
+#define FAULT_REC_NUM 240U
+/* 独立看门狗, 0禁用; 1启用. 调试时暂停内核不会触发 */
+#define FAULT_REC_IWDG_ENABLE 1
+/* 独立看门狗超时时间(ms), 大于flash扇区擦除时间, 不超过8000 */
+#define FAULT_REC_IWDG_MS 3000U
+/* 记录格式版本, 字段改变时加1 */
+#define FAULT_REC_VERSION 1U
+/* 异常处理使用的栈(字节), 8的倍数, 在汇编中使用, 只能是不带后缀的数字 */
+#define FAULT_REC_STACK_SIZE 512
+
+/* 异常类型, 在汇编中使用, 只能是不带后缀的数字 */
+#define FAULT_REC_NONE  0
+#define FAULT_REC_HARD  1
+#define FAULT_REC_MEM   2
+#define FAULT_REC_BUS   3
+#define FAULT_REC_USAGE 4
+
+/* 周期记录的标志 */
+#define FAULT_REC_FLAG_STALE 0x01U /*!< 回包过期 */
+#define FAULT_REC_FLAG_ESTOP 0x02U /*!< 急停 */
+
+/**
+ * @brief 一个控制周期的记录, 数值为半精度浮点
+ *
+ */
+typedef struct {
+    uint32_t t_us;       /*!< 记录时刻time_us() */
+    uint16_t cmd_pos;    /*!< 给定位置 */
+    uint16_t cmd_torque; /*!< 给定扭矩, 伺服模式为电流 */
+    uint16_t pos;        /*!< 位置 */
+    uint16_t spd;        /*!< 速度 */
+    uint16_t torque;     /*!< 扭矩, 伺服模式为电流 */
+    uint8_t error;       /*!< 电机错误码 */
+    uint8_t flags;       /*!< `FAULT_REC_FLAG_STALE`等 */
+} fault_rec_entry_t;
+
+/**
+ * @brief 异常现场
+ *
+ */
+typedef struct {
+    uint32_t type;       /*!< 异常类型, `FAULT_REC_NONE`没有 */
+    uint32_t frame[8];   /*!< 压栈的r0, r1, r2, r3, r12, lr, pc, xpsr */
+    uint32_t sp;         /*!< 异常前的栈指针, 栈无效时frame全为0 */
+    uint32_t exc_return; /*!< 进入异常时的lr */
+    uint32_t cfsr;       /*!< SCB->CFSR */
+    uint32_t hfsr;       /*!< SCB->HFSR */
+    uint32_t mmfar;      /*!< SCB->MMFAR */
+    uint32_t bfar;       /*!< SCB->BFAR */
+    uint32_t t_us;       /*!< 异常时刻time_us() */
+} fault_rec_fault_t;
+
+/**
+ * @brief 备份SRAM中的全部内容
+ *
+ */
+typedef struct {
+    uint32_t magic;     /*!< 有效标记 */
+    uint16_t version;   /*!< `FAULT_REC_VERSION` */
+    uint16_t size;      /*!< sizeof(fault_rec_t) */
+    uint32_t boots;     /*!< 启动次数 */
+    uint32_t reset_csr; /*!< 本次启动时的RCC->CSR, 复位原因 */
+    uint32_t head;      /*!< 下一条记录的位置 */
+    uint32_t count;     /*!< 累计记录条数 */
+    fault_rec_fault_t fault;                /*!< 异常现场 */
+    fault_rec_entry_t entry[FAULT_REC_NUM]; /*!< 周期记录, 环形 */
+} fault_rec_t;
+
+/* 异常处理函数的修饰, 函数体只能是`FAULT_REC_HANDLER()` */
+#if FAULT_REC_TARGET
+#define FAULT_REC_NAKED __attribute__((naked))
+#define FAULT_REC_STR_(x) #x
+#define FAULT_REC_STR(x) FAULT_REC_STR_(x)
+/* 异常处理栈的栈顶, 在汇编中使用 */
+#define FAULT_REC_STACK_TOP \
+    "fault_rec_stack + " FAULT_REC_STR(FAULT_REC_STACK_SIZE)
+/* 按EXC_RETURN的bit2取异常前使用的栈指针, 切换到专用的栈后跳转到
+   fault_rec_fault(). 栈溢出引起的异常不能再往原来的栈上压栈 */
+#define FAULT_REC_HANDLER(type)                           \
+    __asm volatile(                                       \
+        "tst lr, #4\n"                                    \
+        "ite eq\n"                                        \
+        "mrseq r0, msp\n"                                 \
+        "mrsne r0, psp\n"                                 \
+        "mov r1, lr\n"                                    \
+        "movs r2, #" FAULT_REC_STR(type) "\n"             \
+        "movw r3, #:lower16:" FAULT_REC_STACK_TOP "\n"    \
+        "movt r3, #:upper16:" FAULT_REC_STACK_TOP "\n"    \
+        "msr msp, r3\n"                                   \
+        "b fault_rec_fault\n")
+#else
+#define FAULT_REC_NAKED
+#define FAULT_REC_HANDLER(type) fault_rec_fault(0, 0, (type))
+#endif /* FAULT_REC_TARGET */
+
+void fault_rec_init(void);
+void fault_rec_report(void);
+void fault_rec_log(float cmd_pos,
+                   float cmd_torque,
+                   float pos,
+                   float spd,
+                   float torque,
+                   uint8_t error,
+                   uint8_t flags);
+void fault_rec_wdg_start(void);
+void fault_rec_kick(void);
+void fault_rec_fault(const uint32_t* sp, uint32_t exc_return, uint32_t type);
+const fault_rec_t* fault_rec_data(void);
+
+#if FAULT_REC_TARGET
+extern uint32_t fault_rec_stack[FAULT_REC_STACK_SIZE / 4];
+#else
+void fault_rec_host_reset(uint32_t csr);
+#endif /* FAULT_REC_TARGET */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FAULT_REC_H */
@@ -0,0 +1,98 @@
+/**
+ * @file    flash_store.h
+ * @author  Deadline--
+ * @brief   片内flash记录存储, 双扇区轮换
+ * @version 0.1
+ * @date    2023-12-23
+ * @note    使用STM32F429最后两个128KB扇区(10和11), 每个扇区分成
+ *          `FLASH_STORE_SLOT_SIZE`字节的槽, 每次保存写入当前扇区的下一个空槽,
+ *          记录带递增序号和CRC-32, 读取时取两个扇区中序号最大的有效记录.
+ *          当前扇区写满后擦除另一个扇区再写入, 旧扇区保留到下一次轮换,
+ *          擦写在两个扇区之间平均分布, 写入或擦除中途掉电时上一条记录仍然有效.
+ *
+ *          程序从同一个bank运行, 擦除(1 ~ 2s)和编程期间取指令会停顿,
+ *          中断也会被推迟, 只能在电机没有控制时保存.
+ *          工程的IROM只到0x080C0000(扇区0 ~ 9), 链接器不会把代码放进这两个扇区.
+ *
+ *          在主机上编译时(非ARM)由RAM模拟flash: 擦除后为0xFF,
+ *          编程只能把1写成0, 可以模拟写入中途掉电, 用于测试.
+ */
+
+#ifndef __FLASH_STORE_H
+#define __FLASH_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__ARMCC_VERSION) || defined(__arm__)
+#include "sys.h"
+#define FLASH_STORE_TARGET 1
+#else
+#define FLASH_STORE_TARGET 0
+#endif /* __ARMCC_VERSION || __arm__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 两个扇区的起始地址和扇区号 */
+#define FLASH_STORE_ADDR_0   0x080C0000U
+#define FLASH_STORE_ADDR_1   0x080E0000U
+#define FLASH_STORE_SECTOR_0 10U
+#define FLASH_STORE_SECTOR_1 11U
+/* 扇区大小(字节) */
+#define FLASH_STORE_SECTOR_SIZE 0x20000U
+/* 每条记录占用的空间(字节), 包括记录头, 必须是4的倍数且能整除扇区大小 */
+#define FLASH_STORE_SLOT_SIZE 512U
+/* 每个扇区的槽数 */
+#define FLASH_STORE_SLOT_NUM (FLASH_STORE_SECTOR_SIZE / FLASH_STORE_SLOT_SIZE)
+/* 记录头的标记, 最后写入, 作为写入完成的标志 */
+#define FLASH_STORE_MAGIC 0x31475643U
+/* 记录头长度(字节) */
+#define FLASH_STORE_HDR_SIZE 16U
+/* 一条记录最大的数据长度(字节) */
+#define FLASH_STORE_MAX_LEN (FLASH_STORE_SLOT_SIZE - FLASH_STORE_HDR_SIZE)
+
+/**
+ * @brief 操作结果
+ *
+ */
+typedef enum {
+    FLASH_STORE_OK = 0,      /*!< 成功 */
+    FLASH_STORE_EMPTY,       /*!< 没有有效记录 */
+    FLASH_STORE_ERR_LEN,     /*!< 长度超过`FLASH_STORE_MAX_LEN`或缓冲区 */
+    FLASH_STORE_ERR_ERASE,   /*!< 擦除失败 */
+    FLASH_STORE_ERR_PROGRAM, /*!< 编程失败 */
+    FLASH_STORE_ERR_VERIFY,  /*!< 写入后读回的CRC不一致 */
+} flash_store_status_t;
+
+/**
+ * @brief 存储状态
+ *
+ */
+typedef struct {
+    bool valid;       /*!< 是否有有效记录 */
+    uint32_t seq;     /*!< 最新记录的序号 */
+    uint32_t len;     /*!< 最新记录的数据长度 */
+    uint32_t sector;  /*!< 最新记录所在的扇区, 0或1 */
+    uint32_t slot;    /*!< 最新记录所在的槽 */
+    uint32_t erases;  /*!< 本次上电以来的擦除次数 */
+} flash_store_info_t;
+
+flash_store_status_t flash_store_load(void* data, uint32_t size, uint32_t* len);
+flash_store_status_t flash_store_save(const void* data, uint32_t len);
+flash_store_status_t flash_store_erase(void);
+void flash_store_info(flash_store_info_t* info);
+const char* flash_store_status_str(flash_store_status_t status);
+void flash_store_erase_callback(void);
+
+#if !FLASH_STORE_TARGET
+void flash_store_host_reset(void);
+void flash_store_host_cut(uint32_t words);
+#endif /* !FLASH_STORE_TARGET */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FLASH_STORE_H */
@@ -2,13 +2,19 @@
  * @file    key.h
  * @author  Deadline--
  * @brief   按键检测及初始化
- * @version 0.1
- * @date    2023-10-20
+ * @version 0.2
+ * @date    2023-12-15
+ * @note    `KEY_EXTI_ENABLE`为1时按键边沿触发EXTI中断, SysTick每个节拍调用
+ *          `KEY_Tick`消抖, 电平稳定`KEY_DEBOUNCE_MS`后产生按下/松开事件,
+ *          用`KEY_Get_Event`或`KEY_Get_Press`读取, 不会阻塞.
+ *          急停按键在第一个按下边沿立即回调`KEY_Estop_Callback`, 不等消抖.
  */
 
 #ifndef __KEY_H
 #define __KEY_H
+#include "ring_buffer.h"
 #include "sys.h"
+#include "timebase.h"
 
 #define KEY0 HAL_GPIO_ReadPin(GPIOH, GPIO_PIN_3)
 #define KEY1 HAL_GPIO_ReadPin(GPIOH, GPIO_PIN_2)
@@ -20,7 +26,41 @@
 #define KEY2_PRES 3
 #define WKUP_PRES 4
 
+/* 按键由EXTI中断触发并在SysTick中消抖, 0使用KEY_Scan轮询; 1启用 */
+#define KEY_EXTI_ENABLE 1
+
+/* 消抖时间(ms), 电平保持不变这么久才产生事件 */
+#define KEY_DEBOUNCE_MS 10U
+
+/* 按键事件队列长度, 必须是2的幂 */
+#define KEY_EVENT_QUEUE_LEN 8U
+
+/* 急停按键, 0表示不使用. 急停按键的EXTI使用最高中断优先级 */
+#define KEY_ESTOP WKUP_PRES
+
+/* 普通按键EXTI中断优先级, 只启动消抖, 不需要很高 */
+#define KEY_EXTI_PRIORITY 3
+
+/**
+ * @brief 按键事件
+ *
+ */
+typedef struct {
+    uint8_t key;     /*!< KEY0_PRES ~ WKUP_PRES */
+    uint8_t pressed; /*!< 1-按下; 0-松开 */
+    uint32_t tick;   /*!< 消抖完成时的HAL节拍 */
+} KEY_Event_t;
+
 void KEY_Init(void);
 uint8_t KEY_Scan(uint8_t mode);
+uint8_t KEY_Get_Press(void);
+
+#if KEY_EXTI_ENABLE
+extern uint32_t key_event_lost;
+
+bool KEY_Get_Event(KEY_Event_t* event);
+void KEY_Tick(void);
+void KEY_Estop_Callback(uint32_t start_cycles);
+#endif /* KEY_EXTI_ENABLE */
 
 #endif /* __KEY_H */
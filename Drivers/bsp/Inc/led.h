@@ -22,6 +22,11 @@
 #define LED0_TOGGLE() HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_0) /* 翻转LED0 */
 #define LED1_TOGGLE() HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_1) /* 翻转LED1 */
 
+/* 收到指令时LED1闪烁的时间(ms) */
+#define LED1_BLINK_MS 100U
+
 void LED_Init(void);
+void LED1_Blink(void);
+void LED1_Blink_Poll(void);
 
 #endif /* __LED_H */
@@ -0,0 +1,148 @@
+/**
+ * @file    profiler.h
+ * @author  Deadline--
+ * @brief   基于DWT的代码段耗时统计
+ * @version 0.3
+ * @date    2023-12-19
+ * @note    在代码段首尾放置PROF_ENTER/PROF_EXIT, 统计每段的进入次数,
+ *          累计和最大周期数, 以及进入时的嵌套深度. 被中断抢占的时间记到
+ *          抢占者上, 每段只统计自身耗时. CPU负载由空闲时间得到:
+ *          前后台循环中是PROF_IDLE段(等待), 使用OS时是空闲任务的运行时间,
+ *          再加上delay_sleep的睡眠时间.
+ *          PROF_ENABLE为0时所有宏展开为空.
+ * @warning 探针必须成对且按后进先出嵌套. 使用OS时只能放在中断中或调度器
+ *          挂起期间, 不能跨越任务切换.
+ */
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include "sys.h"
+#include "timebase.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 启用耗时统计, 0禁用; 1启用 */
+#define PROF_ENABLE 1
+
+/* 最大嵌套深度, 超过的部分不统计 */
+#define PROF_STACK_DEPTH 8U
+
+/* 报告周期(ms), 每个周期输出一次并清零统计 */
+#define PROF_REPORT_PERIOD_MS 1000U
+
+/**
+ * @brief 统计的代码段
+ *
+ * @note 同类的多条总线必须连续排列, 用总线编号做偏移
+ */
+typedef enum {
+    PROF_MAIN_LOOP = 0, /*!< 前后台循环的一个周期 */
+    PROF_IDLE,          /*!< 等待, 前后台循环用它计算CPU负载 */
+    PROF_SYSTICK,       /*!< SysTick_Handler */
+    PROF_USART1,        /*!< USART1_IRQHandler */
+    PROF_CAN1_RX,       /*!< CAN1_RX0_IRQHandler */
+    PROF_CAN2_RX,       /*!< CAN2_RX0_IRQHandler */
+    PROF_CAN1_TX,       /*!< CAN1_TX_IRQHandler */
+    PROF_CAN2_TX,       /*!< CAN2_TX_IRQHandler */
+    PROF_FAULT_REC,     /*!< 写一条飞行记录 */
+    PROF_REGION_NUM     /*!< 代码段数量 */
+} Prof_Region_t;
+
+#if PROF_ENABLE
+
+/**
+ * @brief 每段的统计, 单位是内核时钟周期
+ *
+ */
+typedef struct {
+    uint32_t count;        /*!< 进入次数 */
+    uint32_t cycles_max;   /*!< 单次最大自身耗时 */
+    uint32_t nest_max;     /*!< 进入时的最大嵌套深度, 0表示没有在其他段内 */
+    uint64_t cycles_total; /*!< 累计自身耗时 */
+} Prof_Stats_t;
+
+/**
+ * @brief 嵌套栈中的一层
+ *
+ */
+typedef struct {
+    uint32_t start; /*!< 进入时的CYCCNT */
+    uint32_t child; /*!< 被内层段占用的周期数 */
+} Prof_Frame_t;
+
+extern Prof_Stats_t prof_stats[PROF_REGION_NUM];
+extern Prof_Frame_t prof_stack[PROF_STACK_DEPTH];
+extern volatile uint32_t prof_depth;
+
+/**
+ * @brief 进入代码段
+ *
+ * @param region 代码段
+ */
+static inline void Prof_Enter(Prof_Region_t region) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t depth = prof_depth;
+    if (depth > prof_stats[region].nest_max) {
+        prof_stats[region].nest_max = depth;
+    }
+    if (depth < PROF_STACK_DEPTH) {
+        prof_stack[depth].child = 0;
+        prof_stack[depth].start = time_cycles();
+    }
+    prof_depth = depth + 1;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 离开代码段, 自身耗时 = 总耗时 - 内层段耗时
+ *
+ * @param region 代码段, 与对应的Prof_Enter相同
+ */
+static inline void Prof_Exit(Prof_Region_t region) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t now = time_cycles();
+    uint32_t depth = prof_depth - 1;
+    prof_depth = depth;
+    if (depth < PROF_STACK_DEPTH) {
+        uint32_t elapsed = now - prof_stack[depth].start;
+        uint32_t self = elapsed - prof_stack[depth].child;
+        if (depth > 0) {
+            prof_stack[depth - 1].child += elapsed;
+        }
+        Prof_Stats_t* stats = &prof_stats[region];
+        stats->count++;
+        stats->cycles_total += self;
+        if (self > stats->cycles_max) {
+            stats->cycles_max = self;
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+void Prof_Init(void);
+void Prof_Report_Poll(void);
+
+#define PROF_INIT() Prof_Init()
+#define PROF_ENTER(region) Prof_Enter(region)
+#define PROF_EXIT(region) Prof_Exit(region)
+#define PROF_REPORT_POLL() Prof_Report_Poll()
+
+#else
+
+#define PROF_INIT()
+#define PROF_ENTER(region)
+#define PROF_EXIT(region)
+#define PROF_REPORT_POLL()
+
+#endif /* PROF_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __PROFILER_H */
@@ -0,0 +1,141 @@
+/**
+ * @file    timebase.h
+ * @author  Deadline--
+ * @brief   全局微秒时间基准
+ * @version 0.1
+ * @date    2023-12-19
+ * @note    `time_us()`读取以1MHz自由运行的32位定时器TIM2, 约71.6分钟溢出,
+ *          睡眠(WFI)时继续计数; `time_us64()`用溢出中断扩展成64位.
+ *          `time_cycles()`读取DWT周期计数, 分辨率高但睡眠时停止.
+ *          32位时间相减得到的差值不受一次溢出影响, 比较先后用
+ *          `time_expired_us`等函数, 不要直接比较大小.
+ *
+ *          在主机上编译时(非ARM)由`clock_gettime(CLOCK_MONOTONIC)`实现,
+ *          内核时钟按`TIME_HOST_CPU_HZ`换算, 用于仿真.
+ */
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__ARMCC_VERSION) || defined(__arm__)
+#include "dwt.h"
+#include "sys.h"
+#define TIME_TARGET 1
+#else
+#define TIME_TARGET 0
+#endif /* __ARMCC_VERSION || __arm__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 时间基准使用的32位定时器, TIM2或TIM5 */
+#define TIME_TIM              TIM2
+#define TIME_TIM_IRQn         TIM2_IRQn
+#define TIME_TIM_IRQHandler   TIM2_IRQHandler
+#define TIME_TIM_CLK_ENABLE() __HAL_RCC_TIM2_CLK_ENABLE()
+
+/* 主机仿真时的内核时钟频率 */
+#define TIME_HOST_CPU_HZ 180000000U
+
+#if TIME_TARGET
+#define TIME_CPU_HZ SystemCoreClock
+#else
+#define TIME_CPU_HZ TIME_HOST_CPU_HZ
+#endif /* TIME_TARGET */
+
+void time_init(void);
+uint64_t time_us64(void);
+
+#if TIME_TARGET
+/**
+ * @brief 当前时间
+ *
+ * @return uint32_t 微秒, 约71.6分钟溢出一次
+ */
+static inline uint32_t time_us(void) {
+    return TIME_TIM->CNT;
+}
+
+/**
+ * @brief 当前内核时钟周期计数
+ *
+ * @return uint32_t DWT周期计数, 180MHz下约23.8s溢出一次, 睡眠时不计数
+ */
+static inline uint32_t time_cycles(void) {
+    return DWT_Get_Cycles();
+}
+#else
+uint32_t time_us(void);
+uint32_t time_cycles(void);
+#endif /* TIME_TARGET */
+
+/**
+ * @brief 时钟周期数换算成微秒
+ *
+ * @param cycles 周期数
+ * @return uint32_t 微秒
+ */
+static inline uint32_t time_cycles_to_us(uint32_t cycles) {
+    return cycles / (TIME_CPU_HZ / 1000000U);
+}
+
+/**
+ * @brief 微秒换算成时钟周期数
+ *
+ * @param us 微秒, 换算结果不能超过32位
+ * @return uint32_t 周期数
+ */
+static inline uint32_t time_us_to_cycles(uint32_t us) {
+    return us * (TIME_CPU_HZ / 1000000U);
+}
+
+/**
+ * @brief 从某一时刻到现在经过的时间
+ *
+ * @param since 起始时刻, `time_us()`的返回值
+ * @return uint32_t 微秒
+ */
+static inline uint32_t time_elapsed_us(uint32_t since) {
+    return time_us() - since;
+}
+
+/**
+ * @brief 计算截止时刻
+ *
+ * @param timeout_us 从现在开始的超时时间(us), 必须小于2^31
+ * @return uint32_t 截止时刻
+ */
+static inline uint32_t time_deadline_us(uint32_t timeout_us) {
+    return time_us() + timeout_us;
+}
+
+/**
+ * @brief 是否已到截止时刻
+ *
+ * @param deadline `time_deadline_us()`的返回值
+ * @return true-已到; false-未到
+ */
+static inline bool time_expired_us(uint32_t deadline) {
+    return (int32_t)(time_us() - deadline) >= 0;
+}
+
+/**
+ * @brief 距截止时刻还剩的时间
+ *
+ * @param deadline `time_deadline_us()`的返回值
+ * @return uint32_t 微秒, 已到截止时刻返回0
+ */
+static inline uint32_t time_remaining_us(uint32_t deadline) {
+    int32_t remaining = (int32_t)(deadline - time_us());
+    return remaining > 0 ? (uint32_t)remaining : 0U;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __TIMEBASE_H */
@@ -1,7 +1,7 @@
 /**
  * @file    usart.h
- * @date    2023/7/24
- * @version 0.3
+ * @date    2023/12/24
+ * @version 0.5
  * @note    此文件主要用于STM32F4串口(usart1->uart8)的初始化函数以及中断服务函数
  *          如果启用了串口1,printf函数将会被重定义为从串口1输出
  * @warning 要使用相关函数请预先在此文件里定义
@@ -11,6 +11,7 @@
 #define __USART_H
 
 
+#include "bin_frame.h"
 #include "stdarg.h"
 #include "stdio.h"
 #include "string.h"
@@ -21,6 +22,25 @@
 #define TX_BUF_LEN 256    /* 定义发送字节数 256 */
 #define RXBUFFERSIZE 1    /* 定义接收缓冲区大小 */
 
+/**
+ * 串口1发送环形缓冲区, 0禁用(阻塞发送); 1启用
+ * 启用后printf和USART1_Write只把数据写入缓冲区, 由TXE中断逐字节发送,
+ * 在中断里输出也不会阻塞. 缓冲区满时USART1_Write丢弃整段数据
+ */
+#define USART1_TX_RING_ENABLE 1
+/* 串口1发送缓冲区大小(字节), 必须是2的幂 */
+#define USART1_TX_RING_LEN 1024U
+
+/**
+ * 串口1二进制帧接收, 0禁用; 1启用
+ * 文本行没有开始时收到0xA5, 按帧中的长度接收一整帧到USART1_BIN_BUF,
+ * 不进入文本行缓冲区. 帧格式见bin_frame.h.
+ * 只有一个帧缓冲区, 上位机收到应答之后再发下一帧
+ */
+#define USART1_BIN_ENABLE 1
+/* 二进制帧字节间隔超过此值(us)时丢弃不完整的帧 */
+#define USART1_BIN_TIMEOUT_US 5000U
+
 /**
  * 是否使用串口,启用就在此处define
  * @warning 未定义的串口,相关函数将无法使用,编译不通过!
@@ -57,8 +77,17 @@ extern uint8_t USART1_RX_BUF[USART_REC_LEN];
 extern uint16_t USART1_RX_STA;
 extern uint8_t aRxBuffer1[RXBUFFERSIZE];
 #endif
+#if EN_USART1_RX && USART1_BIN_ENABLE
+/* bit15: 收到完整的一帧; bit14: 正在接收; bit13 ~ 0: 已收到的字节数 */
+extern uint8_t USART1_BIN_BUF[BIN_FRAME_MAX_LEN];
+extern volatile uint16_t USART1_BIN_STA;
+#endif
 
 void USART1_Init(uint32_t bound);
+uint32_t USART1_Write(const void* data, uint32_t len);
+#if USART1_TX_RING_ENABLE
+extern volatile uint32_t usart1_tx_dropped;
+#endif
 #endif
 
 #ifdef EN_USART2
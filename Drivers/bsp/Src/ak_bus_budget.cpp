@@ -0,0 +1,53 @@
+/**
+ * @file    ak_bus_budget.cpp
+ * @author  Deadline--
+ * @brief   CAN总线带宽规划
+ * @version 0.2
+ * @date    2023-12-08
+ */
+
+#include "ak_bus_budget.hpp"
+
+/**
+ * @brief 根据一条总线上已注册的电机和控制频率规划总线带宽
+ *
+ * @param bus 总线编号, 两条总线并行发送, 各自单独规划
+ * @param loop_hz 控制频率(Hz)
+ * @param[out] budget 规划详情, 可以为`NULL`
+ * @return AK_Bus_Status_t 规划结果
+ * @note 必须在CAN初始化和电机实例化之后调用, 波特率从`CAN_Get_Bitrate`获取.
+ *       总线上没有电机时负载为0
+ */
+AK_Bus_Status_t ak_bus_plan(CAN_Bus_t bus,
+                            uint32_t loop_hz,
+                            AK_Bus_Budget_t* budget) {
+    AK_Bus_Budget_t result;
+    result.bitrate = CAN_Get_Bitrate(bus);
+    result.mit_motors = ak_motor_count(bus, AK_MIT_Mode);
+    result.servo_motors = ak_motor_count(bus, AK_Servo_Mode);
+    result.bits_per_period =
+        ak_bus_bits_per_period(result.mit_motors, result.servo_motors);
+    result.max_loop_hz =
+        ak_bus_max_loop_hz(result.bitrate, result.mit_motors,
+                           result.servo_motors, AK_BUS_LOAD_LIMIT);
+    if (result.bits_per_period == 0) {
+        result.load_permille = 0;
+    } else if (result.bitrate == 0) {
+        result.load_permille = 1000;
+    } else {
+        result.load_permille =
+            (uint32_t)((uint64_t)result.bits_per_period * loop_hz * 1000U /
+                       result.bitrate);
+    }
+    if (budget != NULL) {
+        *budget = result;
+    }
+
+    if (result.load_permille > AK_BUS_LOAD_LIMIT) {
+        return AK_BUS_OVERLOAD;
+    }
+    if (result.load_permille > AK_BUS_LOAD_WARN) {
+        return AK_BUS_WARN;
+    }
+    return AK_BUS_OK;
+}
@@ -0,0 +1,478 @@
+/**
+ * @file    ak_config.cpp
+ * @author  Deadline--
+ * @brief   电机配置, 保存在片内flash
+ * @version 0.1
+ * @date    2023-12-23
+ */
+
+#include "ak_config.hpp"
+
+#include "num_parse.h"
+
+AK_Config_Class ak_config; /* 全局配置 */
+
+/* 输出增益和限幅的小数位数 */
+#define AK_CONFIG_DECIMALS 4U
+
+/**
+ * @brief 构造函数, 使用默认配置
+ *
+ */
+AK_Config_Class::AK_Config_Class(void) {
+    set_defaults();
+}
+
+/**
+ * @brief 恢复默认配置: 没有电机, 启动时扫描
+ *
+ */
+void AK_Config_Class::set_defaults(void) {
+    memset(&data, 0, sizeof(data));
+    data.version = AK_CONFIG_VERSION;
+    data.size = sizeof(AK_Config_t);
+    data.scan_at_boot = 1;
+    seq = 0;
+}
+
+/**
+ * @brief 一个电机的默认配置, 不限幅, 看门狗使用默认期限只标记失联
+ *
+ * @param[out] motor 电机配置, CAN ID和总线为0
+ */
+void AK_Config_Class::motor_defaults(AK_Config_Motor_t* motor) {
+    memset(motor, 0, sizeof(*motor));
+    motor->model = AK_CONFIG_DEFAULT_MODEL;
+    motor->mode = AK_MIT_Mode;
+    motor->wdg_action = AK_SAFE_NONE;
+    motor->wdg_timeout_us = AK_WDG_TIMEOUT_US;
+}
+
+/**
+ * @brief 检查一个电机的配置是否在范围内
+ *
+ * @param motor 电机配置
+ * @return true-有效; false-有字段超出范围
+ * @note 浮点字段为NaN时也无效
+ */
+bool AK_Config_Class::motor_valid(const AK_Config_Motor_t& motor) {
+    if (motor.bus >= CAN_BUS_NUM || motor.model > AK80_8 ||
+        motor.mode > AK_MIT_Mode || motor.wdg_action > AK_SAFE_BRAKE) {
+        return false;
+    }
+    if (!(motor.kp >= 0.0f && motor.kp <= AK_MIT_MAX_KP) ||
+        !(motor.kd >= 0.0f && motor.kd <= AK_MIT_MAX_KD)) {
+        return false;
+    }
+    return motor.pos_limit >= 0.0f && motor.spd_limit >= 0.0f &&
+           motor.torque_limit >= 0.0f;
+}
+
+/**
+ * @brief 检查整个配置, 同一总线上CAN ID不能重复
+ *
+ * @return true-有效; false-无效
+ */
+bool AK_Config_Class::valid(void) const {
+    if (data.motor_num > AK_CONFIG_MAX_MOTORS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < data.motor_num; i++) {
+        if (motor_valid(data.motor[i]) == false) {
+            return false;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (data.motor[j].bus == data.motor[i].bus &&
+                data.motor[j].id == data.motor[i].id) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 从flash读取配置
+ *
+ * @return AK_Config_Status_t 读取结果, 除`AK_CFG_OK`和`AK_CFG_MIGRATED`外
+ *         都使用默认配置
+ * @note 旧版本的记录按长度复制, 末尾的新字段为默认值
+ */
+AK_Config_Status_t AK_Config_Class::load(void) {
+    AK_Config_t record;
+    uint32_t len = 0;
+    store_status = flash_store_load(&record, sizeof(record), &len);
+    if (store_status == FLASH_STORE_EMPTY) {
+        set_defaults();
+        return AK_CFG_DEFAULT;
+    }
+    if (store_status != FLASH_STORE_OK || len < 4U ||
+        record.version > AK_CONFIG_VERSION || record.size != len ||
+        (record.version == AK_CONFIG_VERSION && len != sizeof(AK_Config_t))) {
+        set_defaults();
+        return AK_CFG_ERR_VERSION;
+    }
+
+    AK_Config_Status_t status = AK_CFG_OK;
+    set_defaults();
+    if (record.version < AK_CONFIG_VERSION) {
+        memcpy(&data, &record, len);
+        data.version = AK_CONFIG_VERSION;
+        data.size = sizeof(AK_Config_t);
+        status = AK_CFG_MIGRATED;
+    } else {
+        data = record;
+    }
+    if (valid() == false) {
+        set_defaults();
+        return AK_CFG_ERR_INVALID;
+    }
+    flash_store_info_t info;
+    flash_store_info(&info);
+    seq = info.seq;
+    return status;
+}
+
+/**
+ * @brief 把当前配置保存到flash
+ *
+ * @return AK_Config_Status_t `AK_CFG_OK`或`AK_CFG_ERR_STORE`
+ * @note 阻塞, 需要轮换扇区时1 ~ 2s, 只能在电机没有控制时调用
+ */
+AK_Config_Status_t AK_Config_Class::save(void) {
+    data.version = AK_CONFIG_VERSION;
+    data.size = sizeof(AK_Config_t);
+    store_status = flash_store_save(&data, sizeof(data));
+    if (store_status != FLASH_STORE_OK) {
+        return AK_CFG_ERR_STORE;
+    }
+    flash_store_info_t info;
+    flash_store_info(&info);
+    seq = info.seq;
+    return AK_CFG_OK;
+}
+
+/**
+ * @brief 擦除flash中的配置, 当前配置不变
+ *
+ * @return AK_Config_Status_t `AK_CFG_OK`或`AK_CFG_ERR_STORE`
+ * @note 阻塞2 ~ 4s, 只能在电机没有控制时调用
+ */
+AK_Config_Status_t AK_Config_Class::erase(void) {
+    store_status = flash_store_erase();
+    if (store_status != FLASH_STORE_OK) {
+        return AK_CFG_ERR_STORE;
+    }
+    seq = 0;
+    return AK_CFG_OK;
+}
+
+/**
+ * @brief 设置一个电机的配置
+ *
+ * @param index 下标, 等于电机数时追加
+ * @param motor 电机配置
+ * @return AK_Config_Status_t `AK_CFG_OK`或`AK_CFG_ERR_INVALID`
+ */
+AK_Config_Status_t AK_Config_Class::set_motor(uint32_t index,
+                                              const AK_Config_Motor_t& motor) {
+    if (index > data.motor_num || index >= AK_CONFIG_MAX_MOTORS ||
+        motor_valid(motor) == false) {
+        return AK_CFG_ERR_INVALID;
+    }
+    for (uint32_t i = 0; i < data.motor_num; i++) {
+        if (i != index && data.motor[i].bus == motor.bus &&
+            data.motor[i].id == motor.id) {
+            return AK_CFG_ERR_INVALID;
+        }
+    }
+    data.motor[index] = motor;
+    if (index == data.motor_num) {
+        data.motor_num++;
+    }
+    return AK_CFG_OK;
+}
+
+/**
+ * @brief 追加一个使用默认参数的电机, 用于记录扫描结果
+ *
+ * @param bus 总线编号
+ * @param id CAN ID
+ * @param model 型号
+ * @param mode 控制模式
+ * @return int32_t 电机的下标, 已经存在时返回原来的下标; 配置已满时为-1
+ */
+int32_t AK_Config_Class::add_motor(CAN_Bus_t bus,
+                                   uint8_t id,
+                                   AK_motor_model_t model,
+                                   AK_Ctrlmode_t mode) {
+    for (uint32_t i = 0; i < data.motor_num; i++) {
+        if (data.motor[i].bus == bus && data.motor[i].id == id) {
+            return (int32_t)i;
+        }
+    }
+    AK_Config_Motor_t motor;
+    motor_defaults(&motor);
+    motor.bus = (uint8_t)bus;
+    motor.id = id;
+    motor.model = (uint8_t)model;
+    motor.mode = (uint8_t)mode;
+    if (set_motor(data.motor_num, motor) != AK_CFG_OK) {
+        return -1;
+    }
+    return (int32_t)(data.motor_num - 1U);
+}
+
+/**
+ * @brief 查找一条总线上第一个指定模式的电机
+ *
+ * @param bus 总线编号
+ * @param mode 控制模式
+ * @return const AK_Config_Motor_t* 没有找到返回`NULL`
+ */
+const AK_Config_Motor_t* AK_Config_Class::find(CAN_Bus_t bus,
+                                               AK_Ctrlmode_t mode) const {
+    for (uint32_t i = 0; i < data.motor_num; i++) {
+        if (data.motor[i].bus == bus && data.motor[i].mode == mode) {
+            return &data.motor[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 把配置中的看门狗参数应用到电机对象
+ *
+ * @param motor 电机对象, 已用配置中的ID、型号、模式和总线构造
+ * @param cfg 电机配置
+ * @note 增益和限幅由控制程序使用, 见`clamp()`
+ */
+void AK_Config_Class::apply(AK_Motor_Class& motor,
+                            const AK_Config_Motor_t& cfg) {
+    motor.set_watchdog(cfg.wdg_timeout_us, (AK_Safe_Action_t)cfg.wdg_action);
+}
+
+/**
+ * @brief 对称限幅
+ *
+ * @param value 数值
+ * @param limit 绝对值上限, 0不限制
+ * @return float 限幅后的值
+ */
+static inline float ak_config_limit(float value, float limit) {
+    if (limit <= 0.0f) {
+        return value;
+    }
+    if (value > limit) {
+        return limit;
+    }
+    return value < -limit ? -limit : value;
+}
+
+/**
+ * @brief 按配置限制给定值
+ *
+ * @param cfg 电机配置
+ * @param[in,out] pos 目标位置
+ * @param[in,out] spd 目标速度, 伺服模式为转速
+ * @param[in,out] torque 前馈扭矩, 伺服模式为电流
+ */
+void AK_Config_Class::clamp(const AK_Config_Motor_t& cfg,
+                            float& pos,
+                            float& spd,
+                            float& torque) {
+    pos = ak_config_limit(pos, cfg.pos_limit);
+    spd = ak_config_limit(spd, cfg.spd_limit);
+    torque = ak_config_limit(torque, cfg.torque_limit);
+}
+
+/**
+ * @brief 把浮点数格式化成以'\0'结尾的字符串
+ *
+ * @param[out] buf 输出, 至少`NUM_FMT_MAX_LEN + 1`字节
+ * @param value 数值
+ * @return const char* buf
+ */
+static const char* ak_config_fmt(char* buf, float value) {
+    buf[num_fmt_fixed(buf, value, AK_CONFIG_DECIMALS)] = '\0';
+    return buf;
+}
+
+/**
+ * @brief 串口输出全部配置, 格式与写入指令相同, 每行以`#`开头
+ *
+ */
+void ak_config_report(void) {
+    char a[NUM_FMT_MAX_LEN + 1], b[NUM_FMT_MAX_LEN + 1], c[NUM_FMT_MAX_LEN + 1];
+    const AK_Config_t* cfg = &ak_config.data;
+    printf("#cfg v%u seq %lu motors %u\r\n", (unsigned)cfg->version,
+           (unsigned long)ak_config.seq, (unsigned)cfg->motor_num);
+    printf("#cfg scan %u\r\n", (unsigned)cfg->scan_at_boot);
+    for (uint32_t i = 0; i < cfg->motor_num; i++) {
+        const AK_Config_Motor_t* m = &cfg->motor[i];
+        printf("#cfg motor %lu,%u,%u,%u,%u\r\n", (unsigned long)i,
+               (unsigned)m->id, (unsigned)m->bus, (unsigned)m->model,
+               (unsigned)m->mode);
+        printf("#cfg gain %lu,%s,%s\r\n", (unsigned long)i,
+               ak_config_fmt(a, m->kp), ak_config_fmt(b, m->kd));
+        printf("#cfg limit %lu,%s,%s,%s\r\n", (unsigned long)i,
+               ak_config_fmt(a, m->pos_limit), ak_config_fmt(b, m->spd_limit),
+               ak_config_fmt(c, m->torque_limit));
+        printf("#cfg wdg %lu,%lu,%u\r\n", (unsigned long)i,
+               (unsigned long)m->wdg_timeout_us, (unsigned)m->wdg_action);
+    }
+}
+
+/**
+ * @brief 解析指令参数中的非负整数
+ *
+ * @param value 解析得到的浮点数
+ * @param max 最大值
+ * @param[out] out 结果
+ * @return true-成功; false-不是整数或超出范围
+ */
+static bool ak_config_uint(float value, uint32_t max, uint32_t* out) {
+    if (!(value >= 0.0f && value <= (float)max) ||
+        (float)(uint32_t)value != value) {
+        return false;
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+/**
+ * @brief 解析指令参数, 第一个字段是电机下标
+ *
+ * @param args 参数
+ * @param[out] values 字段值
+ * @param count 字段数, 包括下标
+ * @param[out] motor 下标对应的电机配置, 下标等于电机数时为默认配置
+ * @param[out] index 下标
+ * @return true-成功; false-格式错误或下标超出范围, 已输出错误信息
+ */
+static bool ak_config_args(const char* args,
+                           float* values,
+                           uint32_t count,
+                           AK_Config_Motor_t* motor,
+                           uint32_t* index) {
+    uint32_t pos = 0;
+    num_parse_status_t status = num_parse_csv(args, values, count, 0.0f, &pos);
+    if (status != NUM_PARSE_OK) {
+        printf("#cfg parse error: %s at %lu\r\n", num_parse_status_str(status),
+               (unsigned long)pos);
+        return false;
+    }
+    if (ak_config_uint(values[0], ak_config.data.motor_num, index) == false ||
+        *index >= AK_CONFIG_MAX_MOTORS) {
+        printf("#cfg bad index\r\n");
+        return false;
+    }
+    if (*index < ak_config.data.motor_num) {
+        *motor = ak_config.data.motor[*index];
+    } else {
+        AK_Config_Class::motor_defaults(motor);
+    }
+    return true;
+}
+
+/**
+ * @brief 执行一行配置指令, 指令格式见`ak_config.hpp`
+ *
+ * @param line 一行文本, 不含换行
+ * @param allow_write 是否允许读写flash, 控制电机时传false
+ * @return true-是配置指令(无论成功与否); false-不是配置指令
+ * @note 修改的是内存中的配置, `cfg save`之后才写入flash.
+ *       已经创建的电机对象不会改变ID和型号, 限幅立即生效
+ */
+bool ak_config_command(const char* line, bool allow_write) {
+    if (strncmp(line, "cfg", 3) != 0 || (line[3] != '\0' && line[3] != ' ')) {
+        return false;
+    }
+    const char* cmd = line[3] == ' ' ? line + 4 : line + 3;
+    float v[5];
+    uint32_t index = 0, num = 0, action = 0;
+    AK_Config_Motor_t motor;
+    AK_Config_Status_t status = AK_CFG_OK;
+
+    if (*cmd == '\0') {
+        ak_config_report();
+        return true;
+    }
+    if (strcmp(cmd, "save") == 0 || strcmp(cmd, "load") == 0 ||
+        strcmp(cmd, "erase") == 0) {
+        if (allow_write == false) {
+            printf("#cfg busy, exit control first\r\n");
+            return true;
+        }
+        if (cmd[0] == 's') {
+            status = ak_config.save();
+        } else if (cmd[0] == 'l') {
+            status = ak_config.load();
+        } else {
+            status = ak_config.erase();
+        }
+        printf("#cfg %s %s, seq %lu\r\n", cmd,
+               flash_store_status_str(ak_config.store_status),
+               (unsigned long)ak_config.seq);
+        return true;
+    }
+    if (strcmp(cmd, "clear") == 0) {
+        ak_config.data.motor_num = 0;
+    } else if (strncmp(cmd, "scan ", 5) == 0) {
+        if (num_parse_csv(cmd + 5, v, 1, 0.0f, NULL) != NUM_PARSE_OK ||
+            ak_config_uint(v[0], 1U, &num) == false) {
+            printf("#cfg bad value\r\n");
+            return true;
+        }
+        ak_config.data.scan_at_boot = (uint8_t)num;
+    } else if (strncmp(cmd, "motor ", 6) == 0) {
+        if (ak_config_args(cmd + 6, v, 5, &motor, &index) == false) {
+            return true;
+        }
+        uint32_t id = 0, bus = 0, model = 0, mode = 0;
+        if (ak_config_uint(v[1], AK_MOTOR_ID_NUM - 1U, &id) == false ||
+            ak_config_uint(v[2], CAN_BUS_NUM - 1U, &bus) == false ||
+            ak_config_uint(v[3], AK80_8, &model) == false ||
+            ak_config_uint(v[4], AK_MIT_Mode, &mode) == false) {
+            printf("#cfg bad value\r\n");
+            return true;
+        }
+        motor.id = (uint8_t)id;
+        motor.bus = (uint8_t)bus;
+        motor.model = (uint8_t)model;
+        motor.mode = (uint8_t)mode;
+        status = ak_config.set_motor(index, motor);
+    } else if (strncmp(cmd, "gain ", 5) == 0) {
+        if (ak_config_args(cmd + 5, v, 3, &motor, &index) == false) {
+            return true;
+        }
+        motor.kp = v[1];
+        motor.kd = v[2];
+        status = ak_config.set_motor(index, motor);
+    } else if (strncmp(cmd, "limit ", 6) == 0) {
+        if (ak_config_args(cmd + 6, v, 4, &motor, &index) == false) {
+            return true;
+        }
+        motor.pos_limit = v[1];
+        motor.spd_limit = v[2];
+        motor.torque_limit = v[3];
+        status = ak_config.set_motor(index, motor);
+    } else if (strncmp(cmd, "wdg ", 4) == 0) {
+        if (ak_config_args(cmd + 4, v, 3, &motor, &index) == false) {
+            return true;
+        }
+        if (ak_config_uint(v[1], 999999U, &num) == false ||
+            ak_config_uint(v[2], AK_SAFE_BRAKE, &action) == false) {
+            printf("#cfg bad value\r\n");
+            return true;
+        }
+        motor.wdg_timeout_us = num;
+        motor.wdg_action = (uint8_t)action;
+        status = ak_config.set_motor(index, motor);
+    } else {
+        printf("#cfg unknown command\r\n");
+        return true;
+    }
+    printf(status == AK_CFG_OK ? "#cfg ok\r\n" : "#cfg invalid\r\n");
+    return true;
+}
@@ -10,159 +10,753 @@
  ======================================================================
                        ##### 库使用说明 #####
  ======================================================================
- (#) 实例化一个`AK_Motor_Class`对象, 指定型号与CAN ID
- (#) 在构造函数内会将电机对象插入到链表中, 以便于回调给对应的电机参数赋值.
-     构造一个对象时, 会查找链表中是否存在相同CAN ID的对象,
-     如果存在, 则将`id_conflict`属性设为`true`. 因此使用时要关注`id_conflict`.
-     当CAN接收中断回调时, 会遍历链表, 查找与CAN ID一致的对象,
-     找到后给对象属性赋值.
- (#) 链表使用Linux内核链表, 以保证可靠性
+ (#) 实例化一个`AK_Motor_Class`对象, 指定型号与CAN ID, 以及所在总线(默认CAN1)
+ (#) 每条总线有独立的注册表和发送队列, 相同CAN ID可以同时用在两条总线上.
+ (#) 在构造函数内会将电机对象插入到注册表中, 以便于回调给对应的电机参数赋值.
+     注册表节点来自`AK_MAX_MOTORS`个静态节点, 不使用堆, 注册/注销都是O(1).
+     构造一个对象时, 会查表判断同一总线上是否存在相同CAN ID的对象,
+     如果存在, 则将`id_conflict`属性设为`true`. 节点用完时注册失败.
+     结果都记录在`reg_status`中, 因此使用时要关注`reg_status`.
+     当CAN接收中断回调时, 按CAN ID查表找到对象, 给对象属性赋值.
+ (#) 链表使用`intrusive_list.hpp`中的侵入式链表, 遍历用局部迭代器,
+     修改链表时关中断, 与CAN接收中断互不干扰
+ (#) 回包触发控制: 调用`set_reply_trigger(true)`把电机加入控制组.
+     每个控制周期先调用`ak_group_arm()`, 再发送指令, 然后调用`ak_group_wait()`.
+     组内最后一个回包在`ak_can_get_measure`中到达时, 立即结束等待并回调
+     `ak_group_ready_callback()`; 回包缺失时等待超时, 退回周期控制.
+ (#) 重复帧抑制: 调用`set_tx_dedup(true, keepalive_ms)`后, 指令帧与上一帧
+     完全相同且未到保活间隔时不发送, 被抑制的帧数记录在`tx_suppressed`.
+     进入/退出/设置原点指令总是发送.
+ (#) 电机属性由CAN接收中断更新, 在其他线程/任务中读取时用`get_state()`
+     获取同一帧回包的一致快照.
+ (#) 急停: `ak_estop()`清空发送队列, 给所有已注册的电机写入紧急停止帧
+     (运控模式退出控制, 伺服模式电流置0), 之后所有指令都不发送,
+     直到调用`ak_estop_clear()`.
+ (#) 回包看门狗: 发出指令后开始等待回包, SysTick中`ak_wdg_tick()`检查期限,
+     超时则标记`wdg.stale`并计数, 按`set_watchdog()`设置的安全动作
+     发送停止帧, 失联期间普通指令不发送, 收到回包后自动恢复.
 
  @endverbatim
  */
 
 #include "ak_motor.hpp"
 
-struct list_head* head_ptr = NULL; /* 头指针, 空代表没有初始化 */
-struct list_head* pos_ptr;         /* 遍历时的链表位置指针 */
+#include "ak_scan.hpp"
+#include "math.h"
+
+static volatile bool ak_group_ready = false; /* 控制组回包是否已全部到达 */
+static volatile bool ak_group_replied = false; /* 本周期是否收到过控制组回包 */
+static volatile bool ak_estop_latched = false; /* 是否处于急停状态 */
+static uint32_t ak_estop_buses = 0;  /* 停止帧还没发送完成的总线, 按位表示 */
+static uint32_t ak_estop_start = 0;  /* 急停触发时的DWT周期计数 */
+AK_Estop_Stats_t ak_estop_stats;     /* 急停延迟统计 */
 
 /**
  * @brief 将电机类与链表关联, 此结构体仅限本文件使用
  *
  */
-typedef struct {
-    struct list_head ak_motor_list;    /*!< 链表指针 */
+struct AK_Motor_Linklist {
+    List_Node ak_motor_list;           /*!< 链表节点 */
     AK_Motor_Class* ak_motor_instance; /*!< 对象实例 */
-} AK_Motor_Linklist_t;
+};
+typedef struct AK_Motor_Linklist AK_Motor_Linklist_t;
+
+typedef Intrusive_List<AK_Motor_Linklist_t, &AK_Motor_Linklist_t::ak_motor_list>
+    AK_Motor_List_t;
+
+static AK_Motor_Linklist_t ak_motor_pool[AK_MAX_MOTORS]; /* 节点静态存储区 */
+static AK_Motor_List_t ak_motor_free; /* 空闲节点链表, 两条总线共用 */
+static AK_Motor_List_t ak_motor_list[CAN_BUS_NUM]; /* 每条总线已注册的电机 */
+static bool ak_motor_pool_ready = false; /* 空闲链表是否已初始化 */
+
+/* 每条总线CAN ID到节点的映射表, 注册/注销/查找都是O(1) */
+static AK_Motor_Linklist_t* ak_motor_id_table[CAN_BUS_NUM][AK_MOTOR_ID_NUM];
+
+/**
+ * @brief 查找CAN ID对应的电机
+ *
+ * @param bus 总线编号
+ * @param id CAN ID
+ * @return AK_Motor_Class* 电机对象, 不存在返回`NULL`
+ */
+static inline AK_Motor_Class* ak_motor_find(CAN_Bus_t bus, uint32_t id) {
+    if (bus >= CAN_BUS_NUM || id >= AK_MOTOR_ID_NUM ||
+        ak_motor_id_table[bus][id] == NULL) {
+        return NULL;
+    }
+    return ak_motor_id_table[bus][id]->ak_motor_instance;
+}
+
+/**
+ * @brief 控制组内的电机本周期不再等待回包, 检查是否为最后一个
+ *
+ * @param motor 电机对象
+ * @param replied `true`-收到回包; `false`-指令没有发送, 不会有回包
+ * @note 调用时不能被CAN接收中断打断.
+ *       本周期的指令全部被抑制时不触发, 等待到超时, 避免控制循环空转
+ */
+static void ak_group_reply_done(AK_Motor_Class* motor, bool replied) {
+    if (motor->reply_pending == false) {
+        return;
+    }
+    motor->reply_pending = false;
+    if (replied == true) {
+        ak_group_replied = true;
+    }
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        for (AK_Motor_Linklist_t& node : ak_motor_list[bus]) {
+            if (node.ak_motor_instance->reply_pending == true) {
+                return;
+            }
+        }
+    }
+    if (ak_group_replied == false) {
+        return;
+    }
+    ak_group_ready = true;
+    ak_group_ready_callback();
+}
 
 /**
  * @brief Construct a new ak motor class::ak motor class object
  *
  * @param ID CAN ID
  * @param model AK电机型号
+ * @param mode 控制模式, 用于总线带宽规划, 发送指令后自动更新
+ * @param bus 电机所在总线, 不同总线上的电机可以使用相同的CAN ID
+ * @note 注册结果保存在`reg_status`中, 失败时对象仍可以发送指令,
+ *       但收不到电机回包
  */
-AK_Motor_Class::AK_Motor_Class(uint32_t ID, AK_motor_model_t model) {
+AK_Motor_Class::AK_Motor_Class(uint32_t ID,
+                               AK_motor_model_t model,
+                               AK_Ctrlmode_t mode,
+                               CAN_Bus_t bus) {
     id_conflict = false;
+    reg_status = AK_REG_OK;
+    state_seq = 0;
+    reg_node = NULL;
+    reply_trigger = false;
+    reply_pending = false;
+    tx_dedup = false;
+    tx_keepalive_us = 0;
+    tx_suppressed = 0;
+    tx_cache_valid = false;
+    motor_pos_multi = 0.0f;
+    motor_spd_est = 0.0f;
+    memset(&pos_est, 0, sizeof(pos_est));
+    pos_est.alpha = AK_EST_ALPHA;
+    pos_est.beta = AK_EST_BETA;
+    rx_us = 0;
+    rx_time = 0;
+    memset(&mit_cmd, 0, sizeof(mit_cmd));
+    pred_inertia = 0.0f;
+    memset(&wdg, 0, sizeof(wdg));
+    wdg.timeout_us = AK_WDG_TIMEOUT_US;
+    wdg.action = AK_SAFE_NONE;
 
     controller_id = ID;
+    can_bus = bus;
     motor_model = model;
-    /* 将对象加入到链表中 */
-    if (head_ptr == NULL) {
-        head_ptr = (list_head*)malloc(sizeof(list_head));
-        /* 链表为空, 说明是第一次实例化对象, 初始化链表 */
-        INIT_LIST_HEAD(head_ptr);
+    ctrl_mode = mode;
+
+    if (ID >= AK_MOTOR_ID_NUM || bus >= CAN_BUS_NUM) {
+        reg_status = AK_REG_ID_INVALID;
+        return;
+    }
+
+    /* CAN中断里也会访问注册表, 修改时关中断 */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (ak_motor_pool_ready == false) {
+        /* 第一次实例化对象, 把所有节点放入空闲链表 */
+        for (uint32_t i = 0; i < AK_MAX_MOTORS; i++) {
+            ak_motor_free.push_back(ak_motor_pool[i]);
+        }
+        ak_motor_pool_ready = true;
+    }
+    if (ak_motor_id_table[bus][ID] != NULL) {
+        id_conflict = true; /* CAN ID冲突 */
+        reg_status = AK_REG_ID_CONFLICT;
     } else {
-        /* 不为空, 遍历查找CAN ID是否冲突 */
-        list_for_each(pos_ptr, head_ptr) {
-            if (((AK_Motor_Linklist_t*)pos_ptr)
-                    ->ak_motor_instance->controller_id == ID) {
-                id_conflict = true; /* CAN ID冲突 */
-                return;
-            }
+        reg_node = ak_motor_free.pop_front();
+        if (reg_node == NULL) {
+            reg_status = AK_REG_POOL_FULL; /* 超过AK_MAX_MOTORS */
+        } else {
+            reg_node->ak_motor_instance = this;
+            ak_motor_list[bus].push_front(*reg_node);
+            ak_motor_id_table[bus][ID] = reg_node;
         }
     }
-    AK_Motor_Linklist_t* new_node;
-    new_node = (AK_Motor_Linklist_t*)malloc(sizeof(AK_Motor_Linklist_t));
-    new_node->ak_motor_instance = this;
-    list_add(&new_node->ak_motor_list, head_ptr);
+    __set_PRIMASK(primask);
 }
 /**
  * @brief Destroy the ak motor class::ak motor class object
  *
  */
 AK_Motor_Class::~AK_Motor_Class() {
-    if (id_conflict == true) {
-        /* ID冲突, 链表中不存在, 不做处理 */
+    if (reg_node == NULL) {
+        /* 注册失败, 注册表中不存在, 不做处理 */
         return;
     }
-    /* 对象被销毁, 从队列里释放 */
-    list_for_each(pos_ptr, head_ptr) {
-        if (((AK_Motor_Linklist_t*)pos_ptr)->ak_motor_instance->controller_id ==
-            controller_id) {
-            list_del(&((AK_Motor_Linklist_t*)pos_ptr)->ak_motor_list);
-            break;
-        }
+    /* 对象被销毁, 节点归还空闲链表 */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ak_motor_id_table[can_bus][controller_id] = NULL;
+    AK_Motor_List_t::remove(*reg_node);
+    reg_node->ak_motor_instance = NULL;
+    ak_motor_free.push_front(*reg_node);
+    __set_PRIMASK(primask);
+    reg_node = NULL;
+}
+
+/* 取回包数据第n个字节, 数据低4字节在data_lo, 高4字节在data_hi */
+#define AK_DATA_BYTE(word, n) (((word) >> (((n) & 3U) * 8U)) & 0xFFU)
+
+/**
+ * @brief 用一帧位置原始值更新多圈位置和速度估计
+ *
+ * @param est 估计器
+ * @param mode 回包模式
+ * @param raw 位置原始值, 运控模式是无符号偏移码, 伺服模式是有符号数
+ * @param vel_hint 超时重新初始化时使用的速度(计数/s), 不知道时传0
+ * @param stamp 收到回包时的time_us()
+ * @note 展开时取使 |增量 - 预测增量| 最小的整周期数, 预测增量 = 速度 * 间隔.
+ *       间隔不超过`AK_EST_TIMEOUT_MS`时, 即使只用原始增量,
+ *       也要速度超过半个周期/50ms(运控模式250rad/s)才会判错, 高于所有型号
+ *       的最大速度; 超时后用电机回报的速度预测, 长时间丢包也能正确展开.
+ */
+static void ak_pos_est_update(AK_Pos_Est_t* est,
+                              AK_Ctrlmode_t mode,
+                              uint16_t raw,
+                              float vel_hint,
+                              uint32_t stamp) {
+    if (est->valid == false || est->mode != mode) {
+        est->valid = true;
+        est->mode = mode;
+        est->counts = (mode == AK_Servo_Mode) ? (int64_t)(int16_t)raw
+                                              : (int64_t)raw;
+        est->raw_last = raw;
+        est->stamp = stamp;
+        est->err = 0.0f;
+        est->vel = vel_hint;
+        return;
+    }
+
+    float dt = (float)(stamp - est->stamp) * 1e-6f;
+    bool timeout = dt > (float)AK_EST_TIMEOUT_MS * 0.001f;
+    if (dt <= 0.0f) {
+        return; /* 同一时刻的重复回包 */
+    }
+    if (timeout) {
+        est->vel = vel_hint;
+        est->err = 0.0f;
+        est->resets++;
+    }
+
+    /* 16位增量, 再按预测修正整周期数 */
+    int32_t delta = (int16_t)(uint16_t)(raw - est->raw_last);
+    float wraps =
+        (est->vel * dt - (float)delta) / (float)AK_EST_RAW_SPAN + 0.5f;
+    delta += (int32_t)floorf(wraps) * AK_EST_RAW_SPAN;
+    est->counts += delta;
+    est->raw_last = raw;
+    est->stamp = stamp;
+
+    if (timeout == false) {
+        /* α-β滤波, 只保存估计值与测量值之差, 多圈后也不损失精度 */
+        float residual = (float)delta - (est->err + est->vel * dt);
+        est->err = (est->alpha - 1.0f) * residual;
+        est->vel += est->beta * residual / dt;
     }
 }
 
 /**
  * @brief 获得电机状态参数, 运控模式和伺服模式是一样的, 只是帧格式不同
  *
+ * @param bus 收到回包的总线
  * @param can_id CAN ID
  * @param can_msg CAN消息
  * @param AK_mode 模式
- * @note 此函数可以被重写
+ * @param rx_time 硬件时间戳(位时间), 未启用`CAN_TIMESTAMP_ENABLE`时为0
+ * @note 此函数可以被重写. CAN快速路径直接调用`ak_can_get_measure_words`,
+ *       不经过此函数
  */
-__weak void ak_can_get_measure(uint8_t can_id,
+__weak void ak_can_get_measure(CAN_Bus_t bus,
+                               uint8_t can_id,
                                uint8_t* can_msg,
-                               AK_Ctrlmode_t AK_mode) {
-    bool found = false;
-    list_for_each(pos_ptr, head_ptr) {
-        if (((AK_Motor_Linklist_t*)pos_ptr)->ak_motor_instance->controller_id ==
-            can_id) {
-            found = true;
-            break;
-        }
+                               AK_Ctrlmode_t AK_mode,
+                               uint64_t rx_time) {
+    uint32_t data_lo = (uint32_t)can_msg[0] | (uint32_t)can_msg[1] << 8 |
+                       (uint32_t)can_msg[2] << 16 | (uint32_t)can_msg[3] << 24;
+    uint32_t data_hi = (uint32_t)can_msg[4] | (uint32_t)can_msg[5] << 8 |
+                       (uint32_t)can_msg[6] << 16 | (uint32_t)can_msg[7] << 24;
+    ak_can_get_measure_words(bus, can_id, data_lo, data_hi, AK_mode, rx_time);
+}
+
+/**
+ * @brief 解码电机回包, 数据按邮箱寄存器RDLR/RDHR的格式传入
+ *
+ * @param bus 收到回包的总线
+ * @param can_id CAN ID
+ * @param data_lo 数据第0 ~ 3字节, 第0字节在最低位
+ * @param data_hi 数据第4 ~ 7字节, 第4字节在最低位
+ * @param AK_mode 模式
+ * @param rx_time 硬件时间戳(位时间), 未启用`CAN_TIMESTAMP_ENABLE`时为0
+ */
+void ak_can_get_measure_words(CAN_Bus_t bus,
+                              uint8_t can_id,
+                              uint32_t data_lo,
+                              uint32_t data_hi,
+                              AK_Ctrlmode_t AK_mode,
+                              uint64_t rx_time) {
+#if AK_SCAN_ENABLE
+    if (ak_scan_active == true) {
+        /* 扫描时记录所有ID的回包, 包括没有注册的 */
+        ak_scan_on_reply(bus, can_id, AK_mode);
     }
-    if (found == false) {
+#endif /* AK_SCAN_ENABLE */
+    /* 电机对象指针 */
+    AK_Motor_Class* ak_target = ak_motor_find(bus, can_id);
+    if (ak_target == NULL) {
         /* ID不存在 */
         return;
     }
+#if CAN_TIMESTAMP_ENABLE
+    /* 由硬件时间戳换算, 不含中断排队的抖动 */
+    uint32_t stamp = CAN_Time_To_Local_Us(bus, rx_time);
+#else
+    uint32_t stamp = time_us();
+#endif /* CAN_TIMESTAMP_ENABLE */
     float motor_pos, motor_spd, motor_cur_troq;
-    int8_t temperature;
-    uint8_t error;
-
-    /* 电机对象指针 */
-    AK_Motor_Class* ak_target =
-        ((AK_Motor_Linklist_t*)pos_ptr)->ak_motor_instance;
+    float pos_scale, pos_offset;
+    int8_t temperature = (int8_t)AK_DATA_BYTE(data_hi, 6);
+    uint8_t error = (uint8_t)AK_DATA_BYTE(data_hi, 7);
 
     if (AK_mode == AK_Servo_Mode) {
-        /* 整数整合, 转换成小数 */
-        motor_pos = (float)((int16_t)(can_msg[0] << 8 | can_msg[1])) * 0.1f;
-        motor_spd = (float)((int16_t)(can_msg[2] << 8 | can_msg[3])) * 10.0f;
-        motor_cur_troq =
-            (float)((int16_t)(can_msg[4] << 8 | can_msg[5])) * 0.01f;
-        temperature = can_msg[6];
-        error = can_msg[7];
-
-        /* 对象属性赋值 */
-        ak_target->motor_pos = motor_pos;
-        ak_target->motor_spd = motor_spd;
-        ak_target->motor_cur_troq = motor_cur_troq;
-        ak_target->motor_temperature = temperature;
-        ak_target->error_code = error;
-        printf("%.2f,%.2f,%.2f,%d,%d\r\n", ak_target->motor_pos,
-               ak_target->motor_spd, ak_target->motor_cur_troq,
-               ak_target->motor_temperature, ak_target->error_code);
-    } else if (AK_mode == AK_MIT_Mode) {
-        /* 整数整合 */
-        int16_t pos_int = (can_msg[1] << 8) | can_msg[2];
-        int16_t spd_int = (can_msg[3] << 4) | (can_msg[4] >> 4);
-        int16_t torq_int = ((can_msg[4] * 0xF) << 8) | can_msg[5];
+        /* 整数整合, 转换成小数, 高字节在前 */
+        int16_t pos_int = (int16_t)(AK_DATA_BYTE(data_lo, 0) << 8 |
+                                    AK_DATA_BYTE(data_lo, 1));
+        int16_t spd_int = (int16_t)(AK_DATA_BYTE(data_lo, 2) << 8 |
+                                    AK_DATA_BYTE(data_lo, 3));
+        int16_t cur_int = (int16_t)(AK_DATA_BYTE(data_hi, 4) << 8 |
+                                    AK_DATA_BYTE(data_hi, 5));
+        motor_pos = (float)pos_int * 0.1f;
+        motor_spd = (float)spd_int * 10.0f;
+        motor_cur_troq = (float)cur_int * 0.01f;
 
-        temperature = can_msg[6];
-        error = can_msg[7];
+        /* 伺服模式回报的是电转速, 超时后不用它预测 */
+        pos_scale = 0.1f;
+        pos_offset = 0.0f;
+        ak_pos_est_update(&ak_target->pos_est, AK_mode, (uint16_t)pos_int,
+                          0.0f, stamp);
+    } else if (AK_mode == AK_MIT_Mode) {
+        /* 整数整合, 都是无符号数 */
+        uint32_t pos_int =
+            AK_DATA_BYTE(data_lo, 1) << 8 | AK_DATA_BYTE(data_lo, 2);
+        uint32_t spd_int =
+            AK_DATA_BYTE(data_lo, 3) << 4 | AK_DATA_BYTE(data_hi, 4) >> 4;
+        uint32_t torq_int =
+            (AK_DATA_BYTE(data_hi, 4) & 0xFU) << 8 | AK_DATA_BYTE(data_hi, 5);
 
         /* 转换成小数 */
-        motor_pos = uint_to_float(pos_int, -AK_MIT_LIM_POS, AK_MIT_LIM_POS, 16);
+        motor_pos = uint_to_float((int)pos_int, -AK_MIT_LIM_POS,
+                                  AK_MIT_LIM_POS, 16);
         motor_spd = uint_to_float(
-            spd_int,
+            (int)spd_int,
             -AK_MIT_param_limit[ak_target->motor_model][AK_MIT_LIM_SPEED],
             AK_MIT_param_limit[ak_target->motor_model][AK_MIT_LIM_SPEED], 12);
         motor_cur_troq = uint_to_float(
-            torq_int,
+            (int)torq_int,
             -AK_MIT_param_limit[ak_target->motor_model][AK_MIT_LIM_TORQUE],
             AK_MIT_param_limit[ak_target->motor_model][AK_MIT_LIM_TORQUE], 12);
-        /* 属性赋值 */
-        ak_target->motor_pos = motor_pos;
-        ak_target->motor_spd = motor_spd;
-        ak_target->motor_cur_troq = motor_cur_troq;
-        ak_target->motor_temperature = temperature;
-        ak_target->error_code = error;
-        printf("%.2f,%.2f,%.2f,%d,%d\r\n", ak_target->motor_pos,
-               ak_target->motor_spd, ak_target->motor_cur_troq,
-               ak_target->motor_temperature, ak_target->error_code);
+
+        /* 与uint_to_float相同的比例, 超时后用回报的速度预测 */
+        pos_scale = 2.0f * AK_MIT_LIM_POS / 65535.0f;
+        pos_offset = -AK_MIT_LIM_POS;
+        ak_pos_est_update(&ak_target->pos_est, AK_mode, (uint16_t)pos_int,
+                          motor_spd / pos_scale, stamp);
+    } else {
+        return;
+    }
+    float pos_multi = (float)ak_target->pos_est.counts * pos_scale + pos_offset;
+    float spd_est = ak_target->pos_est.vel * pos_scale;
+
+    /* 对象属性赋值, 序号为奇数表示正在更新, 读取快照时据此重试 */
+    ak_target->state_seq++;
+    RING_BARRIER();
+    ak_target->motor_pos = motor_pos;
+    ak_target->motor_spd = motor_spd;
+    ak_target->motor_cur_troq = motor_cur_troq;
+    ak_target->motor_temperature = temperature;
+    ak_target->error_code = error;
+    ak_target->motor_pos_multi = pos_multi;
+    ak_target->motor_spd_est = spd_est;
+    ak_target->rx_us = stamp;
+    ak_target->rx_time = rx_time;
+#if AK_WDG_ENABLE
+    ak_target->wdg.armed = false;
+    ak_target->wdg.stale = false;
+    ak_target->wdg.miss_streak = 0;
+#endif /* AK_WDG_ENABLE */
+    RING_BARRIER();
+    ak_target->state_seq++;
+#if AK_MEASURE_PRINT_ENABLE
+    AK_Motor_State_t state;
+    char line[AK_STATE_LINE_LEN];
+    ak_target->get_state(&state);
+    USART1_Write(line, ak_state_format(line, &state));
+#endif /* AK_MEASURE_PRINT_ENABLE */
+
+    ak_group_reply_done(ak_target, true);
+}
+
+/**
+ * @brief 读取电机状态快照
+ *
+ * @param[out] state 状态, 各字段来自同一帧回包
+ * @note 可以在任意线程中调用, 与CAN接收中断之间不需要加锁
+ */
+void AK_Motor_Class::get_state(AK_Motor_State_t* state) {
+    uint32_t seq;
+    do {
+        seq = state_seq;
+        RING_BARRIER();
+        state->controller_id = controller_id;
+        state->motor_pos = motor_pos;
+        state->motor_spd = motor_spd;
+        state->motor_cur_troq = motor_cur_troq;
+        state->motor_temperature = motor_temperature;
+        state->error_code = error_code;
+        state->motor_pos_multi = motor_pos_multi;
+        state->motor_spd_est = motor_spd_est;
+        state->rx_us = rx_us;
+        state->rx_time = rx_time;
+        state->stale = wdg.stale;
+        RING_BARRIER();
+    } while ((seq & 1U) != 0 || seq != state_seq);
+}
+
+/**
+ * @brief 把状态格式化成一行文本"位置,速度,电流,温度,错误码\r\n"
+ *
+ * @param[out] buf 输出, 至少`AK_STATE_LINE_LEN`字节, 不以'\0'结尾
+ * @param state 状态
+ * @return uint32_t 写入的字符数
+ * @note 只用整数运算, 与原来printf("%.2f,%.2f,%.2f,%d,%d\r\n")的格式相同
+ */
+uint32_t ak_state_format(char* buf, const AK_Motor_State_t* state) {
+    uint32_t n = 0;
+    n += num_fmt_fixed(buf + n, state->motor_pos, AK_STATE_DECIMALS);
+    buf[n++] = ',';
+    n += num_fmt_fixed(buf + n, state->motor_spd, AK_STATE_DECIMALS);
+    buf[n++] = ',';
+    n += num_fmt_fixed(buf + n, state->motor_cur_troq, AK_STATE_DECIMALS);
+    buf[n++] = ',';
+    n += num_fmt_int(buf + n, state->motor_temperature);
+    buf[n++] = ',';
+    n += num_fmt_uint(buf + n, state->error_code);
+    buf[n++] = '\r';
+    buf[n++] = '\n';
+    return n;
+}
+
+/**
+ * @brief 设置电机是否参与回包触发控制
+ *
+ * @param enable `true`-加入控制组; `false`-移出控制组
+ */
+void AK_Motor_Class::set_reply_trigger(bool enable) {
+    reply_trigger = enable;
+    if (enable == false) {
+        reply_pending = false;
+    }
+}
+
+/**
+ * @brief 设置重复帧抑制
+ *
+ * @param enable `true`-启用; `false`-禁用, 每条指令都发送
+ * @param keepalive_ms 保活间隔(ms), 帧内容不变时每隔这么久仍发送一次,
+ *                     保证电机持续回包
+ */
+void AK_Motor_Class::set_tx_dedup(bool enable, uint32_t keepalive_ms) {
+    tx_dedup = enable;
+    tx_keepalive_us = keepalive_ms * 1000U;
+    tx_cache_valid = false;
+}
+
+/**
+ * @brief 设置速度估计α-β滤波器参数
+ *
+ * @param alpha 位置修正系数, 0 ~ 1, 越小越平滑
+ * @param beta 速度修正系数, 临界阻尼取alpha^2 / (2 - alpha)
+ * @note 1kHz回包时默认参数的速度带宽约为25Hz
+ */
+void AK_Motor_Class::set_vel_filter(float alpha, float beta) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pos_est.alpha = alpha;
+    pos_est.beta = beta;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 清除多圈位置, 下一帧回包重新初始化估计器
+ *
+ * @note 设置原点后位置会跳变, 设置原点的指令会自动调用
+ */
+void AK_Motor_Class::reset_pos_est(void) {
+    pos_est.valid = false;
+}
+
+/**
+ * @brief 设置预测使用的转动惯量
+ *
+ * @param inertia 电机输出端的总转动惯量(kg*m^2), 包括负载;
+ *                0表示不考虑指令扭矩, 按匀速前推
+ */
+void AK_Motor_Class::set_pred_inertia(float inertia) {
+    pred_inertia = inertia;
+}
+
+/**
+ * @brief 设置回包看门狗
+ *
+ * @param timeout_us 回包期限(us), 0不检查. 不能小于回包间隔,
+ *                   SysTick每1ms检查一次, 实际超时最多晚1ms
+ * @param action 超时后的安全动作, `AK_SAFE_NONE`只标记失联
+ */
+void AK_Motor_Class::set_watchdog(uint32_t timeout_us,
+                                  AK_Safe_Action_t action) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    wdg.timeout_us = timeout_us;
+    wdg.action = action;
+    wdg.armed = false;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 把最近一帧回包的状态前推到下一帧指令发出的时刻
+ *
+ * @param[out] pred 预测结果
+ * @param lead_us 从现在到下一帧指令发出的时间(us)
+ * @return true-成功; false-还没有收到回包
+ * @note 从回包时刻开始积分, 运控模式下扭矩按最近一次发送的指令计算:
+ *       torque = kp * (pos - p) + kd * (spd - v) + torque_ff,
+ *       加速度 = torque / 转动惯量, 忽略摩擦和外力.
+ *       转动惯量为0或伺服模式时按估计速度匀速前推.
+ *       在发送指令的线程中调用, 与mit_can_send_data在同一线程
+ */
+bool AK_Motor_Class::predict_state(AK_Motor_Pred_t* pred, uint32_t lead_us) {
+    AK_Motor_State_t state;
+    if (pos_est.valid == false) {
+        return false;
+    }
+    get_state(&state);
+
+    /* 前推时间 = 回包已经过去的时间 + 到下一帧指令的时间 */
+    uint32_t horizon_us = time_elapsed_us(state.rx_us) + lead_us;
+    if (horizon_us > AK_PRED_MAX_MS * 1000U) {
+        horizon_us = AK_PRED_MAX_MS * 1000U;
+    }
+
+    bool use_torque = ctrl_mode == AK_MIT_Mode && pred_inertia > 0.0f &&
+                      ak_estop_active() == false;
+    float torque_lim = AK_MIT_param_limit[motor_model][AK_MIT_LIM_TORQUE];
+    float p = state.motor_pos, v = state.motor_spd_est, dp = 0.0f;
+    float torque = use_torque ? state.motor_cur_troq : 0.0f;
+    uint32_t steps = (horizon_us + AK_PRED_STEP_US - 1) / AK_PRED_STEP_US;
+    float h = steps > 0 ? (float)horizon_us * 1e-6f / (float)steps : 0.0f;
+
+    /* 隐式欧拉积分: PD项按步末的位置和速度计算, 解一元一次方程
+       v' = (v + a * (kp * (pos - p) + kd * spd + torque_ff)) /
+            (1 + a * kd + a * kp * h), a = h / J.
+       kd * h / J或kp * h^2 / J很大(转动惯量小)时也不会发散.
+       扭矩饱和时按限幅扭矩显式积分, 恒定扭矩下是精确的 */
+    float a = use_torque ? h / pred_inertia : 0.0f;
+    for (uint32_t i = 0; i < steps; i++) {
+        if (use_torque) {
+            float v_next =
+                (v + a * (mit_cmd.kp * (mit_cmd.pos - p) +
+                          mit_cmd.kd * mit_cmd.spd + mit_cmd.torque)) /
+                (1.0f + a * mit_cmd.kd + a * mit_cmd.kp * h);
+            torque = mit_cmd.kp * (mit_cmd.pos - p - v_next * h) +
+                     mit_cmd.kd * (mit_cmd.spd - v_next) + mit_cmd.torque;
+            if (torque > torque_lim) {
+                torque = torque_lim;
+                v_next = v + a * torque;
+            } else if (torque < -torque_lim) {
+                torque = -torque_lim;
+                v_next = v + a * torque;
+            }
+            v = v_next;
+        }
+        p += v * h;
+        dp += v * h;
+    }
+
+    pred->pos = p;
+    pred->pos_multi = state.motor_pos_multi + dp;
+    pred->spd = v;
+    pred->torque = torque;
+    pred->horizon_us = horizon_us;
+    return true;
+}
+
+/**
+ * @brief 发送指令帧, 所有指令都经过这里
+ *
+ * @param ext `true`-扩展帧(伺服模式); `false`-标准帧(运控模式)
+ * @param id 帧ID
+ * @param data 数据
+ * @param len 数据长度
+ * @param dedup 是否允许抑制. 进入/退出/设置原点等指令必须发送, 传`false`
+ * @param prio 发送优先级, 退出控制和刹车用`CAN_PRIO_EMERGENCY`
+ * @return uint8_t 0-成功或被抑制; 其他-发送失败, 处于急停状态或失联
+ */
+uint8_t AK_Motor_Class::can_transmit(bool ext,
+                                     uint32_t id,
+                                     uint8_t* data,
+                                     uint8_t len,
+                                     bool dedup,
+                                     CAN_Prio_t prio) {
+    if (ak_estop_latched == true) {
+        return 2;
+    }
+#if AK_WDG_ENABLE
+    if (dedup == true && wdg.stale == true && wdg.action != AK_SAFE_NONE) {
+        /* 失联后只发送安全动作帧, 恢复后第一帧指令必须发送 */
+        tx_cache_valid = false;
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        ak_group_reply_done(this, false);
+        __set_PRIMASK(primask);
+        return 3;
+    }
+#endif /* AK_WDG_ENABLE */
+    if (tx_dedup == true && dedup == true && tx_cache_valid == true &&
+        tx_cache_ext == ext && tx_cache_id == id && tx_cache_len == len &&
+        memcmp(tx_cache_data, data, len) == 0 &&
+        time_expired_us(tx_cache_deadline) == false) {
+        /* 与上一帧相同且未到保活时间, 不发送, 本周期也就没有回包 */
+        tx_suppressed++;
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        ak_group_reply_done(this, false);
+        __set_PRIMASK(primask);
+        return 0;
+    }
+
+    if (dedup == true) {
+        tx_cache_ext = ext;
+        tx_cache_id = id;
+        tx_cache_len = len;
+        memcpy(tx_cache_data, data, len);
+        tx_cache_deadline = time_deadline_us(tx_keepalive_us);
+        tx_cache_valid = true;
+    } else {
+        /* 特殊指令会改变电机状态, 之后的第一帧指令必须发送 */
+        tx_cache_valid = false;
+    }
+
+    uint8_t ret;
+    if (ext == true) {
+        ctrl_mode = AK_Servo_Mode;
+        ret = CAN_TX_Send(can_bus, prio, CAN_ID_EXT, id, data, len);
+    } else {
+        ctrl_mode = AK_MIT_Mode;
+        ret = CAN_TX_Send(can_bus, prio, CAN_ID_STD, id, data, len);
+    }
+#if AK_WDG_ENABLE
+    if (ret == 0 && wdg.timeout_us != 0) {
+        /* 从最早一帧没有得到回包的指令开始计时, 后续指令不推迟期限 */
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (wdg.armed == false) {
+            wdg.deadline = time_deadline_us(wdg.timeout_us);
+            wdg.armed = true;
+        }
+        __set_PRIMASK(primask);
+    }
+#endif /* AK_WDG_ENABLE */
+    return ret;
+}
+
+/**
+ * @brief 统计一条总线上已注册的电机数量
+ *
+ * @param bus 总线编号
+ * @param mode 控制模式
+ * @return uint32_t 该总线上该模式已注册的电机数量
+ */
+uint32_t ak_motor_count(CAN_Bus_t bus, AK_Ctrlmode_t mode) {
+    uint32_t count = 0;
+    if (bus >= CAN_BUS_NUM) {
+        return 0;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (AK_Motor_Linklist_t& node : ak_motor_list[bus]) {
+        if (node.ak_motor_instance->ctrl_mode == mode) {
+            count++;
+        }
     }
+    __set_PRIMASK(primask);
+    return count;
+}
+
+/**
+ * @brief 开始一个控制周期, 标记控制组内所有电机等待回包
+ *
+ * @note 必须在发送本周期指令之前调用, 否则先到的回包会被漏掉.
+ *       控制组包含两条总线上的电机, 两条总线的指令帧进入各自的发送队列,
+ *       同时在两条总线上发送, 两边的回包都到达后才触发下一周期.
+ */
+void ak_group_arm(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ak_group_ready = false;
+    ak_group_replied = false;
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        for (AK_Motor_Linklist_t& node : ak_motor_list[bus]) {
+            AK_Motor_Class* motor = node.ak_motor_instance;
+            motor->reply_pending = motor->reply_trigger;
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 等待控制组回包全部到达
+ *
+ * @param timeout_ms 超时时间(ms), 即回包缺失时的控制周期
+ * @return true-回包全部到达; false-超时
+ * @note 控制组为空或本周期的指令全部被抑制时总是等待到超时,
+ *       相当于固定周期控制.
+ *       等待时睡眠, 由CAN接收中断或SysTick唤醒.
+ */
+bool ak_group_wait(uint32_t timeout_ms) {
+    uint32_t deadline = time_deadline_us(timeout_ms * 1000U);
+    bool ready = true;
+    PROF_ENTER(PROF_IDLE);
+    while (ak_group_ready == false) {
+        if (time_expired_us(deadline)) {
+            ready = false;
+            break;
+        }
+        delay_sleep();
+    }
+    PROF_EXIT(PROF_IDLE);
+    return ready;
+}
+
+/**
+ * @brief 控制组回包全部到达回调, 在CAN接收中断中调用
+ *
+ * @note 此函数可以被重写, 例如在中断里直接完成控制计算和发送
+ */
+__weak void ak_group_ready_callback(void) {
 }
 
 /**
@@ -207,8 +801,8 @@ void AK_Motor_Class::comm_can_set_duty(float duty) {
     int32_t send_index = 0;
     uint8_t buffer[4];
     buffer_append_int32(buffer, (int32_t)(duty * 100000.0f), &send_index);
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_PWM), buffer,
-                           send_index);
+    can_transmit(true, canid_append_mode(controller_id, AK_PWM),
+                 buffer, send_index, true, CAN_PRIO_CONTROL);
 }
 /**
  * @brief 设置电机电流
@@ -221,8 +815,8 @@ void AK_Motor_Class::comm_can_set_current(float current) {
     int32_t send_index = 0;
     uint8_t buffer[4];
     buffer_append_int32(buffer, (int32_t)(current * 1000.0f), &send_index);
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_CURRENT), buffer,
-                           send_index);
+    can_transmit(true, canid_append_mode(controller_id, AK_CURRENT),
+                 buffer, send_index, true, CAN_PRIO_CONTROL);
 }
 /**
  * @brief 设置电机刹车电流
@@ -234,8 +828,8 @@ void AK_Motor_Class::comm_can_set_cb(float current) {
     int32_t send_index = 0;
     uint8_t buffer[4];
     buffer_append_int32(buffer, (int32_t)(current * 1000.0f), &send_index);
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_CURRENT_BRAKE),
-                           buffer, send_index);
+    can_transmit(true, canid_append_mode(controller_id, AK_CURRENT_BRAKE),
+                 buffer, send_index, true, CAN_PRIO_EMERGENCY);
 }
 /**
  * @brief 速度环模式设置速度
@@ -247,8 +841,8 @@ void AK_Motor_Class::comm_can_set_rpm(float rpm) {
     int32_t send_index = 0;
     uint8_t buffer[4];
     buffer_append_int32(buffer, (int32_t)rpm, &send_index);
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_VELOCITY),
-                           buffer, send_index);
+    can_transmit(true, canid_append_mode(controller_id, AK_VELOCITY),
+                 buffer, send_index, true, CAN_PRIO_CONTROL);
 }
 /**
  * @brief 位置环模式设置位置
@@ -261,8 +855,8 @@ void AK_Motor_Class::comm_can_set_pos(float pos) {
     int32_t send_index = 0;
     uint8_t buffer[4];
     buffer_append_int32(buffer, (int32_t)(pos * 10000.0f), &send_index);
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_POSITION),
-                           buffer, send_index);
+    can_transmit(true, canid_append_mode(controller_id, AK_POSITION),
+                 buffer, send_index, true, CAN_PRIO_CONTROL);
 }
 /**
  * @brief 设置原点
@@ -275,8 +869,9 @@ void AK_Motor_Class::comm_can_set_pos(float pos) {
 void AK_Motor_Class::comm_can_set_origin(uint8_t set_origin_mode) {
     int32_t send_index = 0;
     uint8_t buffer[4];
-    AKcmd_can_transmit_eid(canid_append_mode(controller_id, AK_ORIGIN), buffer,
-                           send_index);
+    reset_pos_est();
+    can_transmit(true, canid_append_mode(controller_id, AK_ORIGIN),
+                 buffer, send_index, false, CAN_PRIO_CONFIG);
 }
 /**
  * @brief 速度位置环模式
@@ -299,9 +894,9 @@ void AK_Motor_Class::comm_can_set_pos_spd(float pos, float spd, float RPA) {
     buffer_append_int32(buffer, (int32_t)(pos * 10000.0f), &send_index);
     buffer_append_int16(buffer, spd, &send_index1);
     buffer_append_int16(buffer, RPA, &send_index1);
-    AKcmd_can_transmit_eid(
-        canid_append_mode(controller_id, AK_POSITION_VELOCITY), buffer,
-        send_index);
+    can_transmit(true,
+                 canid_append_mode(controller_id, AK_POSITION_VELOCITY),
+                 buffer, send_index, true, CAN_PRIO_CONTROL);
 }
 
 /**
@@ -313,6 +908,47 @@ void AK_Motor_Class::comm_can_set_pos_spd(float pos, float spd, float RPA) {
  * @{
  */
 
+/**
+ * @brief 运控模式指令打包
+ *
+ * @param[out] data 8字节帧数据
+ * @param model 电机型号, 决定速度和扭矩的范围
+ * @param pos 电机位置
+ * @param spd 电机速度
+ * @param kp 运动比例系数
+ * @param kd 运动阻尼系数
+ * @param torque 扭矩
+ */
+static void ak_mit_pack(uint8_t* data,
+                        AK_motor_model_t model,
+                        float pos,
+                        float spd,
+                        float kp,
+                        float kd,
+                        float torque) {
+    /* 转换成整数 */
+    int16_t pos_int = float_to_uint(pos, -AK_MIT_LIM_POS, AK_MIT_LIM_POS, 16);
+    int16_t spd_int =
+        float_to_uint(spd, -AK_MIT_param_limit[model][AK_MIT_LIM_SPEED],
+                      AK_MIT_param_limit[model][AK_MIT_LIM_SPEED], 12);
+    int16_t kp_int = float_to_uint(kp, 0, AK_MIT_MAX_KP, 12);
+    int16_t kd_int = float_to_uint(kd, 0, AK_MIT_MAX_KD, 12);
+    int16_t torque_int =
+        float_to_uint(torque, -AK_MIT_param_limit[model][AK_MIT_LIM_TORQUE],
+                      AK_MIT_param_limit[model][AK_MIT_LIM_TORQUE], 12);
+
+    /* 填充缓冲区 */
+    data[0] = pos_int >> 8;                           /* 位置高8位 */
+    data[1] = pos_int & 0xFF;                         /* 位置低8位 */
+    data[2] = spd_int >> 4;                           /* 速度高8位 */
+    data[3] = ((spd_int & 0xF) << 4) | (kp_int >> 8); /* 速度低4位, kp高4位 */
+    data[4] = kp_int & 0xFF;                          /* kp低8位 */
+    data[5] = kd_int >> 4;                            /* kd高8位 */
+    data[6] =
+        ((kd_int & 0xF) << 4) | (torque_int >> 8); /* kp低4位, 扭矩高4位 */
+    data[7] = torque_int & 0xFF;                   /* 扭矩低8位 */
+}
+
 /**
  * @brief 运控模式进入电机控制
  *
@@ -320,7 +956,7 @@ void AK_Motor_Class::comm_can_set_pos_spd(float pos, float spd, float RPA) {
  */
 void AK_Motor_Class::mit_can_enter_motor(void) {
     uint8_t data[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0XFC};
-    AKcmd_can_transmit_mit(controller_id, data, 8);
+    can_transmit(false, controller_id, data, 8, false, CAN_PRIO_CONFIG);
 }
 /**
  * @brief 运控模式设置电机原点
@@ -328,7 +964,8 @@ void AK_Motor_Class::mit_can_enter_motor(void) {
  */
 void AK_Motor_Class::mit_can_set_origin(void) {
     uint8_t data[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0XFE};
-    AKcmd_can_transmit_mit(controller_id, data, 8);
+    reset_pos_est();
+    can_transmit(false, controller_id, data, 8, false, CAN_PRIO_CONFIG);
 }
 /**
  * @brief 让电机进入控制
@@ -345,29 +982,14 @@ void AK_Motor_Class::mit_can_send_data(float pos,
                                        float kp,
                                        float kd,
                                        float torque) {
-    /* 转换成整数 */
-    int16_t pos_int = float_to_uint(pos, -AK_MIT_LIM_POS, AK_MIT_LIM_POS, 16);
-    int16_t spd_int =
-        float_to_uint(spd, -AK_MIT_param_limit[motor_model][AK_MIT_LIM_SPEED],
-                      AK_MIT_param_limit[motor_model][AK_MIT_LIM_SPEED], 12);
-    int16_t kp_int = float_to_uint(kp, 0, AK_MIT_MAX_KP, 12);
-    int16_t kd_int = float_to_uint(kd, 0, AK_MIT_MAX_KD, 12);
-    int16_t torque_int = float_to_uint(
-        torque, -AK_MIT_param_limit[motor_model][AK_MIT_LIM_TORQUE],
-        AK_MIT_param_limit[motor_model][AK_MIT_LIM_TORQUE], 12);
-
-    /* 填充缓冲区 */
     uint8_t data[8];
-    data[0] = pos_int >> 8;                           /* 位置高8位 */
-    data[1] = pos_int & 0xFF;                         /* 位置低8位 */
-    data[2] = spd_int >> 4;                           /* 速度高8位 */
-    data[3] = ((spd_int & 0xF) << 4) | (kp_int >> 8); /* 速度低4位, kp高4位 */
-    data[4] = kp_int & 0xFF;                          /* kp低8位 */
-    data[5] = kd_int >> 4;                            /* kd高8位 */
-    data[6] =
-        ((kd_int & 0xF) << 4) | (torque_int >> 8); /* kp低4位, 扭矩高4位 */
-    data[7] = torque_int & 0xFF;                   /* 扭矩低8位 */
-    AKcmd_can_transmit_mit(controller_id, data, 8);
+    ak_mit_pack(data, motor_model, pos, spd, kp, kd, torque);
+    mit_cmd.pos = pos;
+    mit_cmd.spd = spd;
+    mit_cmd.kp = kp;
+    mit_cmd.kd = kd;
+    mit_cmd.torque = torque;
+    can_transmit(false, controller_id, data, 8, true, CAN_PRIO_CONTROL);
 }
 /**
  * @brief 让电机退出控制
@@ -375,7 +997,195 @@ void AK_Motor_Class::mit_can_send_data(float pos,
  */
 void AK_Motor_Class::mit_can_exit_motor(void) {
     uint8_t data[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0XFD};
-    AKcmd_can_transmit_mit(controller_id, data, 8);
+    memset(&mit_cmd, 0, sizeof(mit_cmd)); /* 退出后不再输出扭矩 */
+    can_transmit(false, controller_id, data, 8, false, CAN_PRIO_EMERGENCY);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 急停
+ * @{
+ */
+
+/**
+ * @brief 急停, 给所有已注册的电机发送停止帧
+ *
+ * @param start_cycles 触发时刻的DWT周期计数, 用于测量急停延迟
+ * @note 可以在任意中断中调用, 不调用OS函数. 清空普通发送队列后,
+ *       运控模式的电机发送退出控制, 伺服模式的电机发送电流0, 都走紧急队列.
+ *       已经处于急停状态时直接返回, 按键抖动重复调用没有影响.
+ */
+void ak_estop(uint32_t start_cycles) {
+    static const uint8_t mit_exit[8] = {0xFF, 0xFF, 0xFF, 0xFF,
+                                        0xFF, 0xFF, 0xFF, 0xFD};
+    uint8_t zero_current[4] = {0};
+    uint32_t frames = 0;
+
+    /* 全程关中断, 停止帧全部写入之前发送完成中断不会误判为发完 */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (ak_estop_latched == true) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    ak_estop_latched = true;
+    ak_estop_start = start_cycles;
+    ak_estop_buses = 0;
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        /* 被打断的线程可能正在写入一帧指令, 发布后在装填时丢弃 */
+        CAN_TX_Block((CAN_Bus_t)bus, true);
+        CAN_TX_Flush((CAN_Bus_t)bus);
+        for (AK_Motor_Linklist_t& node : ak_motor_list[bus]) {
+            AK_Motor_Class* motor = node.ak_motor_instance;
+            uint8_t ret;
+            if (motor->ctrl_mode == AK_MIT_Mode) {
+                ret = CAN_TX_Urgent((CAN_Bus_t)bus, CAN_ID_STD,
+                                    motor->controller_id,
+                                    (uint8_t*)mit_exit, 8);
+            } else {
+                ret = CAN_TX_Urgent(
+                    (CAN_Bus_t)bus, CAN_ID_EXT,
+                    canid_append_mode(motor->controller_id, AK_CURRENT),
+                    zero_current, 4);
+            }
+            if (ret == 0) {
+                frames++;
+                ak_estop_buses |= 1U << bus;
+            }
+        }
+    }
+    ak_estop_stats.count++;
+    ak_estop_stats.frames = frames;
+    ak_estop_stats.cycles_queued = time_cycles() - start_cycles;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 解除急停, 之后的指令恢复发送
+ *
+ * @note 不会让电机重新进入控制, 需要再发送进入控制指令
+ */
+void ak_estop_clear(void) {
+    ak_estop_latched = false;
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        CAN_TX_Block((CAN_Bus_t)bus, false);
+    }
+}
+
+/**
+ * @brief 是否处于急停状态
+ *
+ * @return true-急停中; false-正常
+ */
+bool ak_estop_active(void) {
+    return ak_estop_latched;
+}
+
+/**
+ * @brief 一条总线的紧急帧全部发送完成, 所有总线都完成时记录急停延迟
+ *
+ * @param bus 总线编号
+ */
+void CAN_TX_Urgent_Done_Callback(CAN_Bus_t bus) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if ((ak_estop_buses & (1U << bus)) != 0) {
+        ak_estop_buses &= ~(1U << bus);
+        if (ak_estop_buses == 0) {
+            uint32_t cycles = time_cycles() - ak_estop_start;
+            ak_estop_stats.cycles_sent = cycles;
+            if (cycles > ak_estop_stats.cycles_sent_max) {
+                ak_estop_stats.cycles_sent_max = cycles;
+            }
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 回包看门狗
+ * @{
+ */
+
+#if AK_WDG_ENABLE
+/**
+ * @brief 给失联的电机发送安全动作帧, 走紧急队列
+ *
+ * @param motor 电机对象
+ * @return uint8_t 0-成功; 其他-紧急队列已满
+ * @note 运控模式的电机收到任何指令都会回包, 安全动作帧同时用来探测电机
+ */
+static uint8_t ak_wdg_send_safe(AK_Motor_Class* motor) {
+    static const uint8_t mit_exit[8] = {0xFF, 0xFF, 0xFF, 0xFF,
+                                        0xFF, 0xFF, 0xFF, 0xFD};
+    uint8_t data[8];
+    int32_t len = 0;
+    AK_Safe_Action_t action = motor->wdg.action;
+
+    if (motor->ctrl_mode == AK_MIT_Mode) {
+        if (action == AK_SAFE_EXIT) {
+            return CAN_TX_Urgent(motor->can_bus, CAN_ID_STD,
+                                 motor->controller_id, (uint8_t*)mit_exit, 8);
+        }
+        float kd = (action == AK_SAFE_BRAKE) ? AK_WDG_BRAKE_KD : 0.0f;
+        ak_mit_pack(data, motor->motor_model, 0.0f, 0.0f, 0.0f, kd, 0.0f);
+        return CAN_TX_Urgent(motor->can_bus, CAN_ID_STD, motor->controller_id,
+                             data, 8);
+    }
+    AKMode_t mode = AK_CURRENT;
+    float current = 0.0f;
+    if (action == AK_SAFE_BRAKE) {
+        mode = AK_CURRENT_BRAKE;
+        current = AK_WDG_BRAKE_CURRENT;
+    }
+    buffer_append_int32(data, (int32_t)(current * 1000.0f), &len);
+    return CAN_TX_Urgent(motor->can_bus, CAN_ID_EXT,
+                         canid_append_mode(motor->controller_id, mode), data,
+                         (uint8_t)len);
+}
+#endif /* AK_WDG_ENABLE */
+
+/**
+ * @brief 检查所有电机的回包期限, 在SysTick中每个节拍调用
+ *
+ * @note 每个电机只比较一次截止时刻, 耗时与电机数量成正比.
+ *       超时后标记失联, 连续和累计超时次数加1; 设置了安全动作时
+ *       发送安全动作帧并重新计时, 之后每个期限重发一次直到收到回包.
+ *       急停期间不发送, 由急停负责.
+ */
+void ak_wdg_tick(void) {
+#if AK_WDG_ENABLE
+    uint32_t now = time_us();
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        for (AK_Motor_Linklist_t& node : ak_motor_list[bus]) {
+            AK_Motor_Class* motor = node.ak_motor_instance;
+            AK_Wdg_t* wdg = &motor->wdg;
+            if (wdg->armed == false || (int32_t)(now - wdg->deadline) < 0) {
+                continue;
+            }
+            wdg->stale = true;
+            wdg->miss_streak++;
+            wdg->miss_total++;
+            wdg->armed = false;
+            if (wdg->action != AK_SAFE_NONE && ak_estop_latched == false &&
+                ak_wdg_send_safe(motor) == 0) {
+                wdg->actions++;
+                wdg->deadline = now + wdg->timeout_us;
+                wdg->armed = true;
+            }
+        }
+    }
+    __set_PRIMASK(primask);
+#endif /* AK_WDG_ENABLE */
 }
 
 /**
@@ -0,0 +1,188 @@
+/**
+ * @file    ak_scan.cpp
+ * @author  Deadline--
+ * @brief   AK电机自动发现
+ * @version 0.1
+ * @date    2023-12-22
+ */
+
+#include "ak_scan.hpp"
+
+volatile bool ak_scan_active = false; /* 是否正在扫描, 接收中断据此记录回包 */
+
+/* 每条总线每种模式收到回包的ID, 按位表示, 下标是AK_Ctrlmode_t */
+static volatile uint32_t ak_scan_seen[CAN_BUS_NUM][2][AK_MOTOR_ID_NUM / 32U];
+
+/**
+ * @brief 扫描期间记录一帧回包, 在CAN接收中断中调用
+ *
+ * @param bus 总线编号
+ * @param id CAN ID
+ * @param mode 回包的帧格式对应的模式
+ * @note 没有注册的ID也会记录
+ */
+void ak_scan_on_reply(CAN_Bus_t bus, uint8_t id, AK_Ctrlmode_t mode) {
+    if (bus >= CAN_BUS_NUM) {
+        return;
+    }
+    ak_scan_seen[bus][mode][id >> 5] |= 1U << (id & 31U);
+}
+
+/**
+ * @brief 是否有总线的探测帧还没发完
+ *
+ * @param buses 扫描的总线, 按位表示
+ * @param limit 允许剩余的帧数
+ * @return true-有总线剩余超过limit帧; false-都不超过
+ */
+static bool ak_scan_busy(uint32_t buses, uint32_t limit) {
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        if ((buses & (1U << bus)) != 0 &&
+            CAN_TX_Pending((CAN_Bus_t)bus, CAN_PRIO_BULK) > limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 给一个ID发送两种模式的探测帧
+ *
+ * @param bus 总线编号
+ * @param id CAN ID
+ * @param[out] result 统计发送结果
+ */
+static void ak_scan_probe(CAN_Bus_t bus, uint8_t id, AK_Scan_Result_t* result) {
+    /* 运控模式退出控制, 电机在任何状态都会回包 */
+    static const uint8_t mit_exit[8] = {0xFF, 0xFF, 0xFF, 0xFF,
+                                        0xFF, 0xFF, 0xFF, 0xFD};
+    /* 伺服模式电流0 */
+    uint8_t zero_current[4] = {0};
+
+    if (CAN_TX_Send(bus, CAN_PRIO_BULK, CAN_ID_STD, id, (uint8_t*)mit_exit,
+                    8) != 0) {
+        result->tx_fail++;
+    }
+    if (CAN_TX_Send(bus, CAN_PRIO_BULK, CAN_ID_EXT,
+                    (uint32_t)id | ((uint32_t)AK_CURRENT << 8), zero_current,
+                    4) != 0) {
+        result->tx_fail++;
+    }
+    result->probes += 2;
+}
+
+/**
+ * @brief 扫描CAN ID范围内的电机
+ *
+ * @param buses 扫描的总线, 按位表示, 例如`(1U << CAN_BUS_1) | (1U << CAN_BUS_2)`,
+ *              没有初始化的总线跳过
+ * @param first_id 第一个ID
+ * @param last_id 最后一个ID(包含)
+ * @param[out] result 扫描结果
+ * @return uint32_t 发现的电机数
+ * @note 阻塞到扫描结束, 在CAN初始化之后、控制开始之前调用.
+ *       已经注册的电机也会被发现. 使用OS时在调度器启动前调用.
+ */
+uint32_t ak_scan_run(uint32_t buses,
+                     uint8_t first_id,
+                     uint8_t last_id,
+                     AK_Scan_Result_t* result) {
+    memset(result, 0, sizeof(*result));
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        if (CAN_Get_Bitrate((CAN_Bus_t)bus) == 0) {
+            buses &= ~(1U << bus);
+        }
+    }
+    if (buses == 0 || first_id > last_id) {
+        return 0;
+    }
+
+    memset((void*)ak_scan_seen, 0, sizeof(ak_scan_seen));
+    ak_scan_active = true;
+    uint32_t start = time_us();
+    uint32_t deadline = time_deadline_us(AK_SCAN_TIMEOUT_MS * 1000U);
+
+    /* 上一批剩余不超过一批时写入下一批, 邮箱一直有帧可发 */
+    uint32_t id = first_id;
+    while (id <= last_id) {
+        if (time_expired_us(deadline)) {
+            result->timeout = true;
+            break;
+        }
+        if (ak_scan_busy(buses, AK_SCAN_BATCH * 2U)) {
+            continue;
+        }
+        uint32_t end = id + AK_SCAN_BATCH - 1U;
+        if (end > last_id) {
+            end = last_id;
+        }
+        for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+            if ((buses & (1U << bus)) == 0) {
+                continue;
+            }
+            for (uint32_t i = id; i <= end; i++) {
+                ak_scan_probe((CAN_Bus_t)bus, (uint8_t)i, result);
+            }
+        }
+        id = end + 1U;
+    }
+
+    /* 等最后一批发完, 再等回包 */
+    while (ak_scan_busy(buses, 0)) {
+        if (time_expired_us(deadline)) {
+            result->timeout = true;
+            break;
+        }
+    }
+    uint32_t window = time_deadline_us(AK_SCAN_WINDOW_US);
+    while (time_expired_us(window) == false) {
+    }
+    ak_scan_active = false;
+    result->elapsed_us = time_elapsed_us(start);
+
+    for (uint32_t bus = 0; bus < CAN_BUS_NUM; bus++) {
+        if ((buses & (1U << bus)) == 0) {
+            continue;
+        }
+        for (uint32_t i = first_id; i <= last_id; i++) {
+            uint32_t bit = 1U << (i & 31U);
+            bool mit = (ak_scan_seen[bus][AK_MIT_Mode][i >> 5] & bit) != 0;
+            bool servo = (ak_scan_seen[bus][AK_Servo_Mode][i >> 5] & bit) != 0;
+            if (mit == false && servo == false) {
+                continue;
+            }
+            if (result->found < AK_SCAN_MAX_FOUND) {
+                AK_Scan_Entry_t* entry = &result->entry[result->found];
+                entry->bus = (CAN_Bus_t)bus;
+                entry->id = (uint8_t)i;
+                entry->mode = mit ? AK_MIT_Mode : AK_Servo_Mode;
+                entry->both_modes = mit && servo;
+            }
+            result->found++;
+        }
+    }
+    return result->found;
+}
+
+/**
+ * @brief 串口输出扫描结果
+ *
+ * @param result 扫描结果
+ */
+void ak_scan_report(const AK_Scan_Result_t* result) {
+    printf("#scan %lu motors, %lu probes, %lu fail, %lu us%s\r\n",
+           (unsigned long)result->found, (unsigned long)result->probes,
+           (unsigned long)result->tx_fail, (unsigned long)result->elapsed_us,
+           result->timeout ? ", timeout" : "");
+    uint32_t num = result->found;
+    if (num > AK_SCAN_MAX_FOUND) {
+        num = AK_SCAN_MAX_FOUND;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        const AK_Scan_Entry_t* entry = &result->entry[i];
+        printf("#scan CAN%lu id %u %s%s\r\n", (unsigned long)(entry->bus + 1),
+               (unsigned)entry->id,
+               (entry->mode == AK_MIT_Mode) ? "mit" : "servo",
+               entry->both_modes ? " (both)" : "");
+    }
+}
@@ -2,16 +2,141 @@
  * @file    can.c
  * @author  Deadline--
  * @brief   CAN通信相关
- * @version 0.1
- * @date    2023-10-26
+ * @version 0.7
+ * @date    2023-12-21
+ * @note    CAN1和CAN2各有一组发送队列和一组发送邮箱, 两条总线并行发送.
+ *          发送队列按紧急/控制/配置/批量分为四级, 邮箱空闲时总是装入
+ *          优先级最高的帧. 邮箱全满时紧急帧中止还没发出的低优先级帧,
+ *          被中止的帧在同级别队列之前重新装入, 不会丢失.
+ *          CAN2是从控制器, 过滤器在CAN1中, 按`CAN_SLAVE_START_FILTER_BANK`
+ *          分给两条总线.
+ *          `CAN_FAST_PATH`为1时收发中断不经过HAL库, 直接以32位字读写邮箱
+ *          寄存器, 初始化仍使用HAL库.
+ *          `CAN_TIMESTAMP_ENABLE`为1时每个接收帧和发送完成的帧都带有
+ *          扩展成64位的硬件时间戳, 单位是位时间.
+ *          `CAN_ERR_ENABLE`为1时处理错误警告/被动/离线和错误码中断,
+ *          离线后不再装填普通帧, 退避一段时间后由SysTick请求恢复.
  */
 #include "can.h"
-CAN_HandleTypeDef CAN1_Handler;    /* CAN1句柄 */
-CAN_TxHeaderTypeDef CAN1_TxHeader; /* 发送参数句柄 */
-CAN_RxHeaderTypeDef CAN1_RxHeader; /* 接收参数句柄 */
+#include "ak_motor.hpp"
+#include "profiler.h"
+
+CAN_HandleTypeDef CAN1_Handler; /* CAN1句柄 */
+CAN_HandleTypeDef CAN2_Handler; /* CAN2句柄 */
+
+#if CAN_TIMESTAMP_ENABLE
+/**
+ * @brief 硬件时间戳扩展, 时间单位是位时间
+ *
+ */
+typedef struct {
+    bool valid;               /*!< 是否已有第一帧 */
+    uint64_t time;            /*!< 上一帧的扩展时间 */
+    uint64_t local_us;        /*!< 处理上一帧时的time_us64() */
+    uint32_t offset;          /*!< time_us() - 帧时间换算的微秒数的最小值 */
+    uint32_t us_per_bit_q16;  /*!< 每个位时间的微秒数, Q16定点 */
+    uint32_t bits_per_us_q16; /*!< 每微秒的位时间数, Q16定点 */
+} CAN_Clock_t;
+#endif /* CAN_TIMESTAMP_ENABLE */
+
+#if CAN_ERR_ENABLE
+/**
+ * @brief 错误状态和离线恢复
+ *
+ */
+typedef struct {
+    volatile CAN_Err_State_t state; /*!< 当前错误状态 */
+    bool recover_req;               /*!< 已请求恢复, 等待硬件检测到总线空闲 */
+    uint32_t off_us;                /*!< 进入离线的时刻 */
+    uint32_t recover_at;            /*!< 请求恢复的时刻 */
+    uint32_t backoff_us;            /*!< 本次离线的退避时间 */
+    uint32_t active_us;             /*!< 上次恢复的时刻 */
+} CAN_Err_Ctrl_t;
+#endif /* CAN_ERR_ENABLE */
+
+#define CAN_TX_MAILBOX_NUM 3 /* 发送邮箱数量 */
+
+/**
+ * @brief 每条总线的收发数据
+ *
+ */
+typedef struct {
+    CAN_HandleTypeDef* handle;                  /*!< CAN句柄 */
+    CAN_TxHeaderTypeDef tx_header;              /*!< 发送参数句柄 */
+    CAN_RxHeaderTypeDef rx_header;              /*!< 接收参数句柄 */
+    CAN_TxFrame_t urgent_buf[CAN_URGENT_QUEUE_LEN];     /*!< 紧急队列存储区 */
+    volatile uint32_t urgent_seq[CAN_URGENT_QUEUE_LEN]; /*!< 紧急队列序号 */
+    CAN_TxFrame_t tx_buf[CAN_TX_QUEUE_LEN];             /*!< 控制队列存储区 */
+    volatile uint32_t tx_seq[CAN_TX_QUEUE_LEN];         /*!< 控制队列序号 */
+    CAN_TxFrame_t config_buf[CAN_CONFIG_QUEUE_LEN];     /*!< 配置队列存储区 */
+    volatile uint32_t config_seq[CAN_CONFIG_QUEUE_LEN]; /*!< 配置队列序号 */
+    CAN_TxFrame_t bulk_buf[CAN_BULK_QUEUE_LEN];         /*!< 批量队列存储区 */
+    volatile uint32_t bulk_seq[CAN_BULK_QUEUE_LEN];     /*!< 批量队列序号 */
+    mpsc_queue_t tx_queue[CAN_PRIO_NUM]; /*!< 各级发送队列, 可在中断中写入 */
+    CAN_TxFrame_t mb_frame[CAN_TX_MAILBOX_NUM]; /*!< 邮箱中的帧 */
+    uint32_t mb_busy;    /*!< 装有帧还没完成的邮箱, 按位表示 */
+    uint32_t mb_preempt; /*!< 为紧急帧中止的邮箱, 完成后重新排队 */
+    uint32_t mb_discard; /*!< 被清除的邮箱, 中止后丢弃 */
+    /* 被中止等待重新装入的帧, 每级最多有邮箱数量个 */
+    CAN_TxFrame_t held[CAN_PRIO_NUM][CAN_TX_MAILBOX_NUM];
+    uint8_t held_num[CAN_PRIO_NUM];
+    volatile uint32_t urgent_pending; /*!< 已写入但还没发送完成的紧急帧数 */
+    volatile bool tx_block; /*!< 为true时普通帧不装入邮箱, 直接丢弃 */
+#if CAN_TIMESTAMP_ENABLE
+    CAN_Clock_t clock; /*!< 硬件时间戳扩展 */
+#endif /* CAN_TIMESTAMP_ENABLE */
+#if CAN_ERR_ENABLE
+    CAN_Err_Ctrl_t err; /*!< 错误状态 */
+#endif /* CAN_ERR_ENABLE */
+} CAN_Bus_Ctrl_t;
+
+static CAN_Bus_Ctrl_t CAN_Bus[CAN_BUS_NUM] = {{.handle = &CAN1_Handler},
+                                              {.handle = &CAN2_Handler}};
+CAN_TxStats_t CAN_TxStats[CAN_BUS_NUM]; /* 发送统计 */
+CAN_PrioStats_t CAN_PrioStats[CAN_BUS_NUM][CAN_PRIO_NUM]; /* 各级发送统计 */
+#if CAN_ERR_ENABLE
+CAN_ErrStats_t CAN_ErrStats[CAN_BUS_NUM]; /* 错误统计 */
+#endif /* CAN_ERR_ENABLE */
+
+#if CAN_ISR_CYCLE_STATS
+CAN_IsrStats_t CAN_RxIsrStats[CAN_BUS_NUM]; /* 接收中断耗时 */
+CAN_IsrStats_t CAN_TxIsrStats[CAN_BUS_NUM]; /* 发送中断耗时 */
+
+/**
+ * @brief 记录一次中断耗时
+ *
+ * @param stats 统计
+ * @param start 进入中断时的周期计数
+ */
+static inline void CAN_Isr_Stats_Update(CAN_IsrStats_t* stats, uint32_t start) {
+    uint32_t cycles = time_cycles() - start;
+    stats->count++;
+    stats->cycles_last = cycles;
+    stats->cycles_total += cycles;
+    if (cycles > stats->cycles_max) {
+        stats->cycles_max = cycles;
+    }
+}
+#define CAN_ISR_ENTER()     uint32_t isr_start = time_cycles()
+#define CAN_ISR_EXIT(stats) CAN_Isr_Stats_Update(&(stats), isr_start)
+#else
+#define CAN_ISR_ENTER()
+#define CAN_ISR_EXIT(stats)
+#endif /* CAN_ISR_CYCLE_STATS */
+
+/**
+ * @brief 根据句柄获取总线编号
+ *
+ * @param hcan CAN句柄
+ * @return CAN_Bus_t 总线编号
+ */
+static inline CAN_Bus_t CAN_Bus_Of(CAN_HandleTypeDef* hcan) {
+    return (hcan->Instance == CAN2) ? CAN_BUS_2 : CAN_BUS_1;
+}
 
 /**
  * @brief CAN初始化
+ * @param bus 总线编号, 初始化CAN2时会同时打开CAN1的时钟(过滤器在CAN1中)
  * @param tsjw 重新同步跳跃时间单元.范围: 1 ~ 3;
  * @param tbs2 时间段2的时间单元.范围: 1 ~ 8;
  * @param tbs1 时间段1的时间单元.范围: 1 ~ 16;
@@ -26,95 +151,602 @@ CAN_RxHeaderTypeDef CAN1_RxHeader; /* 接收参数句柄 */
                CAN_MODE_LOOPBACK, 回环模式
  * @retval 0,初始化成功; 其他, 初始化失败;
  */
-uint8_t CAN1_Init(uint32_t tsjw,
-                  uint32_t tbs2,
-                  uint32_t tbs1,
-                  uint16_t brp,
-                  uint32_t mode) {
-    CAN1_Handler.Instance = CAN1;
-    CAN1_Handler.Init.Prescaler = brp; /* 分频系数(Fdiv)为brp+1 */
-    CAN1_Handler.Init.Mode = mode;     /* 模式设置 */
-    CAN1_Handler.Init.SyncJumpWidth =
+uint8_t CAN_Bus_Init(CAN_Bus_t bus,
+                     uint32_t tsjw,
+                     uint32_t tbs2,
+                     uint32_t tbs1,
+                     uint16_t brp,
+                     uint32_t mode) {
+    if (bus >= CAN_BUS_NUM) {
+        return 1;
+    }
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    CAN_HandleTypeDef* handle = ctrl->handle;
+
+    handle->Instance = (bus == CAN_BUS_1) ? CAN1 : CAN2;
+    handle->Init.Prescaler = brp; /* 分频系数(Fdiv)为brp+1 */
+    handle->Init.Mode = mode;     /* 模式设置 */
+    handle->Init.SyncJumpWidth =
         tsjw; /* 重新同步跳跃宽度(Tsjw)为tsjw+1个时间单位
                  CAN_SJW_1TQ~CAN_SJW_4TQ */
-    CAN1_Handler.Init.TimeSeg1 = tbs1; /* tbs1范围CAN_BS1_1TQ~CAN_BS1_16TQ */
-    CAN1_Handler.Init.TimeSeg2 = tbs2; /* tbs2范围CAN_BS2_1TQ~CAN_BS2_8TQ */
-    CAN1_Handler.Init.TimeTriggeredMode = DISABLE; /* 非时间触发通信模式 */
-    CAN1_Handler.Init.AutoBusOff = DISABLE; /* 软件自动离线管理 */
-    CAN1_Handler.Init.AutoWakeUp =
+    handle->Init.TimeSeg1 = tbs1; /* tbs1范围CAN_BS1_1TQ~CAN_BS1_16TQ */
+    handle->Init.TimeSeg2 = tbs2; /* tbs2范围CAN_BS2_1TQ~CAN_BS2_8TQ */
+#if CAN_TIMESTAMP_ENABLE
+    handle->Init.TimeTriggeredMode = ENABLE; /* 时间触发通信模式, 带时间戳 */
+#else
+    handle->Init.TimeTriggeredMode = DISABLE; /* 非时间触发通信模式 */
+#endif /* CAN_TIMESTAMP_ENABLE */
+    handle->Init.AutoBusOff = DISABLE;        /* 软件自动离线管理 */
+    handle->Init.AutoWakeUp =
         DISABLE; /* 睡眠模式通过软件唤醒(清除CAN->MCR的SLEEP位) */
-    CAN1_Handler.Init.AutoRetransmission = ENABLE; /* 禁止报文自动传送 */
-    CAN1_Handler.Init.ReceiveFifoLocked = DISABLE; /* 报文不锁定,新的覆盖旧的 */
-    CAN1_Handler.Init.TransmitFifoPriority =
-        DISABLE; /* 优先级由报文标识符决定 */
-    if (HAL_CAN_Init(&CAN1_Handler) != HAL_OK) {
+    handle->Init.AutoRetransmission = ENABLE; /* 禁止报文自动传送 */
+    handle->Init.ReceiveFifoLocked = DISABLE; /* 报文不锁定,新的覆盖旧的 */
+    handle->Init.TransmitFifoPriority = DISABLE; /* 优先级由报文标识符决定 */
+    if (HAL_CAN_Init(handle) != HAL_OK) {
         return 1;
     }
 
+    mpsc_queue_init(&ctrl->tx_queue[CAN_PRIO_EMERGENCY], ctrl->urgent_buf,
+                    ctrl->urgent_seq, sizeof(CAN_TxFrame_t),
+                    CAN_URGENT_QUEUE_LEN);
+    mpsc_queue_init(&ctrl->tx_queue[CAN_PRIO_CONTROL], ctrl->tx_buf,
+                    ctrl->tx_seq, sizeof(CAN_TxFrame_t), CAN_TX_QUEUE_LEN);
+    mpsc_queue_init(&ctrl->tx_queue[CAN_PRIO_CONFIG], ctrl->config_buf,
+                    ctrl->config_seq, sizeof(CAN_TxFrame_t),
+                    CAN_CONFIG_QUEUE_LEN);
+    mpsc_queue_init(&ctrl->tx_queue[CAN_PRIO_BULK], ctrl->bulk_buf,
+                    ctrl->bulk_seq, sizeof(CAN_TxFrame_t), CAN_BULK_QUEUE_LEN);
+    ctrl->mb_busy = 0;
+    ctrl->mb_preempt = 0;
+    ctrl->mb_discard = 0;
+    memset(ctrl->held_num, 0, sizeof(ctrl->held_num));
+    ctrl->urgent_pending = 0;
+#if CAN_TIMESTAMP_ENABLE
+    /* 位时间 = brp * (1 + ts1 + ts2)个PCLK1周期, 常用波特率下Q16是精确的 */
+    uint32_t btr = handle->Instance->BTR;
+    uint64_t bit_pclk = (((btr & CAN_BTR_BRP) >> CAN_BTR_BRP_Pos) + 1) *
+                        (3 + ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) +
+                         ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos));
+    uint64_t pclk = HAL_RCC_GetPCLK1Freq();
+    ctrl->clock.valid = false;
+    ctrl->clock.us_per_bit_q16 =
+        (uint32_t)((bit_pclk * 1000000U << 16) / pclk);
+    ctrl->clock.bits_per_us_q16 =
+        (uint32_t)((pclk << 16) / (bit_pclk * 1000000U));
+#endif /* CAN_TIMESTAMP_ENABLE */
+
+    IRQn_Type tx_irq = (bus == CAN_BUS_1) ? CAN1_TX_IRQn : CAN2_TX_IRQn;
+    IRQn_Type rx_irq = (bus == CAN_BUS_1) ? CAN1_RX0_IRQn : CAN2_RX0_IRQn;
+
+    /* 邮箱空闲中断, 继续装填发送队列中的帧 */
+    __HAL_CAN_ENABLE_IT(handle, CAN_IT_TX_MAILBOX_EMPTY);
+    HAL_NVIC_SetPriority(tx_irq, 1, 1); /* 抢占优先级1，子优先级1 */
+    HAL_NVIC_EnableIRQ(tx_irq);
+
 #if CAN_RX0_INT_ENABLE
-    /* 使用中断接收 */
-    __HAL_CAN_ENABLE_IT(
-        &CAN1_Handler, CAN_IT_RX_FIFO0_MSG_PENDING); /* FIFO0消息挂号中断允许 */
-    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);               /* 使能CAN中断 */
-    HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 1, 0); /* 抢占优先级1，子优先级0 */
+    /* 使用中断接收, FIFO0消息挂号中断允许 */
+    __HAL_CAN_ENABLE_IT(handle, CAN_IT_RX_FIFO0_MSG_PENDING);
+    HAL_NVIC_EnableIRQ(rx_irq);         /* 使能CAN中断 */
+    HAL_NVIC_SetPriority(rx_irq, 1, 0); /* 抢占优先级1，子优先级0 */
+#else
+    (void)rx_irq;
 #endif
 
-    CAN_FilterTypeDef CAN1_FilterConf;
-
-    /* 配置CAN过滤器 */
-    CAN1_FilterConf.FilterBank = 0; /* 过滤器0 */
-    CAN1_FilterConf.FilterMode = CAN_FILTERMODE_IDMASK;
-    CAN1_FilterConf.FilterScale = CAN_FILTERSCALE_32BIT;
-    CAN1_FilterConf.FilterIdHigh = 0x0000; /* 32位ID */
-    CAN1_FilterConf.FilterIdLow = 0x0000;
-    CAN1_FilterConf.FilterMaskIdHigh = 0x0000; /* 32位MASK */
-    CAN1_FilterConf.FilterMaskIdLow = 0x0000;
-    CAN1_FilterConf.FilterFIFOAssignment =
-        CAN_FILTER_FIFO0; /* 过滤器0关联到FIFO0 */
-    CAN1_FilterConf.FilterActivation = CAN_FILTER_ENABLE; /* 激活滤波器0 */
-    CAN1_FilterConf.SlaveStartFilterBank = 14;
+#if CAN_ERR_ENABLE
+    ctrl->err.state = CAN_ERR_ACTIVE;
+    ctrl->err.recover_req = false;
+    ctrl->err.backoff_us = CAN_BUSOFF_BACKOFF_MIN_US;
+    ctrl->err.active_us = time_us();
+    /* 错误状态变化和错误码中断, 经SCE中断处理 */
+    IRQn_Type sce_irq = (bus == CAN_BUS_1) ? CAN1_SCE_IRQn : CAN2_SCE_IRQn;
+    __HAL_CAN_ENABLE_IT(handle, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                                    CAN_IT_BUSOFF | CAN_IT_LAST_ERROR_CODE |
+                                    CAN_IT_ERROR);
+    HAL_NVIC_SetPriority(sce_irq, 1, 2); /* 抢占优先级1，子优先级2 */
+    HAL_NVIC_EnableIRQ(sce_irq);
+#endif /* CAN_ERR_ENABLE */
+
+    CAN_FilterTypeDef CAN_FilterConf;
+
+    /* 配置CAN过滤器, 每条总线使用自己的第一个过滤器组, 接收所有帧 */
+    CAN_FilterConf.FilterBank =
+        (bus == CAN_BUS_1) ? 0 : CAN_SLAVE_START_FILTER_BANK;
+    CAN_FilterConf.FilterMode = CAN_FILTERMODE_IDMASK;
+    CAN_FilterConf.FilterScale = CAN_FILTERSCALE_32BIT;
+    CAN_FilterConf.FilterIdHigh = 0x0000; /* 32位ID */
+    CAN_FilterConf.FilterIdLow = 0x0000;
+    CAN_FilterConf.FilterMaskIdHigh = 0x0000; /* 32位MASK */
+    CAN_FilterConf.FilterMaskIdLow = 0x0000;
+    CAN_FilterConf.FilterFIFOAssignment =
+        CAN_FILTER_FIFO0; /* 过滤器关联到FIFO0 */
+    CAN_FilterConf.FilterActivation = CAN_FILTER_ENABLE; /* 激活滤波器 */
+    CAN_FilterConf.SlaveStartFilterBank = CAN_SLAVE_START_FILTER_BANK;
 
     /* 过滤器配置 */
-    if (HAL_CAN_ConfigFilter(&CAN1_Handler, &CAN1_FilterConf) != HAL_OK) {
+    if (HAL_CAN_ConfigFilter(handle, &CAN_FilterConf) != HAL_OK) {
         return 2;
     }
 
     /* 启动CAN外围设备 */
-    if (HAL_CAN_Start(&CAN1_Handler) != HAL_OK) {
+    if (HAL_CAN_Start(handle) != HAL_OK) {
         return 3;
     }
 
     return 0;
 }
 
-#if CAN_RX0_INT_ENABLE
 /**
- * @brief CAN1 RX0中断服务函数
+ * @brief CAN1初始化, 参数见`CAN_Bus_Init`
  *
  */
-void CAN1_RX0_IRQHandler(void) {
-    HAL_CAN_IRQHandler(&CAN1_Handler);
+uint8_t CAN1_Init(uint32_t tsjw,
+                  uint32_t tbs2,
+                  uint32_t tbs1,
+                  uint16_t brp,
+                  uint32_t mode) {
+    return CAN_Bus_Init(CAN_BUS_1, tsjw, tbs2, tbs1, brp, mode);
+}
+
+/**
+ * @brief CAN2初始化, 参数见`CAN_Bus_Init`
+ *
+ */
+uint8_t CAN2_Init(uint32_t tsjw,
+                  uint32_t tbs2,
+                  uint32_t tbs1,
+                  uint16_t brp,
+                  uint32_t mode) {
+    return CAN_Bus_Init(CAN_BUS_2, tsjw, tbs2, tbs1, brp, mode);
+}
+
+/**
+ * @brief 获取CAN总线实际波特率
+ *
+ * @param bus 总线编号
+ * @return uint32_t 波特率(bps), 根据BTR寄存器和PCLK1计算; 未初始化返回0
+ */
+uint32_t CAN_Get_Bitrate(CAN_Bus_t bus) {
+    if (bus >= CAN_BUS_NUM || CAN_Bus[bus].handle->Instance == NULL) {
+        return 0;
+    }
+    uint32_t btr = CAN_Bus[bus].handle->Instance->BTR;
+    uint32_t brp = ((btr & CAN_BTR_BRP) >> CAN_BTR_BRP_Pos) + 1;
+    uint32_t ts1 = ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + 1;
+    uint32_t ts2 = ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos) + 1;
+    return HAL_RCC_GetPCLK1Freq() / (brp * (1 + ts1 + ts2));
+}
+
+#if CAN_TIMESTAMP_ENABLE
+/**
+ * @brief 把16位硬件时间戳扩展成64位单调时间
+ *
+ * @param bus 总线编号
+ * @param stamp 邮箱中的时间戳
+ * @return uint64_t 扩展后的时间(位时间)
+ * @note 用time_us64()算出距上一帧经过的位时间, 得到预测值,
+ *       取低16位等于时间戳且最接近预测值的时间. 中断延迟远小于半个周期
+ *       (32768个位时间, 1Mbps时32ms), 不会判错.
+ *       同时记录"time_us() - 帧时间"的最小值, 即中断延迟最小的那一帧,
+ *       用于把帧时间换算成没有中断抖动的本地时间.
+ */
+static uint64_t CAN_Time_Extend(CAN_Bus_t bus, uint16_t stamp) {
+    CAN_Clock_t* clock = &CAN_Bus[bus].clock;
+    uint64_t time;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t now = time_us64();
+    if (clock->valid == false) {
+        /* 从第二个周期开始, 后面的帧时间减去半个周期也不会小于0 */
+        time = 0x10000U + stamp;
+        clock->valid = true;
+        clock->offset = (uint32_t)now - (uint32_t)CAN_Time_To_Us(bus, time);
+    } else {
+        uint64_t elapsed =
+            ((now - clock->local_us) * clock->bits_per_us_q16) >> 16;
+        uint64_t expected = clock->time + elapsed;
+        time = expected + (int16_t)(uint16_t)(stamp - (uint16_t)expected);
+        uint32_t offset = (uint32_t)now - (uint32_t)CAN_Time_To_Us(bus, time);
+        if ((int32_t)(offset - clock->offset) < 0) {
+            clock->offset = offset;
+        }
+    }
+    clock->time = time;
+    clock->local_us = now;
+    __set_PRIMASK(primask);
+    return time;
+}
+
+/**
+ * @brief 发送完成的帧带上时间戳, 交给回调函数
+ *
+ * @param bus 总线编号
+ * @param mailbox 邮箱编号
+ * @param stamp 邮箱中的时间戳
+ */
+static inline void CAN_TX_Stamp(CAN_Bus_t bus,
+                                uint32_t mailbox,
+                                uint16_t stamp) {
+    CAN_TX_Time_Callback(bus, mailbox, CAN_Time_Extend(bus, stamp));
+}
+
+/**
+ * @brief 把帧时间换算成微秒
+ *
+ * @param bus 总线编号
+ * @param time 帧时间(位时间)
+ * @return uint64_t 微秒数, 起点是第一帧前的某个时刻
+ */
+uint64_t CAN_Time_To_Us(CAN_Bus_t bus, uint64_t time) {
+    return (time * CAN_Bus[bus].clock.us_per_bit_q16) >> 16;
+}
+
+/**
+ * @brief 把帧时间换算成本地时间
+ *
+ * @param bus 总线编号
+ * @param time 帧时间(位时间)
+ * @return uint32_t 对应的time_us(), 即延迟最小时进入中断的时刻,
+ *         没有中断抖动, 可以和time_us()相减
+ */
+uint32_t CAN_Time_To_Local_Us(CAN_Bus_t bus, uint64_t time) {
+    return (uint32_t)CAN_Time_To_Us(bus, time) + CAN_Bus[bus].clock.offset;
+}
+#else
+#define CAN_TX_Stamp(bus, mailbox, stamp)
+#endif /* CAN_TIMESTAMP_ENABLE */
+
+/**
+ * @brief 帧发送成功的回调, 带硬件时间戳
+ *
+ * @param bus 总线编号
+ * @param mailbox 邮箱编号
+ * @param time 帧起始位的时间(位时间)
+ * @note 只在`CAN_TIMESTAMP_ENABLE`为1时调用, 在发送中断中执行
+ */
+__weak void CAN_TX_Time_Callback(CAN_Bus_t bus,
+                                 uint32_t mailbox,
+                                 uint64_t time) {
+    UNUSED(bus);
+    UNUSED(mailbox);
+    UNUSED(time);
+}
+
+/**
+ * @brief 被中止的帧暂存, 等待重新装入
+ *
+ * @param bus 总线编号
+ * @param frame 帧
+ * @note 调用时关中断. 同级别的帧只有在暂存区为空时才从队列取出,
+ *       所以每级最多暂存邮箱数量个帧
+ */
+static inline void CAN_TX_Hold(CAN_Bus_t bus, const CAN_TxFrame_t* frame) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    uint32_t num = ctrl->held_num[frame->prio];
+    if (num >= CAN_TX_MAILBOX_NUM) {
+        CAN_TxStats[bus].dropped++;
+        return;
+    }
+    ctrl->held[frame->prio][num] = *frame;
+    ctrl->held_num[frame->prio] = (uint8_t)(num + 1);
+}
+
+/**
+ * @brief 取出一级中最早写入队列的暂存帧
+ *
+ * @param bus 总线编号
+ * @param prio 优先级
+ * @param[out] frame 帧
+ * @return true-成功; false-没有暂存帧
+ */
+static inline bool CAN_TX_Unhold(CAN_Bus_t bus,
+                                 uint32_t prio,
+                                 CAN_TxFrame_t* frame) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    uint32_t num = ctrl->held_num[prio];
+    if (num == 0) {
+        return false;
+    }
+    uint32_t oldest = 0;
+    for (uint32_t i = 1; i < num; i++) {
+        if ((int32_t)(ctrl->held[prio][i].queued_us -
+                      ctrl->held[prio][oldest].queued_us) < 0) {
+            oldest = i;
+        }
+    }
+    *frame = ctrl->held[prio][oldest];
+    ctrl->held[prio][oldest] = ctrl->held[prio][num - 1];
+    ctrl->held_num[prio] = (uint8_t)(num - 1);
+    return true;
+}
+
+/**
+ * @brief 邮箱发送完成(或中止), 统计发送时间, 被紧急帧中止的帧重新排队
+ *
+ * @param bus 总线编号
+ * @param done 完成的邮箱, 按位表示
+ * @param ok 其中发送成功的邮箱, 按位表示
+ */
+static inline void CAN_TX_Complete(CAN_Bus_t bus, uint32_t done, uint32_t ok) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    bool urgent_done = false;
+    bool all_done = false;
+    uint32_t now = time_us();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        uint32_t bit = 1U << i;
+        if ((done & ctrl->mb_busy & bit) == 0) {
+            continue;
+        }
+        CAN_TxFrame_t* frame = &ctrl->mb_frame[i];
+        CAN_PrioStats_t* stats = &CAN_PrioStats[bus][frame->prio];
+        if ((ok & bit) != 0) {
+            uint32_t us = now - frame->queued_us;
+            stats->sent++;
+            stats->sent_us_total += us;
+            if (us > stats->sent_us_max) {
+                stats->sent_us_max = us;
+            }
+        } else if ((ctrl->mb_discard & bit) != 0) {
+            stats->flushed++;
+            CAN_TxStats[bus].flushed++;
+        } else if ((ctrl->mb_preempt & bit) != 0) {
+            stats->preempted++;
+            CAN_TX_Hold(bus, frame);
+        } else {
+            CAN_TxStats[bus].dropped++; /* 发送出错后被中止 */
+        }
+        if (frame->prio == CAN_PRIO_EMERGENCY) {
+            ctrl->urgent_pending--;
+            urgent_done = true;
+        }
+        ctrl->mb_busy &= ~bit;
+        ctrl->mb_preempt &= ~bit;
+        ctrl->mb_discard &= ~bit;
+    }
+    all_done = urgent_done && ctrl->urgent_pending == 0;
+    __set_PRIMASK(primask);
+    if (all_done) {
+        CAN_TX_Urgent_Done_Callback(bus);
+    }
+}
+
+/**
+ * @brief 邮箱空闲后继续装填, 有紧急帧等待时直接装填, 不经过发送任务
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_TX_Refill(CAN_Bus_t bus) {
+    if (mpsc_queue_count(&CAN_Bus[bus].tx_queue[CAN_PRIO_EMERGENCY]) != 0) {
+        CAN_TX_Poll(bus);
+    } else {
+        CAN_TX_Request_Callback(bus);
+    }
+}
+
+#if CAN_FAST_PATH
+/**
+ * @brief 直接读取接收FIFO0中的所有帧
+ *
+ * @param bus 总线编号
+ * @note 只读取RIR/RDTR/RDLR/RDHR四个寄存器, 数据按两个32位字交给解码函数
+ */
+static inline void CAN_RX_Fast(CAN_Bus_t bus) {
+    CAN_TypeDef* can = CAN_Bus[bus].handle->Instance;
+    while ((can->RF0R & CAN_RF0R_FMP0) != 0) {
+        CAN_FIFOMailBox_TypeDef* mailbox = &can->sFIFOMailBox[0];
+        uint32_t rir = mailbox->RIR;
+        uint32_t rdtr = mailbox->RDTR;
+        uint32_t data_lo = mailbox->RDLR;
+        uint32_t data_hi = mailbox->RDHR;
+        can->RF0R = CAN_RF0R_RFOM0; /* 释放FIFO输出邮箱 */
+        if ((rdtr & CAN_RDT0R_DLC) != 8) {
+            /* 电机回包都是8字节 */
+            continue;
+        }
+#if CAN_TIMESTAMP_ENABLE
+        uint64_t rx_time =
+            CAN_Time_Extend(bus, (uint16_t)(rdtr >> CAN_RDT0R_TIME_Pos));
+#else
+        uint64_t rx_time = 0;
+#endif /* CAN_TIMESTAMP_ENABLE */
+        if ((rir & CAN_RI0R_IDE) == 0) {
+            /* 标准帧数据, 运控模式, 第一个字节是ID */
+            ak_can_get_measure_words(bus, (uint8_t)data_lo, data_lo, data_hi,
+                                     AK_MIT_Mode, rx_time);
+        } else {
+            /* 扩展帧数据, 伺服模式, ID低8位是电机ID */
+            ak_can_get_measure_words(bus, (uint8_t)(rir >> CAN_RI0R_EXID_Pos),
+                                     data_lo, data_hi, AK_Servo_Mode, rx_time);
+        }
+    }
 }
+/**
+ * @brief 清除发送完成标志, 继续装填发送队列
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_TX_Fast(CAN_Bus_t bus) {
+    CAN_TypeDef* can = CAN_Bus[bus].handle->Instance;
+    uint32_t tsr = can->TSR;
+    /* 写1清除RQCPx, 同时清除TXOKx/ALSTx/TERRx */
+    uint32_t done = tsr & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+    can->TSR = done;
+#if CAN_TIMESTAMP_ENABLE
+    /* 只有发送成功(TXOKx)的邮箱时间戳有效, 被中止的没有 */
+    for (uint32_t i = 0; i < 3; i++) {
+        if ((tsr & (CAN_TSR_TXOK0 << (8 * i))) != 0) {
+            CAN_TX_Stamp(bus, i,
+                         (uint16_t)(can->sTxMailBox[i].TDTR >>
+                                    CAN_TDT0R_TIME_Pos));
+        }
+    }
+#endif /* CAN_TIMESTAMP_ENABLE */
+    /* RQCP0/1/2在第0/8/16位, TXOK0/1/2在第1/9/17位, 转换成邮箱位 */
+    CAN_TX_Complete(bus,
+                    (done & 1U) | ((done >> 7) & 2U) | ((done >> 14) & 4U),
+                    ((tsr >> 1) & 1U) | ((tsr >> 8) & 2U) |
+                        ((tsr >> 15) & 4U));
+    CAN_TX_Refill(bus);
+}
+#else
+#if CAN_RX0_INT_ENABLE
 /**
  * @brief CAN RX FIFO0挂起中断回调
  *
  * @param hcan
  */
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
-    if (hcan->Instance == CAN1) {
-        uint8_t msg[8];
-        HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &CAN1_RxHeader, msg);
-        if (CAN1_RxHeader.IDE == CAN_ID_STD) {
-            /* 标准帧数据, 运控模式 */
-            ak_can_get_measure(msg[0], msg, AK_MIT_Mode);
-        } else if (CAN1_RxHeader.IDE == CAN_ID_EXT) {
-            /* 扩展帧数据, 伺服模式 */
-            ak_can_get_measure((uint8_t)(CAN1_RxHeader.ExtId & 0xFF), msg,
-                               AK_Servo_Mode);
-        }
+    CAN_Bus_t bus = CAN_Bus_Of(hcan);
+    CAN_RxHeaderTypeDef* header = &CAN_Bus[bus].rx_header;
+    uint8_t msg[8];
+    HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, header, msg);
+    if (header->DLC != 8) {
+        /* 电机回包都是8字节 */
+        return;
+    }
+#if CAN_TIMESTAMP_ENABLE
+    uint64_t rx_time = CAN_Time_Extend(bus, (uint16_t)header->Timestamp);
+#else
+    uint64_t rx_time = 0;
+#endif /* CAN_TIMESTAMP_ENABLE */
+    if (header->IDE == CAN_ID_STD) {
+        /* 标准帧数据, 运控模式 */
+        ak_can_get_measure(bus, msg[0], msg, AK_MIT_Mode, rx_time);
+    } else if (header->IDE == CAN_ID_EXT) {
+        /* 扩展帧数据, 伺服模式 */
+        ak_can_get_measure(bus, (uint8_t)(header->ExtId & 0xFF), msg,
+                           AK_Servo_Mode, rx_time);
     }
 }
 #endif /* CAN_RX0_INT_ENABLE */
+/**
+ * @brief 邮箱0发送完成回调
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Stamp(CAN_Bus_Of(hcan), 0,
+                 (uint16_t)HAL_CAN_GetTxTimestamp(hcan, CAN_TX_MAILBOX0));
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 0, 1U << 0);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+/**
+ * @brief 邮箱0中止回调, 被中止的都是普通帧
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 0, 0);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+/**
+ * @brief 邮箱1发送完成回调
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Stamp(CAN_Bus_Of(hcan), 1,
+                 (uint16_t)HAL_CAN_GetTxTimestamp(hcan, CAN_TX_MAILBOX1));
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 1, 1U << 1);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+/**
+ * @brief 邮箱1中止回调, 被中止的都是普通帧
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 1, 0);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+/**
+ * @brief 邮箱2发送完成回调
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Stamp(CAN_Bus_Of(hcan), 2,
+                 (uint16_t)HAL_CAN_GetTxTimestamp(hcan, CAN_TX_MAILBOX2));
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 2, 1U << 2);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+/**
+ * @brief 邮箱2中止回调, 被中止的都是普通帧
+ *
+ * @param hcan
+ */
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan) {
+    CAN_TX_Complete(CAN_Bus_Of(hcan), 1U << 2, 0);
+    CAN_TX_Refill(CAN_Bus_Of(hcan));
+}
+#endif /* CAN_FAST_PATH */
+
+#if CAN_RX0_INT_ENABLE
+/**
+ * @brief CAN接收中断处理
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_RX_IRQ(CAN_Bus_t bus) {
+    PROF_ENTER((Prof_Region_t)(PROF_CAN1_RX + bus));
+    CAN_ISR_ENTER();
+#if CAN_FAST_PATH
+    CAN_RX_Fast(bus);
+#else
+    HAL_CAN_IRQHandler(CAN_Bus[bus].handle);
+#endif /* CAN_FAST_PATH */
+    CAN_ISR_EXIT(CAN_RxIsrStats[bus]);
+    PROF_EXIT((Prof_Region_t)(PROF_CAN1_RX + bus));
+}
+/**
+ * @brief CAN1 RX0中断服务函数
+ *
+ */
+void CAN1_RX0_IRQHandler(void) {
+    CAN_RX_IRQ(CAN_BUS_1);
+}
+/**
+ * @brief CAN2 RX0中断服务函数
+ *
+ */
+void CAN2_RX0_IRQHandler(void) {
+    CAN_RX_IRQ(CAN_BUS_2);
+}
+#endif /* CAN_RX0_INT_ENABLE */
+
+/**
+ * @brief CAN发送中断处理
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_TX_IRQ(CAN_Bus_t bus) {
+    PROF_ENTER((Prof_Region_t)(PROF_CAN1_TX + bus));
+    CAN_ISR_ENTER();
+#if CAN_FAST_PATH
+    CAN_TX_Fast(bus);
+#else
+    HAL_CAN_IRQHandler(CAN_Bus[bus].handle);
+#endif /* CAN_FAST_PATH */
+    CAN_ISR_EXIT(CAN_TxIsrStats[bus]);
+    PROF_EXIT((Prof_Region_t)(PROF_CAN1_TX + bus));
+}
+/**
+ * @brief CAN1 TX中断服务函数
+ *
+ */
+void CAN1_TX_IRQHandler(void) {
+    CAN_TX_IRQ(CAN_BUS_1);
+}
+/**
+ * @brief CAN2 TX中断服务函数
+ *
+ */
+void CAN2_TX_IRQHandler(void) {
+    CAN_TX_IRQ(CAN_BUS_2);
+}
 
 /**
  * @brief CAN底层驱动
@@ -122,103 +754,811 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
  * @param hcan CAN句柄
  */
 void HAL_CAN_MspInit(CAN_HandleTypeDef* hcan) {
+    GPIO_InitTypeDef GPIO_Initure;
+
+    GPIO_Initure.Mode = GPIO_MODE_AF_PP;
+    GPIO_Initure.Pull = GPIO_PULLUP;
+    GPIO_Initure.Speed = GPIO_SPEED_FREQ_HIGH;
     if (hcan->Instance == CAN1) {
         __HAL_RCC_GPIOA_CLK_ENABLE(); /* CAN引脚使能 */
         __HAL_RCC_CAN1_CLK_ENABLE();  /* 使能CAN1时钟 */
 
-        GPIO_InitTypeDef GPIO_Initure;
-
         GPIO_Initure.Pin = GPIO_PIN_12;
-        GPIO_Initure.Mode = GPIO_MODE_AF_PP;
-        GPIO_Initure.Pull = GPIO_PULLUP;
-        GPIO_Initure.Speed = GPIO_SPEED_FREQ_HIGH;
         GPIO_Initure.Alternate = GPIO_AF9_CAN1;
         HAL_GPIO_Init(GPIOA, &GPIO_Initure); /* CAN_TX脚 模式设置 */
 
         GPIO_Initure.Pin = GPIO_PIN_11;
         HAL_GPIO_Init(GPIOA, &GPIO_Initure); /* CAN_RX脚 必须设置成输入模式 */
+    } else if (hcan->Instance == CAN2) {
+        __HAL_RCC_GPIOB_CLK_ENABLE(); /* CAN引脚使能 */
+        __HAL_RCC_CAN1_CLK_ENABLE();  /* CAN2的过滤器在CAN1中, 必须使能 */
+        __HAL_RCC_CAN2_CLK_ENABLE();  /* 使能CAN2时钟 */
+
+        GPIO_Initure.Pin = GPIO_PIN_13;
+        GPIO_Initure.Alternate = GPIO_AF9_CAN2;
+        HAL_GPIO_Init(GPIOB, &GPIO_Initure); /* CAN_TX脚 模式设置 */
+
+        GPIO_Initure.Pin = GPIO_PIN_12;
+        HAL_GPIO_Init(GPIOB, &GPIO_Initure); /* CAN_RX脚 必须设置成输入模式 */
     }
 }
+#if CAN_FAST_PATH
 /**
- * @brief 伺服模式给AK电机发送消息, 扩展帧
+ * @brief 是否有空闲的发送邮箱
  *
- * @param id 发送ID
+ * @param bus 总线编号
+ */
+static inline bool CAN_TX_Mailbox_Free(CAN_Bus_t bus) {
+    return (CAN_Bus[bus].handle->Instance->TSR & CAN_TSR_TME) != 0;
+}
+/**
+ * @brief 把一帧写入空闲邮箱并请求发送, 调用前确认有空闲邮箱
+ *
+ * @param bus 总线编号
+ * @param frame 帧
+ * @param[out] mailbox 使用的邮箱编号
+ * @return true-成功; false-失败
+ */
+static inline bool CAN_TX_Load(CAN_Bus_t bus,
+                               const CAN_TxFrame_t* frame,
+                               uint32_t* mailbox) {
+    CAN_TypeDef* can = CAN_Bus[bus].handle->Instance;
+    /* CODE是下一个空邮箱的编号 */
+    uint32_t index = (can->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    CAN_TxMailBox_TypeDef* tx_mailbox = &can->sTxMailBox[index];
+    uint32_t tir = (frame->ide == CAN_ID_EXT)
+                       ? (frame->id << CAN_TI0R_EXID_Pos) | CAN_ID_EXT
+                       : (frame->id << CAN_TI0R_STID_Pos);
+    tx_mailbox->TDTR = frame->len;
+    tx_mailbox->TDLR = frame->word[0];
+    tx_mailbox->TDHR = frame->word[1];
+    tx_mailbox->TIR = tir | CAN_TI0R_TXRQ; /* 最后写TXRQ, 请求发送 */
+    *mailbox = index;
+    return true;
+}
+/**
+ * @brief 请求中止邮箱中还没发出的帧, 正在发送的帧会发完
+ *
+ * @param bus 总线编号
+ * @param mailbox 邮箱编号
+ */
+static inline void CAN_TX_Abort(CAN_Bus_t bus, uint32_t mailbox) {
+    CAN_Bus[bus].handle->Instance->TSR = CAN_TSR_ABRQ0 << (8 * mailbox);
+}
+#else
+/* HAL库实现, 说明同上 */
+static inline bool CAN_TX_Mailbox_Free(CAN_Bus_t bus) {
+    return HAL_CAN_GetTxMailboxesFreeLevel(CAN_Bus[bus].handle) > 0;
+}
+static inline bool CAN_TX_Load(CAN_Bus_t bus,
+                               const CAN_TxFrame_t* frame,
+                               uint32_t* mailbox) {
+    CAN_TxHeaderTypeDef* header = &CAN_Bus[bus].tx_header;
+    uint32_t TxMailbox;
+    header->IDE = frame->ide;
+    header->StdId = frame->id;
+    header->ExtId = frame->id;
+    header->RTR = CAN_RTR_DATA; /* 数据帧 */
+    header->DLC = frame->len;
+    if (HAL_CAN_AddTxMessage(CAN_Bus[bus].handle, header,
+                             (uint8_t*)frame->data, &TxMailbox) != HAL_OK) {
+        return false;
+    }
+    /* CAN_TX_MAILBOX0/1/2是1/2/4 */
+    *mailbox = TxMailbox >> 1;
+    return true;
+}
+static inline void CAN_TX_Abort(CAN_Bus_t bus, uint32_t mailbox) {
+    HAL_CAN_AbortTxRequest(CAN_Bus[bus].handle, 1U << mailbox);
+}
+#endif /* CAN_FAST_PATH */
+
+/**
+ * @brief 一帧装入空闲邮箱, 记录邮箱中的帧和排队时间
+ *
+ * @param bus 总线编号
+ * @param frame 帧
+ * @return true-成功; false-失败
+ * @note 调用时关中断
+ */
+static inline bool CAN_TX_Load_Frame(CAN_Bus_t bus,
+                                     const CAN_TxFrame_t* frame) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    CAN_PrioStats_t* stats = &CAN_PrioStats[bus][frame->prio];
+    uint32_t mailbox;
+
+    if (CAN_TX_Load(bus, frame, &mailbox) == false) {
+        CAN_TxStats[bus].dropped++;
+        return false;
+    }
+    ctrl->mb_frame[mailbox] = *frame;
+    ctrl->mb_busy |= 1U << mailbox;
+    CAN_TxStats[bus].sent++;
+    if (frame->prio == CAN_PRIO_EMERGENCY) {
+        CAN_TxStats[bus].urgent++;
+    }
+
+    uint32_t wait = time_us() - frame->queued_us;
+    stats->loaded++;
+    stats->wait_us_last = wait;
+    stats->wait_us_total += wait;
+    if (wait > stats->wait_us_max) {
+        stats->wait_us_max = wait;
+    }
+    return true;
+}
+
+/**
+ * @brief 邮箱全满时为紧急帧中止优先级最低的帧
+ *
+ * @param bus 总线编号
+ * @param need 等待装入的紧急帧数
+ * @note 调用时关中断. 只中止还缺的数量, 同级别先中止最晚写入的帧,
+ *       中止完成后在发送中断中重新排队
+ */
+static inline void CAN_TX_Preempt(CAN_Bus_t bus, uint32_t need) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    uint32_t aborting = 0;
+    for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if (((ctrl->mb_preempt | ctrl->mb_discard) & (1U << i)) != 0) {
+            aborting++;
+        }
+    }
+
+    while (aborting < need) {
+        uint32_t victim = CAN_TX_MAILBOX_NUM;
+        for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+            uint32_t bit = 1U << i;
+            const CAN_TxFrame_t* frame = &ctrl->mb_frame[i];
+            if ((ctrl->mb_busy & bit) == 0 ||
+                ((ctrl->mb_preempt | ctrl->mb_discard) & bit) != 0 ||
+                frame->prio == CAN_PRIO_EMERGENCY) {
+                continue;
+            }
+            if (victim == CAN_TX_MAILBOX_NUM ||
+                frame->prio > ctrl->mb_frame[victim].prio ||
+                (frame->prio == ctrl->mb_frame[victim].prio &&
+                 (int32_t)(frame->queued_us -
+                           ctrl->mb_frame[victim].queued_us) > 0)) {
+                victim = i;
+            }
+        }
+        if (victim == CAN_TX_MAILBOX_NUM) {
+            break; /* 邮箱中都是紧急帧 */
+        }
+        ctrl->mb_preempt |= 1U << victim;
+        CAN_TX_Abort(bus, victim);
+        CAN_TxStats[bus].aborted++;
+        aborting++;
+    }
+}
+
+/**
+ * @brief 丢弃队列中和暂存的非紧急帧
+ *
+ * @param bus 总线编号
+ * @return uint32_t 丢弃的帧数
+ * @note 调用时关中断
+ */
+static uint32_t CAN_TX_Drop(CAN_Bus_t bus) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    CAN_TxFrame_t frame;
+    uint32_t count = 0;
+    for (uint32_t prio = CAN_PRIO_CONTROL; prio < CAN_PRIO_NUM; prio++) {
+        uint32_t num = ctrl->held_num[prio];
+        ctrl->held_num[prio] = 0;
+        while (mpsc_queue_pop(&ctrl->tx_queue[prio], &frame)) {
+            num++;
+        }
+        CAN_PrioStats[bus][prio].flushed += num;
+        count += num;
+    }
+    return count;
+}
+
+/**
+ * @brief 把发送队列中的帧装入空闲的发送邮箱
+ *
+ * @param bus 总线编号
+ * @note 线程和中断都可能调用, 装填过程关中断, 保证队列只有一个消费者.
+ *       按优先级从高到低装填, 每级先装入被中止的暂存帧, 再从队列取出.
+ *       紧急队列不为空时不装填其他帧, 邮箱全满时中止低优先级的帧,
+ *       中止完成后在发送中断中继续装填紧急帧.
+ */
+void CAN_TX_Poll(CAN_Bus_t bus) {
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    mpsc_queue_t* urgent = &ctrl->tx_queue[CAN_PRIO_EMERGENCY];
+    CAN_TxFrame_t frame;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (mpsc_queue_count(urgent) != 0) {
+        if (CAN_TX_Mailbox_Free(bus) == false) {
+            CAN_TX_Preempt(bus, mpsc_queue_count(urgent));
+            break;
+        }
+        if (mpsc_queue_pop(urgent, &frame) == false) {
+            break;
+        }
+        if (CAN_TX_Load_Frame(bus, &frame) == false) {
+            ctrl->urgent_pending--;
+        }
+    }
+    if (ctrl->tx_block == true) {
+        /* 急停前开始写入、急停后才发布的帧也在这里丢弃 */
+        CAN_TxStats[bus].flushed += CAN_TX_Drop(bus);
+        __set_PRIMASK(primask);
+        return;
+    }
+#if CAN_ERR_ENABLE
+    if (ctrl->err.state == CAN_ERR_BUS_OFF) {
+        /* 离线时普通帧留在队列中, 恢复后按CAN_BUSOFF_FLUSH处理 */
+        __set_PRIMASK(primask);
+        return;
+    }
+#endif /* CAN_ERR_ENABLE */
+    for (uint32_t prio = CAN_PRIO_CONTROL; prio < CAN_PRIO_NUM; prio++) {
+        while (mpsc_queue_count(urgent) == 0 && CAN_TX_Mailbox_Free(bus)) {
+            if (CAN_TX_Unhold(bus, prio, &frame) == false &&
+                mpsc_queue_pop(&ctrl->tx_queue[prio], &frame) == false) {
+                break;
+            }
+            CAN_TX_Load_Frame(bus, &frame);
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief 发送队列有新帧或邮箱空闲时回调
+ *
+ * @param bus 总线编号
+ * @note 默认直接装填邮箱; 使用OS时重写此函数, 唤醒CAN发送任务
+ */
+__weak void CAN_TX_Request_Callback(CAN_Bus_t bus) {
+    CAN_TX_Poll(bus);
+}
+
+/**
+ * @brief 填充一帧
+ *
+ * @param[out] frame 帧
+ * @param prio 优先级
+ * @param ide CAN_ID_STD或CAN_ID_EXT
+ * @param id 帧ID
  * @param msg 数据
- * @param len 数据长度
- * @return uint8_t 0-成功; 1-添加发送邮箱失败; 2-发送超时
+ * @param len 数据长度, 超过8截断
  */
-uint8_t AKcmd_can_transmit_eid(uint32_t id, uint8_t* msg, uint8_t len) {
+static inline void CAN_TX_Frame_Fill(CAN_TxFrame_t* frame,
+                                     CAN_Prio_t prio,
+                                     uint32_t ide,
+                                     uint32_t id,
+                                     uint8_t* msg,
+                                     uint8_t len) {
     if (len > 8) {
         /* 长度限制8 */
         len = 8;
     }
-    uint16_t t = 0;
-    uint32_t TxMailbox = CAN_TX_MAILBOX0;
-
-    CAN1_TxHeader.IDE = CAN_ID_EXT; /* 使用扩展帧 */
-    CAN1_TxHeader.StdId = 0;        /* 标准标识符 */
-    CAN1_TxHeader.ExtId = id;       /* 扩展标识符(29位) */
-
-    CAN1_TxHeader.RTR = CAN_RTR_DATA; /* 数据帧 */
-    CAN1_TxHeader.DLC = len;
+    frame->id = id;
+    frame->ide = ide;
+    frame->len = len;
+    frame->prio = (uint8_t)prio;
+    frame->queued_us = time_us();
+    frame->word[0] = 0;
+    frame->word[1] = 0;
+    memcpy(frame->data, msg, len);
+}
 
-    if (HAL_CAN_AddTxMessage(&CAN1_Handler, &CAN1_TxHeader, msg, &TxMailbox) !=
-        HAL_OK) {
-        /* 发送消息 */
+/**
+ * @brief 帧按优先级写入发送队列
+ *
+ * @param bus 总线编号
+ * @param prio 优先级
+ * @param ide CAN_ID_STD或CAN_ID_EXT
+ * @param id 帧ID
+ * @param msg 数据
+ * @param len 数据长度
+ * @return uint8_t 0-成功; 1-队列已满或参数错误
+ * @note 任意线程或中断都可以调用, 不会阻塞. 紧急帧立即装填邮箱,
+ *       不经过发送任务, 这条总线的紧急帧全部发送完成时回调
+ *       `CAN_TX_Urgent_Done_Callback`; 其他帧由邮箱空闲中断或发送任务装填
+ */
+uint8_t CAN_TX_Send(CAN_Bus_t bus,
+                    CAN_Prio_t prio,
+                    uint32_t ide,
+                    uint32_t id,
+                    uint8_t* msg,
+                    uint8_t len) {
+    CAN_TxFrame_t frame;
+    if (bus >= CAN_BUS_NUM || prio >= CAN_PRIO_NUM) {
         return 1;
     }
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+    CAN_TX_Frame_Fill(&frame, prio, ide, id, msg, len);
 
-    while (HAL_CAN_GetTxMailboxesFreeLevel(&CAN1_Handler) != 3) {
-        /* 等待发送完成,所有邮箱为空 */
-        t++;
-        if (t > 0xFFF) {
-            HAL_CAN_AbortTxRequest(&CAN1_Handler, TxMailbox);
-            /* 超时，直接中止邮箱的发送请求 */
-            return 1;
+    uint32_t primask = __get_PRIMASK();
+    if (prio == CAN_PRIO_EMERGENCY) {
+        /* 先计数再写入, 保证发送完成时计数已经包含这一帧 */
+        __disable_irq();
+        ctrl->urgent_pending++;
+        __set_PRIMASK(primask);
+    }
+    if (mpsc_queue_push(&ctrl->tx_queue[prio], &frame) == false) {
+        if (prio == CAN_PRIO_EMERGENCY) {
+            __disable_irq();
+            ctrl->urgent_pending--;
+            __set_PRIMASK(primask);
         }
+        CAN_TxStats[bus].overflow++;
+        CAN_PrioStats[bus][prio].overflow++;
+        return 1;
+    }
+    CAN_PrioStats[bus][prio].queued++;
+    if (prio == CAN_PRIO_EMERGENCY) {
+        CAN_TX_Poll(bus);
+    } else {
+        CAN_TX_Request_Callback(bus);
     }
-
     return 0;
 }
 
+/**
+ * @brief 伺服模式给AK电机发送消息, 扩展帧
+ *
+ * @param bus 总线编号
+ * @param id 发送ID
+ * @param msg 数据
+ * @param len 数据长度
+ * @return uint8_t 0-成功; 1-发送队列已满
+ * @note 帧写入控制级发送队列, 由邮箱空闲中断或发送任务装入邮箱, 不会阻塞
+ */
+uint8_t AKcmd_can_transmit_eid(CAN_Bus_t bus,
+                               uint32_t id,
+                               uint8_t* msg,
+                               uint8_t len) {
+    return CAN_TX_Send(bus, CAN_PRIO_CONTROL, CAN_ID_EXT, id, msg, len);
+}
+
 /**
  * @brief 运控模式给AK电机发送消息, 标准帧
  *
+ * @param bus 总线编号
  * @param id 发送ID
  * @param msg 数据
  * @param len 数据长度
- * @return uint8_t 0-成功; 1-添加发送邮箱失败; 2-发送超时
+ * @return uint8_t 0-成功; 1-发送队列已满
+ * @note 帧写入控制级发送队列, 由邮箱空闲中断或发送任务装入邮箱, 不会阻塞
  */
-uint8_t AKcmd_can_transmit_mit(uint32_t id, uint8_t* msg, uint8_t len) {
-    if (len > 8) {
-        /* 长度限制8 */
-        len = 8;
+uint8_t AKcmd_can_transmit_mit(CAN_Bus_t bus,
+                               uint32_t id,
+                               uint8_t* msg,
+                               uint8_t len) {
+    return CAN_TX_Send(bus, CAN_PRIO_CONTROL, CAN_ID_STD, id, msg, len);
+}
+
+/**
+ * @brief 帧写入紧急发送队列并立即装填邮箱
+ *
+ * @param bus 总线编号
+ * @param ide CAN_ID_STD或CAN_ID_EXT
+ * @param id 帧ID
+ * @param msg 数据
+ * @param len 数据长度
+ * @return uint8_t 0-成功; 1-紧急队列已满或总线编号错误
+ * @note 同`CAN_TX_Send(bus, CAN_PRIO_EMERGENCY, ...)`
+ */
+uint8_t CAN_TX_Urgent(CAN_Bus_t bus,
+                      uint32_t ide,
+                      uint32_t id,
+                      uint8_t* msg,
+                      uint8_t len) {
+    return CAN_TX_Send(bus, CAN_PRIO_EMERGENCY, ide, id, msg, len);
+}
+
+/**
+ * @brief 一条总线的紧急帧全部发送完成时回调, 在发送中断中调用
+ *
+ * @param bus 总线编号
+ */
+__weak void CAN_TX_Urgent_Done_Callback(CAN_Bus_t bus) {
+    UNUSED(bus);
+}
+
+/**
+ * @brief 清除所有非紧急帧, 包括邮箱中还没发出的帧
+ *
+ * @param bus 总线编号
+ * @return uint32_t 清除的帧数, 包括请求中止的邮箱
+ * @note 急停时调用, 避免旧指令在停止帧之后发出. 邮箱中的帧中止后丢弃,
+ *       不会重新排队
+ */
+uint32_t CAN_TX_Flush(CAN_Bus_t bus) {
+    if (bus >= CAN_BUS_NUM) {
+        return 0;
     }
-    uint16_t t = 0;
-    uint32_t TxMailbox = CAN_TX_MAILBOX0;
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
 
-    CAN1_TxHeader.IDE = CAN_ID_STD; /* 使用标准帧 */
-    CAN1_TxHeader.StdId = id;       /* 标准标识符 */
-    CAN1_TxHeader.ExtId = id;       /* 扩展标识符(29位) */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t count = CAN_TX_Drop(bus);
+    CAN_TxStats[bus].flushed += count;
+    for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        uint32_t bit = 1U << i;
+        if ((ctrl->mb_busy & bit) == 0 || (ctrl->mb_discard & bit) != 0 ||
+            ctrl->mb_frame[i].prio == CAN_PRIO_EMERGENCY) {
+            continue;
+        }
+        if ((ctrl->mb_preempt & bit) == 0) {
+            CAN_TX_Abort(bus, i);
+        }
+        ctrl->mb_preempt &= ~bit;
+        ctrl->mb_discard |= bit; /* 中止完成时计入flushed */
+        count++;
+    }
+    __set_PRIMASK(primask);
+    return count;
+}
 
-    CAN1_TxHeader.RTR = CAN_RTR_DATA; /* 数据帧 */
-    CAN1_TxHeader.DLC = len;
+/**
+ * @brief 禁止或恢复装填非紧急帧
+ *
+ * @param bus 总线编号
+ * @param block `true`-禁止, 之后发布的非紧急帧在装填时丢弃; `false`-恢复
+ * @note 急停时先禁止再`CAN_TX_Flush`. 写入队列的过程可能被急停中断打断,
+ *       这一帧在清空之后才发布, 只有禁止装填才能保证它不在停止帧之后发出.
+ *       恢复时先丢弃禁止期间留在队列中的帧
+ */
+void CAN_TX_Block(CAN_Bus_t bus, bool block) {
+    if (bus >= CAN_BUS_NUM) {
+        return;
+    }
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
 
-    if (HAL_CAN_AddTxMessage(&CAN1_Handler, &CAN1_TxHeader, msg, &TxMailbox) !=
-        HAL_OK) {
-        /* 发送消息 */
-        return 1;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (block == false && ctrl->tx_block == true) {
+        CAN_TxStats[bus].flushed += CAN_TX_Drop(bus);
     }
+    ctrl->tx_block = block;
+    __set_PRIMASK(primask);
+}
 
-    while (HAL_CAN_GetTxMailboxesFreeLevel(&CAN1_Handler) != 3) {
-        /* 等待发送完成,所有邮箱为空 */
-        t++;
-        if (t > 0xFFF) {
-            HAL_CAN_AbortTxRequest(&CAN1_Handler, TxMailbox);
-            /* 超时，直接中止邮箱的发送请求 */
-            return 1;
+/**
+ * @brief 一个优先级还没发送完成的帧数
+ *
+ * @param bus 总线编号
+ * @param prio 优先级
+ * @return uint32_t 队列中、暂存的和邮箱中的帧数之和
+ * @note 用于批量发送时控制写入速度, 不占满队列
+ */
+uint32_t CAN_TX_Pending(CAN_Bus_t bus, CAN_Prio_t prio) {
+    if (bus >= CAN_BUS_NUM || prio >= CAN_PRIO_NUM) {
+        return 0;
+    }
+    CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t count =
+        mpsc_queue_count(&ctrl->tx_queue[prio]) + ctrl->held_num[prio];
+    for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if ((ctrl->mb_busy & (1U << i)) != 0 &&
+            ctrl->mb_frame[i].prio == prio) {
+            count++;
         }
     }
+    __set_PRIMASK(primask);
+    return count;
+}
 
-    return 0;
+#if CAN_ERR_ENABLE
+/**
+ * @brief 由错误状态寄存器得到错误状态
+ *
+ * @param esr ESR寄存器
+ * @return CAN_Err_State_t 错误状态
+ */
+static inline CAN_Err_State_t CAN_Err_State_Of(uint32_t esr) {
+    if ((esr & CAN_ESR_BOFF) != 0) {
+        return CAN_ERR_BUS_OFF;
+    }
+    if ((esr & CAN_ESR_EPVF) != 0) {
+        return CAN_ERR_PASSIVE;
+    }
+    if ((esr & CAN_ESR_EWGF) != 0) {
+        return CAN_ERR_WARNING;
+    }
+    return CAN_ERR_ACTIVE;
+}
+
+/**
+ * @brief 丢弃离线前后的旧指令
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_Bus_Off_Flush(CAN_Bus_t bus) {
+#if CAN_BUSOFF_FLUSH
+    CAN_ErrStats[bus].stale_flushed += CAN_TX_Flush(bus);
+#else
+    UNUSED(bus);
+#endif /* CAN_BUSOFF_FLUSH */
+}
+
+/**
+ * @brief 进入离线, 丢弃旧指令并计算退避时间
+ *
+ * @param bus 总线编号
+ * @note 恢复后不到`CAN_BUSOFF_STABLE_MS`又离线时退避时间加倍,
+ *       避免总线一直有故障时反复恢复干扰其他节点
+ */
+static void CAN_Bus_Off_Enter(CAN_Bus_t bus) {
+    CAN_Err_Ctrl_t* err = &CAN_Bus[bus].err;
+    uint32_t now = time_us();
+
+    if (CAN_ErrStats[bus].recovered != 0 &&
+        now - err->active_us < CAN_BUSOFF_STABLE_MS * 1000U) {
+        err->backoff_us *= 2U;
+        if (err->backoff_us > CAN_BUSOFF_BACKOFF_MAX_US) {
+            err->backoff_us = CAN_BUSOFF_BACKOFF_MAX_US;
+        }
+    } else {
+        err->backoff_us = CAN_BUSOFF_BACKOFF_MIN_US;
+    }
+    err->off_us = now;
+    err->recover_at = now + err->backoff_us;
+    err->recover_req = false;
+    CAN_Bus_Off_Flush(bus);
+}
+
+/**
+ * @brief 请求退出离线
+ *
+ * @param bus 总线编号
+ * @note 没有使能自动离线管理时, 软件进入再退出初始化模式,
+ *       之后硬件检测到128次11个连续隐性位(1Mbps时约1.4ms)才恢复
+ */
+static void CAN_Bus_Off_Recover(CAN_Bus_t bus) {
+    CAN_TypeDef* can = CAN_Bus[bus].handle->Instance;
+    can->MCR |= CAN_MCR_INRQ;
+    /* 离线时没有收发, 很快就能进入初始化模式 */
+    for (uint32_t i = 0; i < 1000U && (can->MSR & CAN_MSR_INAK) == 0; i++) {
+    }
+    can->MCR &= ~CAN_MCR_INRQ;
+}
+
+/**
+ * @brief 离线恢复完成, 统计恢复时间并重新开始发送
+ *
+ * @param bus 总线编号
+ */
+static void CAN_Bus_Off_Exit(CAN_Bus_t bus) {
+    CAN_Err_Ctrl_t* err = &CAN_Bus[bus].err;
+    CAN_ErrStats_t* stats = &CAN_ErrStats[bus];
+    uint32_t now = time_us();
+    uint32_t elapsed = now - err->off_us;
+
+    stats->recovered++;
+    stats->recover_us_last = elapsed;
+    if (elapsed > stats->recover_us_max) {
+        stats->recover_us_max = elapsed;
+    }
+    err->active_us = now;
+    err->recover_req = false;
+    CAN_Bus_Off_Flush(bus); /* 离线期间写入的帧也已过时 */
+}
+
+/**
+ * @brief 更新错误状态, 统计每次状态变化
+ *
+ * @param bus 总线编号
+ * @param state 新状态
+ * @note 调用时关中断. 被动错误和离线时关闭错误码中断, 否则没有应答时
+ *       每次重发都会进中断, 错误码改由SysTick采样
+ */
+static void CAN_Err_State_Set(CAN_Bus_t bus, CAN_Err_State_t state) {
+    CAN_Err_Ctrl_t* err = &CAN_Bus[bus].err;
+    CAN_Err_State_t old_state = err->state;
+    if (state == old_state) {
+        return;
+    }
+    err->state = state;
+    CAN_ErrStats[bus].enter[state]++;
+    if (state >= CAN_ERR_PASSIVE) {
+        __HAL_CAN_DISABLE_IT(CAN_Bus[bus].handle, CAN_IT_LAST_ERROR_CODE);
+    } else {
+        __HAL_CAN_ENABLE_IT(CAN_Bus[bus].handle, CAN_IT_LAST_ERROR_CODE);
+    }
+    if (state == CAN_ERR_BUS_OFF) {
+        CAN_Bus_Off_Enter(bus);
+    } else if (old_state == CAN_ERR_BUS_OFF) {
+        CAN_Bus_Off_Exit(bus);
+        CAN_TX_Request_Callback(bus);
+    }
+    CAN_Err_State_Callback(bus, old_state, state);
+}
+
+/**
+ * @brief 处理一次错误状态寄存器的读数
+ *
+ * @param bus 总线编号
+ * @param esr ESR寄存器, LEC已由调用者清除
+ */
+static void CAN_Err_Event(CAN_Bus_t bus, uint32_t esr) {
+    CAN_ErrStats_t* stats = &CAN_ErrStats[bus];
+    uint32_t lec = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos;
+    uint8_t tec = (uint8_t)(esr >> CAN_ESR_TEC_Pos);
+    uint8_t rec = (uint8_t)(esr >> CAN_ESR_REC_Pos);
+
+    if (lec != 0) {
+        stats->lec[lec]++;
+    }
+    if (tec > stats->tec_max) {
+        stats->tec_max = tec;
+    }
+    if (rec > stats->rec_max) {
+        stats->rec_max = rec;
+    }
+    CAN_Err_State_Set(bus, CAN_Err_State_Of(esr));
+}
+
+#if CAN_FAST_PATH
+/**
+ * @brief 读取并清除错误码, 更新错误状态
+ *
+ * @param bus 总线编号
+ */
+static inline void CAN_Err_Fast(CAN_Bus_t bus) {
+    CAN_TypeDef* can = CAN_Bus[bus].handle->Instance;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t esr = can->ESR;
+    can->ESR = 0;              /* 只有LEC可写, 清零以便区分新的错误 */
+    can->MSR = CAN_MSR_ERRI;   /* 写1清除 */
+    CAN_Err_Event(bus, esr);
+    __set_PRIMASK(primask);
+}
+#else
+/**
+ * @brief 处理HAL库记录的错误码, 更新错误状态
+ *
+ * @param hcan CAN句柄
+ * @param code HAL库错误码
+ */
+static void CAN_Err_Hal(CAN_HandleTypeDef* hcan, uint32_t code) {
+    CAN_Bus_t bus = CAN_Bus_Of(hcan);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    /* HAL_CAN_ERROR_STF ~ HAL_CAN_ERROR_CRC依次对应LEC 1 ~ 6 */
+    for (uint32_t lec = 1; lec <= 6; lec++) {
+        if ((code & (HAL_CAN_ERROR_STF << (lec - 1))) != 0) {
+            CAN_ErrStats[bus].lec[lec]++;
+        }
+    }
+    CAN_Err_Event(bus, hcan->Instance->ESR & ~CAN_ESR_LEC);
+    __set_PRIMASK(primask);
+}
+#endif /* CAN_FAST_PATH */
+
+/**
+ * @brief CAN1 SCE(状态变化和错误)中断服务函数
+ *
+ */
+void CAN1_SCE_IRQHandler(void) {
+#if CAN_FAST_PATH
+    CAN_Err_Fast(CAN_BUS_1);
+#else
+    HAL_CAN_IRQHandler(CAN_Bus[CAN_BUS_1].handle);
+#endif /* CAN_FAST_PATH */
+}
+/**
+ * @brief CAN2 SCE(状态变化和错误)中断服务函数
+ *
+ */
+void CAN2_SCE_IRQHandler(void) {
+#if CAN_FAST_PATH
+    CAN_Err_Fast(CAN_BUS_2);
+#else
+    HAL_CAN_IRQHandler(CAN_Bus[CAN_BUS_2].handle);
+#endif /* CAN_FAST_PATH */
+}
+
+/**
+ * @brief 检查错误状态并执行离线恢复, 在SysTick中每个节拍调用
+ *
+ * @note 错误计数下降不会产生中断, 回到主动错误由这里检测.
+ *       离线超过退避时间后请求恢复, 硬件恢复完成后重新开始发送.
+ */
+void CAN_Err_Tick(void) {
+    for (uint32_t i = 0; i < CAN_BUS_NUM; i++) {
+        CAN_Bus_t bus = (CAN_Bus_t)i;
+        CAN_Bus_Ctrl_t* ctrl = &CAN_Bus[bus];
+        CAN_TypeDef* can = ctrl->handle->Instance;
+        if (can == NULL) {
+            continue; /* 未初始化 */
+        }
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (ctrl->err.state == CAN_ERR_BUS_OFF &&
+            ctrl->err.recover_req == false &&
+            time_expired_us(ctrl->err.recover_at)) {
+            CAN_Bus_Off_Recover(bus);
+            ctrl->err.recover_req = true;
+        }
+        uint32_t esr = can->ESR;
+        if ((esr & CAN_ESR_LEC) != 0) {
+            can->ESR = 0;
+        }
+        CAN_Err_Event(bus, esr);
+        __set_PRIMASK(primask);
+    }
+}
+
+/**
+ * @brief 获取错误状态
+ *
+ * @param bus 总线编号
+ * @return CAN_Err_State_t 错误状态
+ */
+CAN_Err_State_t CAN_Get_Err_State(CAN_Bus_t bus) {
+    if (bus >= CAN_BUS_NUM) {
+        return CAN_ERR_ACTIVE;
+    }
+    return CAN_Bus[bus].err.state;
+}
+#else
+CAN_Err_State_t CAN_Get_Err_State(CAN_Bus_t bus) {
+    UNUSED(bus);
+    return CAN_ERR_ACTIVE;
+}
+
+void CAN_Err_Tick(void) {
+}
+#endif /* CAN_ERR_ENABLE */
+
+#if !CAN_FAST_PATH
+/**
+ * @brief CAN错误回调, HAL库已读取并清除错误码
+ *
+ * @param hcan CAN句柄
+ * @note 邮箱中止时如果之前有过仲裁失败或发送错误, HAL库报告错误而不是
+ *       中止回调, 在这里按中止处理
+ */
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan) {
+    CAN_Bus_t bus = CAN_Bus_Of(hcan);
+    uint32_t code = HAL_CAN_GetError(hcan);
+    uint32_t failed = 0;
+    HAL_CAN_ResetError(hcan);
+
+    /* 邮箱0/1/2的ALST和TERR依次相差2位 */
+    for (uint32_t i = 0; i < CAN_TX_MAILBOX_NUM; i++) {
+        if ((code & ((HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0)
+                     << (2 * i))) != 0) {
+            failed |= 1U << i;
+        }
+    }
+#if CAN_ERR_ENABLE
+    CAN_Err_Hal(hcan, code);
+#endif /* CAN_ERR_ENABLE */
+    if (failed != 0) {
+        CAN_TX_Complete(bus, failed, 0);
+        CAN_TX_Refill(bus);
+    }
+}
+#endif /* !CAN_FAST_PATH */
+
+/**
+ * @brief 错误状态变化回调, 在中断中调用
+ *
+ * @param bus 总线编号
+ * @param old_state 原状态
+ * @param new_state 新状态
+ * @note 可以重写, 例如离线时点亮指示灯或让上层进入安全状态
+ */
+__weak void CAN_Err_State_Callback(CAN_Bus_t bus,
+                                   CAN_Err_State_t old_state,
+                                   CAN_Err_State_t new_state) {
+    UNUSED(bus);
+    UNUSED(old_state);
+    UNUSED(new_state);
 }
@@ -0,0 +1,20 @@
+/**
+ * @file    dwt.c
+ * @author  Deadline--
+ * @brief   DWT周期计数器, 用于测量代码执行的时钟周期数
+ * @version 0.1
+ * @date    2023-12-12
+ */
+
+#include "dwt.h"
+
+/**
+ * @brief 使能DWT周期计数器
+ *
+ * @note 调试器连接时也可能已经使能, 重复调用没有影响
+ */
+void DWT_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
@@ -0,0 +1,426 @@
+/**
+ * @file    fault_rec.c
+ * @author  Deadline--
+ * @brief   飞行记录: 备份SRAM中的控制周期记录和异常现场, 复位后输出
+ * @version 0.1
+ * @date    2023-12-26
+ */
+
+#include "fault_rec.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "num_fmt.h"
+#include "timebase.h"
+
+/* 有效标记 */
+#define FAULT_REC_MAGIC 0x52464B41U
+/* 复位标志, 与RCC->CSR中的位置相同 */
+#define FAULT_REC_RST_BOR  (1U << 25)
+#define FAULT_REC_RST_PIN  (1U << 26)
+#define FAULT_REC_RST_POR  (1U << 27)
+#define FAULT_REC_RST_SFT  (1U << 28)
+#define FAULT_REC_RST_IWDG (1U << 29)
+#define FAULT_REC_RST_WWDG (1U << 30)
+#define FAULT_REC_RST_LPWR (1U << 31)
+
+/* 一行周期记录的最大长度 */
+#define FAULT_REC_LINE_LEN (24U + 5U * (NUM_FMT_MAX_LEN + 1U))
+
+/* 备份SRAM只有4KB, 超出时编译报错 */
+typedef char fault_rec_size_check[(sizeof(fault_rec_t) <= 4096U) ? 1 : -1];
+
+#if FAULT_REC_TARGET
+/* 备份SRAM */
+#define fault_rec ((fault_rec_t*)BKPSRAM_BASE)
+
+#if FAULT_REC_IWDG_ENABLE
+static IWDG_HandleTypeDef fault_rec_iwdg; /* Instance不为NULL时已启动 */
+#endif /* FAULT_REC_IWDG_ENABLE */
+
+/* 异常处理使用的栈, 由异常处理函数切换 */
+__attribute__((aligned(8))) uint32_t fault_rec_stack[FAULT_REC_STACK_SIZE / 4];
+
+/**
+ * @brief 读取并清除复位标志, 使能备份SRAM
+ *
+ * @return uint32_t 复位时的RCC->CSR
+ * @note 接VBAT时打开备份调压器, 掉电后内容也保持
+ */
+static uint32_t fault_rec_hw_init(void) {
+    uint32_t csr = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+    PWR->CSR |= PWR_CSR_BRE;
+    uint32_t start = time_us();
+    while ((PWR->CSR & PWR_CSR_BRR) == 0 && time_elapsed_us(start) < 10000U) {
+        /* 没有VBAT时调压器不会就绪, 不影响复位后保持 */
+    }
+    return csr;
+}
+
+/**
+ * @brief float转半精度浮点, 使用FPU的转换指令
+ *
+ * @param v 数值
+ * @return uint16_t 半精度浮点
+ */
+static inline uint16_t fault_rec_half(float v) {
+    float h;
+    uint32_t bits;
+    __asm("vcvtb.f16.f32 %0, %1" : "=t"(h) : "t"(v));
+    memcpy(&bits, &h, sizeof(bits));
+    return (uint16_t)bits;
+}
+#else
+static fault_rec_t fault_rec_ram;         /* 模拟的备份SRAM */
+static uint32_t fault_rec_host_csr = 0;   /* 下一次初始化时的复位标志 */
+static uint32_t fault_rec_host_kicks = 0; /* 喂狗次数 */
+#define fault_rec (&fault_rec_ram)
+
+/**
+ * @brief 读取模拟的复位标志
+ *
+ * @return uint32_t 复位标志
+ */
+static uint32_t fault_rec_hw_init(void) {
+    uint32_t csr = fault_rec_host_csr;
+    fault_rec_host_csr = 0;
+    return csr;
+}
+
+/**
+ * @brief float转半精度浮点, 超出范围时为无穷大, 很小的数截断
+ *
+ * @param v 数值
+ * @return uint16_t 半精度浮点
+ */
+static uint16_t fault_rec_half(float v) {
+    uint32_t x;
+    memcpy(&x, &v, sizeof(x));
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000U);
+    int32_t exp = (int32_t)((x >> 23) & 0xFFU) - 127 + 15;
+    uint32_t mant = x & 0x7FFFFFU;
+    if (((x >> 23) & 0xFFU) == 0xFFU) {
+        return (uint16_t)(sign | 0x7C00U | (mant != 0 ? 0x200U : 0U));
+    }
+    if (exp >= 31) {
+        return (uint16_t)(sign | 0x7C00U);
+    }
+    if (exp <= 0) {
+        if (exp < -10) {
+            return sign;
+        }
+        mant |= 0x800000U;
+        return (uint16_t)(sign | (mant >> (14 - exp)));
+    }
+    return (uint16_t)(sign | ((uint32_t)exp << 10) | (mant >> 13));
+}
+
+/**
+ * @brief 模拟一次复位, 备份SRAM内容保留
+ *
+ * @param csr 下一次`fault_rec_init()`读到的复位标志, 与RCC->CSR的位置相同
+ */
+void fault_rec_host_reset(uint32_t csr) {
+    fault_rec_host_csr = csr;
+}
+#endif /* FAULT_REC_TARGET */
+
+/**
+ * @brief 半精度浮点转float
+ *
+ * @param h 半精度浮点
+ * @return float 数值
+ */
+static float fault_rec_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000U) << 16;
+    uint32_t exp = (h >> 10) & 0x1FU;
+    uint32_t mant = h & 0x3FFU;
+    uint32_t bits;
+    float v;
+    if (exp == 0) {
+        v = (float)mant / 16777216.0f; /* 非规格化数, mant * 2^-24 */
+        return sign != 0 ? -v : v;
+    }
+    if (exp == 31) {
+        bits = sign | 0x7F800000U | (mant << 13);
+    } else {
+        bits = sign | ((exp + 112U) << 23) | (mant << 13);
+    }
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief 半精度浮点格式化成3位小数, 无穷大输出"inf"
+ *
+ * @param[out] buf 输出, 至少`NUM_FMT_MAX_LEN`字节, 不以'\0'结尾
+ * @param h 半精度浮点
+ * @return uint32_t 写入的字符数
+ */
+static uint32_t fault_rec_fmt(char* buf, uint16_t h) {
+    uint32_t n = 0;
+    if ((h & 0x7FFFU) == 0x7C00U) {
+        if ((h & 0x8000U) != 0) {
+            buf[n++] = '-';
+        }
+        buf[n++] = 'i';
+        buf[n++] = 'n';
+        buf[n++] = 'f';
+        return n;
+    }
+    return num_fmt_fixed(buf, fault_rec_float(h), 3);
+}
+
+/**
+ * @brief 初始化, 在时间基准和串口之后、第一次记录之前调用
+ *
+ * @note 备份SRAM内容无效(第一次上电或格式改变)时清空
+ */
+void fault_rec_init(void) {
+    uint32_t csr = fault_rec_hw_init();
+    if (fault_rec->magic != FAULT_REC_MAGIC ||
+        fault_rec->version != FAULT_REC_VERSION ||
+        fault_rec->size != sizeof(fault_rec_t) ||
+        fault_rec->head >= FAULT_REC_NUM) {
+        memset(fault_rec, 0, sizeof(fault_rec_t));
+        fault_rec->magic = FAULT_REC_MAGIC;
+        fault_rec->version = FAULT_REC_VERSION;
+        fault_rec->size = sizeof(fault_rec_t);
+    }
+    fault_rec->boots++;
+    fault_rec->reset_csr = csr;
+}
+
+/**
+ * @brief 复位原因
+ *
+ * @param csr 复位标志
+ * @return const char* 原因
+ * @note 内部复位也会拉低NRST引脚, 所以PIN标志最后判断
+ */
+static const char* fault_rec_reset_str(uint32_t csr) {
+    if (csr & FAULT_REC_RST_IWDG) {
+        return "iwdg";
+    }
+    if (csr & FAULT_REC_RST_WWDG) {
+        return "wwdg";
+    }
+    if (csr & FAULT_REC_RST_LPWR) {
+        return "lpwr";
+    }
+    if (csr & FAULT_REC_RST_SFT) {
+        return "soft";
+    }
+    if (csr & (FAULT_REC_RST_POR | FAULT_REC_RST_BOR)) {
+        return "power";
+    }
+    if (csr & FAULT_REC_RST_PIN) {
+        return "pin";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief 输出异常现场
+ *
+ * @param f 异常现场
+ */
+static void fault_rec_report_fault(const fault_rec_fault_t* f) {
+    static const char* const names[] = {"none", "hard", "mem", "bus", "usage"};
+    const char* name = f->type < 5U ? names[f->type] : "?";
+    printf("#fault %s pc 0x%08lX lr 0x%08lX sp 0x%08lX xpsr 0x%08lX\r\n", name,
+           (unsigned long)f->frame[6], (unsigned long)f->frame[5],
+           (unsigned long)f->sp, (unsigned long)f->frame[7]);
+    printf("#fault r0 0x%08lX r1 0x%08lX r2 0x%08lX r3 0x%08lX r12 0x%08lX\r\n",
+           (unsigned long)f->frame[0], (unsigned long)f->frame[1],
+           (unsigned long)f->frame[2], (unsigned long)f->frame[3],
+           (unsigned long)f->frame[4]);
+    printf("#fault cfsr 0x%08lX hfsr 0x%08lX mmfar 0x%08lX bfar 0x%08lX "
+           "exc_return 0x%08lX t_us %lu\r\n",
+           (unsigned long)f->cfsr, (unsigned long)f->hfsr,
+           (unsigned long)f->mmfar, (unsigned long)f->bfar,
+           (unsigned long)f->exc_return, (unsigned long)f->t_us);
+}
+
+/**
+ * @brief 启动时输出复位原因, 异常或看门狗复位时输出现场和周期记录
+ *
+ * @note 在`fault_rec_init()`之后、第一次记录之前调用
+ */
+void fault_rec_report(void) {
+    uint32_t csr = fault_rec->reset_csr;
+    printf("#fault boot %lu reset %s csr 0x%08lX\r\n",
+           (unsigned long)fault_rec->boots, fault_rec_reset_str(csr),
+           (unsigned long)csr);
+    if (fault_rec->fault.type == FAULT_REC_NONE &&
+        (csr & FAULT_REC_RST_IWDG) == 0) {
+        return;
+    }
+    if (fault_rec->fault.type != FAULT_REC_NONE) {
+        fault_rec_report_fault(&fault_rec->fault);
+    }
+
+    uint32_t num = fault_rec->count < FAULT_REC_NUM ? fault_rec->count
+                                                    : FAULT_REC_NUM;
+    uint32_t pos = fault_rec->count < FAULT_REC_NUM ? 0 : fault_rec->head;
+    printf("#fault log %lu "
+           "t_us,cmd_pos,cmd_torque,pos,spd,torque,error,flags\r\n",
+           (unsigned long)num);
+    for (uint32_t i = 0; i < num; i++) {
+        const fault_rec_entry_t* e = &fault_rec->entry[pos];
+        const uint16_t values[5] = {e->cmd_pos, e->cmd_torque, e->pos, e->spd,
+                                    e->torque};
+        char line[FAULT_REC_LINE_LEN];
+        uint32_t n = 0;
+        line[n++] = '#';
+        n += num_fmt_uint(line + n, e->t_us);
+        for (uint32_t k = 0; k < 5U; k++) {
+            line[n++] = ',';
+            n += fault_rec_fmt(line + n, values[k]);
+        }
+        line[n++] = ',';
+        n += num_fmt_uint(line + n, e->error);
+        line[n++] = ',';
+        n += num_fmt_uint(line + n, e->flags);
+        line[n++] = '\r';
+        line[n++] = '\n';
+        line[n] = '\0';
+        printf("%s", line); /* 等待发送缓冲区, 不丢行 */
+        if (++pos >= FAULT_REC_NUM) {
+            pos = 0;
+        }
+    }
+    memset(&fault_rec->fault, 0, sizeof(fault_rec->fault));
+}
+
+/**
+ * @brief 记录一个控制周期, 在控制线程中每个周期调用一次
+ *
+ * @param cmd_pos 给定位置
+ * @param cmd_torque 给定扭矩, 伺服模式为电流
+ * @param pos 位置
+ * @param spd 速度
+ * @param torque 扭矩, 伺服模式为电流
+ * @param error 电机错误码
+ * @param flags `FAULT_REC_FLAG_STALE`等
+ * @note 只有一个线程调用; 先写记录再移动head, 异常时最多丢失正在写的一条
+ */
+void fault_rec_log(float cmd_pos,
+                   float cmd_torque,
+                   float pos,
+                   float spd,
+                   float torque,
+                   uint8_t error,
+                   uint8_t flags) {
+    uint32_t head = fault_rec->head;
+    fault_rec_entry_t* e = &fault_rec->entry[head];
+    e->t_us = time_us();
+    e->cmd_pos = fault_rec_half(cmd_pos);
+    e->cmd_torque = fault_rec_half(cmd_torque);
+    e->pos = fault_rec_half(pos);
+    e->spd = fault_rec_half(spd);
+    e->torque = fault_rec_half(torque);
+    e->error = error;
+    e->flags = flags;
+    fault_rec->head = head + 1U < FAULT_REC_NUM ? head + 1U : 0U;
+    fault_rec->count++;
+}
+
+/**
+ * @brief 启动独立看门狗, 已经启动时只喂狗
+ *
+ * @note 启动后不能停止, 之后所有可能长时间运行的循环都要调用`fault_rec_kick()`
+ */
+void fault_rec_wdg_start(void) {
+#if FAULT_REC_IWDG_ENABLE && FAULT_REC_TARGET
+    if (fault_rec_iwdg.Instance != NULL) {
+        HAL_IWDG_Refresh(&fault_rec_iwdg);
+        return;
+    }
+    __HAL_DBGMCU_FREEZE_IWDG(); /* 调试暂停内核时看门狗也暂停 */
+    fault_rec_iwdg.Instance = IWDG;
+    /* LSI 32kHz, 64分频后2ms一个计数 */
+    fault_rec_iwdg.Init.Prescaler = IWDG_PRESCALER_64;
+    fault_rec_iwdg.Init.Reload = FAULT_REC_IWDG_MS / 2U;
+    HAL_IWDG_Init(&fault_rec_iwdg);
+#endif /* FAULT_REC_IWDG_ENABLE && FAULT_REC_TARGET */
+}
+
+/**
+ * @brief 喂独立看门狗, 没有启动时不起作用
+ *
+ */
+void fault_rec_kick(void) {
+#if FAULT_REC_TARGET
+#if FAULT_REC_IWDG_ENABLE
+    if (fault_rec_iwdg.Instance != NULL) {
+        HAL_IWDG_Refresh(&fault_rec_iwdg);
+    }
+#endif /* FAULT_REC_IWDG_ENABLE */
+#else
+    fault_rec_host_kicks++;
+#endif /* FAULT_REC_TARGET */
+}
+
+/**
+ * @brief 栈指针是否指向RAM, 栈溢出时不能读取压栈的寄存器
+ *
+ * @param sp 栈指针
+ * @return true-可以读取32字节; false-无效
+ */
+static bool fault_rec_sp_valid(const uint32_t* sp) {
+    uint32_t addr = (uint32_t)(uintptr_t)sp;
+    if (sp == NULL || (addr & 3U) != 0) {
+        return false;
+    }
+    /* SRAM1/2/3共192KB, CCM 64KB */
+    return (addr >= 0x20000000U && addr <= 0x20030000U - 32U) ||
+           (addr >= 0x10000000U && addr <= 0x10010000U - 32U);
+}
+
+/**
+ * @brief 保存异常现场并复位, 由异常处理函数跳转过来
+ *
+ * @param sp 异常前的栈指针, 指向压栈的r0
+ * @param exc_return 进入异常时的lr
+ * @param type 异常类型
+ * @note 不返回. 在主机上编译时只保存现场
+ */
+void fault_rec_fault(const uint32_t* sp, uint32_t exc_return, uint32_t type) {
+    fault_rec_fault_t* f = &fault_rec->fault;
+    memset(f, 0, sizeof(*f));
+    if (fault_rec_sp_valid(sp)) {
+        memcpy(f->frame, sp, sizeof(f->frame));
+    }
+    f->sp = (uint32_t)(uintptr_t)sp;
+    f->exc_return = exc_return;
+    f->t_us = time_us();
+#if FAULT_REC_TARGET
+    f->cfsr = SCB->CFSR;
+    f->hfsr = SCB->HFSR;
+    f->mmfar = SCB->MMFAR;
+    f->bfar = SCB->BFAR;
+#endif /* FAULT_REC_TARGET */
+    f->type = type; /* 最后写入, 作为现场有效的标志 */
+#if FAULT_REC_TARGET
+    __DSB();
+    NVIC_SystemReset();
+    while (1) {
+    }
+#endif /* FAULT_REC_TARGET */
+}
+
+/**
+ * @brief 备份SRAM中的全部内容, 用于调试
+ *
+ * @return const fault_rec_t* 内容
+ */
+const fault_rec_t* fault_rec_data(void) {
+    return fault_rec;
+}
@@ -0,0 +1,505 @@
+/**
+ * @file    flash_store.c
+ * @author  Deadline--
+ * @brief   片内flash记录存储, 双扇区轮换
+ * @version 0.1
+ * @date    2023-12-23
+ * @note    槽的布局: [标记][序号][长度][CRC][数据...], 先写数据和序号、长度、
+ *          CRC, 最后写标记. CRC覆盖序号、长度和数据.
+ *          同一个扇区内序号随槽号递增, 从后往前找到的第一条有效记录
+ *          就是这个扇区最新的记录, 启动时只需要校验很少的几条记录.
+ *          写入前检查整个槽是否为擦除状态, 中途掉电留下的半条记录会被跳过.
+ */
+
+#include "flash_store.h"
+
+#include <string.h>
+
+#include "crc32.h"
+
+/* 擦除状态的字 */
+#define FLASH_STORE_ERASED 0xFFFFFFFFU
+
+/**
+ * @brief 记录头
+ *
+ */
+typedef struct {
+    uint32_t magic; /*!< `FLASH_STORE_MAGIC`, 最后写入 */
+    uint32_t seq;   /*!< 序号, 每次保存加1 */
+    uint32_t len;   /*!< 数据长度(字节) */
+    uint32_t crc;   /*!< 序号、长度和数据的CRC-32 */
+} flash_store_hdr_t;
+
+/**
+ * @brief 扫描得到的存储状态
+ *
+ */
+static struct {
+    bool scanned;      /* 是否已经扫描 */
+    bool valid;        /* 是否有有效记录 */
+    uint32_t seq;      /* 最新记录的序号 */
+    uint32_t sector;   /* 最新记录所在扇区 */
+    uint32_t slot;     /* 最新记录所在的槽 */
+    uint32_t wsector;  /* 下一次写入的扇区 */
+    uint32_t next;     /* 下一次写入从这个槽开始找空槽 */
+    uint32_t erases;   /* 擦除次数 */
+} flash_store;
+
+/**
+ * @defgroup 底层读写
+ * @{
+ */
+
+#if FLASH_STORE_TARGET
+/**
+ * @brief 扇区的起始地址
+ *
+ * @param sector 0或1
+ * @return const uint8_t* 起始地址
+ */
+static const uint8_t* flash_store_base(uint32_t sector) {
+    return (const uint8_t*)(sector == 0 ? FLASH_STORE_ADDR_0
+                                        : FLASH_STORE_ADDR_1);
+}
+
+/**
+ * @brief 解锁flash, 清除上一次操作的错误标志
+ *
+ */
+static void flash_store_unlock(void) {
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR |
+                           FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR |
+                           FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+}
+
+/**
+ * @brief 锁定flash
+ *
+ */
+static void flash_store_lock(void) {
+    HAL_FLASH_Lock();
+}
+
+/**
+ * @brief 擦除扇区之前调用, 可以在这里喂看门狗
+ *
+ * @note 擦除期间CPU停顿, 中断也不能执行
+ */
+__weak void flash_store_erase_callback(void) {
+}
+
+/**
+ * @brief 擦除一个扇区
+ *
+ * @param sector 0或1
+ * @return true-成功; false-失败
+ * @note 耗时1 ~ 2s, 期间从flash取指令会停顿
+ */
+static bool flash_store_erase_sector(uint32_t sector) {
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error = 0;
+    flash_store_erase_callback();
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Banks = FLASH_BANK_1;
+    erase.Sector = sector == 0 ? FLASH_STORE_SECTOR_0 : FLASH_STORE_SECTOR_1;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3; /* 2.7 ~ 3.6V, 按32位擦除 */
+    return HAL_FLASHEx_Erase(&erase, &error) == HAL_OK &&
+           error == 0xFFFFFFFFU;
+}
+
+/**
+ * @brief 编程一个字
+ *
+ * @param addr 地址, 4字节对齐, 必须是擦除状态
+ * @param word 数据
+ * @return true-成功; false-失败
+ */
+static bool flash_store_program(const uint8_t* addr, uint32_t word) {
+    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)addr, word) !=
+        HAL_OK) {
+        return false;
+    }
+    return *(const volatile uint32_t*)addr == word;
+}
+#else
+/* 模拟的两个扇区, 按字对齐 */
+static uint32_t flash_store_ram[2][FLASH_STORE_SECTOR_SIZE / 4U];
+static bool flash_store_ram_ready = false;
+/* 模拟掉电: 大于0时每编程一个字减1, 减到0之后编程全部失败 */
+static uint32_t flash_store_cut_words = 0;
+static bool flash_store_cut_armed = false;
+
+/**
+ * @brief 扇区的起始地址
+ *
+ * @param sector 0或1
+ * @return const uint8_t* 起始地址
+ */
+static const uint8_t* flash_store_base(uint32_t sector) {
+    if (flash_store_ram_ready == false) {
+        memset(flash_store_ram, 0xFF, sizeof(flash_store_ram));
+        flash_store_ram_ready = true;
+    }
+    return (const uint8_t*)flash_store_ram[sector];
+}
+
+static void flash_store_unlock(void) {
+}
+
+static void flash_store_lock(void) {
+}
+
+/**
+ * @brief 擦除一个扇区
+ *
+ * @param sector 0或1
+ * @return true-成功; false-模拟掉电
+ */
+static bool flash_store_erase_sector(uint32_t sector) {
+    if (flash_store_cut_armed && flash_store_cut_words == 0) {
+        return false;
+    }
+    memset(flash_store_ram[sector], 0xFF, sizeof(flash_store_ram[sector]));
+    return true;
+}
+
+/**
+ * @brief 编程一个字, 与NOR flash一样只能把1写成0
+ *
+ * @param addr 地址, 4字节对齐
+ * @param word 数据
+ * @return true-成功; false-位不能从0写成1, 或模拟掉电
+ */
+static bool flash_store_program(const uint8_t* addr, uint32_t word) {
+    uint32_t* p = (uint32_t*)(uintptr_t)addr;
+    if (flash_store_cut_armed) {
+        if (flash_store_cut_words == 0) {
+            return false;
+        }
+        flash_store_cut_words--;
+    }
+    *p &= word;
+    return *p == word;
+}
+
+/**
+ * @brief 把模拟的flash恢复成全部擦除, 清除掉电模拟和扫描结果
+ *
+ */
+void flash_store_host_reset(void) {
+    memset(flash_store_ram, 0xFF, sizeof(flash_store_ram));
+    flash_store_ram_ready = true;
+    flash_store_cut_armed = false;
+    memset(&flash_store, 0, sizeof(flash_store));
+}
+
+/**
+ * @brief 模拟掉电, 再编程words个字之后编程和擦除全部失败
+ *
+ * @param words 还能编程的字数, `UINT32_MAX`取消模拟
+ * @note 调用后下一次读写重新扫描两个扇区, 与重新上电相同.
+ *       `flash_store_host_cut(UINT32_MAX)`模拟恢复供电
+ */
+void flash_store_host_cut(uint32_t words) {
+    flash_store_cut_armed = words != UINT32_MAX;
+    flash_store_cut_words = words;
+    flash_store.scanned = false;
+}
+#endif /* FLASH_STORE_TARGET */
+
+/**
+ * @}
+ */
+
+/**
+ * @brief 槽的起始地址
+ *
+ * @param sector 0或1
+ * @param slot 槽号
+ * @return const uint8_t* 起始地址
+ */
+static const uint8_t* flash_store_slot(uint32_t sector, uint32_t slot) {
+    return flash_store_base(sector) + slot * FLASH_STORE_SLOT_SIZE;
+}
+
+/**
+ * @brief 检查一个区域是否全部为擦除状态
+ *
+ * @param addr 起始地址, 4字节对齐
+ * @param len 长度(字节), 4的倍数
+ * @return true-全部擦除; false-有数据
+ */
+static bool flash_store_blank(const uint8_t* addr, uint32_t len) {
+    const uint32_t* p = (const uint32_t*)addr;
+    for (uint32_t i = 0; i < len / 4U; i++) {
+        if (p[i] != FLASH_STORE_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 计算记录的CRC
+ *
+ * @param seq 序号
+ * @param len 数据长度
+ * @param data 数据
+ * @return uint32_t CRC-32
+ */
+static uint32_t flash_store_crc(uint32_t seq, uint32_t len, const void* data) {
+    uint32_t head[2] = {seq, len};
+    uint32_t crc = crc32_update(CRC32_INIT, head, sizeof(head));
+    return crc32_update(crc, data, len);
+}
+
+/**
+ * @brief 槽中是否是一条完整有效的记录
+ *
+ * @param sector 0或1
+ * @param slot 槽号
+ * @return true-有效; false-空槽、未写完或CRC错误
+ */
+static bool flash_store_slot_valid(uint32_t sector, uint32_t slot) {
+    const uint8_t* addr = flash_store_slot(sector, slot);
+    const flash_store_hdr_t* hdr = (const flash_store_hdr_t*)addr;
+    if (hdr->magic != FLASH_STORE_MAGIC || hdr->len > FLASH_STORE_MAX_LEN) {
+        return false;
+    }
+    return hdr->crc ==
+           flash_store_crc(hdr->seq, hdr->len, addr + FLASH_STORE_HDR_SIZE);
+}
+
+/**
+ * @brief 扫描两个扇区, 找到最新的有效记录
+ *
+ * @note 每个扇区从后往前找, 只校验标记正确的槽
+ */
+static void flash_store_scan(void) {
+    uint32_t erases = flash_store.erases;
+    memset(&flash_store, 0, sizeof(flash_store));
+    flash_store.erases = erases;
+    for (uint32_t sector = 0; sector < 2; sector++) {
+        for (uint32_t slot = FLASH_STORE_SLOT_NUM; slot-- > 0;) {
+            if (flash_store_slot_valid(sector, slot) == false) {
+                continue;
+            }
+            const flash_store_hdr_t* hdr =
+                (const flash_store_hdr_t*)flash_store_slot(sector, slot);
+            if (flash_store.valid == false || hdr->seq > flash_store.seq) {
+                flash_store.valid = true;
+                flash_store.seq = hdr->seq;
+                flash_store.sector = sector;
+                flash_store.slot = slot;
+                flash_store.wsector = sector;
+                flash_store.next = slot + 1U;
+            }
+            break;
+        }
+    }
+    flash_store.scanned = true;
+}
+
+/**
+ * @brief 读取最新的记录
+ *
+ * @param[out] data 数据
+ * @param size data的大小(字节)
+ * @param[out] len 记录的数据长度, 可以为`NULL`
+ * @return flash_store_status_t `FLASH_STORE_OK`或`FLASH_STORE_EMPTY`,
+ *         记录比缓冲区长时为`FLASH_STORE_ERR_LEN`, 不修改data
+ * @note 第一次调用时扫描两个扇区, 之后直接读取
+ */
+flash_store_status_t flash_store_load(void* data, uint32_t size, uint32_t* len) {
+    if (flash_store.scanned == false) {
+        flash_store_scan();
+    }
+    if (flash_store.valid == false) {
+        return FLASH_STORE_EMPTY;
+    }
+    const uint8_t* addr = flash_store_slot(flash_store.sector, flash_store.slot);
+    const flash_store_hdr_t* hdr = (const flash_store_hdr_t*)addr;
+    if (len != NULL) {
+        *len = hdr->len;
+    }
+    if (hdr->len > size) {
+        return FLASH_STORE_ERR_LEN;
+    }
+    memcpy(data, addr + FLASH_STORE_HDR_SIZE, hdr->len);
+    return FLASH_STORE_OK;
+}
+
+/**
+ * @brief 在指定的槽写入一条记录
+ *
+ * @param sector 0或1
+ * @param slot 槽号, 必须是擦除状态
+ * @param seq 序号
+ * @param data 数据
+ * @param len 长度(字节)
+ * @return flash_store_status_t 结果
+ */
+static flash_store_status_t flash_store_write(uint32_t sector,
+                                              uint32_t slot,
+                                              uint32_t seq,
+                                              const void* data,
+                                              uint32_t len) {
+    const uint8_t* addr = flash_store_slot(sector, slot);
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t word;
+
+    /* 数据按字写入, 最后不足一个字的部分补0xFF */
+    for (uint32_t i = 0; i < len; i += 4U) {
+        word = FLASH_STORE_ERASED;
+        memcpy(&word, src + i, (len - i) < 4U ? (len - i) : 4U);
+        if (flash_store_program(addr + FLASH_STORE_HDR_SIZE + i, word) ==
+            false) {
+            return FLASH_STORE_ERR_PROGRAM;
+        }
+    }
+    if (flash_store_program(addr + 4U, seq) == false ||
+        flash_store_program(addr + 8U, len) == false ||
+        flash_store_program(addr + 12U, flash_store_crc(seq, len, data)) ==
+            false ||
+        flash_store_program(addr, FLASH_STORE_MAGIC) == false) {
+        return FLASH_STORE_ERR_PROGRAM;
+    }
+    if (flash_store_slot_valid(sector, slot) == false) {
+        return FLASH_STORE_ERR_VERIFY;
+    }
+    return FLASH_STORE_OK;
+}
+
+/**
+ * @brief 保存一条记录
+ *
+ * @param data 数据
+ * @param len 长度(字节), 不超过`FLASH_STORE_MAX_LEN`
+ * @return flash_store_status_t 结果, 失败时上一条记录仍然有效
+ * @note 当前扇区写满时擦除另一个扇区, 阻塞1 ~ 2s.
+ *       写入失败的槽下一次保存时跳过
+ */
+flash_store_status_t flash_store_save(const void* data, uint32_t len) {
+    if (len > FLASH_STORE_MAX_LEN) {
+        return FLASH_STORE_ERR_LEN;
+    }
+    if (flash_store.scanned == false) {
+        flash_store_scan();
+    }
+
+    uint32_t sector = flash_store.wsector;
+    uint32_t slot = flash_store.next;
+    while (slot < FLASH_STORE_SLOT_NUM &&
+           flash_store_blank(flash_store_slot(sector, slot),
+                             FLASH_STORE_SLOT_SIZE) == false) {
+        slot++;
+    }
+
+    flash_store_status_t status = FLASH_STORE_OK;
+    flash_store_unlock();
+    if (slot >= FLASH_STORE_SLOT_NUM) {
+        /* 当前扇区已满, 换到另一个扇区, 旧扇区保留到下一次轮换 */
+        sector ^= 1U;
+        slot = 0;
+        if (flash_store_blank(flash_store_base(sector),
+                              FLASH_STORE_SECTOR_SIZE) == false) {
+            flash_store.erases++;
+            if (flash_store_erase_sector(sector) == false) {
+                status = FLASH_STORE_ERR_ERASE;
+            }
+        }
+    }
+    uint32_t seq = flash_store.valid ? flash_store.seq + 1U : 1U;
+    if (status == FLASH_STORE_OK) {
+        status = flash_store_write(sector, slot, seq, data, len);
+    }
+    flash_store_lock();
+
+    if (status == FLASH_STORE_ERR_ERASE) {
+        return status;
+    }
+    /* 写入失败时最新记录不变, 下一次从后面的槽开始写 */
+    flash_store.wsector = sector;
+    flash_store.next = slot + 1U;
+    if (status == FLASH_STORE_OK) {
+        flash_store.valid = true;
+        flash_store.seq = seq;
+        flash_store.sector = sector;
+        flash_store.slot = slot;
+    }
+    return status;
+}
+
+/**
+ * @brief 擦除两个扇区, 删除所有记录
+ *
+ * @return flash_store_status_t 结果
+ * @note 阻塞2 ~ 4s
+ */
+flash_store_status_t flash_store_erase(void) {
+    flash_store_status_t status = FLASH_STORE_OK;
+    flash_store_unlock();
+    for (uint32_t sector = 0; sector < 2; sector++) {
+        if (flash_store_blank(flash_store_base(sector),
+                              FLASH_STORE_SECTOR_SIZE)) {
+            continue;
+        }
+        flash_store.erases++;
+        if (flash_store_erase_sector(sector) == false) {
+            status = FLASH_STORE_ERR_ERASE;
+        }
+    }
+    flash_store_lock();
+    flash_store.scanned = false;
+    return status;
+}
+
+/**
+ * @brief 读取存储状态
+ *
+ * @param[out] info 状态
+ */
+void flash_store_info(flash_store_info_t* info) {
+    if (flash_store.scanned == false) {
+        flash_store_scan();
+    }
+    memset(info, 0, sizeof(*info));
+    info->valid = flash_store.valid;
+    info->erases = flash_store.erases;
+    if (flash_store.valid) {
+        const flash_store_hdr_t* hdr = (const flash_store_hdr_t*)
+            flash_store_slot(flash_store.sector, flash_store.slot);
+        info->seq = flash_store.seq;
+        info->len = hdr->len;
+        info->sector = flash_store.sector;
+        info->slot = flash_store.slot;
+    }
+}
+
+/**
+ * @brief 操作结果的说明文字
+ *
+ * @param status 结果
+ * @return const char* 说明
+ */
+const char* flash_store_status_str(flash_store_status_t status) {
+    switch (status) {
+        case FLASH_STORE_OK:
+            return "ok";
+        case FLASH_STORE_EMPTY:
+            return "empty";
+        case FLASH_STORE_ERR_LEN:
+            return "length";
+        case FLASH_STORE_ERR_ERASE:
+            return "erase failed";
+        case FLASH_STORE_ERR_PROGRAM:
+            return "program failed";
+        case FLASH_STORE_ERR_VERIFY:
+            return "verify failed";
+        default:
+            return "unknown";
+    }
+}
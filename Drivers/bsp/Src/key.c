@@ -2,17 +2,58 @@
  * @file    key.c
  * @author  Deadline--
  * @brief   按键检测及初始化
- * @version 0.1
- * @date    2023-10-20
+ * @version 0.2
+ * @date    2023-12-15
  */
 
 #include "key.h"
 #include "delay.h"
 
+#if KEY_EXTI_ENABLE
+#define KEY_NUM 4U /* 按键数量, 下标 = 按键值 - 1 */
+
+/**
+ * @brief 按键引脚, 此结构体仅限本文件使用
+ *
+ */
+typedef struct {
+    GPIO_TypeDef* port; /*!< 端口 */
+    uint16_t pin;       /*!< 引脚 */
+    uint8_t active;     /*!< 按下时的电平 */
+    IRQn_Type irq;      /*!< EXTI中断 */
+} KEY_Pin_t;
+
+/* 与KEY0_PRES ~ WKUP_PRES顺序一致 */
+static const KEY_Pin_t KEY_Pins[KEY_NUM] = {
+    {GPIOH, GPIO_PIN_3, 0, EXTI3_IRQn},      /* KEY0 */
+    {GPIOH, GPIO_PIN_2, 0, EXTI2_IRQn},      /* KEY1 */
+    {GPIOC, GPIO_PIN_13, 0, EXTI15_10_IRQn}, /* KEY2 */
+    {GPIOA, GPIO_PIN_0, 1, EXTI0_IRQn},      /* WK_UP */
+};
+
+static uint8_t key_level[KEY_NUM];             /* 消抖后的状态, 1按下 */
+static volatile uint8_t key_debounce[KEY_NUM]; /* 消抖剩余节拍数 */
+static volatile uint32_t key_busy = 0;         /* 正在消抖的按键, 按位表示 */
+static KEY_Event_t key_event_buf[KEY_EVENT_QUEUE_LEN];
+static spsc_ring_t key_event_queue; /* SysTick写入, 主循环或任务读取 */
+uint32_t key_event_lost = 0;        /* 队列满丢失的事件数 */
+
+/**
+ * @brief 读取按键是否按下
+ *
+ * @param key 按键引脚
+ * @return uint8_t 1-按下; 0-松开
+ */
+static inline uint8_t KEY_Pressed(const KEY_Pin_t* key) {
+    return HAL_GPIO_ReadPin(key->port, key->pin) == key->active;
+}
+#endif /* KEY_EXTI_ENABLE */
+
 /**
  * @brief 初始化按键
  * @note
  * KEY0->PH3, KEY1->PH2, KEY2->PC13, WKUP->PA0
+ * 启用EXTI时双边沿触发中断, 急停按键使用最高优先级
  */
 void KEY_Init(void) {
     GPIO_InitTypeDef GPIO_Initure;
@@ -21,20 +62,39 @@ void KEY_Init(void) {
     __HAL_RCC_GPIOC_CLK_ENABLE(); /* 开启GPIOC时钟 */
     __HAL_RCC_GPIOH_CLK_ENABLE(); /* 开启GPIOH时钟 */
 
+#if KEY_EXTI_ENABLE
+    uint32_t mode = GPIO_MODE_IT_RISING_FALLING; /* 双边沿中断 */
+#else
+    uint32_t mode = GPIO_MODE_INPUT; /* 输入 */
+#endif /* KEY_EXTI_ENABLE */
+
     GPIO_Initure.Pin = GPIO_PIN_0;        /* PA0 */
-    GPIO_Initure.Mode = GPIO_MODE_INPUT;  /* 输入 */
+    GPIO_Initure.Mode = mode;
     GPIO_Initure.Pull = GPIO_PULLDOWN;    /* 下拉 */
     GPIO_Initure.Speed = GPIO_SPEED_HIGH; /* 高速 */
     HAL_GPIO_Init(GPIOA, &GPIO_Initure);
 
     GPIO_Initure.Pin = GPIO_PIN_13;       /* PC13 */
-    GPIO_Initure.Mode = GPIO_MODE_INPUT;  /* 输入 */
+    GPIO_Initure.Mode = mode;
     GPIO_Initure.Pull = GPIO_PULLUP;      /* 上拉 */
     GPIO_Initure.Speed = GPIO_SPEED_HIGH; /* 高速 */
     HAL_GPIO_Init(GPIOC, &GPIO_Initure);
 
     GPIO_Initure.Pin = GPIO_PIN_2 | GPIO_PIN_3; /* PH2,3 */
     HAL_GPIO_Init(GPIOH, &GPIO_Initure);
+
+#if KEY_EXTI_ENABLE
+    spsc_ring_init(&key_event_queue, key_event_buf, sizeof(KEY_Event_t),
+                   KEY_EVENT_QUEUE_LEN);
+    for (uint32_t i = 0; i < KEY_NUM; i++) {
+        key_level[i] = KEY_Pressed(&KEY_Pins[i]);
+        __HAL_GPIO_EXTI_CLEAR_IT(KEY_Pins[i].pin);
+        /* 急停按键抢占CAN和串口中断 */
+        uint32_t priority = (i + 1 == KEY_ESTOP) ? 0 : KEY_EXTI_PRIORITY;
+        HAL_NVIC_SetPriority(KEY_Pins[i].irq, priority, 0);
+        HAL_NVIC_EnableIRQ(KEY_Pins[i].irq);
+    }
+#endif /* KEY_EXTI_ENABLE */
 }
 /**
  * @brief 按键扫描
@@ -67,3 +127,128 @@ uint8_t KEY_Scan(uint8_t mode) {
     }
     return 0; /* 无按键按下 */
 }
+
+/**
+ * @brief 读取一次按下, 不会阻塞
+ *
+ * @return uint8_t 按下的按键KEY0_PRES ~ WKUP_PRES; 没有按下返回0
+ * @note 启用EXTI时从事件队列中取出, 跳过松开事件; 否则调用KEY_Scan(0)
+ */
+uint8_t KEY_Get_Press(void) {
+#if KEY_EXTI_ENABLE
+    KEY_Event_t event;
+    while (KEY_Get_Event(&event)) {
+        if (event.pressed) {
+            return event.key;
+        }
+    }
+    return 0;
+#else
+    return KEY_Scan(0);
+#endif /* KEY_EXTI_ENABLE */
+}
+
+#if KEY_EXTI_ENABLE
+/**
+ * @brief 读取一个按键事件, 只能在一个线程或任务中调用
+ *
+ * @param[out] event 事件
+ * @return true-读到事件; false-没有事件
+ */
+bool KEY_Get_Event(KEY_Event_t* event) {
+    return spsc_ring_pop(&key_event_queue, event);
+}
+
+/**
+ * @brief 消抖, 在SysTick中断中每个节拍调用一次
+ *
+ * @note 没有按键在消抖时只判断一次
+ */
+void KEY_Tick(void) {
+    if (key_busy == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < KEY_NUM; i++) {
+        if ((key_busy & (1U << i)) == 0) {
+            continue;
+        }
+        /* EXTI中断会重新计时, 与它互斥 */
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        bool stable = (--key_debounce[i] == 0);
+        if (stable) {
+            key_busy &= ~(1U << i);
+        }
+        __set_PRIMASK(primask);
+        if (stable == false) {
+            continue;
+        }
+        uint8_t pressed = KEY_Pressed(&KEY_Pins[i]);
+        if (pressed == key_level[i]) {
+            continue; /* 抖动后回到原状态 */
+        }
+        key_level[i] = pressed;
+        KEY_Event_t event = {(uint8_t)(i + 1), pressed, HAL_GetTick()};
+        if (spsc_ring_push(&key_event_queue, &event) == false) {
+            key_event_lost++;
+        }
+    }
+}
+
+/**
+ * @brief 急停按键按下, 在急停按键的EXTI中断中调用
+ *
+ * @param start_cycles 进入中断时的DWT周期计数, 用于测量急停延迟
+ * @note 第一个按下边沿就回调, 抖动会回调多次, 实现时要保证重复调用没有影响
+ */
+__weak void KEY_Estop_Callback(uint32_t start_cycles) {
+    UNUSED(start_cycles);
+}
+
+/**
+ * @brief 按键EXTI中断处理, 每个边沿重新开始消抖
+ *
+ * @param index 按键下标
+ */
+static inline void KEY_EXTI_IRQ(uint32_t index) {
+    uint32_t start = time_cycles();
+    const KEY_Pin_t* key = &KEY_Pins[index];
+    __HAL_GPIO_EXTI_CLEAR_IT(key->pin);
+    if (index + 1 == KEY_ESTOP && KEY_Pressed(key)) {
+        KEY_Estop_Callback(start);
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    key_debounce[index] = KEY_DEBOUNCE_MS;
+    key_busy |= 1U << index;
+    __set_PRIMASK(primask);
+}
+/**
+ * @brief EXTI0中断服务函数, WK_UP
+ *
+ */
+void EXTI0_IRQHandler(void) {
+    KEY_EXTI_IRQ(WKUP_PRES - 1);
+}
+/**
+ * @brief EXTI2中断服务函数, KEY1
+ *
+ */
+void EXTI2_IRQHandler(void) {
+    KEY_EXTI_IRQ(KEY1_PRES - 1);
+}
+/**
+ * @brief EXTI3中断服务函数, KEY0
+ *
+ */
+void EXTI3_IRQHandler(void) {
+    KEY_EXTI_IRQ(KEY0_PRES - 1);
+}
+/**
+ * @brief EXTI15_10中断服务函数, KEY2
+ *
+ */
+void EXTI15_10_IRQHandler(void) {
+    KEY_EXTI_IRQ(KEY2_PRES - 1);
+}
+#endif /* KEY_EXTI_ENABLE */
@@ -8,6 +8,11 @@
 
 #include "led.h"
 
+#include "timebase.h"
+
+static bool led1_blink_on = false; /* LED1是否处于闪烁翻转后的状态 */
+static uint32_t led1_blink_end;    /* 翻转回来的时刻 */
+
 /**
  * @brief LED初始化
  *
@@ -31,3 +36,27 @@ void LED_Init(void) {
     HAL_GPIO_WritePin(GPIOB, GPIO_PIN_1,
                       GPIO_PIN_SET); /* PB1置1, 默认初始化后灯灭 */
 }
+
+/**
+ * @brief 翻转LED1并在`LED1_BLINK_MS`后翻转回来, 不阻塞
+ *
+ * @note 闪烁期间再次调用只延长闪烁时间
+ */
+void LED1_Blink(void) {
+    if (led1_blink_on == false) {
+        LED1_TOGGLE();
+        led1_blink_on = true;
+    }
+    led1_blink_end = time_deadline_us(LED1_BLINK_MS * 1000U);
+}
+
+/**
+ * @brief 闪烁时间到后把LED1翻转回来, 在主循环中调用
+ *
+ */
+void LED1_Blink_Poll(void) {
+    if (led1_blink_on && time_expired_us(led1_blink_end)) {
+        LED1_TOGGLE();
+        led1_blink_on = false;
+    }
+}
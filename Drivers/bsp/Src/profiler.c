@@ -0,0 +1,113 @@
+/**
+ * @file    profiler.c
+ * @author  Deadline--
+ * @brief   基于DWT的代码段耗时统计
+ * @version 0.3
+ * @date    2023-12-19
+ * @note    报告每行以`#prof`开头, 上位机脚本解析电机数据时可以跳过:
+ *          #prof load <CPU负载%> sleep <睡眠%> <周期内时钟周期数>
+ *          #prof <段名> <次数> <平均周期> <最大周期> <最大嵌套> <占比%>
+ */
+
+#include "profiler.h"
+
+#include "delay.h"
+#include "string.h"
+#include "usart.h"
+
+#if SYS_SUPPORT_OS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif /* SYS_SUPPORT_OS */
+
+#if PROF_ENABLE
+
+Prof_Stats_t prof_stats[PROF_REGION_NUM];
+Prof_Frame_t prof_stack[PROF_STACK_DEPTH];
+volatile uint32_t prof_depth = 0;
+
+static uint32_t prof_report_us = 0;  /* 上次报告的时间(us) */
+static uint64_t prof_sleep_last = 0; /* 上次报告时的累计睡眠时间 */
+#if SYS_SUPPORT_OS && configGENERATE_RUN_TIME_STATS
+static uint32_t prof_idle_last = 0; /* 上次报告时空闲任务的运行时间 */
+#endif
+
+/* 段名, 与Prof_Region_t顺序一致 */
+static const char* const prof_names[PROF_REGION_NUM] = {
+    "main", "idle", "systick", "usart1", "can1_rx", "can2_rx", "can1_tx",
+    "can2_tx", "fault_rec",
+};
+
+/**
+ * @brief 开始第一个统计周期, 在time_init之后调用
+ *
+ */
+void Prof_Init(void) {
+    memset(prof_stats, 0, sizeof(prof_stats));
+    prof_depth = 0;
+    prof_report_us = time_us();
+    prof_sleep_last = delay_get_sleep_cycles();
+}
+
+/**
+ * @brief 到达报告周期时输出统计并清零, 在主循环或遥测任务中调用
+ *
+ * @note 睡眠时DWT停止计数, 统计周期用睡眠时也计数的time_us()测量,
+ *       再换算成时钟周期.
+ *       空闲时间 = 空闲段(或空闲任务)的清醒时间 + 睡眠时间.
+ *       报告周期必须小于CYCCNT溢出时间(180MHz下约23.8s)
+ */
+void Prof_Report_Poll(void) {
+    Prof_Stats_t snap[PROF_REGION_NUM];
+    uint32_t window, idle, sleep;
+
+    uint32_t now = time_us();
+    uint32_t elapsed = now - prof_report_us;
+    if (elapsed < PROF_REPORT_PERIOD_MS * 1000U) {
+        return;
+    }
+    window = time_us_to_cycles(elapsed);
+    prof_report_us = now;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t sleep_now = delay_get_sleep_cycles();
+    sleep = (uint32_t)(sleep_now - prof_sleep_last);
+    prof_sleep_last = sleep_now;
+    memcpy(snap, prof_stats, sizeof(snap));
+    memset(prof_stats, 0, sizeof(prof_stats));
+#if SYS_SUPPORT_OS && configGENERATE_RUN_TIME_STATS
+    uint32_t idle_now = (uint32_t)ulTaskGetIdleRunTimeCounter();
+    idle = idle_now - prof_idle_last;
+    prof_idle_last = idle_now;
+#else
+    idle = (uint32_t)snap[PROF_IDLE].cycles_total;
+#endif
+    __set_PRIMASK(primask);
+
+    idle += sleep;
+    uint32_t load = 0;
+    if (idle < window) {
+        load = 1000U - (uint32_t)((uint64_t)idle * 1000U / window);
+    }
+    uint32_t sleep_permille = (uint32_t)((uint64_t)sleep * 1000U / window);
+    printf("#prof load %lu.%lu%% sleep %lu.%lu%% %lu\r\n",
+           (unsigned long)(load / 10), (unsigned long)(load % 10),
+           (unsigned long)(sleep_permille / 10),
+           (unsigned long)(sleep_permille % 10), (unsigned long)window);
+    for (uint32_t i = 0; i < PROF_REGION_NUM; i++) {
+        if (snap[i].count == 0) {
+            continue;
+        }
+        uint32_t share =
+            (uint32_t)(snap[i].cycles_total * 1000U / window);
+        printf("#prof %s %lu %lu %lu %lu %lu.%lu%%\r\n", prof_names[i],
+               (unsigned long)snap[i].count,
+               (unsigned long)(snap[i].cycles_total / snap[i].count),
+               (unsigned long)snap[i].cycles_max,
+               (unsigned long)snap[i].nest_max, (unsigned long)(share / 10),
+               (unsigned long)(share % 10));
+    }
+}
+
+#endif /* PROF_ENABLE */
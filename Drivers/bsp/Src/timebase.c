@@ -0,0 +1,126 @@
+/**
+ * @file    timebase.c
+ * @author  Deadline--
+ * @brief   全局微秒时间基准
+ * @version 0.1
+ * @date    2023-12-19
+ * @note    TIM2是APB1上的32位定时器, 分频到1MHz后自由运行,
+ *          只有溢出时进一次中断, 给64位时间的高32位加1.
+ */
+
+#if !(defined(__ARMCC_VERSION) || defined(__arm__))
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#endif
+
+#include "timebase.h"
+
+#if TIME_TARGET
+static volatile uint32_t time_us_high = 0; /* 64位时间的高32位 */
+
+/**
+ * @brief 初始化时间基准, 同时使能DWT周期计数器, 在时钟配置之后调用
+ *
+ * @note 定时器时钟是APB1时钟, APB1分频系数不为1时是PCLK1的2倍
+ */
+void time_init(void) {
+    DWT_Init();
+
+    uint32_t tim_clk = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clk *= 2U;
+    }
+
+    TIME_TIM_CLK_ENABLE();
+    TIME_TIM->CR1 = 0;
+    TIME_TIM->PSC = tim_clk / 1000000U - 1U;
+    TIME_TIM->ARR = 0xFFFFFFFFU;
+    TIME_TIM->CNT = 0;
+    TIME_TIM->EGR = TIM_EGR_UG; /* 装载预分频值 */
+    TIME_TIM->SR = 0;
+    TIME_TIM->DIER = TIM_DIER_UIE;
+    time_us_high = 0;
+
+    HAL_NVIC_SetPriority(TIME_TIM_IRQn, 0, 0); /* 只有溢出时进入, 耗时极短 */
+    HAL_NVIC_EnableIRQ(TIME_TIM_IRQn);
+    TIME_TIM->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief 64位当前时间
+ *
+ * @return uint64_t 微秒
+ * @note 关中断期间发生的溢出还没有计入高32位, 根据溢出标志补上
+ */
+uint64_t time_us64(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t high = time_us_high;
+    uint32_t low = TIME_TIM->CNT;
+    if (TIME_TIM->SR & TIM_SR_UIF) {
+        low = TIME_TIM->CNT; /* 溢出标志置位后再读一次, 保证是溢出之后的值 */
+        high++;
+    }
+    __set_PRIMASK(primask);
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * @brief 定时器溢出中断服务函数
+ */
+void TIME_TIM_IRQHandler(void) {
+    if (TIME_TIM->SR & TIM_SR_UIF) {
+        TIME_TIM->SR = ~(uint32_t)TIM_SR_UIF; /* 写0清除, 写1无影响 */
+        time_us_high++;
+    }
+}
+#else
+#include <time.h>
+
+static uint64_t time_host_base_ns = 0; /* time_init()时的单调时钟 */
+
+/**
+ * @brief 读取主机单调时钟
+ *
+ * @return uint64_t 纳秒
+ */
+static uint64_t time_host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 初始化时间基准, 从0开始计时
+ */
+void time_init(void) {
+    time_host_base_ns = time_host_ns();
+}
+
+/**
+ * @brief 64位当前时间
+ *
+ * @return uint64_t 微秒
+ */
+uint64_t time_us64(void) {
+    return (time_host_ns() - time_host_base_ns) / 1000U;
+}
+
+/**
+ * @brief 当前时间
+ *
+ * @return uint32_t 微秒
+ */
+uint32_t time_us(void) {
+    return (uint32_t)time_us64();
+}
+
+/**
+ * @brief 按`TIME_HOST_CPU_HZ`换算的时钟周期计数
+ *
+ * @return uint32_t 周期数
+ */
+uint32_t time_cycles(void) {
+    uint64_t ns = time_host_ns() - time_host_base_ns;
+    return (uint32_t)(ns * (TIME_HOST_CPU_HZ / 1000000U) / 1000U);
+}
+#endif /* TIME_TARGET */
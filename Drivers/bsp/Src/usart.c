@@ -1,19 +1,19 @@
 /**
  * @file    usart.c
- * @date    2023/7/24
+ * @date    2023/12/24
  * @author  Deadline
- * @version 0.3
+ * @version 0.5
  * @note    此文件主要用于STM32F4串口(usart1->uart8)的初始化函数以及中断服务函数
  *          如果启用了串口1,printf函数将会被重定义为从串口1输出
+ *          启用USART1_TX_RING_ENABLE时串口1经环形缓冲区由TXE中断发送
+ *          启用USART1_BIN_ENABLE时串口1同时接收文本行和二进制帧
  * @warning 要使用相关函数请预先在usart.h里定义
  */
 
 #include "usart.h"
-
-/* 如果使用os,则包括下面的头文件即可 */
-#if SYS_SUPPORT_OS
-#include "os.h" /* os 使用 */
-#endif
+#include "profiler.h"
+#include "ring_buffer.h"
+#include "timebase.h"
 
 uint8_t USART_TX_BUF[TX_BUF_LEN]; /* 发送缓冲区 */
 
@@ -23,19 +23,104 @@ UART_HandleTypeDef USART1_Handler;
 uint8_t USART1_RX_BUF[USART_REC_LEN];
 uint16_t USART1_RX_STA = 0;
 uint8_t aRxBuffer1[RXBUFFERSIZE];
+#if USART1_BIN_ENABLE
+uint8_t USART1_BIN_BUF[BIN_FRAME_MAX_LEN];
+volatile uint16_t USART1_BIN_STA = 0;
+static uint32_t usart1_bin_last_us = 0; /* 上一个字节的接收时刻 */
+
 /**
- * @brief 串口1中断服务函数
+ * @brief 接收二进制帧的一个字节, 在接收中断中调用
+ *
+ * @param ch 收到的字节
+ * @return true-属于二进制帧(或被丢弃); false-交给文本行处理
+ * @note 上一帧还没有处理时, 新帧的起始字节交给文本行, 这一行会解析失败
  */
-void USART1_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
+static bool usart1_bin_rx(uint8_t ch) {
+    uint16_t sta = USART1_BIN_STA;
+    uint32_t n = sta & 0x3FFFU;
+    if ((sta & 0x4000U) &&
+        time_elapsed_us(usart1_bin_last_us) > USART1_BIN_TIMEOUT_US) {
+        sta = 0; /* 不完整的帧超时, 重新开始 */
+    }
+    usart1_bin_last_us = time_us();
+    if ((sta & 0x4000U) == 0) {
+        if ((sta & 0x8000U) || ch != BIN_FRAME_SYNC || USART1_RX_STA != 0) {
+            USART1_BIN_STA = sta;
+            return false;
+        }
+        USART1_BIN_BUF[0] = ch;
+        USART1_BIN_STA = 0x4000U | 1U;
+        return true;
+    }
+    USART1_BIN_BUF[n++] = ch;
+    if (n >= BIN_FRAME_HEAD &&
+        n == BIN_FRAME_OVERHEAD + bin_frame_len(USART1_BIN_BUF)) {
+        USART1_BIN_STA = (uint16_t)(0x8000U | n);
+    } else {
+        USART1_BIN_STA = (uint16_t)(0x4000U | n);
+    }
+    return true;
+}
+#endif /* USART1_BIN_ENABLE */
 #endif
+#if USART1_TX_RING_ENABLE
+static uint8_t usart1_tx_buf[USART1_TX_RING_LEN];
+/* 生产者可能是多个线程或中断, 写入时关中断; 消费者只有TXE中断 */
+static spsc_ring_t usart1_tx_ring = {0, 0, USART1_TX_RING_LEN - 1, 1,
+                                     usart1_tx_buf};
+volatile uint32_t usart1_tx_dropped = 0; /* 缓冲区满丢弃的字节数 */
 
-    HAL_UART_IRQHandler(&USART1_Handler); /* 调用HAL库中断处理公用函数 */
+/**
+ * @brief 把数据写入发送缓冲区并打开TXE中断
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return true-成功; false-剩余空间不足, 没有写入
+ */
+static bool usart1_tx_push(const void* data, uint32_t len) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool ok = spsc_ring_space(&usart1_tx_ring) >= len;
+    if (ok) {
+        spsc_ring_write(&usart1_tx_ring, data, len);
+        __HAL_UART_ENABLE_IT(&USART1_Handler, UART_IT_TXE);
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
 
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
+/**
+ * @brief 发送数据寄存器空, 从缓冲区取下一个字节, 取空后关闭TXE中断
+ *
+ * @note 更高优先级的中断可能同时写入并打开TXE中断, 判空和关中断必须是原子的
+ */
+static void usart1_tx_isr(void) {
+    uint8_t ch;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (spsc_ring_pop(&usart1_tx_ring, &ch)) {
+        USART1->DR = ch;
+    } else {
+        __HAL_UART_DISABLE_IT(&USART1_Handler, UART_IT_TXE);
+    }
+    __set_PRIMASK(primask);
+}
+#endif /* USART1_TX_RING_ENABLE */
+#if EN_USART1_RX || USART1_TX_RING_ENABLE
+/**
+ * @brief 串口1中断服务函数
+ */
+void USART1_IRQHandler(void) {
+    PROF_ENTER(PROF_USART1);
+#if USART1_TX_RING_ENABLE
+    /* 先处理发送, HAL库只处理由HAL_UART_Transmit_IT发起的发送 */
+    if (__HAL_UART_GET_IT_SOURCE(&USART1_Handler, UART_IT_TXE) &&
+        __HAL_UART_GET_FLAG(&USART1_Handler, UART_FLAG_TXE)) {
+        usart1_tx_isr();
+    }
+#endif /* USART1_TX_RING_ENABLE */
+    HAL_UART_IRQHandler(&USART1_Handler); /* 调用HAL库中断处理公用函数 */
+    PROF_EXIT(PROF_USART1);
 }
 #endif
 /**
@@ -56,6 +141,49 @@ void USART1_Init(uint32_t bound) {
 #endif
 }
 
+/**
+ * @brief 串口1发送一段数据
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint32_t 写入的字节数. 启用发送缓冲区时不阻塞,
+ *         空间不足则整段丢弃并返回0, 这样上位机不会收到半行数据
+ */
+uint32_t USART1_Write(const void* data, uint32_t len) {
+#if USART1_TX_RING_ENABLE
+    if (usart1_tx_push(data, len) == false) {
+        usart1_tx_dropped += len;
+        return 0;
+    }
+#else
+    HAL_UART_Transmit(&USART1_Handler, (uint8_t*)data, len, 0xFFFF);
+#endif /* USART1_TX_RING_ENABLE */
+    return len;
+}
+
+/**
+ * @brief 串口1输出一个字符, 供printf使用
+ *
+ * @param ch 字符
+ * @note 启用发送缓冲区时, 在线程中缓冲区满则等待TXE中断腾出空间;
+ *       在中断中或关中断时无法等待, 直接丢弃
+ */
+static void usart1_putc(uint8_t ch) {
+#if USART1_TX_RING_ENABLE
+    while (usart1_tx_push(&ch, 1) == false) {
+        if (__get_IPSR() != 0 || __get_PRIMASK() != 0) {
+            usart1_tx_dropped++;
+            return;
+        }
+    }
+#else
+    while ((USART1->SR & 0X40) == 0)
+        ; /* 等待上一个字符发送完成 */
+
+    USART1->DR = ch; /* 将要发送的字符 ch 写入到DR寄存器 */
+#endif /* USART1_TX_RING_ENABLE */
+}
+
 #endif
 
 #ifdef EN_USART2
@@ -71,10 +199,6 @@ uint8_t aRxBuffer2[RXBUFFERSIZE];
  * @brief 串口2中断服务函数
  */
 void USART2_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif /* SYS_SUPPORT_OS */
-
 #if UART_USE_IDLE_IT
     if (__HAL_UART_GET_FLAG(&USART2_Handler, UART_FLAG_IDLE) != RESET) {
         __HAL_UART_CLEAR_IDLEFLAG(&USART2_Handler);
@@ -83,10 +207,6 @@ void USART2_IRQHandler(void) {
 #endif /* UART_USE_IDLE_IT */
 
     HAL_UART_IRQHandler(&USART2_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif /* SYS_SUPPORT_OS */
 }
 /**
  * @brief 串口2初始化
@@ -131,15 +251,7 @@ uint8_t aRxBuffer3[RXBUFFERSIZE];
  * @brief 串口3中断服务函数
  */
 void USART3_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&USART3_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -172,15 +284,7 @@ uint8_t aRxBuffer4[RXBUFFERSIZE];
  * @brief 串口4中断服务函数
  */
 void UART4_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&UART4_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -212,15 +316,7 @@ uint8_t aRxBuffer5[RXBUFFERSIZE];
  * @brief 串口5中断服务函数
  */
 void UART5_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&UART5_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -252,15 +348,7 @@ uint8_t aRxBuffer6[RXBUFFERSIZE];
  * @brief 串口6中断服务函数
  */
 void USART6_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&USART6_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -292,15 +380,7 @@ uint8_t aRxBuffer7[RXBUFFERSIZE];
  * @brief 串口7中断服务函数
  */
 void UART7_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&UART7_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -332,15 +412,7 @@ uint8_t aRxBuffer8[RXBUFFERSIZE];
  * @brief 串口8中断服务函数
  */
 void UART8_IRQHandler(void) {
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntEnter();
-#endif
-
     HAL_UART_IRQHandler(&UART8_Handler); /* 调用HAL库中断处理公用函数 */
-
-#if SYS_SUPPORT_OS /* 使用OS */
-    OSIntExit();
-#endif
 }
 #endif
 /**
@@ -381,7 +453,7 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart) {
         HAL_GPIO_Init(GPIOA, &GPIO_Initure); /* PA9 */
         GPIO_Initure.Pin = GPIO_PIN_10;
         HAL_GPIO_Init(GPIOA, &GPIO_Initure); /* PA10 */
-#if EN_USART1_RX
+#if EN_USART1_RX || USART1_TX_RING_ENABLE
         HAL_NVIC_EnableIRQ(USART1_IRQn);
         HAL_NVIC_SetPriority(USART1_IRQn, 2, 2);
 #endif
@@ -551,6 +623,11 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart) {
         /* 以下用于测试中断回调是否有问题,根据实际情况修改
          * 也可以将接收写在中断服务函数中
          */
+#if USART1_BIN_ENABLE
+        if (usart1_bin_rx(aRxBuffer1[0])) {
+            /* 二进制帧, 不进入文本行 */
+        } else
+#endif /* USART1_BIN_ENABLE */
         if ((USART1_RX_STA & 0x8000) == 0) {
             /* 接收未完成 */
             if (USART1_RX_STA & 0x4000) {
@@ -559,6 +636,8 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart) {
                     /* 不是0x0a(即\n) */
                     USART1_RX_STA = 0; /* 接收错误,重新开始 */
                 } else {
+                    /* 以'\0'结尾, 上一行较长时剩余的字符不会被当成本行的内容 */
+                    USART1_RX_BUF[USART1_RX_STA & 0X3FFF] = '\0';
                     USART1_RX_STA |= 0x8000; /* 接收完成了 */
                 }
             } else {
@@ -805,10 +884,7 @@ FILE __stdout;
 
 /* MDK下需要重定义fputc函数, printf函数最终会通过调用fputc输出字符串到串口 */
 int fputc(int ch, FILE* f) {
-    while ((USART1->SR & 0X40) == 0)
-        ; /* 等待上一个字符发送完成 */
-
-    USART1->DR = (uint8_t)ch; /* 将要发送的字符 ch 写入到DR寄存器 */
+    usart1_putc((uint8_t)ch);
     return ch;
 }
 /* 重定向c库函数scanf到串口DEBUG_USART，重写向后可使用scanf、getchar等函数 */
@@ -819,11 +895,13 @@ int fgetc(FILE* f) {
 }
 #elif (defined(__GNUC__))            /* 使用ARM GCC编译器 */
 
-/* 使用ARM GCC需要添加-u _printf_float以支持浮点数 */
+/* 工程中的输出都不再使用%f, 使用ARM GCC时不需要添加-u _printf_float */
 #pragma import(__use_no_semihosting) /* 不适用半主机模式 */
 /*重新定义__write函数*/
 int _write(int fd, char* ptr, int len) {
-    HAL_UART_Transmit(&USART1_Handler, (uint8_t*)ptr, len, 0xFFFF);
+    for (int i = 0; i < len; i++) {
+        usart1_putc((uint8_t)ptr[i]);
+    }
     return len;
 }
 
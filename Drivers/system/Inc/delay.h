@@ -2,7 +2,7 @@
  ****************************************************************************************************
  * @file        delay.h
  * @author      正点原子团队(ALIENTEK)
- * @version     V1.0
+ * @version     V1.1
  * @date        2021-10-14
  * @brief       使用SysTick的普通计数模式对延迟进行管理(支持ucosii)
  *              提供delay_init初始化函数， delay_us和delay_ms等延时函数
@@ -19,6 +19,8 @@
  * 修改说明
  * V1.0 20211014
  * 第一次发布
+ * V1.1 20231214
+ * 新增delay_sleep和delay_get_sleep_cycles
  *
  ****************************************************************************************************
  */
@@ -32,6 +34,8 @@
 void delay_init(uint16_t sysclk);           /* 初始化延迟函数 */
 void delay_ms(uint16_t nms);                /* 延时nms */
 void delay_us(uint32_t nus);                /* 延时nus */
+void delay_sleep(void);                     /* 睡眠到下一个中断 */
+uint64_t delay_get_sleep_cycles(void);      /* 累计睡眠时间 */
 
 #if (!SYS_SUPPORT_OS)                       /* 没有使用Systick中断 */
     void HAL_Delay(uint32_t Delay);         /* HAL库的延时函数，SDIO等需要用到 */
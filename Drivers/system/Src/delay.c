@@ -2,9 +2,9 @@
  ****************************************************************************************************
  * @file        delay.c
  * @author      正点原子团队(ALIENTEK)
- * @version     V1.1
- * @date        2023-02-25
- * @brief       使用SysTick的普通计数模式对延迟进行管理(支持ucosii)
+ * @version     V1.6
+ * @date        2023-12-20
+ * @brief       使用SysTick的普通计数模式对延迟进行管理(支持FreeRTOS)
  *              提供delay_init初始化函数， delay_us和delay_ms等延时函数
  * @license     Copyright (c) 2022-2032, 广州市星翼电子科技有限公司
  ****************************************************************************************************
@@ -24,21 +24,39 @@
  * 修改delay_init不再使用8分频,全部统一使用MCU时钟
  * 修改delay_us使用时钟摘取法延时, 兼容OS
  * 修改delay_ms直接使用delay_us延时实现.
+ * V1.2 20231210
+ * SYS_SUPPORT_OS部分改为支持FreeRTOS
+ * V1.3 20231213
+ * delay_us的忙等时间计入profiler的空闲段
+ * V1.4 20231214
+ * 新增delay_sleep, 用WFI睡眠到下一个中断并用SysTick计数值累计睡眠时间
+ * 修改delay_ms在没有OS调度时按节拍睡眠等待, 不足一个节拍的部分忙等补齐
+ * V1.5 20231215
+ * SysTick_Handler中调用KEY_Tick按键消抖
+ * V1.6 20231220
+ * SysTick_Handler中调用ak_wdg_tick检查电机回包期限
+ * SysTick_Handler中调用CAN_Err_Tick检查CAN错误状态和离线恢复
+ * V1.7 20231228
+ * SysTick中的周期处理移到stm32f4xx_it.c的sys_tick_hook, 两个SysTick_Handler共用
  *
  ****************************************************************************************************
  */
 
 #include "sys.h"
 #include "delay.h"
+#include "profiler.h"
+#include "stm32f4xx_it.h"
 
 
 static uint32_t g_fac_us = 0;       /* us延时倍乘数 */
+static uint64_t g_sleep_cycles = 0; /* 累计睡眠时间, 单位为SysTick计数(内核时钟周期) */
 
 /* 如果SYS_SUPPORT_OS定义了,说明要支持OS了(不限于UCOS) */
 #if SYS_SUPPORT_OS
 
-/* 添加公共头文件 ( ucos需要用到) */
-#include "os.h"
+/* 添加公共头文件 (FreeRTOS需要用到) */
+#include "FreeRTOS.h"
+#include "task.h"
 
 /* 定义g_fac_ms变量, 表示ms延时的倍乘数, 代表每个节拍的ms数, (仅在使能os的时候,需要用到) */
 static uint16_t g_fac_ms = 0;
@@ -54,13 +72,15 @@ static uint16_t g_fac_ms = 0;
  *      delay_osschedunlock:用于解锁OS任务调度,重新开启调度
  *      delay_ostimedly    :用于OS延时,可以引起任务调度.
  *
- *  本例程仅作UCOSII的支持,其他OS,请自行参考着移植
+ *  本例程支持FreeRTOS, 原UCOSII的实现请参考V1.1版本
  */
 
-/* 支持UCOSII */
-#define delay_osrunning     OSRunning           /* OS是否运行标记,0,不运行;1,在运行 */
-#define delay_ostickspersec OS_TICKS_PER_SEC    /* OS时钟节拍,即每秒调度次数 */
-#define delay_osintnesting  OSIntNesting        /* 中断嵌套级别,即中断嵌套次数 */
+/* 支持FreeRTOS */
+#define delay_osrunning     (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) /* OS是否运行标记 */
+#define delay_ostickspersec configTICK_RATE_HZ  /* OS时钟节拍,即每秒调度次数 */
+#define delay_osintnesting  (__get_IPSR() != 0) /* 是否在中断中, 中断里面不可以调度 */
+
+extern void xPortSysTickHandler(void);          /* FreeRTOS移植层的SysTick处理函数 */
 
 
 /**
@@ -70,7 +90,7 @@ static uint16_t g_fac_ms = 0;
  */
 void delay_osschedlock(void)
 {
-    OSSchedLock();                      /* UCOSII的方式,禁止调度，防止打断us延时 */
+    vTaskSuspendAll();                  /* FreeRTOS的方式,挂起调度器，防止打断us延时 */
 }
 
 /**
@@ -80,7 +100,7 @@ void delay_osschedlock(void)
  */
 void delay_osschedunlock(void)
 {
-    OSSchedUnlock();                    /* UCOSII的方式,恢复调度 */
+    xTaskResumeAll();                   /* FreeRTOS的方式,恢复调度 */
 }
 
 /**
@@ -90,7 +110,7 @@ void delay_osschedunlock(void)
  */
 void delay_ostimedly(uint32_t ticks)
 {
-    OSTimeDly(ticks);                               /* UCOSII延时 */
+    vTaskDelay(ticks);                              /* FreeRTOS延时 */
 }
 
 /**
@@ -100,13 +120,13 @@ void delay_ostimedly(uint32_t ticks)
  */  
 void SysTick_Handler(void)
 {
+    sys_tick_hook();                    /* HAL节拍, 按键, 看门狗等周期处理 */
     /* OS 开始跑了,才执行正常的调度处理 */
-    if (delay_osrunning == OS_TRUE)
+    if (delay_osrunning)
     {
-        /* 调用 uC/OS-II 的 SysTick 中断服务函数 */
-        OS_CPU_SysTickHandler();
+        /* 调用 FreeRTOS 的 SysTick 中断服务函数 */
+        xPortSysTickHandler();
     }
-    HAL_IncTick();
 }
 #endif
 
@@ -151,6 +171,7 @@ void delay_us(uint32_t nus)
     delay_osschedlock();                    /* 锁定 OS 的任务调度器 */
 #endif
 
+    PROF_ENTER(PROF_IDLE);                  /* 忙等时间计入空闲 */
     told = SysTick->VAL;                    /* 刚进入时的计数器值 */
     while (1)
     {
@@ -172,6 +193,7 @@ void delay_us(uint32_t nus)
             }
         }
     }
+    PROF_EXIT(PROF_IDLE);
 
 #if SYS_SUPPORT_OS                          /* 如果需要支持OS */
     delay_osschedunlock();                  /* 恢复 OS 的任务调度器 */
@@ -179,14 +201,63 @@ void delay_us(uint32_t nus)
 
 }
 
+/**
+ * @brief     睡眠到下一个中断, 并累计睡眠时间
+ * @note      关中断后执行WFI, 有中断挂起时唤醒, 读取SysTick后再开中断执行中断服务函数,
+ *            所以睡眠时间不包含唤醒它的中断. SysTick每个节拍唤醒一次, 单次睡眠不超过一个节拍.
+ *            睡眠时内核时钟停止, DWT->CYCCNT也停止计数, 所以用SysTick计数值测量.
+ * @param     无
+ * @retval    无
+ */
+void delay_sleep(void)
+{
+    uint32_t told, tnow;
+    uint32_t reload = SysTick->LOAD;        /* LOAD的值 */
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    told = SysTick->VAL;
+    __DSB();
+    __WFI();
+    tnow = SysTick->VAL;
+    if (tnow <= told)
+    {
+        g_sleep_cycles += told - tnow;      /* SYSTICK是一个递减的计数器 */
+    }
+    else
+    {
+        g_sleep_cycles += reload + 1 - tnow + told;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief     读取累计睡眠时间
+ * @param     无
+ * @retval    累计睡眠的SysTick计数(内核时钟周期), 两次读数相减得到这段时间的睡眠时间
+ */
+uint64_t delay_get_sleep_cycles(void)
+{
+    uint64_t cycles;
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    cycles = g_sleep_cycles;
+    __set_PRIMASK(primask);
+    return cycles;
+}
+
 /**
  * @brief     延时nms
+ * @note      使用OS时让出CPU; 没有OS调度时整数个节拍用delay_sleep睡眠等待, 不足一个节拍的部分忙等补齐.
+ *            在中断里或关中断时节拍不会增加, 退回忙等.
  * @param     nms: 要延时的ms数 (0< nms <= (2^32 / fac_us / 1000))(fac_us一般等于系统主频, 自行套入计算)
  * @retval    无
  */
 void delay_ms(uint16_t nms)
 {
-    
+    uint32_t tstart, vstart;
+
 #if SYS_SUPPORT_OS  /* 如果需要支持OS, 则根据情况调用os延时以释放CPU */
     if (delay_osrunning && delay_osintnesting == 0)     /* 如果OS已经在跑了,并且不是在中断里面(中断里面不能任务调度) */
     {
@@ -196,10 +267,33 @@ void delay_ms(uint16_t nms)
         }
 
         nms %= g_fac_ms;                                /* OS已经无法提供这么小的延时了,采用普通方式延时 */
+        delay_us((uint32_t)(nms * 1000));
+        return;
     }
 #endif
 
-    delay_us((uint32_t)(nms * 1000));                   /* 普通方式延时 */
+    if (nms == 0 || __get_IPSR() != 0 || __get_PRIMASK() != 0)
+    {
+        delay_us((uint32_t)(nms * 1000));               /* 普通方式延时 */
+        return;
+    }
+
+    do                                                  /* 读取一致的起始节拍和计数值 */
+    {
+        tstart = HAL_GetTick();
+        vstart = SysTick->VAL;
+    } while (tstart != HAL_GetTick());
+
+    PROF_ENTER(PROF_IDLE);
+    while (HAL_GetTick() - tstart < nms)
+    {
+        delay_sleep();                                  /* 整数个节拍睡眠 */
+    }
+    while (HAL_GetTick() - tstart == nms && SysTick->VAL > vstart)
+    {
+        ;                                               /* 计数值回到起始值时正好过去nms */
+    }
+    PROF_EXIT(PROF_IDLE);
 }
 
 /**
@@ -0,0 +1,122 @@
+/**
+ * @file    bin_frame.h
+ * @author  Deadline--
+ * @brief   串口二进制帧
+ * @version 0.1
+ * @date    2023-12-24
+ * @note    帧格式: [0xA5][指令][长度][数据 0 ~ 255字节][CRC-32, 4字节],
+ *          CRC覆盖指令、长度和数据, 多字节字段都是小端.
+ *          应答的指令码是请求的指令码 | 0x80.
+ *          文本指令都是ASCII字符, 不会以0xA5开头, 两种指令共用一个串口.
+ */
+
+#ifndef __BIN_FRAME_H
+#define __BIN_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 帧起始字节 */
+#define BIN_FRAME_SYNC 0xA5U
+/* 帧头长度: 起始字节, 指令, 长度 */
+#define BIN_FRAME_HEAD 3U
+/* 帧头和CRC的总长度 */
+#define BIN_FRAME_OVERHEAD (BIN_FRAME_HEAD + 4U)
+/* 数据最大长度 */
+#define BIN_FRAME_MAX_PAYLOAD 255U
+/* 一帧最大长度 */
+#define BIN_FRAME_MAX_LEN (BIN_FRAME_OVERHEAD + BIN_FRAME_MAX_PAYLOAD)
+/* 应答指令码的标志位 */
+#define BIN_FRAME_REPLY 0x80U
+
+/**
+ * @brief 帧中的指令码
+ *
+ * @param frame 帧
+ * @return uint8_t 指令码
+ */
+static inline uint8_t bin_frame_cmd(const uint8_t* frame) {
+    return frame[1];
+}
+
+/**
+ * @brief 帧中的数据长度
+ *
+ * @param frame 帧
+ * @return uint32_t 长度(字节)
+ */
+static inline uint32_t bin_frame_len(const uint8_t* frame) {
+    return frame[2];
+}
+
+/**
+ * @brief 帧中数据的起始地址
+ *
+ * @param frame 帧
+ * @return uint8_t* 数据
+ */
+static inline uint8_t* bin_frame_payload(uint8_t* frame) {
+    return frame + BIN_FRAME_HEAD;
+}
+
+/**
+ * @brief 读取小端u16
+ *
+ * @param p 地址
+ * @return uint16_t 值
+ */
+static inline uint16_t bin_frame_get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief 读取小端u32
+ *
+ * @param p 地址
+ * @return uint32_t 值
+ */
+static inline uint32_t bin_frame_get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 写入小端u16
+ *
+ * @param p 地址
+ * @param v 值
+ * @return uint8_t* 写入之后的地址
+ */
+static inline uint8_t* bin_frame_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+/**
+ * @brief 写入小端u32
+ *
+ * @param p 地址
+ * @param v 值
+ * @return uint8_t* 写入之后的地址
+ */
+static inline uint8_t* bin_frame_put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+bool bin_frame_check(const uint8_t* frame, uint32_t len);
+uint32_t bin_frame_finish(uint8_t* frame, uint8_t cmd, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __BIN_FRAME_H */
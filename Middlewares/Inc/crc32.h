@@ -0,0 +1,31 @@
+/**
+ * @file    crc32.h
+ * @author  Deadline--
+ * @brief   CRC-32校验
+ * @version 0.1
+ * @date    2023-12-23
+ * @note    多项式0x04C11DB7(反射形式0xEDB88320), 初值和结果异或0xFFFFFFFF,
+ *          与zlib/Python的`zlib.crc32()`结果相同, 上位机可以直接校验.
+ *          按4位查表, 表只有64字节. 硬件CRC单元的位序和初值与此不同,
+ *          不能混用.
+ */
+
+#ifndef __CRC32_H
+#define __CRC32_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 计算一段数据时传入的初值 */
+#define CRC32_INIT 0U
+
+uint32_t crc32_update(uint32_t crc, const void* data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CRC32_H */
@@ -0,0 +1,143 @@
+/**
+ * @file    intrusive_list.hpp
+ * @author  Deadline--
+ * @brief   类型安全的侵入式双向链表
+ * @version 0.1
+ * @date    2023-12-05
+ * @note    节点嵌入在元素结构体内部, 插入删除不分配内存, 时间复杂度O(1).
+ *          替代原来的`mylist.h`, 不再依赖GCC的`typeof`语句表达式,
+ *          也不需要把链表指针强转成元素指针.
+ *
+ *          链表本身不加锁, 中断与线程共用时由调用者关中断保护.
+ *          遍历时使用局部迭代器, 不存在共享的全局位置指针.
+ */
+
+#ifndef __INTRUSIVE_LIST_H
+#define __INTRUSIVE_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+/* 头文件可能被包含在`extern "C"`中, 模板必须是C++链接 */
+extern "C++" {
+
+/**
+ * @brief 链表节点, 嵌入到元素结构体中
+ *
+ */
+struct List_Node {
+    List_Node* prev;
+    List_Node* next;
+};
+
+/**
+ * @brief 侵入式双向链表
+ *
+ * @tparam T 元素类型
+ * @tparam Member 元素中链表节点成员的指针, 例如`&T::node`
+ */
+template <typename T, List_Node T::*Member>
+class Intrusive_List {
+   public:
+    /**
+     * @brief 迭代器, 支持范围for循环
+     *
+     */
+    class iterator {
+       public:
+        explicit iterator(List_Node* node) : pos(node) {}
+        T& operator*() const { return *owner(pos); }
+        T* operator->() const { return owner(pos); }
+        iterator& operator++() {
+            pos = pos->next;
+            return *this;
+        }
+        bool operator!=(const iterator& other) const {
+            return pos != other.pos;
+        }
+        bool operator==(const iterator& other) const {
+            return pos == other.pos;
+        }
+
+       private:
+        List_Node* pos;
+    };
+
+    constexpr Intrusive_List() : head{&head, &head} {}
+
+    bool empty(void) const { return head.next == &head; }
+
+    iterator begin(void) { return iterator(head.next); }
+    iterator end(void) { return iterator(&head); }
+
+    T* front(void) { return empty() ? NULL : owner(head.next); }
+
+    /**
+     * @brief 从头部插入
+     *
+     * @param item 元素, 不能已经在某个链表中
+     */
+    void push_front(T& item) { insert(&(item.*Member), &head, head.next); }
+
+    /**
+     * @brief 从尾部插入
+     *
+     * @param item 元素, 不能已经在某个链表中
+     */
+    void push_back(T& item) { insert(&(item.*Member), head.prev, &head); }
+
+    /**
+     * @brief 取出头部元素
+     *
+     * @return T* 元素指针, 链表为空返回`NULL`
+     */
+    T* pop_front(void) {
+        if (empty()) {
+            return NULL;
+        }
+        T* item = owner(head.next);
+        remove(*item);
+        return item;
+    }
+
+    /**
+     * @brief 从所在链表中删除元素, 不需要知道链表头
+     *
+     * @param item 元素
+     */
+    static void remove(T& item) {
+        List_Node* node = &(item.*Member);
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node;
+        node->next = node;
+    }
+
+   private:
+    List_Node head; /* 哨兵节点 */
+
+    static void insert(List_Node* node, List_Node* prev, List_Node* next) {
+        next->prev = node;
+        node->next = next;
+        node->prev = prev;
+        prev->next = node;
+    }
+
+    /**
+     * @brief 根据节点地址获取元素地址
+     *
+     * @param node 节点
+     * @return T* 元素指针
+     */
+    static T* owner(List_Node* node) {
+        const size_t offset =
+            reinterpret_cast<size_t>(&(static_cast<T*>(NULL)->*Member));
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(node) - offset);
+    }
+};
+
+} /* extern "C++" */
+#endif /* __cplusplus */
+
+#endif /* __INTRUSIVE_LIST_H */
@@ -0,0 +1,35 @@
+/**
+ * @file    num_fmt.h
+ * @author  Deadline--
+ * @brief   定点十进制数格式化, 用于串口文本遥测
+ * @version 0.1
+ * @date    2023-12-17
+ * @note    只用整数运算把数值转换成ASCII, 不依赖printf的浮点支持.
+ *          小数按四舍五入保留固定位数, 与printf("%.2f")相比最后一位
+ *          在恰好为5的情况下可能相差1, 负零输出为"0.00".
+ *          输出不以'\0'结尾, 返回写入的字符数, 便于拼接一行.
+ */
+
+#ifndef __NUM_FMT_H
+#define __NUM_FMT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 最多小数位数 */
+#define NUM_FMT_MAX_DECIMALS 4U
+/* 单个数值最长字符数: 符号 + 10位整数 + 小数点 + 小数 */
+#define NUM_FMT_MAX_LEN (12U + NUM_FMT_MAX_DECIMALS)
+
+uint32_t num_fmt_uint(char* buf, uint32_t value);
+uint32_t num_fmt_int(char* buf, int32_t value);
+uint32_t num_fmt_fixed(char* buf, float value, uint32_t decimals);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __NUM_FMT_H */
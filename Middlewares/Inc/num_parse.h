@@ -0,0 +1,55 @@
+/**
+ * @file    num_parse.h
+ * @author  Deadline--
+ * @brief   定格式十进制数解析, 用于串口文本指令
+ * @version 0.1
+ * @date    2023-12-16
+ * @note    只接受`[空格][+-]整数[.小数][空格]`格式, 不支持指数和inf/nan,
+ *          不分配内存, 不依赖locale. 整数部分最多`NUM_PARSE_MAX_INT_DIGITS`位,
+ *          小数超过`NUM_PARSE_MAX_FRAC_DIGITS`位的部分被截断.
+ *          整行逗号分隔的指令一次从前往后扫描完成, 不会回头重新扫描.
+ */
+
+#ifndef __NUM_PARSE_H
+#define __NUM_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 整数部分最多位数, 绝对值不超过999999 */
+#define NUM_PARSE_MAX_INT_DIGITS 6U
+/* 小数部分有效位数, 多余的位被截断 */
+#define NUM_PARSE_MAX_FRAC_DIGITS 6U
+/* 一行最多字段数 */
+#define NUM_PARSE_MAX_FIELDS 8U
+
+/**
+ * @brief 解析结果
+ *
+ */
+typedef enum {
+    NUM_PARSE_OK = 0,      /*!< 成功 */
+    NUM_PARSE_EMPTY,       /*!< 字段为空或没有数字 */
+    NUM_PARSE_BAD_CHAR,    /*!< 非法字符 */
+    NUM_PARSE_RANGE,       /*!< 整数位数过多或超出给定范围 */
+    NUM_PARSE_FIELD_COUNT, /*!< 字段数量不对 */
+} num_parse_status_t;
+
+num_parse_status_t num_parse_float(const char** str, float* value);
+num_parse_status_t num_parse_csv(const char* str,
+                                 float* values,
+                                 uint32_t count,
+                                 float limit,
+                                 uint32_t* error_pos);
+const char* num_parse_status_str(num_parse_status_t status);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __NUM_PARSE_H */
@@ -0,0 +1,111 @@
+/**
+ * @file    param.h
+ * @author  Deadline--
+ * @brief   运行时参数表, 通过串口二进制帧批量读写
+ * @version 0.1
+ * @date    2023-12-24
+ * @note    参数表是应用程序定义的静态数组, 参数ID就是数组下标, 查找为O(1).
+ *          每个参数有名称、类型(32位浮点/无符号/有符号整数)、范围和只读标志.
+ *
+ *          批量设置时先检查全部参数, 有一个不合法则全部不修改;
+ *          检查通过后写入暂存区, 由控制循环在下一个周期开始时调用
+ *          `param_apply()`一次全部写入, 控制计算不会看到只改了一半的参数.
+ *          暂存区只有一组, 上一组还没有应用时新的设置返回`PARAM_ERR_BUSY`.
+ *          读取直接返回变量的当前值.
+ *
+ *          二进制指令(帧格式见bin_frame.h, 数值都是4字节小端, 浮点为IEEE754):
+ *          - GET  0x01: 请求[ID u16] * n; 应答[状态 u8][ID u16, 值 u32] * n
+ *          - SET  0x02: 请求[ID u16, 值 u32] * n; 应答[状态 u8][出错的序号 u8]
+ *          - INFO 0x03: 请求[起始ID u16]; 应答[状态 u8][参数总数 u16]
+ *            [ID u16, 类型 u8, 标志 u8, 最小值 f32, 最大值 f32,
+ *            名称长度 u8, 名称] * 能放下的个数
+ *          暂存和应用可以在不同的线程, 但各自只能有一个线程调用.
+ */
+
+#ifndef __PARAM_H
+#define __PARAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 一次最多设置的参数数, 也是暂存区大小 */
+#define PARAM_BATCH_MAX 16U
+/* 参数名称最大长度 */
+#define PARAM_NAME_MAX 16U
+
+/* 二进制指令码 */
+#define PARAM_CMD_GET  0x01U
+#define PARAM_CMD_SET  0x02U
+#define PARAM_CMD_INFO 0x03U
+
+/* 参数标志: 只读 */
+#define PARAM_FLAG_RO 0x01U
+
+/**
+ * @brief 参数类型, 都是4字节
+ *
+ */
+typedef enum {
+    PARAM_F32 = 0, /*!< float */
+    PARAM_U32,     /*!< uint32_t */
+    PARAM_I32,     /*!< int32_t */
+} param_type_t;
+
+/**
+ * @brief 参数值
+ *
+ */
+typedef union {
+    float f;    /*!< PARAM_F32 */
+    uint32_t u; /*!< PARAM_U32 */
+    int32_t i;  /*!< PARAM_I32 */
+} param_value_t;
+
+/**
+ * @brief 参数定义
+ *
+ * @note 整数类型的范围也用float表示, 绝对值超过2^24时不精确
+ */
+typedef struct {
+    const char* name;            /*!< 名称, 不超过`PARAM_NAME_MAX`字节 */
+    void* ptr;                   /*!< 变量地址, 4字节对齐 */
+    uint8_t type;                /*!< param_type_t */
+    uint8_t flags;               /*!< `PARAM_FLAG_RO`等 */
+    float min;                   /*!< 最小值(包含) */
+    float max;                   /*!< 最大值(包含) */
+    void (*changed)(uint16_t id); /*!< 应用后调用, 可以为NULL */
+} param_def_t;
+
+/**
+ * @brief 操作结果, 也是应答中的状态
+ *
+ */
+typedef enum {
+    PARAM_OK = 0,      /*!< 成功 */
+    PARAM_ERR_ID,      /*!< ID不存在 */
+    PARAM_ERR_RANGE,   /*!< 超出范围或不是有限的浮点数 */
+    PARAM_ERR_RO,      /*!< 只读 */
+    PARAM_ERR_BUSY,    /*!< 上一组设置还没有应用 */
+    PARAM_ERR_FORMAT,  /*!< 请求长度不对或参数过多 */
+} param_status_t;
+
+void param_init(const param_def_t* table, uint32_t num);
+uint32_t param_count(void);
+param_status_t param_get(uint16_t id, param_value_t* value);
+param_status_t param_check(uint16_t id, param_value_t value);
+param_status_t param_stage(const uint16_t* ids,
+                           const param_value_t* values,
+                           uint32_t num,
+                           uint32_t* bad);
+uint32_t param_apply(void);
+uint32_t param_handle(const uint8_t* frame, uint8_t* reply);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __PARAM_H */
@@ -0,0 +1,391 @@
+/**
+ * @file    ring_buffer.h
+ * @author  Deadline--
+ * @brief   无锁环形队列, 可在中断与线程之间传递数据
+ * @version 0.1
+ * @date    2023-12-05
+ * @note    提供两种定长队列, 都不分配内存, 存储区由调用者提供:
+ *          - `spsc_ring_t`: 单生产者单消费者, 生产者只写`head`,
+ *            消费者只写`tail`, 依靠内存屏障实现acquire/release语义;
+ *          - `mpsc_queue_t`: 多生产者单消费者, 生产者用LDREX/STREX
+ *            竞争写位置, 每个槽位带序号, 消费者按序号判断数据是否就绪.
+ *          容量必须是2的幂. C文件直接用C接口, C++文件可以用
+ *          `Spsc_Ring<T, N>`和`Mpsc_Queue<T, N>`模板, 模板自带存储区.
+ *
+ *          在主机上编译时(非ARM), 屏障和CAS使用GCC的`__atomic`内建函数.
+ */
+
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARMCC_VERSION) || defined(__arm__)
+#include "cmsis_compiler.h"
+#define RING_BARRIER() __DMB()
+#else
+#define RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif /* __ARMCC_VERSION || __arm__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief 比较并交换
+ *
+ * @param ptr 目标地址
+ * @param expected 期望值
+ * @param desired 新值
+ * @return true-交换成功; false-值已被修改或被中断打断
+ */
+static inline bool ring_cas(volatile uint32_t* ptr,
+                            uint32_t expected,
+                            uint32_t desired) {
+#if defined(__ARMCC_VERSION) || defined(__arm__)
+    if (__LDREXW(ptr) != expected) {
+        __CLREX();
+        return false;
+    }
+    return __STREXW(desired, ptr) == 0;
+#else
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif /* __ARMCC_VERSION || __arm__ */
+}
+
+/**
+ * @defgroup 单生产者单消费者队列
+ * @{
+ */
+
+typedef struct {
+    volatile uint32_t head; /*!< 写计数, 仅生产者修改 */
+    volatile uint32_t tail; /*!< 读计数, 仅消费者修改 */
+    uint32_t mask;          /*!< 容量 - 1 */
+    uint32_t elem_size;     /*!< 元素大小(字节) */
+    uint8_t* buf;           /*!< 存储区, 大小为容量 * 元素大小 */
+} spsc_ring_t;
+
+/**
+ * @brief 初始化队列
+ *
+ * @param ring 队列
+ * @param buf 存储区
+ * @param elem_size 元素大小(字节)
+ * @param capacity 容量, 必须是2的幂
+ */
+static inline void spsc_ring_init(spsc_ring_t* ring,
+                                  void* buf,
+                                  uint32_t elem_size,
+                                  uint32_t capacity) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = capacity - 1;
+    ring->elem_size = elem_size;
+    ring->buf = (uint8_t*)buf;
+}
+
+/**
+ * @brief 队列中的元素个数, 生产者和消费者都可以调用
+ *
+ * @param ring 队列
+ * @return uint32_t 元素个数
+ */
+static inline uint32_t spsc_ring_count(const spsc_ring_t* ring) {
+    return ring->head - ring->tail;
+}
+
+/**
+ * @brief 队列剩余空间
+ *
+ * @param ring 队列
+ * @return uint32_t 还能写入的元素个数
+ */
+static inline uint32_t spsc_ring_space(const spsc_ring_t* ring) {
+    return ring->mask + 1 - (ring->head - ring->tail);
+}
+
+/**
+ * @brief 写入一个元素, 仅生产者调用
+ *
+ * @param ring 队列
+ * @param elem 元素
+ * @return true-成功; false-队列已满
+ */
+static inline bool spsc_ring_push(spsc_ring_t* ring, const void* elem) {
+    uint32_t head = ring->head;
+    if (head - ring->tail > ring->mask) {
+        return false;
+    }
+    RING_BARRIER(); /* acquire: 消费者读完槽位后才覆盖 */
+    memcpy(ring->buf + (head & ring->mask) * ring->elem_size, elem,
+           ring->elem_size);
+    RING_BARRIER(); /* release: 数据写完再发布 */
+    ring->head = head + 1;
+    return true;
+}
+
+/**
+ * @brief 取出一个元素, 仅消费者调用
+ *
+ * @param ring 队列
+ * @param[out] elem 元素
+ * @return true-成功; false-队列为空
+ */
+static inline bool spsc_ring_pop(spsc_ring_t* ring, void* elem) {
+    uint32_t tail = ring->tail;
+    if (ring->head == tail) {
+        return false;
+    }
+    RING_BARRIER(); /* acquire: 看到head后再读数据 */
+    memcpy(elem, ring->buf + (tail & ring->mask) * ring->elem_size,
+           ring->elem_size);
+    RING_BARRIER(); /* release: 数据读完再归还槽位 */
+    ring->tail = tail + 1;
+    return true;
+}
+
+/**
+ * @brief 查看队首元素但不取出, 仅消费者调用
+ *
+ * @param ring 队列
+ * @return void* 队首元素, 队列为空返回`NULL`
+ */
+static inline void* spsc_ring_peek(spsc_ring_t* ring) {
+    uint32_t tail = ring->tail;
+    if (ring->head == tail) {
+        return NULL;
+    }
+    RING_BARRIER();
+    return ring->buf + (tail & ring->mask) * ring->elem_size;
+}
+
+/**
+ * @brief 批量写入字节, 仅用于元素大小为1的队列
+ *
+ * @param ring 队列
+ * @param data 数据
+ * @param len 长度
+ * @return uint32_t 实际写入的字节数, 空间不足时只写入一部分
+ */
+static inline uint32_t spsc_ring_write(spsc_ring_t* ring,
+                                       const void* data,
+                                       uint32_t len) {
+    uint32_t head = ring->head;
+    uint32_t space = ring->mask + 1 - (head - ring->tail);
+    if (len > space) {
+        len = space;
+    }
+    RING_BARRIER();
+    uint32_t offset = head & ring->mask;
+    uint32_t first = ring->mask + 1 - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, (const uint8_t*)data + first, len - first);
+    RING_BARRIER();
+    ring->head = head + len;
+    return len;
+}
+
+/**
+ * @brief 批量读出字节, 仅用于元素大小为1的队列
+ *
+ * @param ring 队列
+ * @param[out] data 数据
+ * @param len 最大长度
+ * @return uint32_t 实际读出的字节数
+ */
+static inline uint32_t spsc_ring_read(spsc_ring_t* ring,
+                                      void* data,
+                                      uint32_t len) {
+    uint32_t tail = ring->tail;
+    uint32_t count = ring->head - tail;
+    if (len > count) {
+        len = count;
+    }
+    RING_BARRIER();
+    uint32_t offset = tail & ring->mask;
+    uint32_t first = ring->mask + 1 - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, ring->buf + offset, first);
+    memcpy((uint8_t*)data + first, ring->buf, len - first);
+    RING_BARRIER();
+    ring->tail = tail + len;
+    return len;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup 多生产者单消费者队列
+ * @{
+ */
+
+typedef struct {
+    volatile uint32_t head; /*!< 写计数, 生产者之间竞争 */
+    volatile uint32_t tail; /*!< 读计数, 仅消费者修改 */
+    uint32_t mask;          /*!< 容量 - 1 */
+    uint32_t elem_size;     /*!< 元素大小(字节) */
+    volatile uint32_t* seq; /*!< 槽位序号, 大小为容量 */
+    uint8_t* buf;           /*!< 存储区, 大小为容量 * 元素大小 */
+} mpsc_queue_t;
+
+/**
+ * @brief 初始化队列
+ *
+ * @param queue 队列
+ * @param buf 存储区
+ * @param seq 槽位序号存储区
+ * @param elem_size 元素大小(字节)
+ * @param capacity 容量, 必须是2的幂
+ */
+static inline void mpsc_queue_init(mpsc_queue_t* queue,
+                                   void* buf,
+                                   volatile uint32_t* seq,
+                                   uint32_t elem_size,
+                                   uint32_t capacity) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->mask = capacity - 1;
+    queue->elem_size = elem_size;
+    queue->seq = seq;
+    queue->buf = (uint8_t*)buf;
+    for (uint32_t i = 0; i < capacity; i++) {
+        seq[i] = i;
+    }
+}
+
+/**
+ * @brief 队列中的元素个数(近似值, 包含正在写入的元素)
+ *
+ * @param queue 队列
+ * @return uint32_t 元素个数
+ */
+static inline uint32_t mpsc_queue_count(const mpsc_queue_t* queue) {
+    return queue->head - queue->tail;
+}
+
+/**
+ * @brief 写入一个元素, 任意线程或中断都可以调用
+ *
+ * @param queue 队列
+ * @param elem 元素
+ * @return true-成功; false-队列已满
+ */
+static inline bool mpsc_queue_push(mpsc_queue_t* queue, const void* elem) {
+    uint32_t pos = queue->head;
+    while (1) {
+        uint32_t seq = queue->seq[pos & queue->mask];
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            /* 槽位空闲, 抢占写位置 */
+            if (ring_cas(&queue->head, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; /* 队列已满 */
+        }
+        pos = queue->head;
+    }
+    memcpy(queue->buf + (pos & queue->mask) * queue->elem_size, elem,
+           queue->elem_size);
+    RING_BARRIER(); /* release: 数据写完再发布序号 */
+    queue->seq[pos & queue->mask] = pos + 1;
+    return true;
+}
+
+/**
+ * @brief 取出一个元素, 仅消费者调用
+ *
+ * @param queue 队列
+ * @param[out] elem 元素
+ * @return true-成功; false-队列为空或队首元素还没写完
+ */
+static inline bool mpsc_queue_pop(mpsc_queue_t* queue, void* elem) {
+    uint32_t pos = queue->tail;
+    if (queue->seq[pos & queue->mask] != pos + 1) {
+        return false;
+    }
+    RING_BARRIER(); /* acquire: 看到序号后再读数据 */
+    memcpy(elem, queue->buf + (pos & queue->mask) * queue->elem_size,
+           queue->elem_size);
+    RING_BARRIER(); /* release: 数据读完再归还槽位 */
+    queue->seq[pos & queue->mask] = pos + queue->mask + 1;
+    queue->tail = pos + 1;
+    return true;
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+
+/* 头文件可能被包含在`extern "C"`中, 模板必须是C++链接 */
+extern "C++" {
+
+/**
+ * @brief 带存储区的单生产者单消费者队列
+ *
+ * @tparam T 元素类型, 必须可以按字节拷贝
+ * @tparam N 容量, 必须是2的幂
+ */
+template <typename T, uint32_t N>
+class Spsc_Ring {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+   public:
+    Spsc_Ring() { spsc_ring_init(&ring, storage, sizeof(T), N); }
+
+    bool push(const T& item) { return spsc_ring_push(&ring, &item); }
+    bool pop(T& item) { return spsc_ring_pop(&ring, &item); }
+    T* peek(void) { return static_cast<T*>(spsc_ring_peek(&ring)); }
+    uint32_t count(void) const { return spsc_ring_count(&ring); }
+    uint32_t space(void) const { return spsc_ring_space(&ring); }
+    bool empty(void) const { return spsc_ring_count(&ring) == 0; }
+    spsc_ring_t* handle(void) { return &ring; }
+
+   private:
+    spsc_ring_t ring;
+    T storage[N];
+};
+
+/**
+ * @brief 带存储区的多生产者单消费者队列
+ *
+ * @tparam T 元素类型, 必须可以按字节拷贝
+ * @tparam N 容量, 必须是2的幂
+ */
+template <typename T, uint32_t N>
+class Mpsc_Queue {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+   public:
+    Mpsc_Queue() { mpsc_queue_init(&queue, storage, seq, sizeof(T), N); }
+
+    bool push(const T& item) { return mpsc_queue_push(&queue, &item); }
+    bool pop(T& item) { return mpsc_queue_pop(&queue, &item); }
+    uint32_t count(void) const { return mpsc_queue_count(&queue); }
+    bool empty(void) const { return mpsc_queue_count(&queue) == 0; }
+    mpsc_queue_t* handle(void) { return &queue; }
+
+   private:
+    mpsc_queue_t queue;
+    volatile uint32_t seq[N];
+    T storage[N];
+};
+
+} /* extern "C++" */
+#endif /* __cplusplus */
+
+#endif /* __RING_BUFFER_H */
@@ -0,0 +1,140 @@
+/**
+ * @file    scope.h
+ * @author  Deadline--
+ * @brief   示波器: 按控制周期把选定的变量记录到RAM, 触发后通过串口上传
+ * @version 0.1
+ * @date    2023-12-25
+ * @note    应用程序定义信号表(名称、地址、类型), 上位机从中选择最多
+ *          `SCOPE_MAX_CH`个通道. 控制循环每个周期调用一次`scope_sample()`,
+ *          每个通道复制一个32位字, 没有开始采集时直接返回.
+ *
+ *          缓冲区是环形的, 深度为`SCOPE_BUF_WORDS / 通道数`个采样点.
+ *          开始采集后先记录`pre`个触发前的采样点, 之后每个采样点检查触发条件,
+ *          触发后再记录`深度 - pre`个采样点, 缓冲区按时间顺序正好装满.
+ *          触发条件:
+ *          - 立即: 触发前的采样点记录完就触发
+ *          - 上升沿/下降沿: 触发通道的值穿过阈值
+ *          - 变化: 触发通道的值和上一个采样点不同, 用于错误码、超时计数等
+ *          - 上位机强制触发
+ *
+ *          指令和采样在不同的线程时, 开始/停止/强制触发只写入请求,
+ *          由控制线程在周期开始时调用`scope_apply()`执行, 采样过程不加锁.
+ *          读取数据只在采集完成且没有未执行的请求时进行.
+ *
+ *          二进制指令(帧格式见bin_frame.h):
+ *          - LIST   0x10: 请求[起始ID u8]; 应答[状态 u8][信号总数 u8]
+ *            [ID u8, 类型 u8, 名称长度 u8, 名称] * 能放下的个数
+ *          - ARM    0x11: 请求[抽取 u16][pre u16][触发方式 u8][触发通道 u8]
+ *            [阈值 f32][通道数 u8][信号ID u8 * 通道数]; 应答[状态 u8]
+ *          - FORCE  0x12: 强制触发; 应答[状态 u8]
+ *          - STOP   0x13: 停止采集; 应答[状态 u8]
+ *          - STATUS 0x14: 应答[状态 u8][采集状态 u8][抽取 u16][pre u16]
+ *            [深度 u16][触发方式 u8][触发通道 u8][阈值 f32][通道数 u8]
+ *            [信号ID u8 * 通道数]
+ *          - READ   0x15: 请求[起始字 u16][字数 u8]; 应答[状态 u8][起始字 u16]
+ *            [数据 u32 * 字数], 第0个字是最早的采样点的第一个通道,
+ *            触发点是第pre个采样点
+ */
+
+#ifndef __SCOPE_H
+#define __SCOPE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "param.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* 缓冲区大小(32位字) */
+#define SCOPE_BUF_WORDS 4096U
+/* 最多的通道数 */
+#define SCOPE_MAX_CH 8U
+/* 一次READ最多读取的字数 */
+#define SCOPE_READ_MAX_WORDS 63U
+
+/* 二进制指令码 */
+#define SCOPE_CMD_LIST   0x10U
+#define SCOPE_CMD_ARM    0x11U
+#define SCOPE_CMD_FORCE  0x12U
+#define SCOPE_CMD_STOP   0x13U
+#define SCOPE_CMD_STATUS 0x14U
+#define SCOPE_CMD_READ   0x15U
+
+/**
+ * @brief 信号定义
+ *
+ */
+typedef struct {
+    const char* name; /*!< 名称, 不超过`PARAM_NAME_MAX`字节 */
+    const void* ptr;  /*!< 变量地址, 4字节对齐 */
+    uint8_t type;     /*!< param_type_t */
+} scope_signal_t;
+
+/**
+ * @brief 采集状态
+ *
+ */
+typedef enum {
+    SCOPE_IDLE = 0,  /*!< 没有采集 */
+    SCOPE_ARMED,     /*!< 正在记录触发前的数据, 等待触发 */
+    SCOPE_TRIGGERED, /*!< 已触发, 正在记录触发后的数据 */
+    SCOPE_DONE,      /*!< 采集完成, 可以读取 */
+} scope_state_t;
+
+/**
+ * @brief 触发方式
+ *
+ */
+typedef enum {
+    SCOPE_TRIG_NOW = 0, /*!< 立即 */
+    SCOPE_TRIG_RISING,  /*!< 从小于阈值变为大于等于阈值 */
+    SCOPE_TRIG_FALLING, /*!< 从大于阈值变为小于等于阈值 */
+    SCOPE_TRIG_CHANGE,  /*!< 值改变 */
+    SCOPE_TRIG_NUM,
+} scope_trig_t;
+
+/**
+ * @brief 采集设置
+ *
+ */
+typedef struct {
+    uint16_t decimation;          /*!< 每几次调用采样一次, 至少为1 */
+    uint16_t pre;                 /*!< 触发前的采样点数, 小于深度 */
+    uint8_t trig_mode;            /*!< scope_trig_t */
+    uint8_t trig_ch;              /*!< 触发通道, 是通道序号不是信号ID */
+    uint8_t num;                  /*!< 通道数 */
+    uint8_t signal[SCOPE_MAX_CH]; /*!< 每个通道的信号ID */
+    float level;                  /*!< 阈值 */
+} scope_config_t;
+
+/**
+ * @brief 指令结果, 也是应答中的状态
+ *
+ */
+typedef enum {
+    SCOPE_OK = 0,      /*!< 成功 */
+    SCOPE_ERR_ARG,     /*!< 设置不合法 */
+    SCOPE_ERR_BUSY,    /*!< 上一个请求还没有执行 */
+    SCOPE_ERR_STATE,   /*!< 当前状态不能执行, 如没有采集完成时读取 */
+    SCOPE_ERR_FORMAT,  /*!< 请求长度不对 */
+} scope_status_t;
+
+void scope_init(const scope_signal_t* table, uint32_t num);
+scope_status_t scope_arm(const scope_config_t* config);
+scope_status_t scope_force(void);
+scope_status_t scope_stop(void);
+void scope_apply(void);
+void scope_sample(void);
+scope_state_t scope_state(void);
+uint32_t scope_depth(void);
+uint32_t scope_read(uint32_t offset, uint32_t* data, uint32_t count);
+uint32_t scope_handle(const uint8_t* frame, uint8_t* reply);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SCOPE_H */
@@ -0,0 +1,45 @@
+/**
+ * @file    bin_frame.c
+ * @author  Deadline--
+ * @brief   串口二进制帧
+ * @version 0.1
+ * @date    2023-12-24
+ */
+
+#include "bin_frame.h"
+
+#include "crc32.h"
+
+/**
+ * @brief 检查收到的一帧是否完整, CRC是否正确
+ *
+ * @param frame 帧
+ * @param len 收到的长度(字节)
+ * @return true-有效; false-长度或CRC错误
+ */
+bool bin_frame_check(const uint8_t* frame, uint32_t len) {
+    if (len < BIN_FRAME_OVERHEAD || frame[0] != BIN_FRAME_SYNC ||
+        len != BIN_FRAME_OVERHEAD + bin_frame_len(frame)) {
+        return false;
+    }
+    return bin_frame_get32(frame + len - 4U) ==
+           crc32_update(CRC32_INIT, frame + 1, len - 5U);
+}
+
+/**
+ * @brief 填写帧头和CRC, 完成一帧
+ *
+ * @param[in,out] frame 帧, 数据已经写在`bin_frame_payload(frame)`处,
+ *                      大小至少为`BIN_FRAME_OVERHEAD + len`
+ * @param cmd 指令码
+ * @param len 数据长度, 不超过`BIN_FRAME_MAX_PAYLOAD`
+ * @return uint32_t 整帧长度(字节)
+ */
+uint32_t bin_frame_finish(uint8_t* frame, uint8_t cmd, uint32_t len) {
+    frame[0] = BIN_FRAME_SYNC;
+    frame[1] = cmd;
+    frame[2] = (uint8_t)len;
+    uint32_t crc = crc32_update(CRC32_INIT, frame + 1, len + 2U);
+    bin_frame_put32(frame + BIN_FRAME_HEAD + len, crc);
+    return BIN_FRAME_OVERHEAD + len;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file    crc32.c
+ * @author  Deadline--
+ * @brief   CRC-32校验
+ * @version 0.1
+ * @date    2023-12-23
+ */
+
+#include "crc32.h"
+
+/* 反射多项式按4位的余数表 */
+static const uint32_t crc32_table[16] = {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU,
+    0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU,
+    0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU};
+
+/**
+ * @brief 计算CRC-32, 可以分段计算
+ *
+ * @param crc 上一段的结果, 第一段为`CRC32_INIT`
+ * @param data 数据
+ * @param len 长度(字节)
+ * @return uint32_t 到这一段为止的CRC
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, uint32_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0FU];
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0FU];
+    }
+    return ~crc;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file    num_fmt.c
+ * @author  Deadline--
+ * @brief   定点十进制数格式化, 用于串口文本遥测
+ * @version 0.1
+ * @date    2023-12-17
+ * @note    浮点数先乘以10的幂并取整, 只做一次浮点乘法和一次转换,
+ *          之后整数部分和小数部分都用整数除法得到各位数字.
+ *          放大后的绝对值超过UINT32_MAX时饱和.
+ */
+
+#include "num_fmt.h"
+
+/* 10的幂, 下标是小数位数 */
+static const uint32_t num_fmt_pow10[NUM_FMT_MAX_DECIMALS + 1] = {
+    1U, 10U, 100U, 1000U, 10000U};
+
+/**
+ * @brief 无符号整数转十进制
+ *
+ * @param[out] buf 输出, 至少10字节
+ * @param value 数值
+ * @return uint32_t 写入的字符数
+ */
+uint32_t num_fmt_uint(char* buf, uint32_t value) {
+    char tmp[10];
+    uint32_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+    for (uint32_t i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+/**
+ * @brief 有符号整数转十进制
+ *
+ * @param[out] buf 输出, 至少11字节
+ * @param value 数值
+ * @return uint32_t 写入的字符数
+ */
+uint32_t num_fmt_int(char* buf, int32_t value) {
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + num_fmt_uint(buf + 1, 0U - (uint32_t)value);
+    }
+    return num_fmt_uint(buf, (uint32_t)value);
+}
+
+/**
+ * @brief 浮点数按固定小数位数转十进制, 四舍五入
+ *
+ * @param[out] buf 输出, 至少`NUM_FMT_MAX_LEN`字节
+ * @param value 数值
+ * @param decimals 小数位数, 超过`NUM_FMT_MAX_DECIMALS`按最大值处理
+ * @return uint32_t 写入的字符数
+ */
+uint32_t num_fmt_fixed(char* buf, float value, uint32_t decimals) {
+    uint32_t n = 0;
+
+    if (value != value) {
+        buf[0] = 'n';
+        buf[1] = 'a';
+        buf[2] = 'n';
+        return 3;
+    }
+    if (decimals > NUM_FMT_MAX_DECIMALS) {
+        decimals = NUM_FMT_MAX_DECIMALS;
+    }
+    uint32_t scale = num_fmt_pow10[decimals];
+    float magnitude = (value < 0.0f ? -value : value) * (float)scale + 0.5f;
+    uint32_t scaled =
+        magnitude >= 4294967295.0f ? UINT32_MAX : (uint32_t)magnitude;
+
+    if (value < 0.0f && scaled != 0) {
+        buf[n++] = '-';
+    }
+    n += num_fmt_uint(buf + n, scaled / scale);
+    if (decimals > 0) {
+        uint32_t frac = scaled % scale;
+        buf[n++] = '.';
+        for (uint32_t i = decimals; i > 0; i--) {
+            buf[n + i - 1] = (char)('0' + frac % 10U);
+            frac /= 10U;
+        }
+        n += decimals;
+    }
+    return n;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file    num_parse.c
+ * @author  Deadline--
+ * @brief   定格式十进制数解析, 用于串口文本指令
+ * @version 0.1
+ * @date    2023-12-16
+ * @note    整数部分和小数部分分别用整数累加, 最后各做一次浮点运算,
+ *          两部分都不超过6位, 转换成float是精确的.
+ */
+
+#include "num_parse.h"
+
+/* 10的幂, 下标是小数位数 */
+static const float num_parse_pow10[NUM_PARSE_MAX_FRAC_DIGITS + 1] = {
+    1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 100000.0f, 1000000.0f};
+
+/**
+ * @brief 跳过空格和制表符
+ *
+ * @param p 字符串
+ * @return const char* 第一个非空白字符
+ */
+static inline const char* num_parse_skip_space(const char* p) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief 解析一个十进制数
+ *
+ * @param[in,out] str 字符串指针, 成功时指向数字后的第一个非空白字符,
+ *                    失败时指向出错的字符
+ * @param[out] value 结果, 失败时不修改
+ * @return num_parse_status_t 解析结果
+ */
+num_parse_status_t num_parse_float(const char** str, float* value) {
+    const char* p = num_parse_skip_space(*str);
+    bool negative = false;
+    uint32_t int_part = 0, frac_part = 0;
+    uint32_t int_digits = 0, frac_digits = 0;
+    bool has_digit = false;
+
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        p++;
+    }
+    while ((uint8_t)(*p - '0') <= 9) {
+        if (++int_digits > NUM_PARSE_MAX_INT_DIGITS) {
+            *str = p;
+            return NUM_PARSE_RANGE;
+        }
+        int_part = int_part * 10U + (uint32_t)(*p - '0');
+        has_digit = true;
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while ((uint8_t)(*p - '0') <= 9) {
+            if (frac_digits < NUM_PARSE_MAX_FRAC_DIGITS) {
+                frac_part = frac_part * 10U + (uint32_t)(*p - '0');
+                frac_digits++;
+            }
+            has_digit = true;
+            p++;
+        }
+    }
+    if (has_digit == false) {
+        *str = p;
+        return NUM_PARSE_EMPTY;
+    }
+
+    float result =
+        (float)int_part + (float)frac_part / num_parse_pow10[frac_digits];
+    *value = negative ? -result : result;
+    *str = num_parse_skip_space(p);
+    return NUM_PARSE_OK;
+}
+
+/**
+ * @brief 依次解析逗号分隔的字段, 一次扫描到行尾
+ *
+ * @param[in,out] p 字符串指针, 失败时指向出错的字符
+ * @param[out] fields 结果
+ * @param count 字段数
+ * @param limit 绝对值上限, 0不检查
+ * @return num_parse_status_t 解析结果
+ */
+static num_parse_status_t num_parse_fields(const char** p,
+                                           float* fields,
+                                           uint32_t count,
+                                           float limit) {
+    uint32_t n = 0;
+    while (1) {
+        const char* field = *p;
+        num_parse_status_t status = num_parse_float(p, &fields[n]);
+        if (status != NUM_PARSE_OK) {
+            return status;
+        }
+        if (limit > 0.0f && (fields[n] > limit || fields[n] < -limit)) {
+            *p = field;
+            return NUM_PARSE_RANGE;
+        }
+        n++;
+        if (**p != ',') {
+            break;
+        }
+        if (n == count) {
+            return NUM_PARSE_FIELD_COUNT; /* 字段过多 */
+        }
+        (*p)++;
+    }
+    while (**p == '\r' || **p == '\n') {
+        (*p)++;
+    }
+    if (**p != '\0') {
+        return NUM_PARSE_BAD_CHAR;
+    }
+    if (n != count) {
+        return NUM_PARSE_FIELD_COUNT; /* 字段过少 */
+    }
+    return NUM_PARSE_OK;
+}
+
+/**
+ * @brief 解析一行逗号分隔的十进制数, 例如`1.5,-2,0.25`
+ *
+ * @param str 字符串, 以'\0'结束, 末尾可以有"\r\n"
+ * @param[out] values 结果, 只有全部字段解析成功才写入
+ * @param count 字段数, 必须正好这么多个, 最多`NUM_PARSE_MAX_FIELDS`
+ * @param limit 每个值的绝对值上限, 传0不检查
+ * @param[out] error_pos 失败时出错字符的下标, 可以为NULL
+ * @return num_parse_status_t 解析结果
+ */
+num_parse_status_t num_parse_csv(const char* str,
+                                 float* values,
+                                 uint32_t count,
+                                 float limit,
+                                 uint32_t* error_pos) {
+    float fields[NUM_PARSE_MAX_FIELDS];
+    const char* p = str;
+    num_parse_status_t status = NUM_PARSE_FIELD_COUNT;
+
+    if (count > 0 && count <= NUM_PARSE_MAX_FIELDS) {
+        status = num_parse_fields(&p, fields, count, limit);
+    }
+    if (status != NUM_PARSE_OK) {
+        if (error_pos != NULL) {
+            *error_pos = (uint32_t)(p - str);
+        }
+        return status;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = fields[i];
+    }
+    return NUM_PARSE_OK;
+}
+
+/**
+ * @brief 解析结果的名称, 用于输出错误信息
+ *
+ * @param status 解析结果
+ * @return const char* 名称
+ */
+const char* num_parse_status_str(num_parse_status_t status) {
+    switch (status) {
+        case NUM_PARSE_OK:
+            return "ok";
+        case NUM_PARSE_EMPTY:
+            return "empty";
+        case NUM_PARSE_BAD_CHAR:
+            return "bad char";
+        case NUM_PARSE_RANGE:
+            return "range";
+        case NUM_PARSE_FIELD_COUNT:
+            return "field count";
+        default:
+            return "unknown";
+    }
+}
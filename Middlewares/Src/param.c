@@ -0,0 +1,284 @@
+/**
+ * @file    param.c
+ * @author  Deadline--
+ * @brief   运行时参数表, 通过串口二进制帧批量读写
+ * @version 0.1
+ * @date    2023-12-24
+ */
+
+#include "param.h"
+
+#include <string.h>
+
+#include "bin_frame.h"
+#include "ring_buffer.h"
+
+/* 参数表 */
+static const param_def_t* param_table = NULL;
+static uint32_t param_num = 0;
+
+/* 暂存区, param_pending_num不为0时由应用线程读取 */
+static uint16_t param_pending_id[PARAM_BATCH_MAX];
+static param_value_t param_pending_value[PARAM_BATCH_MAX];
+static volatile uint32_t param_pending_num = 0;
+
+/**
+ * @brief 设置参数表
+ *
+ * @param table 参数表, 一直有效
+ * @param num 参数数量, 不超过65535
+ */
+void param_init(const param_def_t* table, uint32_t num) {
+    param_table = table;
+    param_num = num;
+    param_pending_num = 0;
+}
+
+/**
+ * @brief 参数数量
+ *
+ * @return uint32_t 数量
+ */
+uint32_t param_count(void) {
+    return param_num;
+}
+
+/**
+ * @brief 读取一个参数的当前值
+ *
+ * @param id 参数ID
+ * @param[out] value 当前值
+ * @return param_status_t `PARAM_OK`或`PARAM_ERR_ID`
+ */
+param_status_t param_get(uint16_t id, param_value_t* value) {
+    if (id >= param_num) {
+        return PARAM_ERR_ID;
+    }
+    value->u = *(const volatile uint32_t*)param_table[id].ptr;
+    return PARAM_OK;
+}
+
+/**
+ * @brief 检查一个参数能否设置成指定的值
+ *
+ * @param id 参数ID
+ * @param value 新值
+ * @return param_status_t 检查结果
+ */
+param_status_t param_check(uint16_t id, param_value_t value) {
+    if (id >= param_num) {
+        return PARAM_ERR_ID;
+    }
+    const param_def_t* def = &param_table[id];
+    if (def->flags & PARAM_FLAG_RO) {
+        return PARAM_ERR_RO;
+    }
+    float v;
+    if (def->type == PARAM_F32) {
+        v = value.f; /* NaN和inf不满足下面的比较 */
+    } else if (def->type == PARAM_U32) {
+        v = (float)value.u;
+    } else {
+        v = (float)value.i;
+    }
+    if (!(v >= def->min && v <= def->max)) {
+        return PARAM_ERR_RANGE;
+    }
+    return PARAM_OK;
+}
+
+/**
+ * @brief 检查一组参数, 全部合法时写入暂存区
+ *
+ * @param ids 参数ID
+ * @param values 新值
+ * @param num 数量, 不超过`PARAM_BATCH_MAX`
+ * @param[out] bad 出错时为第一个不合法参数的序号, 可以为NULL
+ * @return param_status_t 结果, 不是`PARAM_OK`时什么都没有写入
+ * @note 同一个ID出现多次时以最后一个为准
+ */
+param_status_t param_stage(const uint16_t* ids,
+                           const param_value_t* values,
+                           uint32_t num,
+                           uint32_t* bad) {
+    if (num == 0 || num > PARAM_BATCH_MAX) {
+        return PARAM_ERR_FORMAT;
+    }
+    if (param_pending_num != 0) {
+        return PARAM_ERR_BUSY;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        param_status_t status = param_check(ids[i], values[i]);
+        if (status != PARAM_OK) {
+            if (bad != NULL) {
+                *bad = i;
+            }
+            return status;
+        }
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        param_pending_id[i] = ids[i];
+        param_pending_value[i] = values[i];
+    }
+    RING_BARRIER(); /* 暂存区写完之后才发布数量 */
+    param_pending_num = num;
+    return PARAM_OK;
+}
+
+/**
+ * @brief 把暂存的一组参数全部写入变量, 在控制周期开始时调用
+ *
+ * @return uint32_t 写入的参数数, 没有暂存的参数时为0
+ * @note 写入之后依次调用参数的changed回调
+ */
+uint32_t param_apply(void) {
+    uint32_t num = param_pending_num;
+    if (num == 0) {
+        return 0;
+    }
+    RING_BARRIER();
+    for (uint32_t i = 0; i < num; i++) {
+        *(volatile uint32_t*)param_table[param_pending_id[i]].ptr =
+            param_pending_value[i].u;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        const param_def_t* def = &param_table[param_pending_id[i]];
+        if (def->changed != NULL) {
+            def->changed(param_pending_id[i]);
+        }
+    }
+    RING_BARRIER(); /* 读完暂存区之后才释放 */
+    param_pending_num = 0;
+    return num;
+}
+
+/**
+ * @brief 处理GET请求
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ * @note 有ID不存在时只返回状态
+ */
+static uint32_t param_handle_get(const uint8_t* req,
+                                 uint32_t len,
+                                 uint8_t* out) {
+    uint32_t num = len / 2U;
+    uint8_t* p = out + 1;
+    out[0] = PARAM_OK;
+    if (len == 0 || (len % 2U) != 0 ||
+        1U + num * 6U > BIN_FRAME_MAX_PAYLOAD) {
+        out[0] = PARAM_ERR_FORMAT;
+        return 1;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        uint16_t id = bin_frame_get16(req + i * 2U);
+        param_value_t value;
+        if (param_get(id, &value) != PARAM_OK) {
+            out[0] = PARAM_ERR_ID;
+            return 1;
+        }
+        p = bin_frame_put16(p, id);
+        p = bin_frame_put32(p, value.u);
+    }
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief 处理SET请求
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ */
+static uint32_t param_handle_set(const uint8_t* req,
+                                 uint32_t len,
+                                 uint8_t* out) {
+    uint16_t ids[PARAM_BATCH_MAX];
+    param_value_t values[PARAM_BATCH_MAX];
+    uint32_t num = len / 6U;
+    uint32_t bad = num;
+    param_status_t status = PARAM_ERR_FORMAT;
+
+    if ((len % 6U) == 0 && num > 0 && num <= PARAM_BATCH_MAX) {
+        for (uint32_t i = 0; i < num; i++) {
+            ids[i] = bin_frame_get16(req + i * 6U);
+            values[i].u = bin_frame_get32(req + i * 6U + 2U);
+        }
+        status = param_stage(ids, values, num, &bad);
+    }
+    out[0] = (uint8_t)status;
+    out[1] = (uint8_t)bad;
+    return 2;
+}
+
+/**
+ * @brief 处理INFO请求, 从起始ID开始尽量多地返回参数定义
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ */
+static uint32_t param_handle_info(const uint8_t* req,
+                                  uint32_t len,
+                                  uint8_t* out) {
+    uint8_t* p = out + 1;
+    uint8_t* end = out + BIN_FRAME_MAX_PAYLOAD;
+    if (len != 2U) {
+        out[0] = PARAM_ERR_FORMAT;
+        return 1;
+    }
+    out[0] = PARAM_OK;
+    p = bin_frame_put16(p, (uint16_t)param_num);
+    for (uint32_t id = bin_frame_get16(req); id < param_num; id++) {
+        const param_def_t* def = &param_table[id];
+        uint32_t name_len = (uint32_t)strlen(def->name);
+        if (name_len > PARAM_NAME_MAX) {
+            name_len = PARAM_NAME_MAX;
+        }
+        if (p + 13U + name_len > end) {
+            break;
+        }
+        param_value_t min, max;
+        min.f = def->min;
+        max.f = def->max;
+        p = bin_frame_put16(p, (uint16_t)id);
+        *p++ = def->type;
+        *p++ = def->flags;
+        p = bin_frame_put32(p, min.u);
+        p = bin_frame_put32(p, max.u);
+        *p++ = (uint8_t)name_len;
+        memcpy(p, def->name, name_len);
+        p += name_len;
+    }
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief 处理一帧参数指令
+ *
+ * @param frame 请求帧, 已经用`bin_frame_check()`检查
+ * @param[out] reply 应答帧, 至少`BIN_FRAME_MAX_LEN`字节
+ * @return uint32_t 应答帧长度, 不是参数指令时为0
+ */
+uint32_t param_handle(const uint8_t* frame, uint8_t* reply) {
+    uint8_t cmd = bin_frame_cmd(frame);
+    const uint8_t* req = frame + BIN_FRAME_HEAD;
+    uint32_t req_len = bin_frame_len(frame);
+    uint8_t* out = bin_frame_payload(reply);
+    uint32_t len;
+
+    if (cmd == PARAM_CMD_GET) {
+        len = param_handle_get(req, req_len, out);
+    } else if (cmd == PARAM_CMD_SET) {
+        len = param_handle_set(req, req_len, out);
+    } else if (cmd == PARAM_CMD_INFO) {
+        len = param_handle_info(req, req_len, out);
+    } else {
+        return 0;
+    }
+    return bin_frame_finish(reply, (uint8_t)(cmd | BIN_FRAME_REPLY), len);
+}
@@ -0,0 +1,425 @@
+/**
+ * @file    scope.c
+ * @author  Deadline--
+ * @brief   示波器: 按控制周期把选定的变量记录到RAM, 触发后通过串口上传
+ * @version 0.1
+ * @date    2023-12-25
+ */
+
+#include "scope.h"
+
+#include <string.h>
+
+#include "bin_frame.h"
+#include "ring_buffer.h"
+
+/* 请求, 由指令线程写入, 控制线程执行后清除 */
+#define SCOPE_REQ_NONE  0U
+#define SCOPE_REQ_ARM   1U
+#define SCOPE_REQ_FORCE 2U
+#define SCOPE_REQ_STOP  3U
+
+/* 信号表 */
+static const scope_signal_t* scope_table = NULL;
+static uint32_t scope_table_num = 0;
+
+/* 请求和开始采集时的设置 */
+static volatile uint32_t scope_req = SCOPE_REQ_NONE;
+static scope_config_t scope_req_config;
+
+/* 以下只在控制线程中修改 */
+static scope_config_t scope_config;
+static const volatile uint32_t* scope_src[SCOPE_MAX_CH];
+static uint32_t scope_buf[SCOPE_BUF_WORDS];
+static uint32_t scope_samples = 0;   /* 深度(采样点) */
+static uint32_t scope_head = 0;      /* 下一个采样点的位置 */
+static uint32_t scope_filled = 0;    /* 已记录的触发前采样点 */
+static uint32_t scope_post_left = 0; /* 触发后还要记录的采样点 */
+static uint32_t scope_decim_cnt = 0; /* 抽取计数 */
+static uint32_t scope_last = 0;      /* 触发通道上一个采样点的值 */
+static bool scope_forced = false;    /* 收到强制触发 */
+static volatile uint32_t scope_cur_state = SCOPE_IDLE;
+
+/**
+ * @brief 设置信号表, 停止采集
+ *
+ * @param table 信号表, 一直有效
+ * @param num 信号数量, 不超过255
+ */
+void scope_init(const scope_signal_t* table, uint32_t num) {
+    scope_table = table;
+    scope_table_num = num;
+    scope_req = SCOPE_REQ_NONE;
+    scope_cur_state = SCOPE_IDLE;
+}
+
+/**
+ * @brief 写入一个请求
+ *
+ * @param req 请求
+ * @return scope_status_t `SCOPE_OK`或`SCOPE_ERR_BUSY`
+ */
+static scope_status_t scope_request(uint32_t req) {
+    if (scope_req != SCOPE_REQ_NONE) {
+        return SCOPE_ERR_BUSY;
+    }
+    RING_BARRIER(); /* 设置写完之后才发布请求 */
+    scope_req = req;
+    return SCOPE_OK;
+}
+
+/**
+ * @brief 请求按指定设置开始采集, 正在采集时重新开始
+ *
+ * @param config 设置
+ * @return scope_status_t 结果
+ */
+scope_status_t scope_arm(const scope_config_t* config) {
+    if (config->num == 0 || config->num > SCOPE_MAX_CH ||
+        config->decimation == 0 || config->trig_mode >= SCOPE_TRIG_NUM ||
+        config->trig_ch >= config->num ||
+        config->pre >= SCOPE_BUF_WORDS / config->num) {
+        return SCOPE_ERR_ARG;
+    }
+    for (uint32_t i = 0; i < config->num; i++) {
+        if (config->signal[i] >= scope_table_num) {
+            return SCOPE_ERR_ARG;
+        }
+    }
+    if (scope_req != SCOPE_REQ_NONE) {
+        return SCOPE_ERR_BUSY;
+    }
+    scope_req_config = *config;
+    return scope_request(SCOPE_REQ_ARM);
+}
+
+/**
+ * @brief 请求强制触发, 没有在等待触发时不起作用
+ *
+ * @return scope_status_t 结果
+ */
+scope_status_t scope_force(void) {
+    return scope_request(SCOPE_REQ_FORCE);
+}
+
+/**
+ * @brief 请求停止采集
+ *
+ * @return scope_status_t 结果
+ */
+scope_status_t scope_stop(void) {
+    return scope_request(SCOPE_REQ_STOP);
+}
+
+/**
+ * @brief 执行请求, 在控制线程中每个周期开始时调用
+ *
+ */
+void scope_apply(void) {
+    uint32_t req = scope_req;
+    if (req == SCOPE_REQ_NONE) {
+        return;
+    }
+    RING_BARRIER();
+    if (req == SCOPE_REQ_ARM) {
+        scope_config = scope_req_config;
+        for (uint32_t i = 0; i < scope_config.num; i++) {
+            scope_src[i] = (const volatile uint32_t*)scope_table
+                               [scope_config.signal[i]].ptr;
+        }
+        scope_samples = SCOPE_BUF_WORDS / scope_config.num;
+        scope_head = 0;
+        scope_filled = 0;
+        scope_decim_cnt = scope_config.decimation - 1U; /* 第一次调用就采样 */
+        scope_last = *scope_src[scope_config.trig_ch];
+        scope_forced = false;
+        scope_cur_state = SCOPE_ARMED;
+    } else if (req == SCOPE_REQ_FORCE) {
+        scope_forced = true;
+    } else {
+        scope_cur_state = SCOPE_IDLE;
+    }
+    RING_BARRIER(); /* 状态写完之后才释放请求 */
+    scope_req = SCOPE_REQ_NONE;
+}
+
+/**
+ * @brief 检查触发通道的新值是否满足触发条件
+ *
+ * @param value 新值
+ * @return true-触发; false-没有触发
+ */
+static bool scope_check(uint32_t value) {
+    uint32_t last = scope_last;
+    scope_last = value;
+    if (scope_config.trig_mode == SCOPE_TRIG_NOW) {
+        return true;
+    }
+    if (scope_config.trig_mode == SCOPE_TRIG_CHANGE) {
+        return value != last;
+    }
+    param_value_t now, prev;
+    now.u = value;
+    prev.u = last;
+    float a, b;
+    uint8_t type = scope_table[scope_config.signal[scope_config.trig_ch]].type;
+    if (type == PARAM_F32) {
+        a = prev.f;
+        b = now.f;
+    } else if (type == PARAM_U32) {
+        a = (float)prev.u;
+        b = (float)now.u;
+    } else {
+        a = (float)prev.i;
+        b = (float)now.i;
+    }
+    if (scope_config.trig_mode == SCOPE_TRIG_RISING) {
+        return a < scope_config.level && b >= scope_config.level;
+    }
+    return a > scope_config.level && b <= scope_config.level;
+}
+
+/**
+ * @brief 记录一个采样点, 在控制线程中每个周期调用一次
+ *
+ * @note 没有开始采集时直接返回
+ */
+void scope_sample(void) {
+    uint32_t state = scope_cur_state;
+    if (state != SCOPE_ARMED && state != SCOPE_TRIGGERED) {
+        return;
+    }
+    if (++scope_decim_cnt < scope_config.decimation) {
+        return;
+    }
+    scope_decim_cnt = 0;
+
+    uint32_t num = scope_config.num;
+    uint32_t* dst = &scope_buf[scope_head * num];
+    for (uint32_t i = 0; i < num; i++) {
+        dst[i] = *scope_src[i];
+    }
+    if (++scope_head >= scope_samples) {
+        scope_head = 0;
+    }
+
+    if (state == SCOPE_ARMED) {
+        bool hit = scope_check(dst[scope_config.trig_ch]);
+        if (scope_filled < scope_config.pre) {
+            scope_filled++; /* 触发前的数据还没有记录够, 不检查触发 */
+            return;
+        }
+        if (hit == false && scope_forced == false) {
+            return;
+        }
+        /* 这个采样点是触发点, 也是触发后的第一个采样点 */
+        scope_post_left = scope_samples - scope_config.pre;
+        scope_cur_state = SCOPE_TRIGGERED;
+    }
+    if (--scope_post_left == 0) {
+        scope_cur_state = SCOPE_DONE; /* 最早的采样点在scope_head */
+    }
+}
+
+/**
+ * @brief 采集状态
+ *
+ * @return scope_state_t 状态
+ */
+scope_state_t scope_state(void) {
+    return (scope_state_t)scope_cur_state;
+}
+
+/**
+ * @brief 当前设置的深度
+ *
+ * @return uint32_t 采样点数, 没有开始过采集时为0
+ */
+uint32_t scope_depth(void) {
+    return scope_samples;
+}
+
+/**
+ * @brief 按时间顺序读取采集的数据
+ *
+ * @param offset 起始字, 第0个字是最早的采样点的第一个通道
+ * @param[out] data 数据
+ * @param count 字数
+ * @return uint32_t 读取的字数, 没有采集完成时为0
+ * @note 只能在发出请求的线程中调用
+ */
+uint32_t scope_read(uint32_t offset, uint32_t* data, uint32_t count) {
+    if (scope_cur_state != SCOPE_DONE || scope_req != SCOPE_REQ_NONE) {
+        return 0;
+    }
+    uint32_t total = scope_samples * scope_config.num;
+    if (offset >= total) {
+        return 0;
+    }
+    if (count > total - offset) {
+        count = total - offset;
+    }
+    uint32_t pos = scope_head * scope_config.num + offset;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos >= total) {
+            pos -= total;
+        }
+        data[i] = scope_buf[pos++];
+    }
+    return count;
+}
+
+/**
+ * @brief 处理LIST请求, 从起始ID开始尽量多地返回信号定义
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ */
+static uint32_t scope_handle_list(const uint8_t* req,
+                                  uint32_t len,
+                                  uint8_t* out) {
+    uint8_t* p = out + 2;
+    uint8_t* end = out + BIN_FRAME_MAX_PAYLOAD;
+    if (len != 1U) {
+        out[0] = SCOPE_ERR_FORMAT;
+        return 1;
+    }
+    out[0] = SCOPE_OK;
+    out[1] = (uint8_t)scope_table_num;
+    for (uint32_t id = req[0]; id < scope_table_num; id++) {
+        const scope_signal_t* sig = &scope_table[id];
+        uint32_t name_len = (uint32_t)strlen(sig->name);
+        if (name_len > PARAM_NAME_MAX) {
+            name_len = PARAM_NAME_MAX;
+        }
+        if (p + 3U + name_len > end) {
+            break;
+        }
+        *p++ = (uint8_t)id;
+        *p++ = sig->type;
+        *p++ = (uint8_t)name_len;
+        memcpy(p, sig->name, name_len);
+        p += name_len;
+    }
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief 处理ARM请求
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ */
+static uint32_t scope_handle_arm(const uint8_t* req,
+                                 uint32_t len,
+                                 uint8_t* out) {
+    scope_config_t config;
+    param_value_t level;
+    if (len < 11U || len != 11U + req[10] || req[10] > SCOPE_MAX_CH) {
+        out[0] = SCOPE_ERR_FORMAT;
+        return 1;
+    }
+    memset(&config, 0, sizeof(config));
+    config.decimation = bin_frame_get16(req);
+    config.pre = bin_frame_get16(req + 2);
+    config.trig_mode = req[4];
+    config.trig_ch = req[5];
+    level.u = bin_frame_get32(req + 6);
+    config.level = level.f;
+    config.num = req[10];
+    memcpy(config.signal, req + 11, config.num);
+    out[0] = (uint8_t)scope_arm(&config);
+    return 1;
+}
+
+/**
+ * @brief 处理STATUS请求
+ *
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ * @note 采集过程中设置不变, 重新开始采集后返回新的设置
+ */
+static uint32_t scope_handle_status(uint8_t* out) {
+    uint8_t* p = out;
+    param_value_t level;
+    *p++ = SCOPE_OK;
+    *p++ = (uint8_t)scope_cur_state;
+    p = bin_frame_put16(p, scope_config.decimation);
+    p = bin_frame_put16(p, scope_config.pre);
+    p = bin_frame_put16(p, (uint16_t)scope_samples);
+    *p++ = scope_config.trig_mode;
+    *p++ = scope_config.trig_ch;
+    level.f = scope_config.level;
+    p = bin_frame_put32(p, level.u);
+    *p++ = scope_config.num;
+    memcpy(p, scope_config.signal, scope_config.num);
+    p += scope_config.num;
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief 处理READ请求
+ *
+ * @param req 请求数据
+ * @param len 请求长度
+ * @param[out] out 应答数据
+ * @return uint32_t 应答长度
+ */
+static uint32_t scope_handle_read(const uint8_t* req,
+                                  uint32_t len,
+                                  uint8_t* out) {
+    uint32_t words[SCOPE_READ_MAX_WORDS];
+    if (len != 3U || req[2] == 0 || req[2] > SCOPE_READ_MAX_WORDS) {
+        out[0] = SCOPE_ERR_FORMAT;
+        return 1;
+    }
+    uint16_t offset = bin_frame_get16(req);
+    uint32_t count = scope_read(offset, words, req[2]);
+    if (count == 0) {
+        out[0] = SCOPE_ERR_STATE;
+        return 1;
+    }
+    uint8_t* p = out;
+    *p++ = SCOPE_OK;
+    p = bin_frame_put16(p, offset);
+    for (uint32_t i = 0; i < count; i++) {
+        p = bin_frame_put32(p, words[i]);
+    }
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief 处理一帧示波器指令
+ *
+ * @param frame 请求帧, 已经用`bin_frame_check()`检查
+ * @param[out] reply 应答帧, 至少`BIN_FRAME_MAX_LEN`字节
+ * @return uint32_t 应答帧长度, 不是示波器指令时为0
+ */
+uint32_t scope_handle(const uint8_t* frame, uint8_t* reply) {
+    uint8_t cmd = bin_frame_cmd(frame);
+    const uint8_t* req = frame + BIN_FRAME_HEAD;
+    uint32_t req_len = bin_frame_len(frame);
+    uint8_t* out = bin_frame_payload(reply);
+    uint32_t len = 1;
+
+    if (cmd == SCOPE_CMD_LIST) {
+        len = scope_handle_list(req, req_len, out);
+    } else if (cmd == SCOPE_CMD_ARM) {
+        len = scope_handle_arm(req, req_len, out);
+    } else if (cmd == SCOPE_CMD_FORCE) {
+        out[0] = (uint8_t)scope_force();
+    } else if (cmd == SCOPE_CMD_STOP) {
+        out[0] = (uint8_t)scope_stop();
+    } else if (cmd == SCOPE_CMD_STATUS) {
+        len = scope_handle_status(out);
+    } else if (cmd == SCOPE_CMD_READ) {
+        len = scope_handle_read(req, req_len, out);
+    } else {
+        return 0;
+    }
+    return bin_frame_finish(reply, (uint8_t)(cmd | BIN_FRAME_REPLY), len);
+}
@@ -0,0 +1,186 @@
+"""Assemble the fault recorder's hand-written ARM code without an ARM compiler.
+
+The naked fault handlers (FAULT_REC_HANDLER in fault_rec.h, expanded in
+stm32f4xx_it.c) and the vcvtb inline asm in fault_rec.c are only compiled by
+the ARM toolchain. This script preprocesses both files for the target with the
+host C compiler, wraps the extracted asm in LLVM IR and assembles it with llc
+for Cortex-M4F. It then checks the disassembly and relocations: the switch to
+fault_rec_stack + FAULT_REC_STACK_SIZE, the branch to fault_rec_fault and the
+half-precision conversion.
+
+The C side of the target branch (IWDG, backup SRAM, reset) is checked with
+`-fsyntax-only -D__arm__` against the HAL headers. That catches type and name
+errors but is not a replacement for an armclang build.
+
+Example:
+    python3 Tests/arm_asm_check.py --cc gcc --llc llc --objdump llvm-objdump
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.normpath(os.path.join(os.path.dirname(__file__), ".."))
+INCLUDES = [
+    "Drivers/CMSIS/Device/ST/STM32F4xx/Include",
+    "Drivers/CMSIS/Include",
+    "Drivers/STM32F4xx_HAL_Driver/Inc",
+    ".eide/deps",
+    "Drivers/bsp/Inc",
+    "Drivers/system/Inc",
+    "Middlewares/Inc",
+    "Application/Inc",
+]
+DEFINES = ["__arm__", "STM32F429xx", "USE_HAL_DRIVER"]
+IT_SRC = "Application/Src/stm32f4xx_it.c"
+FAULT_SRC = "Drivers/bsp/Src/fault_rec.c"
+# handler name -> fault type in fault_rec_type_t
+HANDLERS = {
+    "HardFault_Handler": 1,
+    "MemManage_Handler": 2,
+    "BusFault_Handler": 3,
+    "UsageFault_Handler": 4,
+}
+TRIPLE = "thumbv7em-none-eabihf"
+
+C_STRINGS = re.compile(r'((?:\s*"(?:[^"\\]|\\.)*")+)')
+NAKED = re.compile(
+    r"__attribute__\(\(naked\)\)\s*void\s+(\w+)\s*\(void\)\s*\{\s*"
+    r"__asm\s+volatile\s*\(" + C_STRINGS.pattern + r"\s*\)\s*;\s*\}")
+VCVTB = re.compile(r'__asm\s*\(\s*"(vcvtb\.f16\.f32[^"]*)"\s*:\s*"=t"')
+STACK = re.compile(r"fault_rec_stack\s*\[\s*(\d+)\s*/\s*4\s*\]")
+
+
+def flags():
+    return ["-I" + os.path.join(ROOT, inc) for inc in INCLUDES] + [
+        "-D" + d for d in DEFINES]
+
+
+def run(cmd):
+    result = subprocess.run(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        raise SystemExit("failed: " + " ".join(cmd))
+    return result.stdout
+
+
+def preprocess(cc, src):
+    return run([cc, "-E", "-P"] + flags() + [os.path.join(ROOT, src)])
+
+
+def c_string(literals):
+    """Concatenate adjacent C string literals and decode the escapes."""
+    text = "".join(re.findall(r'"((?:[^"\\]|\\.)*)"', literals))
+    return text.encode().decode("unicode_escape")
+
+
+def ir_string(text):
+    return text.replace("\\", "\\5C").replace('"', "\\22").replace("\n", "\\0A")
+
+
+def build_ir(handlers, vcvtb, stack_words):
+    lines = ['target triple = "%s"' % TRIPLE]
+    for name, asm in handlers.items():
+        lines += [
+            "define void @%s() #0 {" % name,
+            '  call void asm sideeffect "%s", ""()' % ir_string(asm.replace("$", "$$")),
+            "  unreachable",
+            "}",
+        ]
+    template = vcvtb.replace("%0", "$0").replace("%1", "$1")
+    lines += [
+        "define i16 @fault_rec_half(float %v) {",
+        '  %%h = call float asm "%s", "=t,t"(float %%v)' % ir_string(template),
+        "  %b = bitcast float %h to i32",
+        "  %r = trunc i32 %b to i16",
+        "  ret i16 %r",
+        "}",
+        "@fault_rec_stack = global [%d x i32] zeroinitializer, align 8" % stack_words,
+        "declare void @fault_rec_fault(i32*, i32, i32)",
+        "attributes #0 = { naked noinline nounwind }",
+    ]
+    return "\n".join(lines) + "\n"
+
+
+def split_functions(disasm):
+    """Map function name -> its disassembly text."""
+    funcs = {}
+    for part in re.split(r"\n(?=[0-9a-f]+ <)", disasm):
+        match = re.match(r"[0-9a-f]+ <(\w+)>:", part)
+        if match:
+            funcs[match.group(1)] = part
+    return funcs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--cc", default="cc")
+    parser.add_argument("--llc", default="llc")
+    parser.add_argument("--objdump", default="llvm-objdump")
+    args = parser.parse_args()
+    errors = []
+
+    for src in (IT_SRC, FAULT_SRC):
+        run([args.cc, "-fsyntax-only", "-w"] + flags() +
+            [os.path.join(ROOT, src)])
+
+    handlers = {m.group(1): c_string(m.group(2))
+                for m in NAKED.finditer(preprocess(args.cc, IT_SRC))}
+    for name in HANDLERS:
+        if name not in handlers:
+            errors.append("%s is not a naked FAULT_REC_HANDLER" % name)
+    fault_i = preprocess(args.cc, FAULT_SRC)
+    vcvtb = VCVTB.search(fault_i)
+    stack = STACK.search(fault_i)
+    if vcvtb is None:
+        errors.append("vcvtb inline asm not found in fault_rec.c")
+    if stack is None:
+        errors.append("fault_rec_stack not found in fault_rec.c")
+    if errors:
+        raise SystemExit("\n".join(errors))
+    stack_bytes = int(stack.group(1))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        ll = os.path.join(tmp, "fault_rec_asm.ll")
+        obj = os.path.join(tmp, "fault_rec_asm.o")
+        with open(ll, "w") as f:
+            f.write(build_ir(handlers, vcvtb.group(1), stack_bytes // 4))
+        run([args.llc, "-mtriple=" + TRIPLE, "-mcpu=cortex-m4",
+             "-mattr=+vfp4d16sp", "-filetype=obj", ll, "-o", obj])
+        disasm = run([args.objdump, "-d", "-r", "--triple=thumbv7em", obj])
+
+    funcs = split_functions(disasm)
+    for name, fault_type in HANDLERS.items():
+        text = funcs.get(name, "")
+        expect = [
+            (r"movs\s+r2, #%d\b" % fault_type, "fault type %d" % fault_type),
+            (r"movw\s+r3, #%d\s+\S+\s+R_ARM_THM_MOVW_ABS_NC\s+fault_rec_stack\b"
+             % stack_bytes, "movw of the fault stack top"),
+            (r"movt\s+r3, #%d\s+\S+\s+R_ARM_THM_MOVT_ABS\s+fault_rec_stack\b"
+             % stack_bytes, "movt of the fault stack top"),
+            (r"msr\s+msp, r3", "switch to the fault stack"),
+            (r"R_ARM_THM_JUMP24\s+fault_rec_fault\b", "branch to fault_rec_fault"),
+        ]
+        for pattern, what in expect:
+            if not re.search(pattern, text):
+                errors.append("%s: missing %s" % (name, what))
+        switch = text.find("msr\tmsp")
+        if switch != -1 and switch < text.find("mrsne"):
+            errors.append("%s: msp is switched before the old sp is read" % name)
+    if not re.search(r"vcvtb\.f16\.f32\s+s\d+, s\d+",
+                     funcs.get("fault_rec_half", "")):
+        errors.append("fault_rec_half: vcvtb.f16.f32 not assembled")
+
+    if errors:
+        print(disasm)
+        raise SystemExit("\n".join(errors))
+    print("%d fault handlers and vcvtb assembled for %s, fault stack %d bytes"
+          % (len(HANDLERS), TRIPLE, stack_bytes))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+/**
+ * @file    bench_num_fmt.c
+ * @author  Deadline--
+ * @brief   遥测文本格式化的主机耗时测试
+ * @version 0.1
+ * @date    2023-12-17
+ * @note    按`ak_state_format()`的格式"位置,速度,电流,温度,错误码\r\n"
+ *          输出一行, 与原来的`snprintf("%.2f,%.2f,%.2f,%d,%d\r\n")`比较.
+ *          主机上的结果只用于比较, 不代表Cortex-M4上的耗时.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "num_fmt.h"
+
+/* 不同状态的个数 */
+#define STATE_COUNT 1024U
+/* 每种方法的格式化行数 */
+#define BENCH_COUNT 2000000U
+
+typedef struct {
+    float pos;
+    float spd;
+    float cur;
+    int32_t temperature;
+    uint32_t error;
+} state_t;
+
+static state_t states[STATE_COUNT];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief 与`ak_state_format()`相同的拼接方式
+ *
+ */
+static uint32_t format_num_fmt(char* buf, const state_t* s) {
+    uint32_t n = 0;
+    n += num_fmt_fixed(buf + n, s->pos, 2);
+    buf[n++] = ',';
+    n += num_fmt_fixed(buf + n, s->spd, 2);
+    buf[n++] = ',';
+    n += num_fmt_fixed(buf + n, s->cur, 2);
+    buf[n++] = ',';
+    n += num_fmt_int(buf + n, s->temperature);
+    buf[n++] = ',';
+    n += num_fmt_uint(buf + n, s->error);
+    buf[n++] = '\r';
+    buf[n++] = '\n';
+    return n;
+}
+
+static uint32_t format_snprintf(char* buf, const state_t* s) {
+    return (uint32_t)snprintf(buf, 64, "%.2f,%.2f,%.2f,%d,%d\r\n", s->pos,
+                              s->spd, s->cur, (int)s->temperature,
+                              (int)s->error);
+}
+
+int main(void) {
+    static char buf[64];
+
+    srand(1);
+    for (uint32_t i = 0; i < STATE_COUNT; i++) {
+        states[i].pos = (rand() % 25000 - 12500) / 1000.0f;
+        states[i].spd = (rand() % 100000 - 50000) / 1000.0f;
+        states[i].cur = (rand() % 60000 - 30000) / 1000.0f;
+        states[i].temperature = rand() % 100 - 20;
+        states[i].error = (uint32_t)rand() % 8U;
+    }
+
+    uint32_t total = 0;
+    double start = now_s();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        total += format_snprintf(buf, &states[i % STATE_COUNT]);
+    }
+    printf("%-10s %7.1f ns/line  (%lu chars)\r\n", "snprintf",
+           (now_s() - start) * 1e9 / BENCH_COUNT, (unsigned long)total);
+
+    total = 0;
+    start = now_s();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        total += format_num_fmt(buf, &states[i % STATE_COUNT]);
+    }
+    printf("%-10s %7.1f ns/line  (%lu chars)\r\n", "num_fmt",
+           (now_s() - start) * 1e9 / BENCH_COUNT, (unsigned long)total);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file    bench_num_parse.c
+ * @author  Deadline--
+ * @brief   文本指令解析的主机耗时测试
+ * @version 0.1
+ * @date    2023-12-16
+ * @note    与原来的`strtok` + `atof`解析比较, 指令行与`mit_mode_ctrl.py`
+ *          发送的格式相同(5个字段, 3位小数). 两种方法都先把指令拷贝到
+ *          接收缓冲区, 因为`strtok`会修改字符串.
+ *          主机上的结果只用于比较, 不代表Cortex-M4上的耗时.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "num_parse.h"
+
+/* 不同指令行的个数 */
+#define LINE_COUNT 1024U
+/* 每种方法的解析行数 */
+#define BENCH_COUNT 2000000U
+/* 每行字段数 */
+#define FIELD_COUNT 5U
+
+static char lines[LINE_COUNT][64];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief 原来的解析方法
+ *
+ */
+static void parse_strtok_atof(char* buf, float* values) {
+    char* token = strtok(buf, ",");
+    for (uint32_t i = 0; i < FIELD_COUNT && token != NULL; i++) {
+        values[i] = (float)atof(token);
+        token = strtok(NULL, ",");
+    }
+}
+
+static void report(const char* name, double seconds, float sum) {
+    printf("%-16s %7.1f ns/line  (sum %g)\r\n", name,
+           seconds * 1e9 / BENCH_COUNT, sum);
+}
+
+int main(void) {
+    static char buf[64];
+    float values[FIELD_COUNT];
+    uint32_t mismatches = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < LINE_COUNT; i++) {
+        snprintf(lines[i], sizeof(lines[i]), "%.3f,%.3f,%.3f,%.3f,%.3f\r\n",
+                 (rand() % 25000 - 12500) / 1000.0, (rand() % 50000) / 1000.0,
+                 (rand() % 5000) / 1000.0, (rand() % 5000) / 1000.0,
+                 (rand() % 18000 - 9000) / 1000.0);
+    }
+
+    /* 两种方法的结果一致(相差不超过float的2个ulp), 耗时比较才有意义 */
+    for (uint32_t i = 0; i < LINE_COUNT; i++) {
+        float expected[FIELD_COUNT];
+        strcpy(buf, lines[i]);
+        parse_strtok_atof(buf, expected);
+        if (num_parse_csv(lines[i], values, FIELD_COUNT, 0.0f, NULL) !=
+            NUM_PARSE_OK) {
+            mismatches++;
+            continue;
+        }
+        for (uint32_t j = 0; j < FIELD_COUNT; j++) {
+            if (fabsf(values[j] - expected[j]) >
+                2.0f * FLT_EPSILON * fabsf(expected[j])) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    if (mismatches != 0) {
+        printf("bench_num_parse: %lu lines differ from atof\r\n",
+               (unsigned long)mismatches);
+        return 1;
+    }
+
+    float sum = 0.0f;
+    double start = now_s();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        strcpy(buf, lines[i % LINE_COUNT]);
+        parse_strtok_atof(buf, values);
+        sum += values[i % FIELD_COUNT];
+    }
+    report("strtok + atof", now_s() - start, sum);
+
+    sum = 0.0f;
+    start = now_s();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        strcpy(buf, lines[i % LINE_COUNT]);
+        num_parse_csv(buf, values, FIELD_COUNT, 0.0f, NULL);
+        sum += values[i % FIELD_COUNT];
+    }
+    report("num_parse_csv", now_s() - start, sum);
+    return 0;
+}
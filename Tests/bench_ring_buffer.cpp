@@ -0,0 +1,143 @@
+/**
+ * @file    bench_ring_buffer.cpp
+ * @author  Deadline--
+ * @brief   无锁队列的主机吞吐量测试
+ * @version 0.1
+ * @date    2023-12-05
+ * @note    分别测量单线程连续写入读出, 以及生产者和消费者在不同线程时
+ *          每秒传递的元素个数. 元素取CAN帧大小(16字节).
+ *          主机上的结果只用于比较不同实现, 不代表Cortex-M4上的耗时;
+ *          队列满或空时让出CPU, 多线程项的结果受主机核数影响.
+ */
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+
+/* 每项测试传递的元素个数 */
+#define BENCH_COUNT 4000000U
+/* MPSC测试的生产者个数 */
+#define BENCH_PRODUCERS 2U
+
+/* 与CAN发送队列的元素大小相同 */
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+    uint8_t data[8];
+} frame_t;
+
+static double elapsed_s(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+}
+
+static void report(const char* name, uint32_t count, double seconds) {
+    printf("%-28s %8.2f Mitem/s  %6.1f ns/item\r\n", name,
+           count / seconds / 1e6, seconds * 1e9 / count);
+}
+
+static void bench_spsc_single(void) {
+    static Spsc_Ring<frame_t, 64> ring;
+    frame_t frame = {0x141, 8, {0}};
+    uint32_t sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        frame.id = i;
+        ring.push(frame);
+        ring.pop(frame);
+        sum += frame.id;
+    }
+    report("spsc push+pop, 1 thread", BENCH_COUNT, elapsed_s(start));
+    if (sum != (uint32_t)((uint64_t)BENCH_COUNT * (BENCH_COUNT - 1) / 2)) {
+        printf("spsc checksum mismatch\r\n");
+    }
+}
+
+static void bench_mpsc_single(void) {
+    static Mpsc_Queue<frame_t, 64> queue;
+    frame_t frame = {0x141, 8, {0}};
+    uint32_t sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        frame.id = i;
+        queue.push(frame);
+        queue.pop(frame);
+        sum += frame.id;
+    }
+    report("mpsc push+pop, 1 thread", BENCH_COUNT, elapsed_s(start));
+    if (sum != (uint32_t)((uint64_t)BENCH_COUNT * (BENCH_COUNT - 1) / 2)) {
+        printf("mpsc checksum mismatch\r\n");
+    }
+}
+
+static void bench_spsc_threads(void) {
+    static Spsc_Ring<frame_t, 64> ring;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([] {
+        frame_t frame = {0x141, 8, {0}};
+        for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+            frame.id = i;
+            while (!ring.push(frame)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    frame_t frame;
+    for (uint32_t i = 0; i < BENCH_COUNT;) {
+        if (ring.pop(frame)) {
+            i++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    report("spsc 1 producer thread", BENCH_COUNT, elapsed_s(start));
+}
+
+static void bench_mpsc_threads(void) {
+    static Mpsc_Queue<frame_t, 64> queue;
+    const uint32_t per_producer = BENCH_COUNT / BENCH_PRODUCERS;
+    std::vector<std::thread> producers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t id = 0; id < BENCH_PRODUCERS; id++) {
+        producers.emplace_back([per_producer] {
+            frame_t frame = {0x141, 8, {0}};
+            for (uint32_t i = 0; i < per_producer; i++) {
+                frame.id = i;
+                while (!queue.push(frame)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    frame_t frame;
+    for (uint32_t i = 0; i < per_producer * BENCH_PRODUCERS;) {
+        if (queue.pop(frame)) {
+            i++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    report("mpsc 2 producer threads", per_producer * BENCH_PRODUCERS,
+           elapsed_s(start));
+}
+
+int main(void) {
+    bench_spsc_single();
+    bench_mpsc_single();
+    bench_spsc_threads();
+    bench_mpsc_threads();
+    return 0;
+}
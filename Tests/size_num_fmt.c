@@ -0,0 +1,32 @@
+/**
+ * @file    size_num_fmt.c
+ * @author  Deadline--
+ * @brief   比较num_fmt与printf浮点支持占用的flash
+ * @version 0.1
+ * @date    2023-12-17
+ * @note    用arm-none-eabi-gcc编译两次: 定义`USE_PRINTF_FLOAT`时用
+ *          `snprintf("%.2f")`输出浮点数, 并链接`_printf_float`;
+ *          否则用`num_fmt_fixed()`. 两种都保留一次整数`snprintf`,
+ *          与固件中其他printf的用法相同, 差值只包含浮点格式化部分.
+ */
+
+#include <stdio.h>
+
+#ifndef USE_PRINTF_FLOAT
+#include "num_fmt.h"
+#endif /* USE_PRINTF_FLOAT */
+
+volatile float value = 1.25f;
+volatile int count = 3;
+char line[64];
+
+int main(void) {
+    int n = snprintf(line, sizeof(line), "#count %d,", count);
+#ifdef USE_PRINTF_FLOAT
+    n += snprintf(line + n, sizeof(line) - n, "%.2f", value);
+#else
+    n += (int)num_fmt_fixed(line + n, value, 2);
+#endif /* USE_PRINTF_FLOAT */
+    line[n] = '\0';
+    return 0;
+}
@@ -0,0 +1,38 @@
+# 编译size_num_fmt.c的两个版本并输出arm-none-eabi-size的结果
+# 参数: ARM_GCC, ARM_SIZE, REPO_ROOT, OUT_DIR
+set(FLAGS -mcpu=cortex-m4 -mthumb -mfloat-abi=hard -mfpu=fpv4-sp-d16 -Os
+    -ffunction-sections -fdata-sections -Wl,--gc-sections
+    --specs=nano.specs --specs=nosys.specs
+    -I${REPO_ROOT}/Middlewares/Inc)
+set(SRC ${REPO_ROOT}/Tests/size_num_fmt.c)
+
+execute_process(
+    COMMAND ${ARM_GCC} ${FLAGS} ${SRC} ${REPO_ROOT}/Middlewares/Src/num_fmt.c
+            -o ${OUT_DIR}/size_num_fmt.elf
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "num_fmt build failed")
+endif()
+execute_process(
+    COMMAND ${ARM_GCC} ${FLAGS} -DUSE_PRINTF_FLOAT -u _printf_float ${SRC}
+            -o ${OUT_DIR}/size_printf_float.elf
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "printf float build failed")
+endif()
+
+execute_process(
+    COMMAND ${ARM_SIZE} ${OUT_DIR}/size_num_fmt.elf
+            ${OUT_DIR}/size_printf_float.elf
+    OUTPUT_VARIABLE sizes)
+message("${sizes}")
+
+# 第二行和第三行的第一列是text
+string(REGEX MATCHALL "\n[ \t]*[0-9]+" text "${sizes}")
+list(GET text 0 num_fmt_text)
+list(GET text 1 printf_text)
+string(STRIP "${num_fmt_text}" num_fmt_text)
+string(STRIP "${printf_text}" printf_text)
+math(EXPR saved "${printf_text} - ${num_fmt_text}")
+message("num_fmt text ${num_fmt_text}, printf float text ${printf_text}, "
+        "saved ${saved} bytes")
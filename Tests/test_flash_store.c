@@ -0,0 +1,146 @@
+/**
+ * @file    test_flash_store.c
+ * @author  Deadline--
+ * @brief   参数存储掉电保护的主机测试
+ * @version 0.1
+ * @date    2023-12-28
+ * @note    使用flash_store.c的主机实现(RAM模拟NOR flash).
+ *          `flash_store_host_cut()`让编程在任意一个字之后失败, 模拟写入
+ *          和扇区轮换中途掉电, 恢复供电后重新扫描, 检查读出的是上一条
+ *          或者新的一条完整记录, 并且之后还能继续保存.
+ */
+
+#include <stdio.h>
+
+#include "flash_store.h"
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: CHECK(%s) failed\r\n", __FILE__, __LINE__,   \
+                   #cond);                                              \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* 一条4字节记录编程的字数: 记录头 + 数据 */
+#define RECORD_WORDS (FLASH_STORE_HDR_SIZE / 4U + 1U)
+
+static int failures = 0;
+
+/**
+ * @brief 模拟重新上电后读出记录
+ *
+ * @return uint32_t 读出的值, 没有有效记录时返回0
+ */
+static uint32_t reload(void) {
+    uint32_t value = 0, len = 0;
+    flash_store_host_cut(UINT32_MAX);
+    if (flash_store_load(&value, sizeof(value), &len) != FLASH_STORE_OK ||
+        len != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+/**
+ * @brief 连续保存, 跨过多次扇区轮换
+ *
+ */
+static void test_save_load(void) {
+    uint32_t value = 0, len = 0;
+    flash_store_host_reset();
+    CHECK(flash_store_load(&value, sizeof(value), &len) == FLASH_STORE_EMPTY);
+
+    for (uint32_t i = 1; i <= 3 * FLASH_STORE_SLOT_NUM; i++) {
+        CHECK(flash_store_save(&i, sizeof(i)) == FLASH_STORE_OK);
+    }
+    CHECK(reload() == 3 * FLASH_STORE_SLOT_NUM);
+
+    uint8_t big[FLASH_STORE_MAX_LEN + 1] = {0};
+    CHECK(flash_store_save(big, sizeof(big)) == FLASH_STORE_ERR_LEN);
+    CHECK(reload() == 3 * FLASH_STORE_SLOT_NUM);
+}
+
+/**
+ * @brief 写入一条记录的每个字之后掉电
+ *
+ */
+static void test_torn_write(void) {
+    flash_store_host_reset();
+    uint32_t old_value = 100;
+    CHECK(flash_store_save(&old_value, sizeof(old_value)) == FLASH_STORE_OK);
+
+    for (uint32_t cut = 0; cut <= RECORD_WORDS; cut++) {
+        uint32_t new_value = 1000 + cut;
+        flash_store_host_cut(cut);
+        flash_store_status_t status =
+            flash_store_save(&new_value, sizeof(new_value));
+        uint32_t value = reload();
+        if (status == FLASH_STORE_OK) {
+            CHECK(value == new_value);
+        } else {
+            /* 没写完的记录不能被当成有效记录 */
+            CHECK(value == old_value);
+        }
+
+        /* 掉电留下的半条记录不影响之后的保存 */
+        old_value = 2000 + cut;
+        CHECK(flash_store_save(&old_value, sizeof(old_value)) ==
+              FLASH_STORE_OK);
+        CHECK(reload() == old_value);
+    }
+}
+
+/**
+ * @brief 当前扇区写满, 轮换时擦除失败或新扇区写入中途掉电
+ *
+ * @param cut 轮换时还能编程的字数, 0表示擦除前就掉电
+ */
+static void test_swap_cut(uint32_t cut) {
+    flash_store_info_t info;
+    uint32_t value = 0;
+
+    flash_store_host_reset();
+    do {
+        value++;
+        CHECK(flash_store_save(&value, sizeof(value)) == FLASH_STORE_OK);
+        flash_store_info(&info);
+    } while (info.slot != FLASH_STORE_SLOT_NUM - 1);
+    uint32_t sector = info.sector;
+
+    uint32_t new_value = 77;
+    flash_store_host_cut(cut);
+    CHECK(flash_store_save(&new_value, sizeof(new_value)) != FLASH_STORE_OK);
+    CHECK(reload() == value);
+    flash_store_info(&info);
+    CHECK(info.sector == sector);
+
+    /* 恢复供电后轮换到另一个扇区 */
+    CHECK(flash_store_save(&new_value, sizeof(new_value)) == FLASH_STORE_OK);
+    CHECK(reload() == new_value);
+    flash_store_info(&info);
+    CHECK(info.sector != sector && info.slot == 0);
+}
+
+static void test_erase(void) {
+    uint32_t value = 5, len = 0;
+    flash_store_host_reset();
+    CHECK(flash_store_save(&value, sizeof(value)) == FLASH_STORE_OK);
+    CHECK(flash_store_erase() == FLASH_STORE_OK);
+    flash_store_host_cut(UINT32_MAX);
+    CHECK(flash_store_load(&value, sizeof(value), &len) == FLASH_STORE_EMPTY);
+}
+
+int main(void) {
+    test_save_load();
+    test_torn_write();
+    test_swap_cut(0);
+    for (uint32_t cut = 1; cut < RECORD_WORDS; cut++) {
+        test_swap_cut(cut);
+    }
+    test_erase();
+
+    printf("test_flash_store: %s\r\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
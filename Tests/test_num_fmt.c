@@ -0,0 +1,101 @@
+/**
+ * @file    test_num_fmt.c
+ * @author  Deadline--
+ * @brief   定点十进制数格式化的主机测试
+ * @version 0.1
+ * @date    2023-12-17
+ * @note    随机数值与`snprintf("%.*f")`比较, 只允许最后一位因为舍入方式
+ *          不同而相差1, 负零按"0.00"比较.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "num_fmt.h"
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: CHECK(%s) failed\r\n", __FILE__, __LINE__,   \
+                   #cond);                                              \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* 随机用例个数 */
+#define RANDOM_COUNT 200000U
+
+static int failures = 0;
+
+static const char* fmt_fixed(float value, uint32_t decimals) {
+    static char buf[NUM_FMT_MAX_LEN + 1];
+    buf[num_fmt_fixed(buf, value, decimals)] = '\0';
+    return buf;
+}
+
+static const char* fmt_int(int32_t value) {
+    static char buf[12];
+    buf[num_fmt_int(buf, value)] = '\0';
+    return buf;
+}
+
+static const char* fmt_uint(uint32_t value) {
+    static char buf[11];
+    buf[num_fmt_uint(buf, value)] = '\0';
+    return buf;
+}
+
+static void test_cases(void) {
+    CHECK(strcmp(fmt_uint(0), "0") == 0);
+    CHECK(strcmp(fmt_uint(4294967295U), "4294967295") == 0);
+    CHECK(strcmp(fmt_int(-2147483647 - 1), "-2147483648") == 0);
+    CHECK(strcmp(fmt_int(-40), "-40") == 0);
+
+    CHECK(strcmp(fmt_fixed(-12.499f, 2), "-12.50") == 0);
+    CHECK(strcmp(fmt_fixed(0.999f, 2), "1.00") == 0);
+    CHECK(strcmp(fmt_fixed(-0.001f, 2), "0.00") == 0);
+    CHECK(strcmp(fmt_fixed(3.7f, 0), "4") == 0);
+    CHECK(strcmp(fmt_fixed(1.00006f, 4), "1.0001") == 0);
+    CHECK(strcmp(fmt_fixed(NAN, 2), "nan") == 0);
+    /* 放大后超过UINT32_MAX时饱和 */
+    CHECK(strcmp(fmt_fixed(1e9f, 2), "42949672.95") == 0);
+    CHECK(strcmp(fmt_fixed(-INFINITY, 2), "-42949672.95") == 0);
+    /* 超过最大位数按最大位数处理 */
+    CHECK(strcmp(fmt_fixed(0.5f, 9), "0.5000") == 0);
+}
+
+static void test_random(void) {
+    char expected[32];
+    uint32_t errors = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < RANDOM_COUNT; i++) {
+        uint32_t decimals = i % (NUM_FMT_MAX_DECIMALS + 1);
+        float value = ((rand() % 2000001) - 1000000) / 1000.0f;
+        if (i % 3 != 0) {
+            value *= 0.0125f;
+        }
+        const char* out = fmt_fixed(value, decimals);
+        snprintf(expected, sizeof(expected), "%.*f", (int)decimals, value);
+        if (expected[0] == '-' && strspn(expected, "-0.") == strlen(expected)) {
+            memmove(expected, expected + 1, strlen(expected));
+        }
+        if (strcmp(out, expected) != 0 &&
+            fabs(atof(out) - atof(expected)) > 1.01 * pow(10.0, -decimals)) {
+            if (errors++ < 10) {
+                printf("%.9g: %s != %s\r\n", value, out, expected);
+            }
+        }
+    }
+    CHECK(errors == 0);
+}
+
+int main(void) {
+    test_cases();
+    test_random();
+
+    printf("test_num_fmt: %s\r\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
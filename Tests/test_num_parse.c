@@ -0,0 +1,106 @@
+/**
+ * @file    test_num_parse.c
+ * @author  Deadline--
+ * @brief   定格式十进制数解析的主机测试
+ * @version 0.1
+ * @date    2023-12-16
+ * @note    固定用例检查格式和错误位置, 随机用例与`strtod`的结果比较,
+ *          误差不超过float的2个ulp.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "num_parse.h"
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: CHECK(%s) failed\r\n", __FILE__, __LINE__,   \
+                   #cond);                                              \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* 随机用例个数 */
+#define RANDOM_COUNT 200000U
+
+static int failures = 0;
+
+typedef struct {
+    const char* line;
+    num_parse_status_t status;
+    uint32_t error_pos;
+} parse_case_t;
+
+static void test_cases(void) {
+    static const parse_case_t cases[] = {
+        {"1.5,-2,0.25,3,4", NUM_PARSE_OK, 0},
+        {"0,0,0,0,0\r\n", NUM_PARSE_OK, 0},
+        {" -12.345678 , 7.,.5,+1,2", NUM_PARSE_OK, 0},
+        {"1,2,3", NUM_PARSE_FIELD_COUNT, 5},
+        {"1,2,3,4,5,6", NUM_PARSE_FIELD_COUNT, 9},
+        {"1e3,1,1,1,1", NUM_PARSE_BAD_CHAR, 1},
+        {"1234567,1,1,1,1", NUM_PARSE_RANGE, 6},
+        {"abc", NUM_PARSE_EMPTY, 0},
+        {"-,1,1,1,1", NUM_PARSE_EMPTY, 1},
+        {"1,2,3,4,5x", NUM_PARSE_BAD_CHAR, 9},
+    };
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        float values[5] = {0};
+        uint32_t pos = 0;
+        num_parse_status_t status =
+            num_parse_csv(cases[i].line, values, 5, 0.0f, &pos);
+        CHECK(status == cases[i].status);
+        if (status != NUM_PARSE_OK) {
+            CHECK(pos == cases[i].error_pos);
+        }
+    }
+
+    float values[5] = {0};
+    uint32_t pos = 0;
+    CHECK(num_parse_csv(" -12.345678 , 7.,.5,+1,2", values, 5, 0.0f,
+                        &pos) == NUM_PARSE_OK);
+    CHECK(values[0] == -12.345678f && values[1] == 7.0f &&
+          values[2] == 0.5f && values[3] == 1.0f && values[4] == 2.0f);
+
+    /* 超出上限时不写入结果, 位置指向超限的字段 */
+    values[2] = 0.0f;
+    CHECK(num_parse_csv("1,2,300,4,5", values, 5, 100.0f, &pos) ==
+          NUM_PARSE_RANGE);
+    CHECK(pos == 4 && values[2] == 0.0f);
+}
+
+static void test_random(void) {
+    char line[32];
+    uint32_t errors = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < RANDOM_COUNT; i++) {
+        uint32_t int_part = (uint32_t)rand() % 1000000U;
+        uint32_t frac_part = (uint32_t)rand() % 1000000U;
+        snprintf(line, sizeof(line), "%s%lu.%06lu", (rand() & 1) ? "-" : "",
+                 (unsigned long)int_part, (unsigned long)frac_part);
+
+        float value = 0.0f;
+        uint32_t pos = 0;
+        float expected = (float)strtod(line, NULL);
+        if (num_parse_csv(line, &value, 1, 0.0f, &pos) != NUM_PARSE_OK ||
+            fabsf(value - expected) > 2.0f * FLT_EPSILON * fabsf(expected)) {
+            if (errors++ < 10) {
+                printf("%s: %.9g != %.9g\r\n", line, value, expected);
+            }
+        }
+    }
+    CHECK(errors == 0);
+}
+
+int main(void) {
+    test_cases();
+    test_random();
+
+    printf("test_num_parse: %s\r\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
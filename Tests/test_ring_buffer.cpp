@@ -0,0 +1,231 @@
+/**
+ * @file    test_ring_buffer.cpp
+ * @author  Deadline--
+ * @brief   无锁队列和侵入式链表的主机测试
+ * @version 0.1
+ * @date    2023-12-05
+ * @note    生产者和消费者跑在不同的线程上, 检查元素不丢失, 不重复,
+ *          同一个生产者的元素保持顺序. 队列容量取得很小, 让满和空的
+ *          边界以及下标回绕被反复触发. 等待时让出CPU, 单核主机上也能跑完.
+ */
+
+#include <stdio.h>
+
+#include <thread>
+#include <vector>
+
+#include "intrusive_list.hpp"
+#include "ring_buffer.h"
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: CHECK(%s) failed\r\n", __FILE__, __LINE__,   \
+                   #cond);                                              \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+/* 每个生产者写入的元素个数 */
+#define STRESS_COUNT 1000000U
+/* MPSC测试的生产者个数 */
+#define MPSC_PRODUCERS 4U
+
+static int failures = 0;
+
+/* 带校验字段的元素, 拷贝被撕裂时`check`对不上 */
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+    uint32_t check;
+} item_t;
+
+static uint32_t item_check(uint32_t producer, uint32_t seq) {
+    return (producer * 0x9E3779B9U) ^ ~seq;
+}
+
+/**
+ * @brief 单个线程内的边界: 满, 空, peek和回绕
+ *
+ */
+static void test_spsc_basic(void) {
+    Spsc_Ring<uint32_t, 4> ring;
+    uint32_t value = 0;
+
+    CHECK(ring.empty());
+    CHECK(!ring.pop(value));
+    CHECK(ring.peek() == NULL);
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            CHECK(ring.push(round * 4 + i));
+        }
+        CHECK(!ring.push(0xFFFFFFFFU));
+        CHECK(ring.space() == 0);
+        CHECK(*ring.peek() == round * 4);
+        for (uint32_t i = 0; i < 4; i++) {
+            CHECK(ring.pop(value) && value == round * 4 + i);
+        }
+        CHECK(ring.empty());
+    }
+}
+
+/**
+ * @brief 批量读写字节, 读写位置跨过存储区末尾
+ *
+ */
+static void test_spsc_bytes(void) {
+    uint8_t buf[16];
+    uint8_t out[16];
+    spsc_ring_t ring;
+    spsc_ring_init(&ring, buf, 1, sizeof(buf));
+
+    uint8_t next_write = 0;
+    uint8_t next_read = 0;
+    for (uint32_t round = 0; round < 100; round++) {
+        uint8_t data[11];
+        for (uint32_t i = 0; i < sizeof(data); i++) {
+            data[i] = next_write++;
+        }
+        CHECK(spsc_ring_write(&ring, data, sizeof(data)) == sizeof(data));
+        uint32_t len = spsc_ring_read(&ring, out, sizeof(out));
+        CHECK(len == sizeof(data));
+        for (uint32_t i = 0; i < len; i++) {
+            CHECK(out[i] == next_read);
+            next_read++;
+        }
+    }
+    CHECK(spsc_ring_write(&ring, out, sizeof(out)) == sizeof(out));
+    CHECK(spsc_ring_write(&ring, out, 1) == 0);
+}
+
+/**
+ * @brief 一个生产者线程和一个消费者线程
+ *
+ */
+static void test_spsc_stress(void) {
+    static Spsc_Ring<item_t, 8> ring;
+
+    std::thread producer([] {
+        for (uint32_t seq = 0; seq < STRESS_COUNT; seq++) {
+            item_t item = {0, seq, item_check(0, seq)};
+            while (!ring.push(item)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    while (expected < STRESS_COUNT) {
+        item_t item;
+        if (!ring.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.seq != expected || item.check != item_check(0, item.seq)) {
+            errors++;
+        }
+        expected = item.seq + 1;
+    }
+    producer.join();
+
+    CHECK(errors == 0);
+    CHECK(ring.empty());
+}
+
+/**
+ * @brief 多个生产者线程同时写入, 一个消费者线程读出
+ *
+ */
+static void test_mpsc_stress(void) {
+    static Mpsc_Queue<item_t, 16> queue;
+    std::vector<std::thread> producers;
+
+    for (uint32_t id = 0; id < MPSC_PRODUCERS; id++) {
+        producers.emplace_back([id] {
+            for (uint32_t seq = 0; seq < STRESS_COUNT; seq++) {
+                item_t item = {id, seq, item_check(id, seq)};
+                while (!queue.push(item)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint32_t next_seq[MPSC_PRODUCERS] = {0};
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    while (received < MPSC_PRODUCERS * STRESS_COUNT) {
+        item_t item;
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        received++;
+        if (item.producer >= MPSC_PRODUCERS ||
+            item.check != item_check(item.producer, item.seq)) {
+            errors++;
+            continue;
+        }
+        /* 同一个生产者的元素必须按顺序到达, 不丢失也不重复 */
+        if (item.seq != next_seq[item.producer]) {
+            errors++;
+        }
+        next_seq[item.producer] = item.seq + 1;
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    CHECK(errors == 0);
+    for (uint32_t id = 0; id < MPSC_PRODUCERS; id++) {
+        CHECK(next_seq[id] == STRESS_COUNT);
+    }
+    CHECK(queue.empty());
+}
+
+struct Node_Item {
+    uint32_t value;
+    List_Node node;
+};
+
+/**
+ * @brief 侵入式链表的插入, 删除和遍历
+ *
+ */
+static void test_intrusive_list(void) {
+    Intrusive_List<Node_Item, &Node_Item::node> list;
+    Node_Item items[4] = {{0, {}}, {1, {}}, {2, {}}, {3, {}}};
+
+    CHECK(list.empty());
+    CHECK(list.front() == NULL);
+    list.push_back(items[1]);
+    list.push_back(items[2]);
+    list.push_front(items[0]);
+    list.push_back(items[3]);
+
+    uint32_t expected = 0;
+    for (Node_Item& item : list) {
+        CHECK(item.value == expected);
+        expected++;
+    }
+    CHECK(expected == 4);
+
+    Intrusive_List<Node_Item, &Node_Item::node>::remove(items[2]);
+    CHECK(list.pop_front() == &items[0]);
+    CHECK(list.pop_front() == &items[1]);
+    CHECK(list.pop_front() == &items[3]);
+    CHECK(list.pop_front() == NULL);
+    CHECK(list.empty());
+}
+
+int main(void) {
+    test_spsc_basic();
+    test_spsc_bytes();
+    test_spsc_stress();
+    test_mpsc_stress();
+    test_intrusive_list();
+
+    printf("test_ring_buffer: %s\r\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
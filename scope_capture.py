@@ -0,0 +1,235 @@
+"""Triggered scope capture over the USART1 binary protocol.
+
+Selects signals, arms the on-target scope, waits for the trigger, uploads the
+buffer and writes it as CSV. Frame format and commands are documented in
+Middlewares/Inc/bin_frame.h and Middlewares/Inc/scope.h.
+
+Examples:
+    python scope_capture.py COM3 --list
+    python scope_capture.py COM3 -s pos,spd,mit.pos,error -t error --edge change
+    python scope_capture.py COM3 -s t_us,pos,spd -t pos --edge rising --level 1.0 --pre 500
+    python scope_capture.py COM3 --read -o last.csv
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import time
+import zlib
+
+import serial
+
+SYNC = 0xA5
+REPLY = 0x80
+
+CMD_LIST = 0x10
+CMD_ARM = 0x11
+CMD_FORCE = 0x12
+CMD_STOP = 0x13
+CMD_STATUS = 0x14
+CMD_READ = 0x15
+
+READ_MAX_WORDS = 63
+# SCOPE_BUF_WORDS in scope.h
+BUF_WORDS = 4096
+
+STATES = ["idle", "armed", "triggered", "done"]
+EDGES = {"now": 0, "rising": 1, "falling": 2, "change": 3}
+ERRORS = ["ok", "bad argument", "busy", "wrong state", "bad format"]
+# type codes from param_type_t
+TYPES = {0: "f", 1: "I", 2: "i"}
+
+
+class ScopeError(Exception):
+    pass
+
+
+def build_frame(cmd, payload=b""):
+    body = bytes([cmd, len(payload)]) + payload
+    return bytes([SYNC]) + body + struct.pack("<I", zlib.crc32(body))
+
+
+def read_frame(ser, cmd, timeout=1.0):
+    """Read the reply to `cmd`, skipping text lines and damaged frames."""
+    buf = bytearray()
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        buf += ser.read(ser.in_waiting or 1)
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                buf.clear()
+                break
+            del buf[:start]
+            if len(buf) < 3:
+                break
+            total = 3 + buf[2] + 4
+            if len(buf) < total:
+                break
+            body = bytes(buf[1:total - 4])
+            (crc,) = struct.unpack_from("<I", buf, total - 4)
+            if crc != zlib.crc32(body) or body[0] != (cmd | REPLY):
+                del buf[:1]
+                continue
+            return body[2:]
+    raise ScopeError("no reply to command 0x%02X" % cmd)
+
+
+def request(ser, cmd, payload=b"", retries=3):
+    for _ in range(retries):
+        ser.reset_input_buffer()
+        ser.write(build_frame(cmd, payload))
+        try:
+            reply = read_frame(ser, cmd)
+        except ScopeError:
+            continue
+        if reply[0] != 0:
+            raise ScopeError("command 0x%02X failed: %s"
+                             % (cmd, ERRORS[reply[0]] if reply[0] < len(ERRORS)
+                                else reply[0]))
+        return reply[1:]
+    raise ScopeError("no reply to command 0x%02X" % cmd)
+
+
+def list_signals(ser):
+    signals = {}
+    start = 0
+    while True:
+        reply = request(ser, CMD_LIST, bytes([start]))
+        total = reply[0]
+        pos = 1
+        while pos < len(reply):
+            sid, stype, nlen = reply[pos], reply[pos + 1], reply[pos + 2]
+            name = reply[pos + 3:pos + 3 + nlen].decode("ascii")
+            signals[sid] = (name, stype)
+            pos += 3 + nlen
+        if len(signals) >= total or pos == 1:
+            return signals
+        start = max(signals) + 1
+
+
+def read_status(ser):
+    reply = request(ser, CMD_STATUS)
+    head = "<BHHHBBfB"
+    state, decim, pre, depth, mode, ch, level, num = struct.unpack_from(
+        head, reply)
+    start = struct.calcsize(head)
+    ids = list(reply[start:start + num])
+    return {"state": state, "decimation": decim, "pre": pre, "depth": depth,
+            "mode": mode, "trig_ch": ch, "level": level, "signals": ids}
+
+
+def read_buffer(ser, words):
+    data = []
+    while len(data) < words:
+        count = min(READ_MAX_WORDS, words - len(data))
+        reply = request(ser, CMD_READ, struct.pack("<HB", len(data), count))
+        (offset,) = struct.unpack_from("<H", reply)
+        if offset != len(data):
+            raise ScopeError("read returned offset %d" % offset)
+        data.extend(struct.unpack_from("<%dI" % ((len(reply) - 2) // 4),
+                                       reply, 2))
+    return data
+
+
+def decode(data, status, signals):
+    """Split the word stream into rows and convert each word by its type."""
+    num = len(status["signals"])
+    fmts = [TYPES[signals[sid][1]] for sid in status["signals"]]
+    rows = []
+    for n in range(len(data) // num):
+        words = data[n * num:(n + 1) * num]
+        row = [struct.unpack("<" + f, struct.pack("<I", w))[0]
+               for f, w in zip(fmts, words)]
+        rows.append(row)
+    return rows
+
+
+def write_csv(path, rows, status, signals):
+    names = [signals[sid][0] for sid in status["signals"]]
+    with open(path, "w", newline="") as f:
+        out = csv.writer(f)
+        # sample index is relative to the trigger point
+        out.writerow(["sample"] + names)
+        for n, row in enumerate(rows):
+            out.writerow([(n - status["pre"]) * status["decimation"]] +
+                         ["%.6g" % v if isinstance(v, float) else v
+                          for v in row])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="AK motor demo scope capture")
+    parser.add_argument("port", help="serial port, e.g. COM3 or /dev/ttyUSB0")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    parser.add_argument("--list", action="store_true",
+                        help="list the available signals and exit")
+    parser.add_argument("-s", "--signals", default="t_us,pos,spd,torque",
+                        help="comma separated signal names")
+    parser.add_argument("-t", "--trig", help="trigger signal, default first")
+    parser.add_argument("--edge", choices=EDGES.keys(), default="now")
+    parser.add_argument("--level", type=float, default=0.0)
+    parser.add_argument("--pre", type=int, default=None,
+                        help="samples before the trigger, default 1/4 depth")
+    parser.add_argument("--decim", type=int, default=1,
+                        help="record every N control ticks")
+    parser.add_argument("--wait", type=float, default=60.0,
+                        help="seconds to wait for the trigger, then force it")
+    parser.add_argument("--read", action="store_true",
+                        help="only upload the last finished capture")
+    parser.add_argument("-o", "--output", default="scope.csv")
+    args = parser.parse_args()
+
+    ser = serial.Serial(args.port, args.baud, timeout=0.05)
+    signals = list_signals(ser)
+    if args.list:
+        for sid, (name, stype) in sorted(signals.items()):
+            print("%3d %-16s %s" % (sid, name, TYPES[stype]))
+        return 0
+
+    if not args.read:
+        by_name = {name: sid for sid, (name, _) in signals.items()}
+        chosen = [s.strip() for s in args.signals.split(",") if s.strip()]
+        trig = args.trig or chosen[0]
+        if trig not in chosen:
+            chosen.append(trig)
+        unknown = [s for s in chosen if s not in by_name]
+        if unknown:
+            print("unknown signals: " + ", ".join(unknown))
+            return 1
+        depth = BUF_WORDS // len(chosen)
+        pre = depth // 4 if args.pre is None else args.pre
+        payload = struct.pack("<HHBBfB", args.decim, pre, EDGES[args.edge],
+                              chosen.index(trig), args.level, len(chosen))
+        payload += bytes(by_name[s] for s in chosen)
+        request(ser, CMD_ARM, payload)
+        print("armed, waiting for trigger on %s" % trig)
+        deadline = time.time() + args.wait
+        forced = False
+        while True:
+            status = read_status(ser)
+            if status["state"] == 3:
+                break
+            if status["state"] == 0:
+                print("capture stopped")
+                return 1
+            if time.time() > deadline and not forced:
+                print("no trigger, forcing")
+                request(ser, CMD_FORCE)
+                forced = True
+            time.sleep(0.2)
+
+    status = read_status(ser)
+    if status["state"] != 3:
+        print("no finished capture (state %s)" % STATES[status["state"]])
+        return 1
+    words = status["depth"] * len(status["signals"])
+    data = read_buffer(ser, words)
+    rows = decode(data, status, signals)
+    write_csv(args.output, rows, status, signals)
+    print("%d samples written to %s" % (len(rows), args.output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())